@@ -2,7 +2,7 @@ QT += core gui multimedia
 greaterThan(QT_MAJOR_VERSION, 4) : QT += widgets
 
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++11 thread
 CONFIG -= app_bundle
 
 QMAKE_CFLAGS_RELEASE -= -O
@@ -10,6 +10,9 @@ QMAKE_CFLAGS_RELEASE -= -O1
 QMAKE_CFLAGS_RELEASE *= -O2
 QMAKE_CFLAGS_RELEASE -= -O3
 
+#RingBuffer aligns its indices to cache lines, which heap allocation only honours with aligned new
+!msvc: QMAKE_CXXFLAGS += -faligned-new
+
 DEFINES += QT_DEPRECATED_WARNINGS
 DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
 
@@ -26,6 +29,14 @@ SOURCES += ../src/qt/main.cpp \
     ../src/core/ee/dmac.cpp \
     ../src/qt/emuwindow.cpp \
     ../src/core/gscontext.cpp \
+    ../src/core/gsjit.cpp \
+    ../src/core/gsrasterizer.cpp \
+    ../src/core/console.cpp \
+    ../src/core/idleloop.cpp \
+    ../src/core/logger.cpp \
+    ../src/core/mmio.cpp \
+    ../src/core/options.cpp \
+    ../src/core/scheduler.cpp \
     ../src/core/ee/emotiondisasm.cpp \
     ../src/core/ee/emotionasm.cpp \
     ../src/core/ee/emotion_fpu.cpp \
@@ -41,7 +52,13 @@ SOURCES += ../src/qt/main.cpp \
     ../src/core/iop/cdvd.cpp \
     ../src/core/iop/sio2.cpp \
     ../src/core/ee/vu.cpp \
-    ../src/core/ee/emotion_vu0.cpp
+    ../src/core/ee/emotion_vu0.cpp \
+    ../src/core/ee/emotioncachedinterpreter.cpp \
+    ../src/core/ee/emotionfastmem.cpp \
+    ../src/core/ee/emotionjit.cpp \
+    ../src/core/ee/emotionpagetable.cpp \
+    ../src/core/jitcommon/emitter64.cpp \
+    ../src/core/jitcommon/jitcache.cpp
 
 HEADERS += \
     ../src/core/ee/emotion.hpp \
@@ -54,6 +71,15 @@ HEADERS += \
     ../src/core/ee/dmac.hpp \
     ../src/qt/emuwindow.hpp \
     ../src/core/gscontext.hpp \
+    ../src/core/gsjit.hpp \
+    ../src/core/console.hpp \
+    ../src/core/idleloop.hpp \
+    ../src/core/int128.hpp \
+    ../src/core/logger.hpp \
+    ../src/core/mmio.hpp \
+    ../src/core/options.hpp \
+    ../src/core/ringbuffer.hpp \
+    ../src/core/scheduler.hpp \
     ../src/core/ee/emotiondisasm.hpp \
     ../src/core/ee/emotionasm.hpp \
     ../src/core/gif.hpp \
@@ -67,4 +93,10 @@ HEADERS += \
     ../src/core/ee/intc.hpp \
     ../src/core/iop/cdvd.hpp \
     ../src/core/iop/sio2.hpp \
-    ../src/core/ee/vu.hpp
+    ../src/core/ee/vu.hpp \
+    ../src/core/ee/emotioncachedinterpreter.hpp \
+    ../src/core/ee/emotionfastmem.hpp \
+    ../src/core/ee/emotionjit.hpp \
+    ../src/core/ee/emotionpagetable.hpp \
+    ../src/core/jitcommon/emitter64.hpp \
+    ../src/core/jitcommon/jitcache.hpp
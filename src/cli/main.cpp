@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "../core/emulator.hpp"
+#include "../core/options.hpp"
+
+/**
+Headless runner for the core, for benchmarking and testing on machines without a display. Runs as fast as it can
+with no frame limiter until a frame or cycle limit is hit, optionally dumping framebuffers along the way.
+**/
+
+using namespace std;
+
+//For reporting speed relative to a real PS2
+#define EE_CLOCK_RATE 294912000.0
+
+static void print_usage()
+{
+    printf("Args: [BIOS] [ELF/ISO] [-frames count] [-cycles count] [-dump prefix] [-dumpevery frames] [-stats] %s\n",
+           Options::USAGE);
+    printf("At least one of -frames or -cycles is needed. Cycle limits are in EE cycles and rounded up to a whole "
+           "frame.\n");
+    printf("-dump writes the last frame to prefix.ppm, and with -dumpevery also every nth frame to prefix_N.ppm.\n");
+    printf("Or: -verifyraster count [seed] checks the GS rasterizer against known results, and its SSE path against its scalar one.\n");
+}
+
+static bool load_BIOS(Emulator* e, const char* name)
+{
+    ifstream BIOS_file(name, ios::binary | ios::in);
+    if (!BIOS_file.is_open())
+    {
+        printf("Failed to load PS2 BIOS from %s\n", name);
+        return false;
+    }
+    uint8_t* BIOS = new uint8_t[1024 * 1024 * 4];
+    BIOS_file.read((char*)BIOS, 1024 * 1024 * 4);
+    BIOS_file.close();
+    e->load_BIOS(BIOS);
+    delete[] BIOS;
+    return true;
+}
+
+static bool load_executable(Emulator* e, const char* name, bool skip_BIOS)
+{
+    string file_string = name;
+    string format = file_string.length() >= 4 ? file_string.substr(file_string.length() - 4) : "";
+    transform(format.begin(), format.end(), format.begin(), ::tolower);
+
+    if (format == ".elf")
+    {
+        ifstream exec_file(name, ios::binary | ios::in | ios::ate);
+        if (!exec_file.is_open())
+        {
+            printf("Failed to load %s\n", name);
+            return false;
+        }
+        uint32_t ELF_size = exec_file.tellg();
+        exec_file.seekg(0);
+        uint8_t* ELF = new uint8_t[ELF_size];
+        exec_file.read((char*)ELF, ELF_size);
+        exec_file.close();
+
+        e->load_ELF(ELF, ELF_size);
+        delete[] ELF;
+        if (skip_BIOS)
+            e->set_skip_BIOS_hack(SKIP_HACK::LOAD_ELF);
+    }
+    else if (format == ".iso")
+    {
+        if (!e->load_CDVD(name))
+        {
+            printf("Failed to load %s\n", name);
+            return false;
+        }
+        if (skip_BIOS)
+            e->set_skip_BIOS_hack(SKIP_HACK::LOAD_DISC);
+    }
+    else
+    {
+        printf("Unrecognized file format %s\n", format.c_str());
+        return false;
+    }
+    return true;
+}
+
+//Writes the current frame as a binary PPM. Returns false if there's no frame to dump.
+static bool dump_framebuffer(Emulator* e, const string& name)
+{
+    uint32_t* buffer = e->get_framebuffer();
+    int w, h;
+    e->get_inner_resolution(w, h);
+    if (!buffer || !w || !h)
+        return false;
+
+    FILE* file = fopen(name.c_str(), "wb");
+    if (!file)
+    {
+        printf("Failed to open %s\n", name.c_str());
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", w, h);
+
+    //The framebuffer is RGBA8888 in memory, PPM wants RGB
+    uint8_t* row = new uint8_t[w * 3];
+    for (int y = 0; y < h; y++)
+    {
+        uint8_t* pixels = (uint8_t*)&buffer[y * w];
+        for (int x = 0; x < w; x++)
+        {
+            row[x * 3] = pixels[x * 4];
+            row[x * 3 + 1] = pixels[x * 4 + 1];
+            row[x * 3 + 2] = pixels[x * 4 + 2];
+        }
+        fwrite(row, 1, w * 3, file);
+    }
+    delete[] row;
+    fclose(file);
+    return true;
+}
+
+//Checks the rasterizer on known and random triangles and fails on any difference. Needs no BIOS or game.
+static int verify_rasterizer(int argc, char** argv)
+{
+    int count = atoi(argv[2]);
+    uint32_t seed = argc > 3 ? strtoul(argv[3], nullptr, 0) : 1;
+    Emulator* e = new Emulator();
+    int mismatches = e->verify_gs_rasterizer(count, seed);
+    printf("Checked %d random triangles with seed %u: %d mismatches\n", count, seed, mismatches);
+    delete e;
+    return mismatches ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        print_usage();
+        return 1;
+    }
+    if (strcmp(argv[1], "-verifyraster") == 0)
+        return verify_rasterizer(argc, argv);
+
+    char* bios_name = argv[1];
+    char* file_name = argv[2];
+
+    Emulator* e = new Emulator();
+
+    bool skip_BIOS = false;
+    bool print_stats = false;
+    long long max_frames = 0;
+    long long max_cycles = 0;
+    string dump_prefix;
+    int dump_interval = 0;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+        {
+            i++;
+            max_frames = atoll(argv[i]);
+        }
+        else if (strcmp(argv[i], "-cycles") == 0 && i + 1 < argc)
+        {
+            i++;
+            max_cycles = atoll(argv[i]);
+        }
+        else if (strcmp(argv[i], "-dump") == 0 && i + 1 < argc)
+        {
+            i++;
+            dump_prefix = argv[i];
+        }
+        else if (strcmp(argv[i], "-dumpevery") == 0 && i + 1 < argc)
+        {
+            i++;
+            dump_interval = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "-stats") == 0)
+            print_stats = true;
+        else if (int used = Options::parse(e, argc, argv, i, skip_BIOS))
+            i += used - 1;
+        else
+        {
+            printf("Unrecognized argument %s\n", argv[i]);
+            print_usage();
+            delete e;
+            return 1;
+        }
+    }
+
+    if (max_frames <= 0 && max_cycles <= 0)
+    {
+        print_usage();
+        delete e;
+        return 1;
+    }
+
+    e->reset();
+    if (!load_BIOS(e, bios_name) || !load_executable(e, file_name, skip_BIOS))
+    {
+        delete e;
+        return 1;
+    }
+
+    typedef chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    double min_frame_time = 0.0, max_frame_time = 0.0;
+    long long frames = 0;
+    while ((max_frames <= 0 || frames < max_frames) && (max_cycles <= 0 || (long long)e->get_cycles() < max_cycles))
+    {
+        clock::time_point frame_start = clock::now();
+        e->run();
+        chrono::duration<double> frame_time = clock::now() - frame_start;
+        frames++;
+
+        if (frames == 1 || frame_time.count() < min_frame_time)
+            min_frame_time = frame_time.count();
+        if (frame_time.count() > max_frame_time)
+            max_frame_time = frame_time.count();
+
+        if (dump_interval > 0 && !dump_prefix.empty() && frames % dump_interval == 0)
+            dump_framebuffer(e, dump_prefix + "_" + to_string(frames) + ".ppm");
+    }
+    chrono::duration<double> elapsed = clock::now() - start;
+
+    if (!dump_prefix.empty() && !dump_framebuffer(e, dump_prefix + ".ppm"))
+        printf("No frame to dump\n");
+
+    if (print_stats)
+    {
+        double seconds = elapsed.count();
+        uint64_t cycles = e->get_cycles();
+        printf("Ran %lld frames (%llu EE cycles) in %.3f s\n", frames, (unsigned long long)cycles, seconds);
+        printf("%.2f FPS, %.1f%% of full speed\n", frames / seconds, cycles / EE_CLOCK_RATE / seconds * 100.0);
+        printf("Frame time: min %.2f ms, avg %.2f ms, max %.2f ms\n", min_frame_time * 1000.0,
+               seconds / frames * 1000.0, max_frame_time * 1000.0);
+        e->print_idle_loop_stats();
+    }
+
+    delete e;
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <vector>
+#include "console.hpp"
+
+static std::mutex registry_lock;
+static std::vector<GuestConsole*> consoles;
+static std::once_flag handlers_installed;
+
+static const int crash_signals[] = {SIGSEGV, SIGABRT, SIGFPE, SIGILL};
+
+constexpr int GuestConsole::FLUSH_INTERVAL_MS;
+constexpr size_t GuestConsole::MEMORY_SIZE;
+
+GuestConsole::GuestConsole() : target(CONSOLE_STDOUT), file(nullptr), line_ready(false), quit(false)
+{
+    flusher = std::thread(&GuestConsole::flusher_loop, this);
+    register_console(this);
+}
+
+GuestConsole::~GuestConsole()
+{
+    unregister_console(this);
+    {
+        std::lock_guard<std::mutex> lock(buffer_lock);
+        quit = true;
+    }
+    buffer_cond.notify_all();
+    flusher.join();
+
+    flush();
+    if (file)
+        fclose(file);
+}
+
+void GuestConsole::register_console(GuestConsole* console)
+{
+    std::call_once(handlers_installed, []
+    {
+        atexit(flush_all);
+        for (unsigned int i = 0; i < sizeof(crash_signals) / sizeof(int); i++)
+            std::signal(crash_signals[i], crash_handler);
+    });
+
+    std::lock_guard<std::mutex> lock(registry_lock);
+    consoles.push_back(console);
+}
+
+void GuestConsole::unregister_console(GuestConsole* console)
+{
+    std::lock_guard<std::mutex> lock(registry_lock);
+    consoles.erase(std::remove(consoles.begin(), consoles.end(), console), consoles.end());
+}
+
+void GuestConsole::flush_all()
+{
+    std::lock_guard<std::mutex> lock(registry_lock);
+    for (unsigned int i = 0; i < consoles.size(); i++)
+        consoles[i]->flush();
+}
+
+void GuestConsole::crash_handler(int signal)
+{
+    //No locking here, the crashing thread might be holding any of them
+    for (unsigned int i = 0; i < consoles.size(); i++)
+        consoles[i]->crash_flush();
+
+    //Let the signal take its usual course
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+void GuestConsole::crash_flush()
+{
+    if (target == CONSOLE_MEMORY || !output_lock.try_lock())
+        return;
+    if (buffer_lock.try_lock())
+    {
+        output(pending);
+        pending.clear();
+        buffer_lock.unlock();
+    }
+    output_lock.unlock();
+}
+
+void GuestConsole::flusher_loop()
+{
+    std::unique_lock<std::mutex> lock(buffer_lock);
+    while (!quit)
+    {
+        buffer_cond.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] { return line_ready || quit; });
+        if (pending.empty())
+            continue;
+
+        //output_lock comes first
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+void GuestConsole::flush()
+{
+    std::lock_guard<std::mutex> output_guard(output_lock);
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(buffer_lock);
+        text.swap(pending);
+        line_ready = false;
+    }
+    output(text);
+}
+
+void GuestConsole::output(const std::string& text)
+{
+    if (text.empty())
+        return;
+
+    switch (target)
+    {
+        case CONSOLE_FILE:
+            if (file)
+            {
+                fwrite(text.data(), 1, text.size(), file);
+                fflush(file);
+            }
+            break;
+        case CONSOLE_STDOUT:
+            fwrite(text.data(), 1, text.size(), stdout);
+            fflush(stdout);
+            break;
+        case CONSOLE_MEMORY:
+            memory += text;
+            if (memory.size() > MEMORY_SIZE)
+                memory.erase(0, memory.size() - MEMORY_SIZE);
+            break;
+    }
+}
+
+bool GuestConsole::open_file(const char* name)
+{
+    FILE* new_file = fopen(name, "w");
+    if (!new_file)
+        return false;
+
+    flush();
+    std::lock_guard<std::mutex> output_guard(output_lock);
+    if (file)
+        fclose(file);
+    file = new_file;
+    target = CONSOLE_FILE;
+    return true;
+}
+
+void GuestConsole::set_target(CONSOLE_TARGET target)
+{
+    flush();
+    std::lock_guard<std::mutex> output_guard(output_lock);
+    this->target = target;
+}
+
+void GuestConsole::put(char c)
+{
+    std::lock_guard<std::mutex> lock(buffer_lock);
+    pending += c;
+    if (c == '\n' && !line_ready)
+    {
+        line_ready = true;
+        buffer_cond.notify_one();
+    }
+}
+
+void GuestConsole::write(const std::string& text)
+{
+    if (text.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(buffer_lock);
+    pending += text;
+    if (text.find('\n') != std::string::npos && !line_ready)
+    {
+        line_ready = true;
+        buffer_cond.notify_one();
+    }
+}
+
+std::string GuestConsole::read_memory()
+{
+    flush();
+    std::lock_guard<std::mutex> output_guard(output_lock);
+    std::string text;
+    text.swap(memory);
+    return text;
+}
@@ -0,0 +1,74 @@
+#ifndef CONSOLE_HPP
+#define CONSOLE_HPP
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+Where the EE's and IOP's debug output (the EE's SIO TX register and IOP ksprintf) ends up.
+
+Text is buffered and handed to a flusher thread whenever a line is completed, so a chatty guest doesn't cost a
+syscall per character. A partial line is written out after FLUSH_INTERVAL_MS at the latest, so prompts still show.
+
+Output can go to a file, stdout, or an in-memory ring for frontends to pull from with read_memory(). The ring keeps
+the last MEMORY_SIZE bytes that haven't been read yet.
+
+Everything buffered is flushed when the console is destroyed, on exit(), and on a crash signal. The crash flush is
+best effort, since it can't take the locks that the crashing thread might be holding.
+**/
+
+enum CONSOLE_TARGET
+{
+    CONSOLE_FILE,
+    CONSOLE_STDOUT,
+    CONSOLE_MEMORY
+};
+
+class GuestConsole
+{
+    private:
+        constexpr static int FLUSH_INTERVAL_MS = 100;
+        constexpr static size_t MEMORY_SIZE = 64 * 1024;
+
+        CONSOLE_TARGET target;
+        FILE* file;
+        std::string memory;
+
+        //Guards pending and the flusher state
+        std::mutex buffer_lock;
+        std::condition_variable buffer_cond;
+        std::string pending;
+        bool line_ready;
+        bool quit;
+        std::thread flusher;
+
+        //Held while writing to the target. Always taken before buffer_lock.
+        std::mutex output_lock;
+
+        void flusher_loop();
+        void output(const std::string& text);
+        void crash_flush();
+
+        static void register_console(GuestConsole* console);
+        static void unregister_console(GuestConsole* console);
+        static void flush_all();
+        static void crash_handler(int signal);
+    public:
+        GuestConsole();
+        ~GuestConsole();
+
+        //Anything buffered goes to the old target first
+        bool open_file(const char* name);
+        void set_target(CONSOLE_TARGET target);
+
+        void put(char c);
+        void write(const std::string& text);
+        void flush();
+
+        //Returns everything written to the ring since the last call
+        std::string read_memory();
+};
+
+#endif // CONSOLE_HPP
@@ -1,9 +1,9 @@
-#include <cstdio>
 #include "bios_hle.hpp"
 #include "emotionasm.hpp"
 
 #include "../emulator.hpp"
 #include "../gs.hpp"
+#include "../logger.hpp"
 
 BIOS_HLE::BIOS_HLE(Emulator* e, GraphicsSynthesizer* gs) : e(e), gs(gs)
 {
@@ -110,7 +110,7 @@ void BIOS_HLE::hle_syscall(EmotionEngine& cpu, int op)
             get_heap_end(cpu);
             break;
         case 0x64:
-            printf("\nSYSCALL: flush_cache");
+            DEBUG_LOG(LOG_BIOS, "SYSCALL: flush_cache\n");
             break;
         case 0x71:
             set_GS_IMR(cpu);
@@ -119,18 +119,18 @@ void BIOS_HLE::hle_syscall(EmotionEngine& cpu, int op)
             get_memory_size(cpu);
             break;
         default:
-            printf("\nUnrecognized HLE syscall $%02X", op);
+            WARN_LOG(LOG_BIOS, "Unrecognized HLE syscall $%02X\n", op);
     }
 }
 
 void BIOS_HLE::reset_EE(EmotionEngine &cpu)
 {
-    printf("\nSYSCALL: reset_EE");
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: reset_EE\n");
 }
 
 void BIOS_HLE::set_GS_CRT(EmotionEngine &cpu)
 {
-    printf("\nSYSCALL: set_GS_CRT");
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: set_GS_CRT\n");
     bool interlaced = cpu.get_gpr<uint64_t>(PARAM0);
     int mode = cpu.get_gpr<uint64_t>(PARAM1);
     bool frame_mode = cpu.get_gpr<uint64_t>(PARAM2);
@@ -139,13 +139,13 @@ void BIOS_HLE::set_GS_CRT(EmotionEngine &cpu)
 
 void BIOS_HLE::set_VBLANK_handler(EmotionEngine &cpu)
 {
-    printf("\nSYSCALL: set_VBLANK_handler");
-    printf("\nPARAM0: $%08X", cpu.get_gpr<uint32_t>(PARAM0));
-    printf("\nPARAM1: $%08X", cpu.get_gpr<uint32_t>(PARAM1));
-    printf("\nPARAM2: $%08X", cpu.get_gpr<uint32_t>(PARAM2));
-    printf("\nPARAM3: $%08X", cpu.get_gpr<uint32_t>(PARAM3));
-    printf("\nPARAM4: $%08X", cpu.get_gpr<uint32_t>(PARAM4));
-    printf("\nPARAM5: $%08X", cpu.get_gpr<uint32_t>(PARAM5));
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: set_VBLANK_handler\n");
+    DEBUG_LOG(LOG_BIOS, "PARAM0: $%08X\n", cpu.get_gpr<uint32_t>(PARAM0));
+    DEBUG_LOG(LOG_BIOS, "PARAM1: $%08X\n", cpu.get_gpr<uint32_t>(PARAM1));
+    DEBUG_LOG(LOG_BIOS, "PARAM2: $%08X\n", cpu.get_gpr<uint32_t>(PARAM2));
+    DEBUG_LOG(LOG_BIOS, "PARAM3: $%08X\n", cpu.get_gpr<uint32_t>(PARAM3));
+    DEBUG_LOG(LOG_BIOS, "PARAM4: $%08X\n", cpu.get_gpr<uint32_t>(PARAM4));
+    DEBUG_LOG(LOG_BIOS, "PARAM5: $%08X\n", cpu.get_gpr<uint32_t>(PARAM5));
 }
 
 void BIOS_HLE::add_INTC_handler(EmotionEngine &cpu)
@@ -154,11 +154,11 @@ void BIOS_HLE::add_INTC_handler(EmotionEngine &cpu)
     uint32_t address = cpu.get_gpr<uint32_t>(PARAM1);
     uint32_t next = cpu.get_gpr<uint32_t>(PARAM2);
     uint32_t arg = cpu.get_gpr<uint32_t>(PARAM3);
-    printf("\nSYSCALL: add_INTC_handler");
-    printf("\nCause: $%08X", cause);
-    printf("\nAddr: $%08X", address);
-    printf("\nNext: $%08X", next);
-    printf("\nArg: $%08X", arg);
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: add_INTC_handler\n");
+    DEBUG_LOG(LOG_BIOS, "Cause: $%08X\n", cause);
+    DEBUG_LOG(LOG_BIOS, "Addr: $%08X\n", address);
+    DEBUG_LOG(LOG_BIOS, "Next: $%08X\n", next);
+    DEBUG_LOG(LOG_BIOS, "Arg: $%08X\n", arg);
 
     INTC_handler handler;
     handler.cause = 1 << cause;
@@ -173,7 +173,7 @@ void BIOS_HLE::add_INTC_handler(EmotionEngine &cpu)
 void BIOS_HLE::enable_INTC(EmotionEngine &cpu)
 {
     uint32_t cause = cpu.get_gpr<uint32_t>(PARAM0);
-    printf("\nSYSCALL: enable_INTC $%08X", cause);
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: enable_INTC $%08X\n", cause);
     uint32_t new_value = 1 << cause;
     uint32_t old_mask = e->read32(0x1000F010);
     bool has_changed = false;
@@ -189,11 +189,11 @@ void BIOS_HLE::enable_INTC(EmotionEngine &cpu)
 
 void BIOS_HLE::init_main_thread(EmotionEngine &cpu)
 {
-    printf("\nSYSCALL: init_main_thread");
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: init_main_thread\n");
     uint32_t stack_base = cpu.get_gpr<uint32_t>(PARAM1);
     uint32_t stack_size = cpu.get_gpr<uint32_t>(PARAM2);
-    printf("\nStack base: $%08X", stack_base);
-    printf("\nStack size: $%08X", stack_size);
+    DEBUG_LOG(LOG_BIOS, "Stack base: $%08X\n", stack_base);
+    DEBUG_LOG(LOG_BIOS, "Stack size: $%08X\n", stack_size);
 
     uint32_t stack_addr;
     if (stack_base == 0xFFFFFFFF)
@@ -212,7 +212,7 @@ void BIOS_HLE::init_main_thread(EmotionEngine &cpu)
 
 void BIOS_HLE::init_heap(EmotionEngine &cpu)
 {
-    printf("\nSYSCALL: init_heap");
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: init_heap\n");
     thread_hle* thread = &threads[0];
     uint32_t heap_base = cpu.get_gpr<uint32_t>(PARAM0);
     uint32_t heap_size = cpu.get_gpr<uint32_t>(PARAM1);
@@ -227,19 +227,19 @@ void BIOS_HLE::init_heap(EmotionEngine &cpu)
 void BIOS_HLE::get_heap_end(EmotionEngine &cpu)
 {
     thread_hle* thread = &threads[0];
-    printf("\nSYSCALL: get_heap_end: $%08X", thread->heap_base);
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: get_heap_end: $%08X\n", thread->heap_base);
     cpu.set_gpr<uint64_t>(RETURN, thread->heap_base);
 }
 
 void BIOS_HLE::set_GS_IMR(EmotionEngine &cpu)
 {
     uint32_t imr = cpu.get_gpr<uint32_t>(PARAM0);
-    printf("\nSYSCALL: set_GS_IMR $%08X", imr);
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: set_GS_IMR $%08X\n", imr);
 }
 
 void BIOS_HLE::get_memory_size(EmotionEngine &cpu)
 {
     //size of EE RDRAM
-    printf("\nSYSCALL: get_memory_size");
+    DEBUG_LOG(LOG_BIOS, "SYSCALL: get_memory_size\n");
     cpu.set_gpr<uint64_t>(RETURN, 0x02000000);
 }
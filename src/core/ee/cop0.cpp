@@ -1,6 +1,7 @@
-#include <cstdio>
 #include "cop0.hpp"
 
+#include "../logger.hpp"
+
 Cop0::Cop0() {}
 
 void Cop0::reset()
@@ -37,7 +38,7 @@ void Cop0::reset()
 
 uint32_t Cop0::mfc(int index)
 {
-    //printf("[COP0] Move from reg%d\n", index);
+    //DEBUG_LOG(LOG_EE, "[COP0] Move from reg%d\n", index);
     switch (index)
     {
         case 12:
@@ -85,7 +86,7 @@ uint32_t Cop0::mfc(int index)
 
 void Cop0::mtc(int index, uint32_t value)
 {
-    //printf("[COP0] Move to reg%d: $%08X\n", index, value);
+    //DEBUG_LOG(LOG_EE, "[COP0] Move to reg%d: $%08X\n", index, value);
     switch (index)
     {
         case 12:
@@ -1,8 +1,9 @@
-#include <cstdio>
 #include <cstdlib>
 #include "dmac.hpp"
 
 #include "../emulator.hpp"
+#include "../logger.hpp"
+#include "../mmio.hpp"
 
 enum CHANNELS
 {
@@ -21,13 +22,15 @@ enum CHANNELS
 DMAC::DMAC(EmotionEngine* cpu, Emulator* e, GraphicsInterface* gif, SubsystemInterface* sif) :
     cpu(cpu), e(e), gif(gif), sif(sif)
 {
-
+    burst_length = 0;
 }
 
-void DMAC::reset()
+void DMAC::reset(uint8_t* RDRAM)
 {
+    this->RDRAM = RDRAM;
     master_disable = 0x1201; //hax
     control.master_enable = false;
+    active_channels = 0;
     for (int i = 0; i < 10; i++)
     {
         channels[i].control = 0;
@@ -41,34 +44,104 @@ void DMAC::reset()
     interrupt_stat.stall_stat = false;
 }
 
-void DMAC::run()
+void DMAC::map_registers(MMIOTable* mmio)
+{
+    //64-bit accesses only reach the lower word
+    for (int width = 4; width <= 8; width *= 2)
+    {
+        mmio->map_read_range(0x10008000, 0x1000F000, width, [this] (uint32_t addr) { return read32(addr); }, true);
+        mmio->map_write_range(0x10008000, 0x1000F000, width,
+                              [this] (uint32_t addr, uint64_t value) { write32(addr, value); });
+    }
+    mmio->map_read(0x1000F520, 4, [this] (uint32_t addr) { return read_master_disable(); }, true);
+    mmio->map_write(0x1000F590, 4, [this] (uint32_t addr, uint64_t value) { write_master_disable(value); });
+}
+
+void DMAC::run(int cycles)
 {
-    if (!control.master_enable || (master_disable & (1 << 16)))
+    if (!active_channels || !control.master_enable || (master_disable & (1 << 16)))
         return;
+
+    //Each active channel moves a quadword per cycle, in bursts, until it's used up its cycles or is stalled on a
+    //FIFO. The channels don't compete for the bus, so each of them gets all of the cycles.
     for (int i = 0; i < 10; i++)
     {
-        if (channels[i].control & 0x100)
+        if (!(active_channels & (1 << i)))
+            continue;
+        int cycles_left = cycles;
+        while (cycles_left > 0 && (channels[i].control & 0x100))
         {
+            int used = 0;
             switch (i)
             {
                 case GIF:
-                    process_GIF();
+                    used = process_GIF(cycles_left);
                     break;
                 case SIF0:
-                    process_SIF0();
+                    used = process_SIF0(cycles_left);
                     break;
                 case SIF1:
-                    process_SIF1();
+                    used = process_SIF1(cycles_left);
                     break;
             }
+            if (!used)
+                break;
+            cycles_left -= used;
         }
     }
 }
 
+//Keeps active_channels in step with the STR bit of a channel's CHCR
+void DMAC::update_active(int index)
+{
+    if (channels[index].control & 0x100)
+        active_channels |= 1 << index;
+    else
+        active_channels &= ~(1 << index);
+}
+
+void DMAC::set_burst_length(int quadwords)
+{
+    if (quadwords < 0)
+        quadwords = 0;
+    burst_length = quadwords;
+}
+
+//How many quadwords the channel can move in one go: the rest of the segment, within the burst length and cycles
+int DMAC::get_burst(int index, int cycles)
+{
+    int quads = channels[index].quadword_count;
+    if (burst_length && quads > burst_length)
+        quads = burst_length;
+    if (quads > cycles)
+        quads = cycles;
+    return quads;
+}
+
+//Transfers to and from RDRAM go straight to host memory. Anything else (scratchpad etc.) goes through the bus.
+uint128_t DMAC::read_quad(uint32_t address)
+{
+    if (address < 0x10000000)
+        return load128(&RDRAM[address & 0x01FFFFF0]);
+    return e->read128(address);
+}
+
+void DMAC::write_quad(uint32_t address, uint128_t quad)
+{
+    if (address < 0x10000000)
+    {
+        store128(&RDRAM[address & 0x01FFFFF0], quad);
+        cpu->invalidate_code(address & 0x01FFFFF0);
+        return;
+    }
+    e->write128(address, quad);
+}
+
 void DMAC::transfer_end(int index)
 {
-    printf("[DMAC] Transfer end: %d\n", index);
+    DEBUG_LOG(LOG_DMAC, "[DMAC] Transfer end: %d\n", index);
     channels[index].control &= ~0x100;
+    update_active(index);
     interrupt_stat.channel_stat[index] = true;
     int1_check();
 }
@@ -87,17 +160,22 @@ void DMAC::int1_check()
     cpu->set_int1_signal(int1_signal);
 }
 
-void DMAC::process_GIF()
+/**
+ * The process functions return how many cycles they used. Each quadword or DMAtag costs one; zero means the channel
+ * is stalled and can't do anything more for now.
+ */
+int DMAC::process_GIF(int cycles)
 {
     if (channels[GIF].quadword_count)
     {
-        uint64_t quad[2];
-        quad[0] = e->read64(channels[GIF].address);
-        quad[1] = e->read64(channels[GIF].address + 8);
-        gif->send_PATH3(quad);
-
-        channels[GIF].address += 16;
-        channels[GIF].quadword_count--;
+        int quads = get_burst(GIF, cycles);
+        for (int i = 0; i < quads; i++)
+        {
+            gif->send_PATH3(read_quad(channels[GIF].address));
+            channels[GIF].address += 16;
+        }
+        channels[GIF].quadword_count -= quads;
+        return quads;
     }
     else
     {
@@ -107,24 +185,31 @@ void DMAC::process_GIF()
         }
         else
             handle_source_chain(GIF);
+        return 1;
     }
 }
 
-void DMAC::process_SIF0()
+//Drains every whole quadword sitting in the FIFO at once rather than one per cycle
+int DMAC::process_SIF0(int cycles)
 {
     if (channels[SIF0].quadword_count)
     {
-        if (sif->get_SIF0_size() >= 4)
+        int quads = sif->get_SIF0_size() / 4;
+        int burst = get_burst(SIF0, cycles);
+        if (quads > burst)
+            quads = burst;
+        if (quads)
         {
-            for (int i = 0; i < 4; i++)
+            uint128_t data[SubsystemInterface::MAX_FIFO_SIZE / 4];
+            sif->read_SIF0(data[0]._u32, quads * 4);
+            for (int i = 0; i < quads; i++)
             {
-                uint32_t word = sif->read_SIF0();
-                printf("[DMAC] Read from SIF0: $%08X\n", word);
-                e->write32(channels[SIF0].address, word);
-                channels[SIF0].address += 4;
+                write_quad(channels[SIF0].address, data[i]);
+                channels[SIF0].address += 16;
             }
-            channels[SIF0].quadword_count--;
+            channels[SIF0].quadword_count -= quads;
         }
+        return quads;
     }
     else
     {
@@ -134,9 +219,10 @@ void DMAC::process_SIF0()
         }
         else if (sif->get_SIF0_size() >= 2)
         {
-            uint64_t DMAtag = sif->read_SIF0();
-            DMAtag |= (uint64_t)sif->read_SIF0() << 32;
-            printf("[DMAC] SIF0 tag: $%08X_%08X\n", DMAtag >> 32, DMAtag);
+            uint32_t tag[2];
+            sif->read_SIF0(tag, 2);
+            uint64_t DMAtag = tag[0] | ((uint64_t)tag[1] << 32);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] SIF0 tag: $%08X_%08X\n", DMAtag >> 32, DMAtag);
 
             channels[SIF0].quadword_count = DMAtag & 0xFFFF;
             channels[SIF0].address = DMAtag >> 32;
@@ -152,23 +238,29 @@ void DMAC::process_SIF0()
             channels[SIF0].control &= 0xFFFF;
             channels[SIF0].control |= DMAtag & 0xFFFF0000;
         }
+        else
+            return 0;
+        return 1;
     }
 }
 
-void DMAC::process_SIF1()
+//Fills the FIFO with as many quadwords as fit at once
+int DMAC::process_SIF1(int cycles)
 {
     if (channels[SIF1].quadword_count)
     {
-        if (sif->get_SIF1_size() <= SubsystemInterface::MAX_FIFO_SIZE - 4)
+        int quads = (SubsystemInterface::MAX_FIFO_SIZE - sif->get_SIF1_size()) / 4;
+        int burst = get_burst(SIF1, cycles);
+        if (quads > burst)
+            quads = burst;
+        for (int i = 0; i < quads; i++)
         {
-            uint64_t quad[2];
-            quad[0] = e->read64(channels[SIF1].address);
-            quad[1] = e->read64(channels[SIF1].address + 8);
-            sif->write_SIF1(quad);
+            sif->write_SIF1(read_quad(channels[SIF1].address));
 
             channels[SIF1].address += 16;
-            channels[SIF1].quadword_count--;
         }
+        channels[SIF1].quadword_count -= quads;
+        return quads;
     }
     else
     {
@@ -178,13 +270,15 @@ void DMAC::process_SIF1()
         }
         else
             handle_source_chain(SIF1);
+        return 1;
     }
 }
 
 void DMAC::handle_source_chain(int index)
 {
     uint64_t DMAtag = e->read64(channels[index].tag_address);
-    printf("[DMAC] Source DMAtag read $%08X: $%08X_%08X\n", channels[index].tag_address, DMAtag >> 32, DMAtag & 0xFFFFFFFF);
+    DEBUG_LOG(LOG_DMAC, "[DMAC] Source DMAtag read $%08X: $%08X_%08X\n", channels[index].tag_address, DMAtag >> 32,
+              DMAtag & 0xFFFFFFFF);
 
     //Change CTRL to have the upper 16 bits equal to bits 16-31 of the most recently read DMAtag
     channels[index].control &= 0xFFFF;
@@ -227,22 +321,22 @@ void DMAC::handle_source_chain(int index)
             channels[index].tag_end = true;
             break;
         default:
-            printf("\n[DMAC] Unrecognized source chain DMAtag id %d\n", id);
+            ERROR_LOG(LOG_DMAC, "[DMAC] Unrecognized source chain DMAtag id %d\n", id);
             exit(1);
     }
     if (IRQ_after_transfer && TIE)
         channels[index].tag_end = true;
-    printf("New address: $%08X\n", channels[index].address);
-    printf("New tag addr: $%08X\n", channels[index].tag_address);
+    DEBUG_LOG(LOG_DMAC, "New address: $%08X\n", channels[index].address);
+    DEBUG_LOG(LOG_DMAC, "New tag addr: $%08X\n", channels[index].tag_address);
 }
 
 void DMAC::start_DMA(int index)
 {
-    printf("[DMAC] D%d started: $%08X\n", index, channels[index].control);
-    printf("Addr: $%08X\n", channels[index].address);
-    printf("Mode: %d\n", (channels[index].control >> 2) & 0x3);
-    printf("ASP: %d\n", (channels[index].control >> 4) & 0x3);
-    printf("TTE: %d\n", channels[index].control & (1 << 6));
+    DEBUG_LOG(LOG_DMAC, "[DMAC] D%d started: $%08X\n", index, channels[index].control);
+    DEBUG_LOG(LOG_DMAC, "Addr: $%08X\n", channels[index].address);
+    DEBUG_LOG(LOG_DMAC, "Mode: %d\n", (channels[index].control >> 2) & 0x3);
+    DEBUG_LOG(LOG_DMAC, "ASP: %d\n", (channels[index].control >> 4) & 0x3);
+    DEBUG_LOG(LOG_DMAC, "TTE: %d\n", channels[index].control & (1 << 6));
     int mode = (channels[index].control >> 2) & 0x3;
     channels[index].tag_end = (mode == 0); //always end transfers in normal mode
 }
@@ -299,7 +393,7 @@ uint32_t DMAC::read32(uint32_t address)
             reg |= interrupt_stat.mfifo_mask << 30;
             break;
         default:
-            printf("[DMAC] Unrecognized read32 from $%08X\n", address);
+            WARN_LOG(LOG_DMAC, "[DMAC] Unrecognized read32 from $%08X\n", address);
             break;
     }
     return reg;
@@ -311,51 +405,54 @@ void DMAC::write32(uint32_t address, uint32_t value)
     {
         case 0x1000A000:
             channels[GIF].control = value;
+            update_active(GIF);
             if (value & 0x100)
                 start_DMA(GIF);
             break;
         case 0x1000A010:
-            printf("[DMAC] GIF M_ADR: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] GIF M_ADR: $%08X\n", value);
             channels[GIF].address = value & ~0xF;
             break;
         case 0x1000A020:
-            printf("[DMAC] GIF QWC: $%08X\n", value & 0xFFFF);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] GIF QWC: $%08X\n", value & 0xFFFF);
             channels[GIF].quadword_count = value & 0xFFFF;
             break;
         case 0x1000A030:
-            printf("[DMAC] GIF T_ADR: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] GIF T_ADR: $%08X\n", value);
             channels[GIF].tag_address = value & ~0xF;
             break;
         case 0x1000C000:
-            printf("[DMAC] SIF0 CTRL: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] SIF0 CTRL: $%08X\n", value);
             channels[SIF0].control = value;
+            update_active(SIF0);
             if (value & 0x100)
                 start_DMA(SIF0);
             break;
         case 0x1000C020:
-            printf("[DMAC] SIF0 QWC: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] SIF0 QWC: $%08X\n", value);
             channels[SIF0].quadword_count = value & 0xFFFF;
             break;
         case 0x1000C030:
-            printf("[DMAC] SIF0 T_ADR: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] SIF0 T_ADR: $%08X\n", value);
             channels[SIF0].tag_address = value & ~0xF;
             break;
         case 0x1000C400:
-            printf("[DMAC] SIF1 CTRL: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] SIF1 CTRL: $%08X\n", value);
             channels[SIF1].control = value;
+            update_active(SIF1);
             if (value & 0x100)
                 start_DMA(SIF1);
             break;
         case 0x1000C420:
-            printf("[DMAC] SIF1 QWC: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] SIF1 QWC: $%08X\n", value);
             channels[SIF1].quadword_count = value & 0xFFFF;
             break;
         case 0x1000C430:
-            printf("[DMAC] SIF1 T_ADR: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] SIF1 T_ADR: $%08X\n", value);
             channels[SIF1].tag_address = value & ~0xF;
             break;
         case 0x1000E000:
-            printf("[DMAC] Write32 D_CTRL: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] Write32 D_CTRL: $%08X\n", value);
             control.master_enable = value & 0x1;
             control.cycle_stealing = value & 0x2;
             control.mem_drain_channel = (value >> 2) & 0x3;
@@ -364,7 +461,7 @@ void DMAC::write32(uint32_t address, uint32_t value)
             control.release_cycle = (value >> 8) & 0x7;
             break;
         case 0x1000E010:
-            printf("[DMAC] Write32 D_STAT: $%08X\n", value);
+            DEBUG_LOG(LOG_DMAC, "[DMAC] Write32 D_STAT: $%08X\n", value);
             for (int i = 0; i < 10; i++)
             {
                 if (value & (1 << i))
@@ -387,7 +484,7 @@ void DMAC::write32(uint32_t address, uint32_t value)
             int1_check();
             break;
         default:
-            printf("[DMAC] Unrecognized write32 of $%08X to $%08X\n", value, address);
+            WARN_LOG(LOG_DMAC, "[DMAC] Unrecognized write32 of $%08X to $%08X\n", value, address);
             break;
     }
 }
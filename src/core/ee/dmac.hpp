@@ -1,6 +1,7 @@
 #ifndef DMAC_HPP
 #define DMAC_HPP
 #include <cstdint>
+#include "../int128.hpp"
 
 struct DMA_Channel
 {
@@ -40,6 +41,7 @@ struct D_STAT
 class EmotionEngine;
 class Emulator;
 class GraphicsInterface;
+class MMIOTable;
 class SubsystemInterface;
 
 class DMAC
@@ -49,16 +51,28 @@ class DMAC
         Emulator* e;
         GraphicsInterface* gif;
         SubsystemInterface* sif;
+        uint8_t* RDRAM;
         DMA_Channel channels[10];
 
+        //Bit per channel with STR set, so an idle DMAC costs nothing
+        uint16_t active_channels;
+
+        //Most quadwords a channel moves before giving way, or 0 for a whole chain segment
+        int burst_length;
+
         D_CTRL control;
         D_STAT interrupt_stat;
 
         uint32_t master_disable;
 
-        void process_GIF();
-        void process_SIF0();
-        void process_SIF1();
+        void update_active(int index);
+        int get_burst(int index, int cycles);
+        uint128_t read_quad(uint32_t address);
+        void write_quad(uint32_t address, uint128_t quad);
+
+        int process_GIF(int cycles);
+        int process_SIF0(int cycles);
+        int process_SIF1(int cycles);
 
         void handle_source_chain(int index);
 
@@ -66,8 +80,11 @@ class DMAC
         void int1_check();
     public:
         DMAC(EmotionEngine* cpu, Emulator* e, GraphicsInterface* gif, SubsystemInterface* sif);
-        void reset();
-        void run();
+        void reset(uint8_t* RDRAM);
+        void map_registers(MMIOTable* mmio);
+        void run(int cycles);
+        bool is_active();
+        void set_burst_length(int quadwords);
         void start_DMA(int index);
 
         uint32_t read_master_disable();
@@ -77,4 +94,9 @@ class DMAC
         void write32(uint32_t address, uint32_t value);
 };
 
+inline bool DMAC::is_active()
+{
+    return active_channels != 0;
+}
+
 #endif // DMAC_HPP
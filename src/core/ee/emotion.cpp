@@ -1,4 +1,3 @@
-#include <cstdio>
 #include <cstdlib>
 #include "emotion.hpp"
 #include "emotiondisasm.hpp"
@@ -6,10 +5,13 @@
 #include "vu.hpp"
 
 #include "../emulator.hpp"
+#include "../logger.hpp"
 
-EmotionEngine::EmotionEngine(BIOS_HLE* b, Emulator* e, VectorUnit* vu0) : bios(b), e(e), vu0(vu0)
+EmotionEngine::EmotionEngine(BIOS_HLE* b, Emulator* e, VectorUnit* vu0) : bios(b), e(e), vu0(vu0),
+    fastmem(e), idle_loops("EE"), cached_interpreter(this), jit(this)
 {
-    reset();
+    mode = CPU_MODE::INTERPRETER;
+    reset(nullptr, nullptr);
 }
 
 const char* EmotionEngine::REG(int id)
@@ -28,13 +30,17 @@ const char* EmotionEngine::REG(int id)
     return names[id];
 }
 
-void EmotionEngine::reset()
+void EmotionEngine::reset(uint8_t* RDRAM, uint8_t* BIOS)
 {
     PC = 0xBFC00000;
     branch_on = false;
     increment_PC = true;
     can_disassemble = false;
     delay_slot = 0;
+    idle_loop_hit = false;
+    skipped_idle = false;
+    slice_ended = false;
+    cycles_run = 0;
 
     //Clear out $zero
     for (int i = 0; i < 16; i++)
@@ -42,15 +48,84 @@ void EmotionEngine::reset()
 
     cp0.reset();
     fpu.reset();
+    idle_loops.reset();
+    if (fastmem.is_active())
+        page_table.reset(RDRAM, BIOS, fastmem.get_scratchpad());
+    else
+        page_table.reset(RDRAM, BIOS, scratchpad);
+    cached_interpreter.reset();
+    jit.reset();
+}
+
+void EmotionEngine::set_mode(CPU_MODE mode)
+{
+    if (mode == CPU_MODE::JIT && !jit.is_available())
+    {
+        WARN_LOG(LOG_EE, "[EE] Unable to allocate JIT cache, falling back to the interpreter\n");
+        mode = CPU_MODE::INTERPRETER;
+    }
+    this->mode = mode;
+}
+
+void EmotionEngine::set_idle_loop_detection(bool enabled)
+{
+    idle_loops.set_enabled(enabled);
 }
 
-void EmotionEngine::run()
+void EmotionEngine::print_idle_loop_stats()
+{
+    idle_loops.print_stats();
+}
+
+//Returns nullptr if the host can't do fastmem. Guest memory must then be taken from the returned object.
+EmotionFastmem* EmotionEngine::enable_fastmem()
+{
+    if (!fastmem.init())
+        return nullptr;
+    return &fastmem;
+}
+
+/**
+ * Runs the EE for roughly the given number of cycles and returns how many were actually executed.
+ * The block-based modes may overshoot by the length of a block, or stop early if compiled code needs to be thrown out.
+ */
+int EmotionEngine::run(int cycles)
+{
+    slice_ended = false;
+    skipped_idle = false;
+    if (mode == CPU_MODE::JIT)
+        return jit.run(cycles);
+    if (mode == CPU_MODE::CACHED_INTERPRETER)
+        return cached_interpreter.run(cycles);
+
+    cycles_run = 0;
+    while (cycles_run < cycles && !slice_ended)
+    {
+        step();
+        cycles_run++;
+        if (idle_loop_hit)
+            cycles_run += take_idle_skip(cycles - cycles_run);
+    }
+    int slice_length = cycles_run;
+    cycles_run = 0;
+    return slice_length;
+}
+
+//Cycles run so far in the current call to run(), for timers read partway through a slice
+int EmotionEngine::get_slice_progress()
+{
+    if (mode == CPU_MODE::JIT)
+        return jit.get_cycles_run();
+    return cycles_run;
+}
+
+void EmotionEngine::step()
 {
     uint32_t instruction = read32(PC);
     if (can_disassemble)
     {
         std::string disasm = EmotionDisasm::disasm_instr(instruction, PC);
-        printf("[$%08X] $%08X - %s\n", PC, instruction, disasm.c_str());
+        INFO_LOG(LOG_EE, "[$%08X] $%08X - %s\n", PC, instruction, disasm.c_str());
     }
     EmotionInterpreter::interpret(*this, instruction);
     cp0.count_up();
@@ -58,31 +133,8 @@ void EmotionEngine::run()
         can_disassemble = true;
     if (PC == 0x100BBC)
         print_state();*/
-    if (increment_PC)
-        PC += 4;
-    else
-        increment_PC = true;
-    if (branch_on)
-    {
-        if (!delay_slot)
-        {
-            branch_on = false;
-            PC = new_PC;
-            if (PC < 0x80000000 && PC >= 0x00100000)
-                if (e->skip_BIOS())
-                    return;
-            /*if (PC == 0x00083270)
-            {
-                can_disassemble = true;
-                print_state();
-            }*/
-
-            if (PC == 0xBFC00928)
-                exit(1);
-        }
-        else
-            delay_slot--;
-    }
+    if (!advance_PC())
+        return;
 
     //if (PC < 0x80000000 && PC >= 0x00100000)
         //can_disassemble = true;
@@ -90,9 +142,60 @@ void EmotionEngine::run()
     //if (PC == 0x84010)
         //print_state();
 
+    check_interrupts();
+}
+
+bool EmotionEngine::finish_branch()
+{
+    branch_on = false;
+
+    //PC is just past the delay slot here
+    if (new_PC < PC && idle_loops.is_idle_loop(*this, new_PC, PC - 8))
+    {
+        idle_loop_hit = true;
+        idle_loop_PC = new_PC;
+    }
+
+    PC = new_PC;
+    if (PC < 0x80000000 && PC >= 0x00100000)
+        if (e->skip_BIOS())
+            return false;
+    /*if (PC == 0x00083270)
+    {
+        can_disassemble = true;
+        print_state();
+    }*/
+
+    if (PC == 0xBFC00928)
+        exit(1);
+    return true;
+}
+
+//Fast-forwards to the end of the time slice, as the idle loop at loop_PC would only spin until then.
+//Emulator::run sees that the EE is idle, and can make the next slice last until the next event.
+void EmotionEngine::skip_idle_cycles(uint32_t loop_PC, int cycles)
+{
+    cp0.gpr[9] += cycles;
+    idle_loops.record_skip(loop_PC, cycles);
+    idle_loop_PC = loop_PC;
+    skipped_idle = true;
+}
+
+//Returns the number of cycles skipped if the CPU is still sitting in the idle loop finish_branch found
+int EmotionEngine::take_idle_skip(int cycles)
+{
+    idle_loop_hit = false;
+    if (PC != idle_loop_PC || branch_on || cycles <= 0)
+        return 0;
+    skip_idle_cycles(PC, cycles);
+    return cycles;
+}
+
+void EmotionEngine::check_interrupts()
+{
     if (cp0.int_enabled())
     {
-        //printf("[EE] Int enabled!\n");
+        //DEBUG_LOG(LOG_EE, "[EE] Int enabled!\n");
         if (cp0.cause.int0_pending)
             int0();
         if (cp0.cause.int1_pending)
@@ -104,13 +207,13 @@ void EmotionEngine::print_state()
 {
     for (int i = 1; i < 32; i++)
     {
-        printf("%s: $%08X_%08X", REG(i), get_gpr<uint32_t>(i, 1), get_gpr<uint32_t>(i));
+        INFO_LOG(LOG_EE, "%s: $%08X_%08X", REG(i), get_gpr<uint32_t>(i, 1), get_gpr<uint32_t>(i));
         if ((i & 3) == 3)
-            printf("\n");
+            INFO_LOG(LOG_EE, "\n");
         else
-            printf("\t");
+            INFO_LOG(LOG_EE, "\t");
     }
-    printf("\n");
+    INFO_LOG(LOG_EE, "\n");
 }
 
 void EmotionEngine::set_disassembly(bool dis)
@@ -125,6 +228,11 @@ uint32_t EmotionEngine::get_PC()
 
 uint8_t EmotionEngine::read8(uint32_t address)
 {
+    if (fastmem.is_active())
+        return fastmem.read8(address);
+    uint8_t* mem = page_table.get_read_ptr(address);
+    if (mem)
+        return *mem;
     if (address >= 0x70000000 && address < 0x70004000)
         return scratchpad[address & 0x3FFF];
     if (address >= 0x30100000 && address < 0x31FFFFFF)
@@ -134,6 +242,11 @@ uint8_t EmotionEngine::read8(uint32_t address)
 
 uint16_t EmotionEngine::read16(uint32_t address)
 {
+    if (fastmem.is_active())
+        return fastmem.read16(address);
+    uint8_t* mem = page_table.get_read_ptr(address);
+    if (mem)
+        return *(uint16_t*)mem;
     if (address >= 0x70000000 && address < 0x70004000)
         return *(uint16_t*)&scratchpad[address & 0x3FFF];
     if (address >= 0x30100000 && address < 0x31FFFFFF)
@@ -142,7 +255,12 @@ uint16_t EmotionEngine::read16(uint32_t address)
 }
 
 uint32_t EmotionEngine::read32(uint32_t address)
-{;
+{
+    if (fastmem.is_active())
+        return fastmem.read32(address);
+    uint8_t* mem = page_table.get_read_ptr(address);
+    if (mem)
+        return *(uint32_t*)mem;
     if (address >= 0x70000000 && address < 0x70004000)
         return *(uint32_t*)&scratchpad[address & 0x3FFC];
     if (address >= 0x30100000 && address < 0x31FFFFFF)
@@ -152,6 +270,11 @@ uint32_t EmotionEngine::read32(uint32_t address)
 
 uint64_t EmotionEngine::read64(uint32_t address)
 {
+    if (fastmem.is_active())
+        return fastmem.read64(address);
+    uint8_t* mem = page_table.get_read_ptr(address);
+    if (mem)
+        return *(uint64_t*)mem;
     if (address >= 0x70000000 && address < 0x70004000)
         return *(uint64_t*)&scratchpad[address & 0x3FFC];
     if (address >= 0x30100000 && address < 0x31FFFFFF)
@@ -159,6 +282,28 @@ uint64_t EmotionEngine::read64(uint32_t address)
     return e->read64(address & 0x1FFFFFFF);
 }
 
+uint128_t EmotionEngine::read128(uint32_t address)
+{
+    if (fastmem.is_active())
+        return fastmem.read128(address);
+    uint8_t* mem = page_table.get_read_ptr(address);
+    if (mem)
+        return load128(mem);
+    if (address >= 0x70000000 && address < 0x70004000)
+        return load128(&scratchpad[address & 0x3FF0]);
+    if (address >= 0x30100000 && address < 0x31FFFFFF)
+        address -= 0x10000000;
+    return e->read128(address & 0x1FFFFFFF);
+}
+
+//For addresses is_memory_address rejects. Width is the access size in bytes.
+bool EmotionEngine::is_pure_io_read(uint32_t address, int width)
+{
+    if (address >= 0x30100000 && address < 0x31FFFFFF)
+        address -= 0x10000000;
+    return e->is_pure_read(address & 0x1FFFFFFF, width);
+}
+
 /*void EmotionEngine::set_gpr_lo(int index, uint64_t value)
 {
     if (index)
@@ -172,6 +317,17 @@ void EmotionEngine::set_PC(uint32_t addr)
 
 void EmotionEngine::write8(uint32_t address, uint8_t value)
 {
+    if (fastmem.is_active())
+    {
+        fastmem.write8(address, value);
+        return;
+    }
+    uint8_t* mem = page_table.get_write_ptr(address);
+    if (mem)
+    {
+        *mem = value;
+        return;
+    }
     if (address >= 0x70000000 && address < 0x70004000)
     {
         scratchpad[address & 0x3FFF] = value;
@@ -184,6 +340,17 @@ void EmotionEngine::write8(uint32_t address, uint8_t value)
 
 void EmotionEngine::write16(uint32_t address, uint16_t value)
 {
+    if (fastmem.is_active())
+    {
+        fastmem.write16(address, value);
+        return;
+    }
+    uint8_t* mem = page_table.get_write_ptr(address);
+    if (mem)
+    {
+        *(uint16_t*)mem = value;
+        return;
+    }
     if (address >= 0x70000000 && address < 0x70004000)
     {
         *(uint32_t*)&scratchpad[address & 0x3FFC] = value;
@@ -196,6 +363,17 @@ void EmotionEngine::write16(uint32_t address, uint16_t value)
 
 void EmotionEngine::write32(uint32_t address, uint32_t value)
 {
+    if (fastmem.is_active())
+    {
+        fastmem.write32(address, value);
+        return;
+    }
+    uint8_t* mem = page_table.get_write_ptr(address);
+    if (mem)
+    {
+        *(uint32_t*)mem = value;
+        return;
+    }
     if (address >= 0x70000000 && address < 0x70004000)
     {
         *(uint32_t*)&scratchpad[address & 0x3FFC] = value;
@@ -208,6 +386,17 @@ void EmotionEngine::write32(uint32_t address, uint32_t value)
 
 void EmotionEngine::write64(uint32_t address, uint64_t value)
 {
+    if (fastmem.is_active())
+    {
+        fastmem.write64(address, value);
+        return;
+    }
+    uint8_t* mem = page_table.get_write_ptr(address);
+    if (mem)
+    {
+        *(uint64_t*)mem = value;
+        return;
+    }
     if (address >= 0x70000000 && address < 0x70004000)
     {
         *(uint64_t*)&scratchpad[address & 0x3FFC] = value;
@@ -218,6 +407,29 @@ void EmotionEngine::write64(uint32_t address, uint64_t value)
     e->write64(address & 0x1FFFFFFF, value);
 }
 
+void EmotionEngine::write128(uint32_t address, uint128_t value)
+{
+    if (fastmem.is_active())
+    {
+        fastmem.write128(address, value);
+        return;
+    }
+    uint8_t* mem = page_table.get_write_ptr(address);
+    if (mem)
+    {
+        store128(mem, value);
+        return;
+    }
+    if (address >= 0x70000000 && address < 0x70004000)
+    {
+        store128(&scratchpad[address & 0x3FF0], value);
+        return;
+    }
+    if (address >= 0x30100000 && address < 0x31FFFFFF)
+        address -= 0x10000000;
+    e->write128(address & 0x1FFFFFFF, value);
+}
+
 void EmotionEngine::jp(uint32_t new_addr)
 {
     branch_on = true;
@@ -259,7 +471,7 @@ void EmotionEngine::mfc(int cop_id, int reg, int cop_reg)
             bark = fpu.get_gpr(cop_reg);
             break;
         default:
-            printf("Unrecognized cop id %d in mfc\n", cop_id);
+            ERROR_LOG(LOG_EE, "Unrecognized cop id %d in mfc\n", cop_id);
             exit(1);
     }
 
@@ -277,7 +489,7 @@ void EmotionEngine::mtc(int cop_id, int reg, int cop_reg)
             fpu.mtc(cop_reg, get_gpr<uint32_t>(reg));
             break;
         default:
-            printf("Unrecognized cop id %d in mtc\n", cop_id);
+            ERROR_LOG(LOG_EE, "Unrecognized cop id %d in mtc\n", cop_id);
             exit(1);
     }
 }
@@ -431,7 +643,7 @@ void EmotionEngine::syscall_exception()
 {
     uint8_t op = read8(PC - 4);
     if (op != 0x7A)
-        printf("[EE] SYSCALL: $%02X Called at $%08X\n", op, PC);
+        DEBUG_LOG(LOG_EE, "[EE] SYSCALL: $%02X Called at $%08X\n", op, PC);
 
     //InitMainThread
     /*if (op == 0x3C)
@@ -451,7 +663,7 @@ void EmotionEngine::int0()
 {
     if (cp0.status.int0_mask)
     {
-        printf("[EE] INT0!\n");
+        DEBUG_LOG(LOG_EE, "[EE] INT0!\n");
         handle_exception(0x80000200, 0);
     }
 }
@@ -460,7 +672,7 @@ void EmotionEngine::int1()
 {
     if (cp0.status.int1_mask)
     {
-        printf("[EE] INT1!\n");
+        DEBUG_LOG(LOG_EE, "[EE] INT1!\n");
         //can_disassemble = true;
         handle_exception(0x80000200, 0);
     }
@@ -470,19 +682,19 @@ void EmotionEngine::set_int0_signal(bool value)
 {
     cp0.cause.int0_pending = value;
     if (value)
-        printf("[EE] Set INT0\n");
+        DEBUG_LOG(LOG_EE, "[EE] Set INT0\n");
 }
 
 void EmotionEngine::set_int1_signal(bool value)
 {
     cp0.cause.int1_pending = value;
     if (value)
-        printf("[EE] Set INT1\n");
+        DEBUG_LOG(LOG_EE, "[EE] Set INT1\n");
 }
 
 void EmotionEngine::eret()
 {
-    //printf("[EE] Return from exception\n");
+    //DEBUG_LOG(LOG_EE, "[EE] Return from exception\n");
     uint32_t EPC = cp0.mfc(14);
     PC = EPC;
     increment_PC = false;
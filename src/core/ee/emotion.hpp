@@ -3,14 +3,30 @@
 #include <cstdint>
 #include "cop0.hpp"
 #include "cop1.hpp"
+#include "emotioncachedinterpreter.hpp"
+#include "emotionfastmem.hpp"
+#include "emotionjit.hpp"
+#include "emotionpagetable.hpp"
+#include "../idleloop.hpp"
+#include "../int128.hpp"
 
 class Emulator;
 class BIOS_HLE;
 class VectorUnit;
 
+enum class CPU_MODE
+{
+    INTERPRETER,
+    CACHED_INTERPRETER,
+    JIT
+};
+
 class EmotionEngine
 {
     private:
+        friend class EmotionCachedInterpreter;
+        friend class EmotionJIT;
+
         BIOS_HLE* bios;
         Emulator* e;
 
@@ -19,7 +35,7 @@ class EmotionEngine
         VectorUnit* vu0;
 
         //Each register is 128-bit
-        uint8_t gpr[32 * sizeof(uint64_t) * 2];
+        alignas(16) uint8_t gpr[32 * sizeof(uint64_t) * 2];
         uint32_t PC, new_PC;
         uint64_t LO, LO1, HI, HI1;
         uint64_t SA;
@@ -30,14 +46,44 @@ class EmotionEngine
         int delay_slot;
 
         uint8_t scratchpad[1024 * 16];
+        EmotionPageTable page_table;
+        EmotionFastmem fastmem;
+
+        IdleLoopDetector idle_loops;
+        uint32_t idle_loop_PC;
+        bool idle_loop_hit;
+        bool skipped_idle;
+        bool slice_ended;
+        int cycles_run;
+
+        CPU_MODE mode;
+        EmotionCachedInterpreter cached_interpreter;
+        EmotionJIT jit;
 
         uint32_t get_paddr(uint32_t vaddr);
         void handle_exception(uint32_t new_addr, uint8_t code);
+
+        bool advance_PC();
+        bool finish_branch();
+        void check_interrupts();
+        void set_code_page(uint32_t paddr, bool is_code);
+        void skip_idle_cycles(uint32_t loop_PC, int cycles);
+        int take_idle_skip(int cycles);
     public:
         EmotionEngine(BIOS_HLE* b, Emulator* e, VectorUnit* vu0);
         static const char* REG(int id);
-        void reset();
-        void run();
+        void reset(uint8_t* RDRAM, uint8_t* BIOS);
+        int run(int cycles);
+        void step();
+        void set_mode(CPU_MODE mode);
+        EmotionFastmem* enable_fastmem();
+        void set_idle_loop_detection(bool enabled);
+        void print_idle_loop_stats();
+        void invalidate_code(uint32_t paddr);
+        void end_slice();
+        int get_slice_progress();
+        bool is_idle();
+        bool idle_loop_reads_io();
         void print_state();
         void set_disassembly(bool dis);
 
@@ -48,6 +94,9 @@ class EmotionEngine
         uint16_t read16(uint32_t address);
         uint32_t read32(uint32_t address);
         uint64_t read64(uint32_t address);
+        uint128_t read128(uint32_t address);
+        bool is_memory_address(uint32_t address);
+        bool is_pure_io_read(uint32_t address, int width);
         //void set_gpr_lo(int index, uint64_t value);
 
         void set_PC(uint32_t addr);
@@ -55,6 +104,7 @@ class EmotionEngine
         void write16(uint32_t address, uint16_t value);
         void write32(uint32_t address, uint32_t value);
         void write64(uint32_t address, uint64_t value);
+        void write128(uint32_t address, uint128_t value);
 
         void jp(uint32_t new_addr);
         void branch(bool condition, int offset);
@@ -98,6 +148,48 @@ class EmotionEngine
         void cop2_special(uint32_t instruction);
 };
 
+//Moves PC past the instruction that just ran. Returns false if the branch it resolved handed control elsewhere.
+inline bool EmotionEngine::advance_PC()
+{
+    if (increment_PC)
+        PC += 4;
+    else
+        increment_PC = true;
+    if (branch_on)
+    {
+        if (!delay_slot)
+            return finish_branch();
+        delay_slot--;
+    }
+    return true;
+}
+
+//Tells the memory maps that stores to this page must go through invalidate_code
+inline void EmotionEngine::set_code_page(uint32_t paddr, bool is_code)
+{
+    page_table.set_code_page(paddr, is_code);
+    fastmem.set_code_page(paddr, is_code);
+}
+
+//Called by every writer of RDRAM (CPU stores, DMA, the ELF loader) through Emulator::writeN
+inline void EmotionEngine::invalidate_code(uint32_t paddr)
+{
+    if (!page_table.is_code_page(paddr))
+        return;
+    if (mode == CPU_MODE::JIT)
+        jit.invalidate(paddr);
+    else if (mode == CPU_MODE::CACHED_INTERPRETER)
+        cached_interpreter.invalidate(paddr);
+}
+
+//Stops run() after the current instruction (or JIT block) so other devices can catch up to the EE
+inline void EmotionEngine::end_slice()
+{
+    slice_ended = true;
+    if (mode == CPU_MODE::JIT)
+        jit.request_exit();
+}
+
 template <typename T>
 inline T EmotionEngine::get_gpr(int id, int offset)
 {
@@ -111,4 +203,27 @@ inline void EmotionEngine::set_gpr(int id, T value, int offset)
         *(T*)&gpr[(id * sizeof(uint64_t) * 2) + (offset * sizeof(T))] = value;
 }
 
+//True if address reads RAM, scratchpad, or the BIOS rather than an I/O register
+inline bool EmotionEngine::is_memory_address(uint32_t address)
+{
+    return page_table.get_read_ptr(address) != nullptr;
+}
+
+//True if the last slice ended by skipping the idle loop the EE is still sitting at the start of
+inline bool EmotionEngine::is_idle()
+{
+    return skipped_idle && PC == idle_loop_PC && !branch_on;
+}
+
+inline bool EmotionEngine::idle_loop_reads_io()
+{
+    return idle_loops.reads_io(idle_loop_PC);
+}
+
+template <>
+inline uint32_t IdleLoopDetector::read_gpr(EmotionEngine& cpu, int id)
+{
+    return cpu.get_gpr<uint32_t>(id);
+}
+
 #endif // EMOTION_HPP
@@ -1,11 +1,13 @@
 #include "emotionasm.hpp"
 
+#include "../logger.hpp"
+
 uint32_t EmotionAssembler::jr(uint8_t addr)
 {
     uint32_t output = 0;
     output |= 0x8;
     output |= addr << 21;
-    printf("\nJR: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "JR: $%08X\n", output);
     return output;
 }
 
@@ -15,7 +17,7 @@ uint32_t EmotionAssembler::jalr(uint8_t return_addr, uint8_t addr)
     output |= 0x9;
     output |= return_addr << 11;
     output |= addr << 21;
-    printf("\nJALR: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "JALR: $%08X\n", output);
     return output;
 }
 
@@ -26,7 +28,7 @@ uint32_t EmotionAssembler::add(uint8_t dest, uint8_t reg1, uint8_t reg2)
     output |= dest << 11;
     output |= reg2 << 16;
     output |= reg1 << 21;
-    printf("\nADD: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "ADD: $%08X\n", output);
     return output;
 }
 
@@ -37,7 +39,7 @@ uint32_t EmotionAssembler::and_ee(uint8_t dest, uint8_t reg1, uint8_t reg2)
     output |= dest << 11;
     output |= reg2 << 16;
     output |= reg1 << 21;
-    printf("\nAND: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "AND: $%08X\n", output);
     return output;
 }
 
@@ -48,7 +50,7 @@ uint32_t EmotionAssembler::addiu(uint8_t dest, uint8_t source, int16_t offset)
     output |= dest << 16;
     output |= source << 21;
     output |= 0x09 << 26;
-    printf("\nADDIU: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "ADDIU: $%08X\n", output);
     return output;
 }
 
@@ -59,7 +61,7 @@ uint32_t EmotionAssembler::ori(uint8_t dest, uint8_t source, uint16_t offset)
     output |= dest << 16;
     output |= source << 21;
     output |= 0xD << 26;
-    printf("\nORI: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "ORI: $%08X\n", output);
     return output;
 }
 
@@ -69,7 +71,7 @@ uint32_t EmotionAssembler::lui(uint8_t dest, int32_t offset)
     output |= (uint16_t)(offset >> 16);
     output |= dest << 16;
     output |= 0x0F << 26;
-    printf("\nLUI: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "LUI: $%08X\n", output);
     return output;
 }
 
@@ -79,7 +81,7 @@ uint32_t EmotionAssembler::mfc0(uint8_t dest, uint8_t source)
     output |= source << 11;
     output |= dest << 16;
     output |= 0x10 << 26;
-    printf("\nMFC0: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "MFC0: $%08X\n", output);
     return output;
 }
 
@@ -89,7 +91,7 @@ uint32_t EmotionAssembler::eret()
     output |= 0x18;
     output |= 0x10 << 21;
     output |= 0x10 << 26;
-    printf("\nERET: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "ERET: $%08X\n", output);
     return output;
 }
 
@@ -100,7 +102,7 @@ uint32_t EmotionAssembler::lq(uint8_t dest, uint8_t base, int16_t offset)
     output |= dest << 16;
     output |= base << 21;
     output |= 0x1E << 26;
-    printf("\nLQ: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "LQ: $%08X\n", output);
     return output;
 }
 
@@ -111,7 +113,7 @@ uint32_t EmotionAssembler::sq(uint8_t source, uint8_t base, int16_t offset)
     output |= source << 16;
     output |= base << 21;
     output |= 0x1F << 26;
-    printf("\nSQ: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "SQ: $%08X\n", output);
     return output;
 }
 
@@ -122,7 +124,7 @@ uint32_t EmotionAssembler::lw(uint8_t dest, uint8_t base, int16_t offset)
     output |= dest << 16;
     output |= base << 21;
     output |= 0x23 << 26;
-    printf("\nLW: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "LW: $%08X\n", output);
     return output;
 }
 
@@ -133,6 +135,6 @@ uint32_t EmotionAssembler::sw(uint8_t source, uint8_t base, int16_t offset)
     output |= source << 16;
     output |= base << 21;
     output |= 0x2B << 26;
-    printf("\nSW: $%08X", output);
+    DEBUG_LOG(LOG_JIT, "SW: $%08X\n", output);
     return output;
 }
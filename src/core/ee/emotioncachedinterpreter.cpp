@@ -0,0 +1,548 @@
+#include <cstring>
+#include "emotion.hpp"
+#include "emotioncachedinterpreter.hpp"
+#include "emotioninterpreter.hpp"
+
+#define MAX_BLOCK_SIZE 128
+
+static void op_interpret(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    EmotionInterpreter::interpret(cpu, op.instruction);
+}
+
+static void op_nop(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+
+}
+
+static void op_sll(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t result = cpu.get_gpr<uint32_t>(op.rt) << op.sa;
+    cpu.set_gpr<int64_t>(op.rd, (int32_t)result);
+}
+
+static void op_srl(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t result = cpu.get_gpr<uint32_t>(op.rt) >> op.sa;
+    cpu.set_gpr<int64_t>(op.rd, (int32_t)result);
+}
+
+static void op_addu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t result = cpu.get_gpr<uint32_t>(op.rs) + cpu.get_gpr<uint32_t>(op.rt);
+    cpu.set_gpr<int64_t>(op.rd, (int32_t)result);
+}
+
+static void op_subu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t result = cpu.get_gpr<uint32_t>(op.rs) - cpu.get_gpr<uint32_t>(op.rt);
+    cpu.set_gpr<int64_t>(op.rd, (int32_t)result);
+}
+
+static void op_daddu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<uint64_t>(op.rd, cpu.get_gpr<uint64_t>(op.rs) + cpu.get_gpr<uint64_t>(op.rt));
+}
+
+static void op_and(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<uint64_t>(op.rd, cpu.get_gpr<uint64_t>(op.rs) & cpu.get_gpr<uint64_t>(op.rt));
+}
+
+static void op_or(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<uint64_t>(op.rd, cpu.get_gpr<uint64_t>(op.rs) | cpu.get_gpr<uint64_t>(op.rt));
+}
+
+static void op_slt(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<uint64_t>(op.rd, cpu.get_gpr<int64_t>(op.rs) < cpu.get_gpr<int64_t>(op.rt));
+}
+
+static void op_sltu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<uint64_t>(op.rd, cpu.get_gpr<uint64_t>(op.rs) < cpu.get_gpr<uint64_t>(op.rt));
+}
+
+static void op_jr(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.jp(cpu.get_gpr<uint32_t>(op.rs));
+}
+
+static void op_jalr(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t return_addr = cpu.get_PC() + 8;
+    cpu.jp(cpu.get_gpr<uint32_t>(op.rs));
+    cpu.set_gpr<uint32_t>(op.rd, return_addr);
+}
+
+static void op_j(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.jp(((cpu.get_PC() + 4) & 0xF0000000) + op.imm);
+}
+
+static void op_jal(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t PC = cpu.get_PC();
+    cpu.jp(((PC + 4) & 0xF0000000) + op.imm);
+    cpu.set_gpr<uint32_t>(31, PC + 8);
+}
+
+static void op_beq(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.branch(cpu.get_gpr<uint64_t>(op.rs) == cpu.get_gpr<uint64_t>(op.rt), op.imm);
+}
+
+static void op_bne(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.branch(cpu.get_gpr<uint64_t>(op.rs) != cpu.get_gpr<uint64_t>(op.rt), op.imm);
+}
+
+static void op_beql(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.branch_likely(cpu.get_gpr<uint64_t>(op.rs) == cpu.get_gpr<uint64_t>(op.rt), op.imm);
+}
+
+static void op_bnel(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.branch_likely(cpu.get_gpr<uint64_t>(op.rs) != cpu.get_gpr<uint64_t>(op.rt), op.imm);
+}
+
+static void op_blez(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.branch(cpu.get_gpr<int64_t>(op.rs) <= 0, op.imm);
+}
+
+static void op_bgtz(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.branch(cpu.get_gpr<int64_t>(op.rs) > 0, op.imm);
+}
+
+static void op_bltz(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.branch(cpu.get_gpr<int64_t>(op.rs) < 0, op.imm);
+}
+
+static void op_bgez(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.branch(cpu.get_gpr<int64_t>(op.rs) >= 0, op.imm);
+}
+
+static void op_addiu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t result = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.set_gpr<int64_t>(op.rt, (int32_t)result);
+}
+
+static void op_daddiu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<uint64_t>(op.rt, cpu.get_gpr<uint64_t>(op.rs) + (int64_t)op.imm);
+}
+
+static void op_andi(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<uint64_t>(op.rt, cpu.get_gpr<uint64_t>(op.rs) & (uint32_t)op.imm);
+}
+
+static void op_ori(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<uint64_t>(op.rt, cpu.get_gpr<uint64_t>(op.rs) | (uint32_t)op.imm);
+}
+
+static void op_lui(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    cpu.set_gpr<int64_t>(op.rt, op.imm);
+}
+
+static void op_lb(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.set_gpr<int64_t>(op.rt, (int8_t)cpu.read8(addr));
+}
+
+static void op_lbu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.set_gpr<uint64_t>(op.rt, cpu.read8(addr));
+}
+
+static void op_lh(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.set_gpr<int64_t>(op.rt, (int16_t)cpu.read16(addr));
+}
+
+static void op_lhu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.set_gpr<uint64_t>(op.rt, cpu.read16(addr));
+}
+
+static void op_lw(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.set_gpr<int64_t>(op.rt, (int32_t)cpu.read32(addr));
+}
+
+static void op_lwu(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.set_gpr<uint64_t>(op.rt, cpu.read32(addr));
+}
+
+static void op_ld(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.set_gpr<uint64_t>(op.rt, cpu.read64(addr));
+}
+
+static void op_sb(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.write8(addr, cpu.get_gpr<uint8_t>(op.rt));
+}
+
+static void op_sh(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.write16(addr, cpu.get_gpr<uint16_t>(op.rt));
+}
+
+static void op_sw(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.write32(addr, cpu.get_gpr<uint32_t>(op.rt));
+}
+
+static void op_sd(EmotionEngine& cpu, const EEDecodedOp& op)
+{
+    uint32_t addr = cpu.get_gpr<uint32_t>(op.rs) + op.imm;
+    cpu.write64(addr, cpu.get_gpr<uint64_t>(op.rt));
+}
+
+static bool is_branch(uint32_t instruction)
+{
+    int op = instruction >> 26;
+    switch (op)
+    {
+        case 0x00:
+            return (instruction & 0x3E) == 0x08;
+        case 0x01:
+            return ((instruction >> 16) & 0x1F) < 0x04;
+        case 0x02:
+        case 0x03:
+        case 0x04:
+        case 0x05:
+        case 0x06:
+        case 0x07:
+        case 0x14:
+        case 0x15:
+        case 0x16:
+            return true;
+        case 0x11:
+            return ((instruction >> 21) & 0x1F) == 0x08;
+        default:
+            return false;
+    }
+}
+
+//Instructions that may raise exceptions or change the interrupt state end a block
+static bool is_terminator(uint32_t instruction)
+{
+    int op = instruction >> 26;
+    if (op == 0x10)
+        return true;
+    return !op && (instruction & 0x3F) == 0x0C;
+}
+
+EmotionCachedInterpreter::EmotionCachedInterpreter(EmotionEngine* cpu) : cpu(cpu)
+{
+    running_block = false;
+    memset(cached_pages, 0, sizeof(cached_pages));
+}
+
+void EmotionCachedInterpreter::reset()
+{
+    blocks.clear();
+    for (int i = 0; i < CACHED_CODE_PAGES; i++)
+    {
+        page_blocks[i].clear();
+        if (cached_pages[i])
+            cpu->set_code_page(i << 12, false);
+    }
+    memset(cached_pages, 0, sizeof(cached_pages));
+    pending_pages.clear();
+    running_block = false;
+}
+
+bool EmotionCachedInterpreter::is_cacheable(uint32_t PC)
+{
+    if (PC >= 0x70000000 && PC < 0x70004000)
+        return false;
+    if (PC >= 0x30100000 && PC < 0x31FFFFFF)
+        return false;
+    uint32_t paddr = PC & 0x1FFFFFFF;
+    return paddr < 0x10000000 || paddr >= 0x1FC00000;
+}
+
+int EmotionCachedInterpreter::run(int cycles)
+{
+    cpu->cycles_run = 0;
+    while (cpu->cycles_run < cycles && !cpu->slice_ended)
+    {
+        //Finish branches started elsewhere and run uncached memory one instruction at a time
+        if (cpu->branch_on || !is_cacheable(cpu->PC))
+        {
+            cpu->step();
+            cpu->cycles_run++;
+            if (cpu->idle_loop_hit)
+                cpu->cycles_run += cpu->take_idle_skip(cycles - cpu->cycles_run);
+            continue;
+        }
+
+        uint32_t paddr = cpu->PC & 0x1FFFFFFF;
+        EECachedBlock* block;
+        auto it = blocks.find(paddr);
+        if (it != blocks.end())
+            block = &it->second;
+        else
+            block = decode_block(paddr);
+
+        running_block = true;
+        bool handed_off = false;
+        uint32_t expected_PC = cpu->PC;
+        for (auto op = block->ops.begin(); op != block->ops.end(); ++op)
+        {
+            op->handler(*cpu, *op);
+            cpu->cp0.count_up();
+            cpu->cycles_run++;
+            expected_PC += 4;
+            if (!cpu->advance_PC())
+            {
+                handed_off = true;
+                break;
+            }
+
+            //Leave as soon as control flow or the code itself goes somewhere the block didn't expect
+            if (cpu->PC != expected_PC || !pending_pages.empty() || cpu->slice_ended)
+                break;
+        }
+        running_block = false;
+
+        for (unsigned int i = 0; i < pending_pages.size(); i++)
+            invalidate_page(pending_pages[i]);
+        pending_pages.clear();
+
+        if (!handed_off)
+            cpu->check_interrupts();
+        if (cpu->idle_loop_hit)
+            cpu->cycles_run += cpu->take_idle_skip(cycles - cpu->cycles_run);
+    }
+    int slice_length = cpu->cycles_run;
+    cpu->cycles_run = 0;
+    return slice_length;
+}
+
+EECachedBlock* EmotionCachedInterpreter::decode_block(uint32_t paddr)
+{
+    EECachedBlock& block = blocks[paddr];
+    uint32_t PC = cpu->PC;
+    bool delay_slot = false;
+    for (int i = 0; i < MAX_BLOCK_SIZE; i++)
+    {
+        uint32_t instruction = cpu->read32(PC + (i * 4));
+        block.ops.push_back(decode(instruction));
+        if (delay_slot || is_terminator(instruction))
+            break;
+        delay_slot = is_branch(instruction);
+    }
+
+    if (paddr < 0x10000000)
+    {
+        int start_page = (paddr & 0x01FFFFFF) >> 12;
+        int end_page = ((paddr + (block.ops.size() * 4) - 1) & 0x01FFFFFF) >> 12;
+        for (int page = start_page; ; page = (page + 1) % CACHED_CODE_PAGES)
+        {
+            page_blocks[page].push_back(paddr);
+            if (!cached_pages[page])
+            {
+                cached_pages[page] = 1;
+                cpu->set_code_page(page << 12, true);
+            }
+            if (page == end_page)
+                break;
+        }
+    }
+    return &block;
+}
+
+void EmotionCachedInterpreter::invalidate_page(int page)
+{
+    if (!cached_pages[page])
+        return;
+    for (unsigned int i = 0; i < page_blocks[page].size(); i++)
+        blocks.erase(page_blocks[page][i]);
+    page_blocks[page].clear();
+    cached_pages[page] = 0;
+    cpu->set_code_page(page << 12, false);
+}
+
+EEDecodedOp EmotionCachedInterpreter::decode(uint32_t instruction)
+{
+    EEDecodedOp op;
+    op.instruction = instruction;
+    op.rs = (instruction >> 21) & 0x1F;
+    op.rt = (instruction >> 16) & 0x1F;
+    op.rd = (instruction >> 11) & 0x1F;
+    op.sa = (instruction >> 6) & 0x1F;
+    op.imm = (int16_t)(instruction & 0xFFFF);
+    op.handler = &op_interpret;
+
+    if (!instruction)
+    {
+        op.handler = &op_nop;
+        return op;
+    }
+
+    switch (instruction >> 26)
+    {
+        case 0x00:
+            switch (instruction & 0x3F)
+            {
+                case 0x00:
+                    op.handler = &op_sll;
+                    break;
+                case 0x02:
+                    op.handler = &op_srl;
+                    break;
+                case 0x08:
+                    op.handler = &op_jr;
+                    break;
+                case 0x09:
+                    op.handler = &op_jalr;
+                    break;
+                case 0x20:
+                case 0x21:
+                    op.handler = &op_addu;
+                    break;
+                case 0x22:
+                case 0x23:
+                    op.handler = &op_subu;
+                    break;
+                case 0x24:
+                    op.handler = &op_and;
+                    break;
+                case 0x25:
+                    op.handler = &op_or;
+                    break;
+                case 0x2A:
+                    op.handler = &op_slt;
+                    break;
+                case 0x2B:
+                    op.handler = &op_sltu;
+                    break;
+                case 0x2C:
+                case 0x2D:
+                    op.handler = &op_daddu;
+                    break;
+            }
+            break;
+        case 0x01:
+            op.imm <<= 2;
+            switch (op.rt)
+            {
+                case 0x00:
+                    op.handler = &op_bltz;
+                    break;
+                case 0x01:
+                    op.handler = &op_bgez;
+                    break;
+            }
+            break;
+        case 0x02:
+            op.imm = (instruction & 0x3FFFFFF) << 2;
+            op.handler = &op_j;
+            break;
+        case 0x03:
+            op.imm = (instruction & 0x3FFFFFF) << 2;
+            op.handler = &op_jal;
+            break;
+        case 0x04:
+            op.imm <<= 2;
+            op.handler = &op_beq;
+            break;
+        case 0x05:
+            op.imm <<= 2;
+            op.handler = &op_bne;
+            break;
+        case 0x06:
+            op.imm <<= 2;
+            op.handler = &op_blez;
+            break;
+        case 0x07:
+            op.imm <<= 2;
+            op.handler = &op_bgtz;
+            break;
+        case 0x08:
+        case 0x09:
+            op.handler = &op_addiu;
+            break;
+        case 0x0C:
+            op.imm = instruction & 0xFFFF;
+            op.handler = &op_andi;
+            break;
+        case 0x0D:
+            op.imm = instruction & 0xFFFF;
+            op.handler = &op_ori;
+            break;
+        case 0x0F:
+            op.imm = (int32_t)((instruction & 0xFFFF) << 16);
+            op.handler = &op_lui;
+            break;
+        case 0x14:
+            op.imm <<= 2;
+            op.handler = &op_beql;
+            break;
+        case 0x15:
+            op.imm <<= 2;
+            op.handler = &op_bnel;
+            break;
+        case 0x19:
+            op.handler = &op_daddiu;
+            break;
+        case 0x20:
+            op.handler = &op_lb;
+            break;
+        case 0x21:
+            op.handler = &op_lh;
+            break;
+        case 0x23:
+            op.handler = &op_lw;
+            break;
+        case 0x24:
+            op.handler = &op_lbu;
+            break;
+        case 0x25:
+            op.handler = &op_lhu;
+            break;
+        case 0x27:
+            op.handler = &op_lwu;
+            break;
+        case 0x28:
+            op.handler = &op_sb;
+            break;
+        case 0x29:
+            op.handler = &op_sh;
+            break;
+        case 0x2B:
+            op.handler = &op_sw;
+            break;
+        case 0x37:
+            op.handler = &op_ld;
+            break;
+        case 0x3F:
+            op.handler = &op_sd;
+            break;
+    }
+    return op;
+}
@@ -0,0 +1,79 @@
+#ifndef EMOTIONCACHEDINTERPRETER_HPP
+#define EMOTIONCACHEDINTERPRETER_HPP
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//4 KB pages of RDRAM that blocks are tracked by
+#define CACHED_CODE_PAGES (1024 * 1024 * 32 / 4096)
+
+/**
+Pre-decoding "cached interpreter" for the Emotion Engine.
+
+Each guest basic block is fetched and decoded once into a list of records holding a handler and the operand fields
+already pulled out of the instruction. Blocks are looked up by physical PC and then run back-to-back without
+touching Emulator::read32 or the decoding switch again. Common instructions get dedicated handlers that use the
+pre-extracted fields; everything else is handed to EmotionInterpreter.
+
+This is portable C++, so it works on hosts where the x86-64 JIT can't.
+**/
+
+class EmotionEngine;
+struct EEDecodedOp;
+
+typedef void (*EEOpHandler)(EmotionEngine& cpu, const EEDecodedOp& op);
+
+struct EEDecodedOp
+{
+    EEOpHandler handler;
+    uint32_t instruction;
+    uint8_t rs, rt, rd, sa;
+    int32_t imm;
+};
+
+struct EECachedBlock
+{
+    std::vector<EEDecodedOp> ops;
+};
+
+class EmotionCachedInterpreter
+{
+    private:
+        EmotionEngine* cpu;
+
+        std::unordered_map<uint32_t, EECachedBlock> blocks;
+
+        //Start addresses of the blocks that overlap each 4 KB page of RDRAM
+        std::vector<uint32_t> page_blocks[CACHED_CODE_PAGES];
+        uint8_t cached_pages[CACHED_CODE_PAGES];
+
+        std::vector<uint32_t> pending_pages;
+        bool running_block;
+
+        bool is_cacheable(uint32_t PC);
+        EECachedBlock* decode_block(uint32_t paddr);
+        EEDecodedOp decode(uint32_t instruction);
+        void invalidate_page(int page);
+    public:
+        EmotionCachedInterpreter(EmotionEngine* cpu);
+
+        void reset();
+        int run(int cycles);
+
+        void invalidate(uint32_t paddr);
+};
+
+inline void EmotionCachedInterpreter::invalidate(uint32_t paddr)
+{
+    int page = (paddr & 0x01FFFFFF) >> 12;
+    if (!cached_pages[page])
+        return;
+
+    //The block being run is still in use, so wait until it's done
+    if (running_block)
+        pending_pages.push_back(page);
+    else
+        invalidate_page(page);
+}
+
+#endif // EMOTIONCACHEDINTERPRETER_HPP
@@ -0,0 +1,385 @@
+#include <cstdio>
+#include <cstring>
+#include "emotionfastmem.hpp"
+
+#include "../emulator.hpp"
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <csignal>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#define FASTMEM_SUPPORTED
+#endif
+
+#define ARENA_SIZE (1ULL << 32)
+
+//Layout of the backing file
+#define RDRAM_OFFSET 0
+#define RDRAM_SIZE (1024 * 1024 * 32)
+#define IOP_RAM_OFFSET (RDRAM_OFFSET + RDRAM_SIZE)
+#define IOP_RAM_SIZE (1024 * 1024 * 2)
+#define BIOS_OFFSET (IOP_RAM_OFFSET + IOP_RAM_SIZE)
+#define BIOS_SIZE (1024 * 1024 * 4)
+#define SCRATCHPAD_OFFSET (BIOS_OFFSET + BIOS_SIZE)
+#define SCRATCHPAD_SIZE (1024 * 16)
+#define MEMORY_SIZE (SCRATCHPAD_OFFSET + SCRATCHPAD_SIZE)
+
+//The 0x30100000 window is page-aligned except for its very last byte, which is left unmapped
+#define REMAP_START 0x30100000
+#define REMAP_SIZE (0x31FFF000 - REMAP_START)
+
+#ifdef FASTMEM_SUPPORTED
+//Only one instance can own the SIGSEGV handler at a time
+static EmotionFastmem* fault_owner = nullptr;
+
+//Whatever handled SIGSEGV before, e.g. the guest console's crash flush
+static struct sigaction previous_action;
+
+static void fault_handler(int sig, siginfo_t* info, void* context)
+{
+    if (fault_owner && fault_owner->handle_fault((uint8_t*)info->si_addr, context))
+        return;
+
+    //Not ours, so let the fault happen again with the previous handler
+    sigaction(SIGSEGV, &previous_action, nullptr);
+}
+
+//Host register number -> ucontext register index
+static const int context_regs[16] =
+{
+    REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+    REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15
+};
+#endif
+
+EmotionFastmem::EmotionFastmem(Emulator* e) : e(e)
+{
+    fd = -1;
+    memory = nullptr;
+    arena = nullptr;
+}
+
+EmotionFastmem::~EmotionFastmem()
+{
+#ifdef FASTMEM_SUPPORTED
+    if (fault_owner == this)
+    {
+        sigaction(SIGSEGV, &previous_action, nullptr);
+        fault_owner = nullptr;
+    }
+    if (arena)
+        munmap(arena, ARENA_SIZE);
+    if (memory)
+        munmap(memory, MEMORY_SIZE);
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+bool EmotionFastmem::init()
+{
+#ifdef FASTMEM_SUPPORTED
+    if (arena)
+        return true;
+    if (fault_owner)
+        return false;
+
+    fd = memfd_create("dobiestation_ee", 0);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, MEMORY_SIZE) < 0)
+        return false;
+
+    memory = (uint8_t*)mmap(nullptr, MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        memory = nullptr;
+        return false;
+    }
+
+    arena = (uint8_t*)mmap(nullptr, ARENA_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena == MAP_FAILED)
+    {
+        arena = nullptr;
+        return false;
+    }
+
+    //Each of the eight 512 MB segments sees the same physical memory
+    bool success = true;
+    for (uint32_t segment = 0; segment < 8; segment++)
+    {
+        uint32_t base = segment << 29;
+        success &= map_view(base, RDRAM_OFFSET, RDRAM_SIZE, true);
+        success &= map_view(base + 0x1FC00000, BIOS_OFFSET, BIOS_SIZE, false);
+    }
+    success &= map_view(REMAP_START, RDRAM_OFFSET + REMAP_START - 0x30000000, REMAP_SIZE, true);
+    success &= map_view(0x70000000, SCRATCHPAD_OFFSET, SCRATCHPAD_SIZE, true);
+    if (!success)
+    {
+        munmap(arena, ARENA_SIZE);
+        arena = nullptr;
+        return false;
+    }
+
+    struct sigaction action;
+    action.sa_sigaction = &fault_handler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, &previous_action) < 0)
+    {
+        munmap(arena, ARENA_SIZE);
+        arena = nullptr;
+        return false;
+    }
+    fault_owner = this;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool EmotionFastmem::map_view(uint32_t vaddr, uint32_t offset, uint32_t size, bool writable)
+{
+#ifdef FASTMEM_SUPPORTED
+    int prot = PROT_READ;
+    if (writable)
+        prot |= PROT_WRITE;
+    void* view = mmap(arena + vaddr, size, prot, MAP_SHARED | MAP_FIXED, fd, offset);
+    return view != MAP_FAILED;
+#else
+    return false;
+#endif
+}
+
+uint8_t* EmotionFastmem::get_RDRAM()
+{
+    return memory + RDRAM_OFFSET;
+}
+
+uint8_t* EmotionFastmem::get_IOP_RAM()
+{
+    return memory + IOP_RAM_OFFSET;
+}
+
+uint8_t* EmotionFastmem::get_BIOS()
+{
+    return memory + BIOS_OFFSET;
+}
+
+uint8_t* EmotionFastmem::get_scratchpad()
+{
+    return memory + SCRATCHPAD_OFFSET;
+}
+
+void EmotionFastmem::set_code_page(uint32_t paddr, bool is_code)
+{
+#ifdef FASTMEM_SUPPORTED
+    if (!arena)
+        return;
+    uint32_t offset = paddr & 0x01FFF000;
+    int prot = PROT_READ;
+    if (!is_code)
+        prot |= PROT_WRITE;
+    for (uint32_t segment = 0; segment < 8; segment++)
+        mprotect(arena + (segment << 29) + offset, 4096, prot);
+    if (offset >= REMAP_START - 0x30000000 && offset < REMAP_START - 0x30000000 + REMAP_SIZE)
+        mprotect(arena + 0x30000000 + offset, 4096, prot);
+#endif
+}
+
+/**
+ * Emulates the mov at the faulting instruction through the Emulator and skips past it.
+ * Only the forms emitted by the read/write helpers and the JIT are understood: mov, movzx, movsx, and movsxd,
+ * with an optional operand-size prefix and REX byte, plus movdqu for quadwords.
+ */
+bool EmotionFastmem::handle_fault(uint8_t* fault_addr, void* context)
+{
+#ifdef FASTMEM_SUPPORTED
+    if (!arena || fault_addr < arena || fault_addr >= arena + ARENA_SIZE)
+        return false;
+    uint32_t vaddr = (uint32_t)(fault_addr - arena);
+
+    greg_t* regs = ((ucontext_t*)context)->uc_mcontext.gregs;
+    uint8_t* code = (uint8_t*)regs[REG_RIP];
+
+    bool op16 = false;
+    bool rep = false;
+    if (*code == 0x66)
+    {
+        op16 = true;
+        code++;
+    }
+    else if (*code == 0xF3)
+    {
+        rep = true;
+        code++;
+    }
+    uint8_t rex = 0;
+    if ((*code & 0xF0) == 0x40)
+    {
+        rex = *code;
+        code++;
+    }
+    bool rex_w = rex & 0x8;
+
+    bool is_store = false;
+    bool sign_extend = false;
+    int size;
+    switch (*code)
+    {
+        case 0x88:
+            is_store = true;
+            size = 1;
+            break;
+        case 0x89:
+            is_store = true;
+            size = op16 ? 2 : (rex_w ? 8 : 4);
+            break;
+        case 0x8B:
+            if (op16)
+                return false;
+            size = rex_w ? 8 : 4;
+            break;
+        case 0x63:
+            sign_extend = true;
+            size = 4;
+            break;
+        case 0x0F:
+            code++;
+            if (rep && (*code == 0x6F || *code == 0x7F))
+            {
+                //movdqu
+                is_store = *code == 0x7F;
+                size = 16;
+                break;
+            }
+            switch (*code)
+            {
+                case 0xB6:
+                    size = 1;
+                    break;
+                case 0xB7:
+                    size = 2;
+                    break;
+                case 0xBE:
+                    sign_extend = true;
+                    size = 1;
+                    break;
+                case 0xBF:
+                    sign_extend = true;
+                    size = 2;
+                    break;
+                default:
+                    return false;
+            }
+            break;
+        default:
+            return false;
+    }
+    code++;
+
+    uint8_t modrm = *code;
+    code++;
+    int mod = modrm >> 6;
+    int reg = ((modrm >> 3) & 0x7) | ((rex & 0x4) << 1);
+    int rm = modrm & 0x7;
+    if (mod == 3)
+        return false;
+    if (rm == 4)
+    {
+        uint8_t sib = *code;
+        code++;
+        if (mod == 0 && (sib & 0x7) == 5)
+            code += 4;
+    }
+    else if (mod == 0 && rm == 5)
+        code += 4;
+    if (mod == 1)
+        code += 1;
+    else if (mod == 2)
+        code += 4;
+
+    //Same translation as EmotionEngine; the scratchpad is always mapped, so it never gets here
+    uint32_t address = vaddr;
+    if (address >= 0x30100000 && address < 0x31FFFFFF)
+        address -= 0x10000000;
+    address &= 0x1FFFFFFF;
+
+    if (size == 16)
+    {
+        //The xmm registers are restored from the saved FPU state when the handler returns
+        uint32_t* xmm = ((ucontext_t*)context)->uc_mcontext.fpregs->_xmm[reg].element;
+        uint128_t value;
+        if (is_store)
+        {
+            memcpy(&value, xmm, 16);
+            e->write128(address, value);
+        }
+        else
+        {
+            value = e->read128(address);
+            memcpy(xmm, &value, 16);
+        }
+    }
+    else if (is_store)
+    {
+        uint64_t value;
+        //Without REX, byte registers 4-7 are AH, CH, DH, and BH
+        if (size == 1 && !rex && reg >= 4)
+            value = regs[context_regs[reg - 4]] >> 8;
+        else
+            value = regs[context_regs[reg]];
+        switch (size)
+        {
+            case 1:
+                e->write8(address, value);
+                break;
+            case 2:
+                e->write16(address, value);
+                break;
+            case 4:
+                e->write32(address, value);
+                break;
+            default:
+                e->write64(address, value);
+                break;
+        }
+    }
+    else
+    {
+        uint64_t value;
+        switch (size)
+        {
+            case 1:
+                value = e->read8(address);
+                if (sign_extend)
+                    value = (int64_t)(int8_t)value;
+                break;
+            case 2:
+                value = e->read16(address);
+                if (sign_extend)
+                    value = (int64_t)(int16_t)value;
+                break;
+            case 4:
+                value = e->read32(address);
+                if (sign_extend)
+                    value = (int64_t)(int32_t)value;
+                break;
+            default:
+                value = e->read64(address);
+                break;
+        }
+
+        //32-bit destinations clear the upper half of the register
+        if (!rex_w)
+            value &= 0xFFFFFFFF;
+        regs[context_regs[reg]] = value;
+    }
+
+    regs[REG_RIP] = (greg_t)code;
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,186 @@
+#ifndef EMOTIONFASTMEM_HPP
+#define EMOTIONFASTMEM_HPP
+#include <cstdint>
+#include "../int128.hpp"
+
+/**
+Host virtual memory "fastmem" for the EE. Only available on x86-64 Linux, and off unless asked for.
+
+A 4 GB region of host address space is reserved so that every EE virtual address has a host counterpart at
+arena + vaddr. RDRAM, IOP RAM, the BIOS, and the scratchpad all live in one memfd, and all but IOP RAM are mapped
+into the arena at each of their KSEG aliases. Guest RAM accesses are then a single host mov with no checks.
+
+Everything else is left unmapped: MMIO, the IOP RAM window (so that the EE syncs up with the IOP when it touches
+it), BIOS writes, the less common 32 MB RDRAM mirrors, and RDRAM pages with cached code (which are made read-only). Touching those raises SIGSEGV. The handler decodes the faulting mov,
+performs the access through Emulator::readN/writeN, and resumes after the instruction.
+**/
+
+class Emulator;
+
+class EmotionFastmem
+{
+    private:
+        Emulator* e;
+
+        int fd;
+        uint8_t* memory;
+        uint8_t* arena;
+
+        bool map_view(uint32_t vaddr, uint32_t offset, uint32_t size, bool writable);
+    public:
+        EmotionFastmem(Emulator* e);
+        ~EmotionFastmem();
+
+        bool init();
+        bool is_active();
+        bool handle_fault(uint8_t* fault_addr, void* context);
+
+        uint8_t* get_arena();
+        uint8_t* get_RDRAM();
+        uint8_t* get_IOP_RAM();
+        uint8_t* get_BIOS();
+        uint8_t* get_scratchpad();
+
+        void set_code_page(uint32_t paddr, bool is_code);
+
+        //Accesses are written out in asm so the fault handler only ever sees plain movs it knows how to decode
+        uint8_t read8(uint32_t vaddr);
+        uint16_t read16(uint32_t vaddr);
+        uint32_t read32(uint32_t vaddr);
+        uint64_t read64(uint32_t vaddr);
+        uint128_t read128(uint32_t vaddr);
+        void write8(uint32_t vaddr, uint8_t value);
+        void write16(uint32_t vaddr, uint16_t value);
+        void write32(uint32_t vaddr, uint32_t value);
+        void write64(uint32_t vaddr, uint64_t value);
+        void write128(uint32_t vaddr, uint128_t value);
+};
+
+inline bool EmotionFastmem::is_active()
+{
+    return arena != nullptr;
+}
+
+inline uint8_t* EmotionFastmem::get_arena()
+{
+    return arena;
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+
+inline uint8_t EmotionFastmem::read8(uint32_t vaddr)
+{
+    uint32_t value;
+    asm volatile("movzbl (%1,%2), %0" : "=r"(value) : "r"(arena), "r"((uint64_t)vaddr) : "memory");
+    return value;
+}
+
+inline uint16_t EmotionFastmem::read16(uint32_t vaddr)
+{
+    uint32_t value;
+    asm volatile("movzwl (%1,%2), %0" : "=r"(value) : "r"(arena), "r"((uint64_t)vaddr) : "memory");
+    return value;
+}
+
+inline uint32_t EmotionFastmem::read32(uint32_t vaddr)
+{
+    uint32_t value;
+    asm volatile("movl (%1,%2), %0" : "=r"(value) : "r"(arena), "r"((uint64_t)vaddr) : "memory");
+    return value;
+}
+
+inline uint64_t EmotionFastmem::read64(uint32_t vaddr)
+{
+    uint64_t value;
+    asm volatile("movq (%1,%2), %0" : "=r"(value) : "r"(arena), "r"((uint64_t)vaddr) : "memory");
+    return value;
+}
+
+inline uint128_t EmotionFastmem::read128(uint32_t vaddr)
+{
+    uint128_t value;
+    asm volatile("movdqu (%1,%2), %0" : "=x"(value._sse) : "r"(arena), "r"((uint64_t)vaddr) : "memory");
+    return value;
+}
+
+inline void EmotionFastmem::write8(uint32_t vaddr, uint8_t value)
+{
+    asm volatile("movb %b0, (%1,%2)" : : "r"(value), "r"(arena), "r"((uint64_t)vaddr) : "memory");
+}
+
+inline void EmotionFastmem::write16(uint32_t vaddr, uint16_t value)
+{
+    asm volatile("movw %w0, (%1,%2)" : : "r"(value), "r"(arena), "r"((uint64_t)vaddr) : "memory");
+}
+
+inline void EmotionFastmem::write32(uint32_t vaddr, uint32_t value)
+{
+    asm volatile("movl %0, (%1,%2)" : : "r"(value), "r"(arena), "r"((uint64_t)vaddr) : "memory");
+}
+
+inline void EmotionFastmem::write64(uint32_t vaddr, uint64_t value)
+{
+    asm volatile("movq %0, (%1,%2)" : : "r"(value), "r"(arena), "r"((uint64_t)vaddr) : "memory");
+}
+
+inline void EmotionFastmem::write128(uint32_t vaddr, uint128_t value)
+{
+    asm volatile("movdqu %0, (%1,%2)" : : "x"(value._sse), "r"(arena), "r"((uint64_t)vaddr) : "memory");
+}
+
+#else
+
+//Never reached, as init() always fails on these hosts
+inline uint8_t EmotionFastmem::read8(uint32_t vaddr)
+{
+    return arena[vaddr];
+}
+
+inline uint16_t EmotionFastmem::read16(uint32_t vaddr)
+{
+    return *(uint16_t*)&arena[vaddr];
+}
+
+inline uint32_t EmotionFastmem::read32(uint32_t vaddr)
+{
+    return *(uint32_t*)&arena[vaddr];
+}
+
+inline uint64_t EmotionFastmem::read64(uint32_t vaddr)
+{
+    return *(uint64_t*)&arena[vaddr];
+}
+
+inline uint128_t EmotionFastmem::read128(uint32_t vaddr)
+{
+    return load128(&arena[vaddr]);
+}
+
+inline void EmotionFastmem::write8(uint32_t vaddr, uint8_t value)
+{
+    arena[vaddr] = value;
+}
+
+inline void EmotionFastmem::write16(uint32_t vaddr, uint16_t value)
+{
+    *(uint16_t*)&arena[vaddr] = value;
+}
+
+inline void EmotionFastmem::write32(uint32_t vaddr, uint32_t value)
+{
+    *(uint32_t*)&arena[vaddr] = value;
+}
+
+inline void EmotionFastmem::write64(uint32_t vaddr, uint64_t value)
+{
+    *(uint64_t*)&arena[vaddr] = value;
+}
+
+inline void EmotionFastmem::write128(uint32_t vaddr, uint128_t value)
+{
+    store128(&arena[vaddr], value);
+}
+
+#endif
+
+#endif // EMOTIONFASTMEM_HPP
@@ -1,7 +1,8 @@
-#include <cstdio>
 #include <cstdlib>
 #include "emotioninterpreter.hpp"
 
+#include "../logger.hpp"
+
 void EmotionInterpreter::interpret(EmotionEngine &cpu, uint32_t instruction)
 {
     if (!instruction)
@@ -441,8 +442,7 @@ void EmotionInterpreter::lq(EmotionEngine &cpu, uint32_t instruction)
     uint64_t base = (instruction >> 21) & 0x1F;
     uint32_t addr = cpu.get_gpr<uint32_t>(base) + imm;
     addr &= ~0xF;
-    cpu.set_gpr<uint64_t>(dest, cpu.read64(addr));
-    cpu.set_gpr<uint64_t>(dest, cpu.read64(addr + 8), 1);
+    cpu.set_gpr<uint128_t>(dest, cpu.read128(addr));
 }
 
 void EmotionInterpreter::sq(EmotionEngine &cpu, uint32_t instruction)
@@ -453,8 +453,7 @@ void EmotionInterpreter::sq(EmotionEngine &cpu, uint32_t instruction)
 
     uint32_t addr = cpu.get_gpr<uint32_t>(base) + imm;
     addr &= ~0xF;
-    cpu.write64(addr, cpu.get_gpr<uint64_t>(source));
-    cpu.write64(addr + 8, cpu.get_gpr<uint64_t>(source, 1));
+    cpu.write128(addr, cpu.get_gpr<uint128_t>(source));
 }
 
 void EmotionInterpreter::lb(EmotionEngine &cpu, uint32_t instruction)
@@ -825,7 +824,7 @@ void EmotionInterpreter::cop2_qmfc2(EmotionEngine &cpu, uint32_t instruction)
 
 void EmotionInterpreter::unknown_op(const char *type, uint32_t instruction, uint16_t op)
 {
-    printf("[EE Interpreter] Unrecognized %s op $%04X\n", type, op);
-    printf("[EE Interpreter] Instr: $%08X\n", instruction);
+    ERROR_LOG(LOG_EE, "[EE Interpreter] Unrecognized %s op $%04X\n", type, op);
+    ERROR_LOG(LOG_EE, "[EE Interpreter] Instr: $%08X\n", instruction);
     exit(1);
 }
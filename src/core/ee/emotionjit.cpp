@@ -0,0 +1,1012 @@
+#include <cstdlib>
+#include "emotion.hpp"
+#include "emotioninterpreter.hpp"
+#include "emotionjit.hpp"
+
+#include "../emulator.hpp"
+#include "../logger.hpp"
+
+#define JIT_CACHE_SIZE (1024 * 1024 * 32)
+#define JIT_CACHE_MARGIN (1024 * 64)
+#define MAX_BLOCK_SIZE 128
+
+enum EE_OP_TYPE
+{
+    OP_NATIVE,
+    OP_FALLBACK,
+    OP_TERMINATOR,
+    OP_BRANCH,
+    OP_INTERP_ONLY
+};
+
+//Slow paths for memory accesses that miss RDRAM or touch a page with compiled code
+static uint64_t jit_read8(EmotionEngine* cpu, uint32_t addr)
+{
+    return cpu->read8(addr);
+}
+
+static uint64_t jit_read8_signed(EmotionEngine* cpu, uint32_t addr)
+{
+    return (int64_t)(int8_t)cpu->read8(addr);
+}
+
+static uint64_t jit_read16(EmotionEngine* cpu, uint32_t addr)
+{
+    return cpu->read16(addr);
+}
+
+static uint64_t jit_read16_signed(EmotionEngine* cpu, uint32_t addr)
+{
+    return (int64_t)(int16_t)cpu->read16(addr);
+}
+
+static uint64_t jit_read32(EmotionEngine* cpu, uint32_t addr)
+{
+    return cpu->read32(addr);
+}
+
+static uint64_t jit_read32_signed(EmotionEngine* cpu, uint32_t addr)
+{
+    return (int64_t)(int32_t)cpu->read32(addr);
+}
+
+static uint64_t jit_read64(EmotionEngine* cpu, uint32_t addr)
+{
+    return cpu->read64(addr);
+}
+
+static void jit_write8(EmotionEngine* cpu, uint32_t addr, uint64_t value)
+{
+    cpu->write8(addr, value);
+}
+
+static void jit_write16(EmotionEngine* cpu, uint32_t addr, uint64_t value)
+{
+    cpu->write16(addr, value);
+}
+
+static void jit_write32(EmotionEngine* cpu, uint32_t addr, uint64_t value)
+{
+    cpu->write32(addr, value);
+}
+
+static void jit_write64(EmotionEngine* cpu, uint32_t addr, uint64_t value)
+{
+    cpu->write64(addr, value);
+}
+
+static EE_OP_TYPE classify(uint32_t instruction)
+{
+    if (!instruction)
+        return OP_NATIVE;
+    int op = instruction >> 26;
+    switch (op)
+    {
+        case 0x00:
+            switch (instruction & 0x3F)
+            {
+                case 0x08:
+                case 0x09:
+                    return OP_BRANCH;
+                case 0x0C:
+                    return OP_TERMINATOR;
+                default:
+                    return OP_FALLBACK;
+            }
+        case 0x01:
+            if (((instruction >> 16) & 0x1F) < 0x04)
+                return OP_BRANCH;
+            return OP_FALLBACK;
+        case 0x02:
+        case 0x03:
+        case 0x04:
+        case 0x05:
+        case 0x06:
+        case 0x07:
+        case 0x14:
+        case 0x15:
+        case 0x16:
+            return OP_BRANCH;
+        case 0x10:
+            //COP0 can enable interrupts or return from exceptions
+            return OP_TERMINATOR;
+        case 0x11:
+            //BC1 is a branch, but rare enough to leave to the interpreter
+            if (((instruction >> 21) & 0x1F) == 0x08)
+                return OP_INTERP_ONLY;
+            return OP_FALLBACK;
+        default:
+            return OP_FALLBACK;
+    }
+}
+
+static bool is_likely_branch(uint32_t instruction)
+{
+    int op = instruction >> 26;
+    if (op == 0x01)
+        return ((instruction >> 16) & 0x1F) >= 0x02;
+    return op >= 0x14 && op <= 0x16;
+}
+
+EmotionJIT::EmotionJIT(EmotionEngine* cpu) : cpu(cpu), cache(JIT_CACHE_SIZE), emitter(&cache)
+{
+    enter_thunk = nullptr;
+    exit_thunk = nullptr;
+    cycles_left = 0;
+    cycles_banked = 0;
+    slice_length = 0;
+    block_start = 0;
+    block_is_idle_loop = false;
+}
+
+bool EmotionJIT::is_available()
+{
+    return cache.is_valid();
+}
+
+void EmotionJIT::reset()
+{
+    if (is_available())
+        flush();
+}
+
+int32_t EmotionJIT::cpu_offset(const void* field)
+{
+    return (int32_t)((const uint8_t*)field - (const uint8_t*)cpu);
+}
+
+int32_t EmotionJIT::gpr_offset(int reg)
+{
+    return cpu_offset(&cpu->gpr[reg * sizeof(uint64_t) * 2]);
+}
+
+void EmotionJIT::flush()
+{
+    cache.flush();
+    blocks.clear();
+    pending_links.clear();
+    block_links.clear();
+    for (int page = 0; page < 1024 * 1024 * 32 / 4096; page++)
+    {
+        if (!page_blocks[page].empty())
+        {
+            page_blocks[page].clear();
+            cpu->set_code_page(page << 12, false);
+        }
+    }
+    emit_thunks();
+}
+
+void EmotionJIT::emit_thunks()
+{
+    enter_thunk = (void (*)(EmotionEngine*, uint8_t*))emitter.get_current_addr();
+    emitter.PUSH(RBX);
+    emitter.PUSH(RBP);
+    emitter.PUSH(R12);
+    emitter.PUSH(R13);
+    emitter.PUSH(R14);
+    emitter.PUSH(R15);
+#ifdef _WIN32
+    emitter.ADD64_REG_IMM(-40, RSP);
+#else
+    emitter.ADD64_REG_IMM(-8, RSP);
+#endif
+    emitter.MOV64_MR(REG_ARG0, RBX);
+    if (cpu->fastmem.is_active())
+        emitter.MOV64_OI((uint64_t)cpu->fastmem.get_arena(), R12);
+    else
+        emitter.MOV64_OI((uint64_t)cpu->page_table.get_read_table(), R12);
+    emitter.MOV64_OI((uint64_t)cpu->page_table.get_write_table(), R13);
+    emitter.JMP_REG(REG_ARG1);
+
+    exit_thunk = emitter.get_current_addr();
+#ifdef _WIN32
+    emitter.ADD64_REG_IMM(40, RSP);
+#else
+    emitter.ADD64_REG_IMM(8, RSP);
+#endif
+    emitter.POP(R15);
+    emitter.POP(R14);
+    emitter.POP(R13);
+    emitter.POP(R12);
+    emitter.POP(RBP);
+    emitter.POP(RBX);
+    emitter.RET();
+}
+
+bool EmotionJIT::is_compilable(uint32_t PC)
+{
+    if (PC >= 0x70000000 && PC < 0x70004000)
+        return false;
+    uint32_t paddr = PC & 0x1FFFFFFF;
+    return paddr < 0x10000000 || paddr >= 0x1FC00000;
+}
+
+//Records that the block starting at PC reads code from addr
+void EmotionJIT::add_block_page(uint32_t PC, uint32_t addr)
+{
+    uint32_t paddr = addr & 0x1FFFFFFF;
+    if (paddr >= 0x10000000)
+        return;
+    int page = (paddr & 0x01FFFFFF) >> 12;
+    if (!page_blocks[page].empty() && page_blocks[page].back() == PC)
+        return;
+    if (page_blocks[page].empty())
+        cpu->set_code_page(paddr, true);
+    page_blocks[page].push_back(PC);
+}
+
+/**
+ * Code memory isn't reclaimed until the next flush, so this is safe to call while a block is running.
+ * Any block that jumped straight into a dropped one goes back through the dispatcher, and is relinked once the
+ * block is recompiled.
+ */
+void EmotionJIT::invalidate_page(int page)
+{
+    for (unsigned int i = 0; i < page_blocks[page].size(); i++)
+    {
+        uint32_t PC = page_blocks[page][i];
+        if (!blocks.erase(PC))
+            continue;
+
+        auto range = block_links.equal_range(PC);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            Emitter64::set_jump_dest(it->second, exit_thunk);
+            pending_links.insert({PC, it->second});
+        }
+        block_links.erase(PC);
+    }
+    page_blocks[page].clear();
+    cpu->set_code_page(page << 12, false);
+}
+
+int EmotionJIT::run(int cycles)
+{
+    cycles_left = cycles;
+    cycles_banked = 0;
+    slice_length = cycles;
+    while (cycles_left > 0)
+    {
+        //Finish off any branch started by the interpreter
+        if (cpu->branch_on)
+        {
+            cycles_left--;
+            cpu->step();
+            if (cpu->idle_loop_hit)
+                cycles_left -= cpu->take_idle_skip(cycles_left);
+            continue;
+        }
+
+        uint32_t PC = cpu->PC;
+        EEJitBlock* block;
+        auto it = blocks.find(PC);
+        if (it != blocks.end())
+            block = &it->second;
+        else
+            block = compile_block(PC);
+
+        if (!block->code)
+        {
+            cycles_left--;
+            cpu->step();
+            if (cpu->idle_loop_hit)
+                cycles_left -= cpu->take_idle_skip(cycles_left);
+            continue;
+        }
+
+        enter_thunk(cpu, block->code);
+
+        PC = cpu->PC;
+        if (PC < 0x80000000 && PC >= 0x00100000)
+        {
+            if (cpu->e->skip_BIOS())
+                continue;
+        }
+        if (PC == 0xBFC00928)
+            exit(1);
+
+        cpu->check_interrupts();
+    }
+    slice_length = 0;
+    return cycles - cycles_banked - cycles_left;
+}
+
+EEJitBlock* EmotionJIT::compile_block(uint32_t PC)
+{
+    if (cache.get_space_left() < JIT_CACHE_MARGIN)
+        flush();
+
+    //The block is only added to the map once it's complete, so that exits back to itself get linked below
+    EEJitBlock new_block;
+    new_block.code = nullptr;
+    new_block.instr_count = 0;
+    if (!is_compilable(PC))
+        return &(blocks[PC] = new_block);
+
+    uint8_t* start = emitter.get_current_addr();
+    block_start = PC;
+    block_is_idle_loop = false;
+    uint32_t addr = PC;
+    int count = 0;
+    while (true)
+    {
+        if (!is_compilable(addr) || count >= MAX_BLOCK_SIZE)
+        {
+            emit_static_exit(addr - 4, addr, count);
+            break;
+        }
+
+        uint32_t instruction = cpu->read32(addr);
+        EE_OP_TYPE type = classify(instruction);
+
+        if (type == OP_BRANCH)
+        {
+            uint32_t delay_slot = cpu->read32(addr + 4);
+            EE_OP_TYPE delay_type = classify(delay_slot);
+
+            //Branches in delay slots and similar oddities are left to the interpreter
+            if (delay_type != OP_NATIVE && delay_type != OP_FALLBACK)
+                type = OP_INTERP_ONLY;
+            else
+            {
+                add_block_page(PC, addr);
+                add_block_page(PC, addr + 4);
+                emit_branch_condition(addr, instruction);
+                count++;
+                if (is_likely_branch(instruction))
+                {
+                    emitter.TEST32_REG(R14, R14);
+                    uint8_t* taken = emitter.JCC_NEAR_DEFERRED(ConditionCode::NE);
+                    emit_static_exit(addr, addr + 8, count);
+                    emitter.set_jump_dest(taken);
+                }
+                emit_instruction(addr + 4, delay_slot);
+                count++;
+                block_is_idle_loop = is_idle_loop_branch(PC, addr, instruction);
+                emit_branch_exit(addr, instruction, count);
+                break;
+            }
+        }
+
+        if (type == OP_INTERP_ONLY)
+        {
+            if (!count)
+            {
+                //Still tracked, so that the PC gets another chance at compiling if the code changes
+                add_block_page(PC, addr);
+                return &(blocks[PC] = new_block);
+            }
+            emit_static_exit(addr - 4, addr, count);
+            break;
+        }
+
+        add_block_page(PC, addr);
+        count++;
+        if (type == OP_TERMINATOR)
+        {
+            emit_terminator(addr, instruction, count);
+            break;
+        }
+
+        emit_instruction(addr, instruction);
+        addr += 4;
+    }
+
+    EEJitBlock& block = blocks[PC];
+    block.code = start;
+    block.instr_count = count;
+
+    //Resolve jumps from blocks compiled before this one
+    auto range = pending_links.equal_range(PC);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        Emitter64::set_jump_dest(it->second, start);
+        block_links.insert({PC, it->second});
+    }
+    pending_links.erase(PC);
+    return &block;
+}
+
+void EmotionJIT::link(uint32_t source, uint32_t dest, uint8_t* jump)
+{
+    //Always return to the dispatcher when it has checks to run on the destination
+    if (dest == 0xBFC00928)
+        return;
+    bool dest_user = dest >= 0x00100000 && dest < 0x80000000;
+    bool source_user = source >= 0x00100000 && source < 0x80000000;
+    if (dest_user && !source_user)
+        return;
+
+    auto it = blocks.find(dest);
+    if (it != blocks.end())
+    {
+        if (it->second.code)
+        {
+            Emitter64::set_jump_dest(jump, it->second.code);
+            block_links.insert({dest, jump});
+        }
+    }
+    else
+        pending_links.insert({dest, jump});
+}
+
+//True if the block at PC is nothing but an idle loop closed by the branch at addr
+bool EmotionJIT::is_idle_loop_branch(uint32_t PC, uint32_t addr, uint32_t instruction)
+{
+    int op = instruction >> 26;
+    uint32_t target;
+    if (op == 0x02)
+        target = ((instruction & 0x3FFFFFF) << 2) | ((addr + 4) & 0xF0000000);
+    else if (op == 0x00 || op == 0x03)
+        return false;
+    else
+        target = addr + 4 + ((int16_t)(instruction & 0xFFFF) << 2);
+    return target == PC && cpu->idle_loops.is_idle_loop(*cpu, PC, addr);
+}
+
+void EmotionJIT::skip_idle_helper(EmotionEngine* cpu, uint32_t loop_PC)
+{
+    EmotionJIT& jit = cpu->jit;
+    //The block was compiled against the registers it first ran with, which may not point at memory anymore
+    if (jit.cycles_left > 0 && cpu->idle_loops.can_skip(*cpu, loop_PC))
+    {
+        cpu->skip_idle_cycles(loop_PC, jit.cycles_left);
+        jit.cycles_left = 0;
+    }
+}
+
+//Like a static exit back to the loop, except the rest of the time slice is skipped
+void EmotionJIT::emit_idle_exit(uint32_t dest, int cycles)
+{
+    emitter.MOV32_IMM_MEM(dest, RBX, cpu_offset(&cpu->PC));
+    emitter.ADD32_MEM_IMM(cycles, RBX, cpu_offset(&cpu->cp0.gpr[9]));
+    emitter.SUB32_MEM_IMM(cycles, RBX, cpu_offset(&cycles_left));
+    emitter.MOV64_MR(RBX, REG_ARG0);
+    emitter.MOV32_REG_IMM(dest, REG_ARG1);
+    emitter.CALL((const void*)&skip_idle_helper);
+    emitter.JMP(exit_thunk);
+}
+
+void EmotionJIT::emit_static_exit(uint32_t source, uint32_t dest, int cycles)
+{
+    if (block_is_idle_loop && dest == block_start)
+    {
+        emit_idle_exit(dest, cycles);
+        return;
+    }
+
+    emitter.MOV32_IMM_MEM(dest, RBX, cpu_offset(&cpu->PC));
+    emitter.ADD32_MEM_IMM(cycles, RBX, cpu_offset(&cpu->cp0.gpr[9]));
+    emitter.SUB32_MEM_IMM(cycles, RBX, cpu_offset(&cycles_left));
+    emitter.JCC(ConditionCode::LE, exit_thunk);
+    uint8_t* jump = emitter.JMP_NEAR_DEFERRED();
+    Emitter64::set_jump_dest(jump, exit_thunk);
+    link(source, dest, jump);
+}
+
+void EmotionJIT::emit_dynamic_exit(int cycles)
+{
+    emitter.MOV32_TO_MEM(R15, RBX, cpu_offset(&cpu->PC));
+    emitter.ADD32_MEM_IMM(cycles, RBX, cpu_offset(&cpu->cp0.gpr[9]));
+    emitter.SUB32_MEM_IMM(cycles, RBX, cpu_offset(&cycles_left));
+    emitter.JMP(exit_thunk);
+}
+
+void EmotionJIT::emit_fallback(uint32_t PC, uint32_t instruction)
+{
+    emitter.MOV32_IMM_MEM(PC, RBX, cpu_offset(&cpu->PC));
+    emitter.MOV64_MR(RBX, REG_ARG0);
+    emitter.MOV32_REG_IMM(instruction, REG_ARG1);
+    emitter.CALL((const void*)&EmotionInterpreter::interpret);
+}
+
+void EmotionJIT::emit_terminator(uint32_t PC, uint32_t instruction, int cycles)
+{
+    //COP0 may read Count, so bring it up to date first
+    if (cycles > 1)
+        emitter.ADD32_MEM_IMM(cycles - 1, RBX, cpu_offset(&cpu->cp0.gpr[9]));
+    emit_fallback(PC, instruction);
+    emitter.ADD32_MEM_IMM(1, RBX, cpu_offset(&cpu->cp0.gpr[9]));
+
+    //Same PC handling as the interpreter: eret and exceptions set PC themselves
+    emitter.CMP8_MEM_IMM(0, RBX, cpu_offset(&cpu->increment_PC));
+    uint8_t* no_increment = emitter.JCC_NEAR_DEFERRED(ConditionCode::E);
+    emitter.ADD32_MEM_IMM(4, RBX, cpu_offset(&cpu->PC));
+    uint8_t* done = emitter.JMP_NEAR_DEFERRED();
+    emitter.set_jump_dest(no_increment);
+    emitter.MOV8_IMM_MEM(1, RBX, cpu_offset(&cpu->increment_PC));
+    emitter.set_jump_dest(done);
+
+    emitter.SUB32_MEM_IMM(cycles, RBX, cpu_offset(&cycles_left));
+    emitter.JMP(exit_thunk);
+}
+
+void EmotionJIT::emit_branch_condition(uint32_t PC, uint32_t instruction)
+{
+    int op = instruction >> 26;
+    int rs = (instruction >> 21) & 0x1F;
+    int rt = (instruction >> 16) & 0x1F;
+    int rd = (instruction >> 11) & 0x1F;
+
+    ConditionCode cond;
+    switch (op)
+    {
+        case 0x00:
+            //JR/JALR - the link register is written before the delay slot, as in the interpreter
+            emitter.MOV32_FROM_MEM(RBX, R15, gpr_offset(rs));
+            if ((instruction & 0x3F) == 0x09 && rd)
+                emitter.MOV32_IMM_MEM(PC + 8, RBX, gpr_offset(rd));
+            return;
+        case 0x02:
+            return;
+        case 0x03:
+            emitter.MOV32_IMM_MEM(PC + 8, RBX, gpr_offset(31));
+            return;
+        case 0x04:
+        case 0x05:
+        case 0x14:
+        case 0x15:
+            emitter.XOR32_REG(R14, R14);
+            emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+            emitter.CMP64_MEM(RBX, RAX, gpr_offset(rt));
+            cond = (op & 0x1) ? ConditionCode::NE : ConditionCode::E;
+            break;
+        case 0x06:
+        case 0x16:
+            emitter.XOR32_REG(R14, R14);
+            emitter.CMP64_MEM_IMM(0, RBX, gpr_offset(rs));
+            cond = ConditionCode::LE;
+            break;
+        case 0x07:
+            emitter.XOR32_REG(R14, R14);
+            emitter.CMP64_MEM_IMM(0, RBX, gpr_offset(rs));
+            cond = ConditionCode::G;
+            break;
+        case 0x01:
+            emitter.XOR32_REG(R14, R14);
+            emitter.CMP64_MEM_IMM(0, RBX, gpr_offset(rs));
+            cond = (rt & 0x1) ? ConditionCode::GE : ConditionCode::L;
+            break;
+        default:
+            ERROR_LOG(LOG_JIT, "[EE JIT] Unrecognized branch $%08X\n", instruction);
+            exit(1);
+    }
+    emitter.SETCC8(cond, R14);
+}
+
+void EmotionJIT::emit_branch_exit(uint32_t PC, uint32_t instruction, int cycles)
+{
+    int op = instruction >> 26;
+    int32_t offset = (int16_t)(instruction & 0xFFFF);
+    offset <<= 2;
+    switch (op)
+    {
+        case 0x00:
+            emit_dynamic_exit(cycles);
+            return;
+        case 0x02:
+        case 0x03:
+        {
+            uint32_t addr = (instruction & 0x3FFFFFF) << 2;
+            addr += (PC + 4) & 0xF0000000;
+            emit_static_exit(PC, addr, cycles);
+            return;
+        }
+        default:
+        {
+            uint32_t taken_addr = PC + offset + 4;
+            if (is_likely_branch(instruction))
+            {
+                //The not-taken path has already left the block
+                emit_static_exit(PC, taken_addr, cycles);
+                return;
+            }
+            emitter.TEST32_REG(R14, R14);
+            uint8_t* taken = emitter.JCC_NEAR_DEFERRED(ConditionCode::NE);
+            emit_static_exit(PC, PC + 8, cycles);
+            emitter.set_jump_dest(taken);
+            emit_static_exit(PC, taken_addr, cycles);
+            return;
+        }
+    }
+}
+
+void EmotionJIT::emit_instruction(uint32_t PC, uint32_t instruction)
+{
+    if (!emit_native(instruction))
+        emit_fallback(PC, instruction);
+}
+
+bool EmotionJIT::emit_native(uint32_t instruction)
+{
+    if (!instruction)
+        return true;
+
+    int op = instruction >> 26;
+    int rs = (instruction >> 21) & 0x1F;
+    int rt = (instruction >> 16) & 0x1F;
+    int rd = (instruction >> 11) & 0x1F;
+    int sa = (instruction >> 6) & 0x1F;
+    int32_t simm = (int16_t)(instruction & 0xFFFF);
+    uint32_t imm = instruction & 0xFFFF;
+
+    switch (op)
+    {
+        case 0x00:
+        {
+            int funct = instruction & 0x3F;
+            switch (funct)
+            {
+                case 0x00:
+                case 0x02:
+                case 0x0A:
+                case 0x0B:
+                case 0x20:
+                case 0x21:
+                case 0x22:
+                case 0x23:
+                case 0x24:
+                case 0x25:
+                case 0x26:
+                case 0x27:
+                case 0x2A:
+                case 0x2B:
+                case 0x2C:
+                case 0x2D:
+                case 0x2F:
+                case 0x38:
+                case 0x3A:
+                case 0x3C:
+                case 0x3E:
+                case 0x3F:
+                    if (!rd)
+                        return true;
+                    break;
+                default:
+                    return false;
+            }
+
+            switch (funct)
+            {
+                case 0x00:
+                    emitter.MOV32_FROM_MEM(RBX, RAX, gpr_offset(rt));
+                    emitter.SHL32_REG_IMM(sa, RAX);
+                    emitter.MOVSX32_TO_64(RAX, RAX);
+                    break;
+                case 0x02:
+                    emitter.MOV32_FROM_MEM(RBX, RAX, gpr_offset(rt));
+                    emitter.SHR32_REG_IMM(sa, RAX);
+                    emitter.MOVSX32_TO_64(RAX, RAX);
+                    break;
+                case 0x0A:
+                case 0x0B:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rd));
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rs));
+                    emitter.MOV64_FROM_MEM(RBX, RDX, gpr_offset(rt));
+                    emitter.TEST64_REG(RDX, RDX);
+                    emitter.CMOVCC64((funct == 0x0A) ? ConditionCode::E : ConditionCode::NE, RCX, RAX);
+                    break;
+                case 0x20:
+                case 0x21:
+                    emitter.MOV32_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.MOV32_FROM_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.ADD32_REG(RCX, RAX);
+                    emitter.MOVSX32_TO_64(RAX, RAX);
+                    break;
+                case 0x22:
+                case 0x23:
+                    emitter.MOV32_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.MOV32_FROM_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.SUB32_REG(RCX, RAX);
+                    emitter.MOVSX32_TO_64(RAX, RAX);
+                    break;
+                case 0x24:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.AND64_REG(RCX, RAX);
+                    break;
+                case 0x25:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.OR64_REG(RCX, RAX);
+                    break;
+                case 0x26:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.XOR64_REG(RCX, RAX);
+                    break;
+                case 0x27:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.OR64_REG(RCX, RAX);
+                    emitter.NOT64(RAX);
+                    break;
+                case 0x2A:
+                case 0x2B:
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rs));
+                    emitter.XOR32_REG(RAX, RAX);
+                    emitter.CMP64_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.SETCC8((funct == 0x2A) ? ConditionCode::L : ConditionCode::B, RAX);
+                    break;
+                case 0x2C:
+                case 0x2D:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.ADD64_REG(RCX, RAX);
+                    break;
+                case 0x2F:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rt));
+                    emitter.SUB64_REG(RCX, RAX);
+                    break;
+                case 0x38:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rt));
+                    emitter.SHL64_REG_IMM(sa, RAX);
+                    break;
+                case 0x3A:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rt));
+                    emitter.SHR64_REG_IMM(sa, RAX);
+                    break;
+                case 0x3C:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rt));
+                    emitter.SHL64_REG_IMM(sa + 32, RAX);
+                    break;
+                case 0x3E:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rt));
+                    emitter.SHR64_REG_IMM(sa + 32, RAX);
+                    break;
+                case 0x3F:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rt));
+                    emitter.SAR64_REG_IMM(sa + 32, RAX);
+                    break;
+            }
+            emitter.MOV64_TO_MEM(RAX, RBX, gpr_offset(rd));
+            return true;
+        }
+        case 0x08:
+        case 0x09:
+        case 0x0A:
+        case 0x0C:
+        case 0x0D:
+        case 0x0E:
+        case 0x0F:
+        case 0x19:
+            if (!rt)
+                return true;
+            switch (op)
+            {
+                case 0x08:
+                case 0x09:
+                    emitter.MOV32_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.ADD32_REG_IMM(simm, RAX);
+                    emitter.MOVSX32_TO_64(RAX, RAX);
+                    break;
+                case 0x0A:
+                    emitter.MOV64_FROM_MEM(RBX, RCX, gpr_offset(rs));
+                    emitter.XOR32_REG(RAX, RAX);
+                    emitter.CMP64_REG_IMM(simm, RCX);
+                    emitter.SETCC8(ConditionCode::L, RAX);
+                    break;
+                case 0x0C:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.AND64_REG_IMM(imm, RAX);
+                    break;
+                case 0x0D:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.OR64_REG_IMM(imm, RAX);
+                    break;
+                case 0x0E:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.XOR64_REG_IMM(imm, RAX);
+                    break;
+                case 0x0F:
+                    emitter.MOV64_OI((int64_t)(int32_t)(imm << 16), RAX);
+                    break;
+                case 0x19:
+                    emitter.MOV64_FROM_MEM(RBX, RAX, gpr_offset(rs));
+                    emitter.ADD64_REG_IMM(simm, RAX);
+                    break;
+            }
+            emitter.MOV64_TO_MEM(RAX, RBX, gpr_offset(rt));
+            return true;
+        case 0x20:
+        case 0x21:
+        case 0x23:
+        case 0x24:
+        case 0x25:
+        case 0x27:
+        case 0x37:
+            //Loads to $zero still need their side effects, which the interpreter takes care of
+            if (!rt)
+                return false;
+            emit_load(instruction);
+            return true;
+        case 0x28:
+        case 0x29:
+        case 0x2B:
+        case 0x3F:
+            emit_store(instruction);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void EmotionJIT::emit_load(uint32_t instruction)
+{
+    int op = instruction >> 26;
+    int base = (instruction >> 21) & 0x1F;
+    int rt = (instruction >> 16) & 0x1F;
+    int32_t offset = (int16_t)(instruction & 0xFFFF);
+
+    emitter.MOV32_FROM_MEM(RBX, RAX, gpr_offset(base));
+    emitter.ADD32_REG_IMM(offset, RAX);
+
+    if (cpu->fastmem.is_active())
+    {
+        emit_fastmem_load(op, rt);
+        return;
+    }
+
+    //Fast path: pages the page table maps to host memory are read directly
+    emitter.MOV32_REG(RAX, RCX);
+    emitter.SHR32_REG_IMM(12, RCX);
+    emitter.MOV64_FROM_SIB_X8(R12, RCX, RDX);
+    emitter.TEST64_REG(RDX, RDX);
+    uint8_t* slow = emitter.JCC_NEAR_DEFERRED(ConditionCode::E);
+    emitter.MOV32_REG(RAX, RCX);
+    emitter.AND32_REG_IMM(0xFFF, RCX);
+
+    const void* helper;
+    switch (op)
+    {
+        case 0x20:
+            emitter.MOVSX8_FROM_SIB(RDX, RCX, RAX);
+            helper = (const void*)&jit_read8_signed;
+            break;
+        case 0x21:
+            emitter.MOVSX16_FROM_SIB(RDX, RCX, RAX);
+            helper = (const void*)&jit_read16_signed;
+            break;
+        case 0x23:
+            emitter.MOV32_FROM_SIB(RDX, RCX, RAX);
+            emitter.MOVSX32_TO_64(RAX, RAX);
+            helper = (const void*)&jit_read32_signed;
+            break;
+        case 0x24:
+            emitter.MOVZX8_FROM_SIB(RDX, RCX, RAX);
+            helper = (const void*)&jit_read8;
+            break;
+        case 0x25:
+            emitter.MOVZX16_FROM_SIB(RDX, RCX, RAX);
+            helper = (const void*)&jit_read16;
+            break;
+        case 0x27:
+            emitter.MOV32_FROM_SIB(RDX, RCX, RAX);
+            helper = (const void*)&jit_read32;
+            break;
+        default:
+            emitter.MOV64_FROM_SIB(RDX, RCX, RAX);
+            helper = (const void*)&jit_read64;
+            break;
+    }
+    uint8_t* done = emitter.JMP_NEAR_DEFERRED();
+
+    emitter.set_jump_dest(slow);
+    emitter.MOV64_MR(RBX, REG_ARG0);
+    emitter.MOV32_REG(RAX, REG_ARG1);
+    emitter.CALL(helper);
+
+    emitter.set_jump_dest(done);
+    emitter.MOV64_TO_MEM(RAX, RBX, gpr_offset(rt));
+}
+
+//The address is in EAX, which the 32-bit add has already zero-extended. Faults are handled by EmotionFastmem.
+void EmotionJIT::emit_fastmem_load(int op, int rt)
+{
+    switch (op)
+    {
+        case 0x20:
+            emitter.MOVSX8_FROM_SIB(R12, RAX, RAX);
+            break;
+        case 0x21:
+            emitter.MOVSX16_FROM_SIB(R12, RAX, RAX);
+            break;
+        case 0x23:
+            emitter.MOV32_FROM_SIB(R12, RAX, RAX);
+            emitter.MOVSX32_TO_64(RAX, RAX);
+            break;
+        case 0x24:
+            emitter.MOVZX8_FROM_SIB(R12, RAX, RAX);
+            break;
+        case 0x25:
+            emitter.MOVZX16_FROM_SIB(R12, RAX, RAX);
+            break;
+        case 0x27:
+            emitter.MOV32_FROM_SIB(R12, RAX, RAX);
+            break;
+        default:
+            emitter.MOV64_FROM_SIB(R12, RAX, RAX);
+            break;
+    }
+    emitter.MOV64_TO_MEM(RAX, RBX, gpr_offset(rt));
+}
+
+void EmotionJIT::emit_store(uint32_t instruction)
+{
+    int op = instruction >> 26;
+    int base = (instruction >> 21) & 0x1F;
+    int rt = (instruction >> 16) & 0x1F;
+    int32_t offset = (int16_t)(instruction & 0xFFFF);
+
+    emitter.MOV32_FROM_MEM(RBX, RAX, gpr_offset(base));
+    emitter.ADD32_REG_IMM(offset, RAX);
+
+    if (cpu->fastmem.is_active())
+    {
+        emit_fastmem_store(op, rt);
+        return;
+    }
+
+    //Fast path: writable pages are written directly. Pages holding compiled code are unmapped for writes,
+    //so stores to them go through the slow path and invalidate the cache.
+    emitter.MOV32_REG(RAX, RCX);
+    emitter.SHR32_REG_IMM(12, RCX);
+    emitter.MOV64_FROM_SIB_X8(R13, RCX, RDX);
+    emitter.TEST64_REG(RDX, RDX);
+    uint8_t* slow = emitter.JCC_NEAR_DEFERRED(ConditionCode::E);
+    emitter.MOV32_REG(RAX, RCX);
+    emitter.AND32_REG_IMM(0xFFF, RCX);
+
+    emitter.MOV64_FROM_MEM(RBX, R8, gpr_offset(rt));
+    const void* helper;
+    switch (op)
+    {
+        case 0x28:
+            emitter.MOV8_TO_SIB(R8, RDX, RCX);
+            helper = (const void*)&jit_write8;
+            break;
+        case 0x29:
+            emitter.MOV16_TO_SIB(R8, RDX, RCX);
+            helper = (const void*)&jit_write16;
+            break;
+        case 0x2B:
+            emitter.MOV32_TO_SIB(R8, RDX, RCX);
+            helper = (const void*)&jit_write32;
+            break;
+        default:
+            emitter.MOV64_TO_SIB(R8, RDX, RCX);
+            helper = (const void*)&jit_write64;
+            break;
+    }
+    uint8_t* done = emitter.JMP_NEAR_DEFERRED();
+
+    emitter.set_jump_dest(slow);
+    emitter.MOV64_MR(RBX, REG_ARG0);
+    emitter.MOV32_REG(RAX, REG_ARG1);
+    emitter.MOV64_FROM_MEM(RBX, REG_ARG2, gpr_offset(rt));
+    emitter.CALL(helper);
+
+    emitter.set_jump_dest(done);
+}
+
+void EmotionJIT::emit_fastmem_store(int op, int rt)
+{
+    emitter.MOV64_FROM_MEM(RBX, RDX, gpr_offset(rt));
+    switch (op)
+    {
+        case 0x28:
+            emitter.MOV8_TO_SIB(RDX, R12, RAX);
+            break;
+        case 0x29:
+            emitter.MOV16_TO_SIB(RDX, R12, RAX);
+            break;
+        case 0x2B:
+            emitter.MOV32_TO_SIB(RDX, R12, RAX);
+            break;
+        default:
+            emitter.MOV64_TO_SIB(RDX, R12, RAX);
+            break;
+    }
+}
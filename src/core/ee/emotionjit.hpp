@@ -0,0 +1,130 @@
+#ifndef EMOTIONJIT_HPP
+#define EMOTIONJIT_HPP
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "../jitcommon/emitter64.hpp"
+#include "../jitcommon/jitcache.hpp"
+
+/**
+Block-based x86-64 recompiler for the Emotion Engine.
+
+Guest basic blocks in RDRAM and the BIOS are compiled into host code on first execution. Simple integer
+operations are emitted natively, and loads/stores look up the EE page table inline, only calling out for MMIO.
+Everything else is passed to EmotionInterpreter through a call, so the JIT is always at least as complete as
+the interpreter.
+
+Branch delay slots are folded into the block epilogue, and static block exits are linked directly to their
+successors. When a write hits an RDRAM page that contains compiled code, only the blocks overlapping that page are
+dropped, and any jumps linked into them are pointed back at the dispatcher.
+
+Host register usage inside compiled code:
+RBX - pointer to the EmotionEngine
+R12 - base of the page table's read entries, or of the fastmem arena
+R13 - base of the page table's write entries
+R14 - branch condition
+R15 - jump register target
+**/
+
+class EmotionEngine;
+
+struct EEJitBlock
+{
+    //nullptr means the block can only be run through the interpreter
+    uint8_t* code;
+    uint32_t instr_count;
+};
+
+class EmotionJIT
+{
+    private:
+        EmotionEngine* cpu;
+        JitCache cache;
+        Emitter64 emitter;
+
+        std::unordered_map<uint32_t, EEJitBlock> blocks;
+
+        //Jumps waiting for a block to be compiled at the given PC
+        std::unordered_multimap<uint32_t, uint8_t*> pending_links;
+
+        //Jumps that have been linked to the block at the given PC
+        std::unordered_multimap<uint32_t, uint8_t*> block_links;
+
+        //Start PCs of the blocks that overlap each 4 KB page of RDRAM
+        std::vector<uint32_t> page_blocks[1024 * 1024 * 32 / 4096];
+
+        void (*enter_thunk)(EmotionEngine* cpu, uint8_t* code);
+        uint8_t* exit_thunk;
+
+
+        int32_t cycles_left;
+        int32_t cycles_banked;
+
+        //Length of the slice being run, or 0 outside of run()
+        int32_t slice_length;
+
+        uint32_t block_start;
+        bool block_is_idle_loop;
+
+        int32_t cpu_offset(const void* field);
+        int32_t gpr_offset(int reg);
+
+        void flush();
+        void emit_thunks();
+        bool is_compilable(uint32_t PC);
+        void add_block_page(uint32_t PC, uint32_t addr);
+        void invalidate_page(int page);
+        EEJitBlock* compile_block(uint32_t PC);
+
+        void emit_instruction(uint32_t PC, uint32_t instruction);
+        void emit_fallback(uint32_t PC, uint32_t instruction);
+        void emit_terminator(uint32_t PC, uint32_t instruction, int cycles);
+        void emit_branch_condition(uint32_t PC, uint32_t instruction);
+        void emit_branch_exit(uint32_t PC, uint32_t instruction, int cycles);
+        void emit_static_exit(uint32_t source, uint32_t dest, int cycles);
+        void emit_idle_exit(uint32_t dest, int cycles);
+        void emit_dynamic_exit(int cycles);
+
+        void emit_load(uint32_t instruction);
+        void emit_store(uint32_t instruction);
+        void emit_fastmem_load(int op, int rt);
+        void emit_fastmem_store(int op, int rt);
+        bool emit_native(uint32_t instruction);
+        void link(uint32_t source, uint32_t dest, uint8_t* jump);
+
+        bool is_idle_loop_branch(uint32_t PC, uint32_t addr, uint32_t instruction);
+        static void skip_idle_helper(EmotionEngine* cpu, uint32_t loop_PC);
+    public:
+        EmotionJIT(EmotionEngine* cpu);
+
+        bool is_available();
+        void reset();
+        int run(int cycles);
+        int get_cycles_run();
+
+        void request_exit();
+        void invalidate(uint32_t paddr);
+};
+
+//Only as precise as the last block exit, as blocks account for their cycles when they leave
+inline int EmotionJIT::get_cycles_run()
+{
+    if (!slice_length)
+        return 0;
+    return slice_length - cycles_banked - cycles_left;
+}
+
+inline void EmotionJIT::request_exit()
+{
+    cycles_banked += cycles_left;
+    cycles_left = 0;
+}
+
+inline void EmotionJIT::invalidate(uint32_t paddr)
+{
+    int page = (paddr & 0x01FFFFFF) >> 12;
+    if (!page_blocks[page].empty())
+        invalidate_page(page);
+}
+
+#endif // EMOTIONJIT_HPP
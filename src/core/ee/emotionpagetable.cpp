@@ -0,0 +1,92 @@
+#include <cstring>
+#include "emotionpagetable.hpp"
+
+#define PAGE_COUNT (1024 * 1024)
+
+EmotionPageTable::EmotionPageTable()
+{
+    read_table = new uintptr_t[PAGE_COUNT];
+    write_table = new uintptr_t[PAGE_COUNT];
+    memset(read_table, 0, PAGE_COUNT * sizeof(uintptr_t));
+    memset(write_table, 0, PAGE_COUNT * sizeof(uintptr_t));
+    memset(code_pages, 0, sizeof(code_pages));
+    RDRAM = nullptr;
+    BIOS = nullptr;
+    scratchpad = nullptr;
+}
+
+EmotionPageTable::~EmotionPageTable()
+{
+    delete[] read_table;
+    delete[] write_table;
+}
+
+void EmotionPageTable::reset(uint8_t* RDRAM, uint8_t* BIOS, uint8_t* scratchpad)
+{
+    this->RDRAM = RDRAM;
+    this->BIOS = BIOS;
+    this->scratchpad = scratchpad;
+    memset(code_pages, 0, sizeof(code_pages));
+
+    for (uint32_t page = 0; page < PAGE_COUNT; page++)
+        map_page(page << 12);
+}
+
+/**
+ * Mirrors the address decoding done by EmotionEngine::read32 and Emulator::read32.
+ * Pages that only partially match a region are left to the generic handler.
+ */
+void EmotionPageTable::map_page(uint32_t vaddr)
+{
+    uint32_t page = vaddr >> 12;
+    read_table[page] = 0;
+    write_table[page] = 0;
+    if (!RDRAM)
+        return;
+
+    if (vaddr >= 0x70000000 && vaddr < 0x70004000)
+    {
+        read_table[page] = (uintptr_t)&scratchpad[vaddr & 0x3FFF];
+        write_table[page] = read_table[page];
+        return;
+    }
+
+    uint32_t addr = vaddr;
+    if (addr >= 0x30100000 && addr < 0x31FFFFFF)
+    {
+        //The last byte of this window isn't remapped, so its page is left to the slow path
+        if (addr + 0xFFF >= 0x31FFFFFF)
+            return;
+        addr -= 0x10000000;
+    }
+    uint32_t paddr = addr & 0x1FFFFFFF;
+
+    if (paddr < 0x10000000)
+    {
+        uint32_t offset = paddr & 0x01FFF000;
+        read_table[page] = (uintptr_t)&RDRAM[offset];
+        if (!code_pages[offset >> 12])
+            write_table[page] = read_table[page];
+    }
+    else if (paddr >= 0x1FC00000)
+        read_table[page] = (uintptr_t)&BIOS[paddr & 0x3FF000];
+}
+
+void EmotionPageTable::set_code_page(uint32_t paddr, bool is_code)
+{
+    uint32_t offset = paddr & 0x01FFF000;
+    if (code_pages[offset >> 12] == is_code)
+        return;
+    code_pages[offset >> 12] = is_code;
+
+    //Update every virtual alias of the page: eight 32 MB mirrors in each of the eight 512 MB segments...
+    for (uint32_t segment = 0; segment < 8; segment++)
+    {
+        for (uint32_t mirror = 0; mirror < 8; mirror++)
+            map_page((segment << 29) | (mirror << 25) | offset);
+    }
+
+    //...plus the window at 0x30100000
+    if (offset >= 0x00100000)
+        map_page(offset + 0x30000000);
+}
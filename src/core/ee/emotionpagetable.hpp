@@ -0,0 +1,77 @@
+#ifndef EMOTIONPAGETABLE_HPP
+#define EMOTIONPAGETABLE_HPP
+#include <cstdint>
+
+/**
+Software page table for the EE's 4 GB virtual address space, at 4 KB granularity.
+
+Each page has a read entry and a write entry. An entry is either a host pointer to the start of the page
+(RDRAM, BIOS, or scratchpad) or null. Null pages take the slow path through Emulator's read/write decoding, which
+dispatches registers through its MMIOTable. The IOP RAM window is deliberately left to it, since the EE touching
+IOP memory is a point where the two CPUs need to sync up.
+
+RDRAM pages that hold cached or compiled code have their write entries cleared, so that stores to them take the
+slow path and trigger invalidation. The same per-page flags are the shared record of which RDRAM pages contain code,
+checked by EmotionEngine::invalidate_code before bothering the active block cache.
+**/
+
+class EmotionPageTable
+{
+    private:
+        uintptr_t* read_table;
+        uintptr_t* write_table;
+
+        uint8_t* RDRAM;
+        uint8_t* BIOS;
+        uint8_t* scratchpad;
+
+        uint8_t code_pages[1024 * 1024 * 32 / 4096];
+
+        void map_page(uint32_t vaddr);
+    public:
+        EmotionPageTable();
+        ~EmotionPageTable();
+
+        void reset(uint8_t* RDRAM, uint8_t* BIOS, uint8_t* scratchpad);
+        void set_code_page(uint32_t paddr, bool is_code);
+        bool is_code_page(uint32_t paddr);
+
+        const uintptr_t* get_read_table();
+        const uintptr_t* get_write_table();
+
+        uint8_t* get_read_ptr(uint32_t vaddr);
+        uint8_t* get_write_ptr(uint32_t vaddr);
+};
+
+inline const uintptr_t* EmotionPageTable::get_read_table()
+{
+    return read_table;
+}
+
+inline const uintptr_t* EmotionPageTable::get_write_table()
+{
+    return write_table;
+}
+
+inline bool EmotionPageTable::is_code_page(uint32_t paddr)
+{
+    return code_pages[(paddr & 0x01FFFFFF) >> 12];
+}
+
+inline uint8_t* EmotionPageTable::get_read_ptr(uint32_t vaddr)
+{
+    uintptr_t entry = read_table[vaddr >> 12];
+    if (!entry)
+        return nullptr;
+    return (uint8_t*)entry + (vaddr & 0xFFF);
+}
+
+inline uint8_t* EmotionPageTable::get_write_ptr(uint32_t vaddr)
+{
+    uintptr_t entry = write_table[vaddr >> 12];
+    if (!entry)
+        return nullptr;
+    return (uint8_t*)entry + (vaddr & 0xFFF);
+}
+
+#endif // EMOTIONPAGETABLE_HPP
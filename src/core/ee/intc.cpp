@@ -1,6 +1,9 @@
 #include "emotion.hpp"
 #include "intc.hpp"
 
+#include "../logger.hpp"
+#include "../mmio.hpp"
+
 INTC::INTC(EmotionEngine* cpu) : cpu(cpu)
 {
 
@@ -12,6 +15,30 @@ void INTC::reset()
     INTC_STAT = 0;
 }
 
+void INTC::map_registers(MMIOTable* mmio)
+{
+    mmio->map_read(0x1000F000, 4, [this] (uint32_t addr)
+    {
+        //DEBUG_LOG(LOG_INTC, "Read32 INTC_STAT: $%08X\n", read_stat());
+        return read_stat();
+    }, true);
+    mmio->map_read(0x1000F010, 4, [this] (uint32_t addr)
+    {
+        DEBUG_LOG(LOG_INTC, "Read32 INTC_MASK: $%08X\n", read_mask());
+        return read_mask();
+    }, true);
+    mmio->map_write(0x1000F000, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_INTC, "Write32 INTC_STAT: $%08X\n", (uint32_t)value);
+        write_stat(value);
+    });
+    mmio->map_write(0x1000F010, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_INTC, "Write32 INTC_MASK: $%08X\n", (uint32_t)value);
+        write_mask(value);
+    });
+}
+
 uint32_t INTC::read_mask()
 {
     return INTC_MASK;
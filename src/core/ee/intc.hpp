@@ -3,6 +3,7 @@
 #include <cstdint>
 
 class EmotionEngine;
+class MMIOTable;
 
 enum class Interrupt
 {
@@ -34,6 +35,7 @@ class INTC
         INTC(EmotionEngine* cpu);
 
         void reset();
+        void map_registers(MMIOTable* mmio);
 
         uint32_t read_mask();
         uint32_t read_stat();
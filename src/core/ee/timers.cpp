@@ -1,10 +1,12 @@
-#include <cstdio>
 #include "intc.hpp"
 #include "timers.hpp"
+#include "../logger.hpp"
+#include "../mmio.hpp"
+#include "../scheduler.hpp"
 
-EmotionTiming::EmotionTiming(INTC* intc) : intc(intc)
+EmotionTiming::EmotionTiming(INTC* intc, Scheduler* scheduler) : intc(intc), scheduler(scheduler)
 {
-
+    timer_event_id = scheduler->register_function([this] (uint64_t param) { timer_event(param); });
 }
 
 void EmotionTiming::reset()
@@ -12,96 +14,233 @@ void EmotionTiming::reset()
     for (int i = 0; i < 4; i++)
     {
         timers[i].counter = 0;
-        timers[i].clocks = 0;
+        timers[i].compare = 0;
+        timers[i].control.mode = 0;
+        timers[i].control.clear_on_reference = false;
         timers[i].control.enabled = false;
+        timers[i].control.compare_int_enable = false;
+        timers[i].control.overflow_int_enable = false;
+        timers[i].control.compare_int = false;
+        timers[i].control.overflow_int = false;
+        timers[i].last_update = 0;
+        timers[i].event_pending = false;
     }
 }
 
-void EmotionTiming::run()
+//Each timer has its counter, mode, and compare registers at $10000000 + (index * $800)
+void EmotionTiming::map_registers(MMIOTable* mmio)
 {
-    for (int i = 0; i < 4; i++)
+    for (int index = 0; index < 4; index++)
     {
-        if (timers[i].control.enabled)
-        {
-            timers[i].clocks++;
-            switch (timers[i].control.mode)
-            {
-                case 0:
-                    if (timers[i].clocks >= 2)
-                        count_up(i, 2);
-                    break;
-                case 3:
-                    //TODO: actual value for HSYNC
-                    if (timers[i].clocks >= 15000)
-                    {
-                        count_up(i, 15000);
-                    }
-                    break;
-            }
-        }
+        uint32_t base = 0x10000000 + (index * 0x800);
+        //Counters keep moving without any event to say so, so they aren't pure reads
+        mmio->map_read(base, 4, [this, index] (uint32_t addr) { return read_counter(index); });
+        mmio->map_read(base + 0x10, 4, [this, index] (uint32_t addr) { return read_control(index); }, true);
+        mmio->map_read(base + 0x20, 4, [this, index] (uint32_t addr) { return read_compare(index); }, true);
+        mmio->map_write(base, 4, [this, index] (uint32_t addr, uint64_t value) { write_counter(index, value); });
+        mmio->map_write(base + 0x10, 4,
+                        [this, index] (uint32_t addr, uint64_t value) { write_control(index, value); });
+        mmio->map_write(base + 0x20, 4,
+                        [this, index] (uint32_t addr, uint64_t value) { write_compare(index, value); });
     }
 }
 
-uint32_t EmotionTiming::read32(uint32_t addr)
+//EE cycles per count, or 0 for HBLANK
+int EmotionTiming::get_clock_divider(int index)
 {
-    switch (addr)
+    switch (timers[index].control.mode)
     {
-        case 0x10000000:
-            return timers[0].counter;
+        case 0:
+            return 2;
+        case 1:
+            return 2 * 16;
+        case 2:
+            return 2 * 256;
         default:
-            printf("[EE Timing] Unrecognized read32 from $%08X\n", addr);
             return 0;
     }
 }
 
-void EmotionTiming::write32(uint32_t addr, uint32_t value)
+void EmotionTiming::update_counter(int index)
 {
-    switch (addr)
+    uint64_t now = scheduler->get_current_cycles();
+    int divider = get_clock_divider(index);
+    if (!timers[index].control.enabled || !divider)
     {
-        case 0x10000010:
-            write_control(0, value);
-            break;
-        case 0x10000810:
-            write_control(1, value);
-            break;
-        case 0x10001010:
-            write_control(2, value);
-            break;
-        case 0x10001810:
-            write_control(3, value);
-            break;
-        case 0x10001820:
-            printf("[EE Timing] Timer 3 compare: $%08X\n", value);
-            timers[3].compare = value & 0xFFFF;
-            break;
-        default:
-            printf("[EE Timing] Unrecognized write32 to $%08X of $%08X\n", addr, value);
-            break;
+        timers[index].last_update = now;
+        return;
     }
+
+    //Already brought further along by a read later in the slice than this event
+    if (now <= timers[index].last_update)
+        return;
+
+    //Leftover cycles that don't make up a full count carry over to the next update
+    uint64_t ticks = (now - timers[index].last_update) / divider;
+    timers[index].last_update += ticks * divider;
+    count_up(index, ticks);
 }
 
-void EmotionTiming::count_up(int index, int cycles_per_count)
+void EmotionTiming::reschedule(int index)
 {
-    timers[index].clocks -= cycles_per_count;
-    timers[index].counter++;
+    Timer& timer = timers[index];
+    if (timer.event_pending)
+    {
+        scheduler->cancel_event(timer.event_id);
+        timer.event_pending = false;
+    }
+
+    int divider = get_clock_divider(index);
+    if (!timer.control.enabled || !divider)
+        return;
 
-    //Overflow check
-    if (timers[index].counter > 0xFFFF)
+    //Counts until the counter next reaches each point of interest, going around through zero if needed
+    uint64_t ticks = UINT64_MAX;
+    if (timer.control.compare_int_enable)
     {
-        if (index == 3)
-            printf("[EE Timing] Timer 3 overflow!\n");
-        timers[index].counter = 0;
-        if (timers[index].control.overflow_int_enable)
+        uint64_t to_compare = (timer.compare - timer.counter) & 0xFFFF;
+        if (!to_compare)
+            to_compare = 0x10000;
+        ticks = to_compare;
+    }
+    bool clears_first = timer.control.clear_on_reference && timer.counter < timer.compare;
+    if (timer.control.overflow_int_enable && !clears_first && ticks > 0x10000 - timer.counter)
+        ticks = 0x10000 - timer.counter;
+    if (ticks == UINT64_MAX)
+        return;
+
+    //The counter may already be partway to its next count, and last_update can be partway into the current slice
+    uint64_t due = timer.last_update + ticks * divider;
+    timer.event_id = scheduler->add_event(timer_event_id, due - scheduler->get_cycles(), index);
+    timer.event_pending = true;
+}
+
+void EmotionTiming::timer_event(int index)
+{
+    timers[index].event_pending = false;
+    update_counter(index);
+    reschedule(index);
+}
+
+void EmotionTiming::hblank()
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (timers[i].control.enabled && timers[i].control.mode == 3)
+            count_up(i, 1);
+    }
+}
+
+uint32_t EmotionTiming::read_counter(int index)
+{
+    update_counter(index);
+    return timers[index].counter;
+}
+
+uint32_t EmotionTiming::read_control(int index)
+{
+    TimerControl& control = timers[index].control;
+    uint32_t reg = control.mode;
+    reg |= control.gate_enable << 2;
+    reg |= control.gate_VBLANK << 3;
+    reg |= control.gate_mode << 4;
+    reg |= control.clear_on_reference << 6;
+    reg |= control.enabled << 7;
+    reg |= control.compare_int_enable << 8;
+    reg |= control.overflow_int_enable << 9;
+    reg |= control.compare_int << 10;
+    reg |= control.overflow_int << 11;
+    return reg;
+}
+
+uint32_t EmotionTiming::read_compare(int index)
+{
+    return timers[index].compare;
+}
+
+void EmotionTiming::write_counter(int index, uint32_t value)
+{
+    update_counter(index);
+    timers[index].counter = value & 0xFFFF;
+    reschedule(index);
+}
+
+void EmotionTiming::write_compare(int index, uint32_t value)
+{
+    DEBUG_LOG(LOG_TIMERS, "[EE Timing] Timer %d compare: $%08X\n", index, value);
+    update_counter(index);
+    timers[index].compare = value & 0xFFFF;
+    reschedule(index);
+}
+
+/**
+ * Advances the counter by any number of counts at once, raising the compare and overflow interrupts it passes.
+ * Once the counter is back at zero, every further period looks the same, so whole periods are skipped together.
+ */
+void EmotionTiming::count_up(int index, uint64_t ticks)
+{
+    Timer& timer = timers[index];
+    bool clears = timer.control.clear_on_reference && timer.compare;
+    uint32_t period = clears ? timer.compare : 0x10000;
+    while (ticks)
+    {
+        if (timer.counter == 0 && ticks >= period)
+        {
+            ticks %= period;
+            compare_hit(index);
+            if (!clears)
+                overflow(index);
+            continue;
+        }
+
+        uint64_t step = 0x10000 - timer.counter;
+        if (timer.counter < timer.compare && timer.compare - timer.counter < step)
+            step = timer.compare - timer.counter;
+        if (step > ticks)
+            step = ticks;
+        timer.counter += step;
+        ticks -= step;
+
+        if (timer.counter > 0xFFFF)
+        {
+            if (index == 3)
+                DEBUG_LOG(LOG_TIMERS, "[EE Timing] Timer 3 overflow!\n");
+            timer.counter = 0;
+            overflow(index);
+        }
+        if (timer.counter == timer.compare)
         {
-            timers[index].control.overflow_int = true;
-            intc->assert_IRQ((int)Interrupt::TIMER0 + index);
+            compare_hit(index);
+            if (clears)
+                timer.counter = 0;
         }
     }
 }
 
+void EmotionTiming::compare_hit(int index)
+{
+    if (timers[index].control.compare_int_enable)
+    {
+        timers[index].control.compare_int = true;
+        intc->assert_IRQ((int)Interrupt::TIMER0 + index);
+    }
+}
+
+void EmotionTiming::overflow(int index)
+{
+    if (timers[index].control.overflow_int_enable)
+    {
+        timers[index].control.overflow_int = true;
+        intc->assert_IRQ((int)Interrupt::TIMER0 + index);
+    }
+}
+
 void EmotionTiming::write_control(int index, uint32_t value)
 {
-    printf("[EE Timing] Write32 timer %d control: $%08X\n", index, value);
+    DEBUG_LOG(LOG_TIMERS, "[EE Timing] Write32 timer %d control: $%08X\n", index, value);
+
+    //Bring the counter up to date under the old settings before switching to the new ones
+    update_counter(index);
     timers[index].control.mode = value & 0x3;
     timers[index].control.gate_enable = value & (1 << 2);
     timers[index].control.gate_VBLANK = value & (1 << 3);
@@ -110,6 +249,9 @@ void EmotionTiming::write_control(int index, uint32_t value)
     timers[index].control.enabled = value & (1 << 7);
     timers[index].control.compare_int_enable = value & (1 << 8);
     timers[index].control.overflow_int_enable = value & (1 << 9);
-    timers[index].control.compare_int &= ~(value & (1 << 10));
-    timers[index].control.overflow_int &= ~(value & (1 << 11));
+    if (value & (1 << 10))
+        timers[index].control.compare_int = false;
+    if (value & (1 << 11))
+        timers[index].control.overflow_int = false;
+    reschedule(index);
 }
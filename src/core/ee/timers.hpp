@@ -2,6 +2,15 @@
 #define TIMERS_HPP
 #include <cstdint>
 
+/**
+The EE timers are counted lazily. Each timer remembers the cycle it was last brought up to date at, and its
+counter is only recomputed from the elapsed cycles when something looks at it or changes its setup. The current
+cycle includes how far the EE has gotten into its slice, so a counter polled in a loop still moves every read.
+Compare and overflow interrupts are scheduled ahead of time as events, so an idle timer costs nothing.
+
+HBLANK-clocked timers (mode 3) are the exception and are ticked directly by the HBLANK event.
+**/
+
 struct TimerControl
 {
     uint8_t mode;
@@ -22,28 +31,48 @@ struct Timer
     TimerControl control;
     uint32_t compare;
 
-    //Internal variable for holding number of EE clocks
-    uint32_t clocks;
+    //Cycle the counter was last updated at
+    uint64_t last_update;
+
+    bool event_pending;
+    uint64_t event_id;
 };
 
 class INTC;
+class MMIOTable;
+class Scheduler;
 
 class EmotionTiming
 {
     private:
         INTC* intc;
+        Scheduler* scheduler;
         Timer timers[4];
 
-        void write_control(int index, uint32_t value);
-        void count_up(int index, int cycles_per_count);
+        int timer_event_id;
+
+        int get_clock_divider(int index);
+        void update_counter(int index);
+        void reschedule(int index);
+        void timer_event(int index);
+
+        void count_up(int index, uint64_t ticks);
+        void compare_hit(int index);
+        void overflow(int index);
     public:
-        EmotionTiming(INTC* intc);
+        EmotionTiming(INTC* intc, Scheduler* scheduler);
 
         void reset();
-        void run();
+        void map_registers(MMIOTable* mmio);
+        void hblank();
 
-        uint32_t read32(uint32_t addr);
-        void write32(uint32_t addr, uint32_t value);
+        uint32_t read_counter(int index);
+        uint32_t read_control(int index);
+        uint32_t read_compare(int index);
+
+        void write_counter(int index, uint32_t value);
+        void write_control(int index, uint32_t value);
+        void write_compare(int index, uint32_t value);
 };
 
 #endif // TIMERS_HPP
@@ -1,6 +1,7 @@
-#include <cstdio>
 #include "vu.hpp"
 
+#include "../logger.hpp"
+
 VectorUnit::VectorUnit(int id) : id(id)
 {
     gpr[0].f[0] = 0.0;
@@ -19,7 +20,7 @@ uint32_t VectorUnit::cfc(int index)
 {
     if (index < 16)
         return int_gpr[index];
-    printf("[COP2] Unrecognized cfc2 from reg %d\n", index);
+    WARN_LOG(LOG_VU, "[COP2] Unrecognized cfc2 from reg %d\n", index);
     return 0;
 }
 
@@ -30,26 +31,26 @@ void VectorUnit::ctc(int index, uint32_t value)
         int_gpr[index] = value & 0xFFFF;
         return;
     }
-    printf("[COP2] Unrecognized ctc2 of $%08X to reg %d\n", value, index);
+    WARN_LOG(LOG_VU, "[COP2] Unrecognized ctc2 of $%08X to reg %d\n", value, index);
 }
 
 void VectorUnit::iswr(uint8_t field, uint8_t source, uint8_t base)
 {
     uint32_t addr = int_gpr[base] << 4;
-    printf("[VU] ISWR to $%08X!\n", addr);
+    DEBUG_LOG(LOG_VU, "[VU] ISWR to $%08X!\n", addr);
 }
 
 void VectorUnit::sub(uint8_t field, uint8_t dest, uint8_t reg1, uint8_t reg2)
 {
-    printf("[VU] SUB: ");
+    DEBUG_LOG(LOG_VU, "[VU] SUB: ");
     for (int i = 0; i < 4; i++)
     {
         if (field & (1 << i))
         {
             float result = gpr[reg1].f[i] - gpr[reg2].f[i];
             set_gpr(dest, i, result);
-            printf("%f ", gpr[dest].f[i]);
+            DEBUG_LOG(LOG_VU, "%f ", gpr[dest].f[i]);
         }
     }
-    printf("\n");
+    DEBUG_LOG(LOG_VU, "\n");
 }
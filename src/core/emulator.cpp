@@ -3,77 +3,293 @@
 #include <cstdlib>
 #include <sstream>
 #include "emulator.hpp"
+#include "logger.hpp"
 
 #define CYCLES_PER_FRAME 1000000
+#define VBLANK_START_CYCLES (CYCLES_PER_FRAME * 8 / 10)
+
+//TODO: actual value for HSYNC
+#define CYCLES_PER_HBLANK 15000
+
+//By default the EE runs until the next scheduled event, but never for longer than this so the polled devices keep up.
+//Slices only go all the way to the next event when everything is idle.
+#define DEFAULT_SLICE_CYCLES 256
+
+//The IOP runs at 1/8 of the EE clock
+#define EE_CYCLES_PER_IOP_CYCLE 8
+
+//How far either CPU may get ahead of the other when the IOP has its own thread. This has to fit at least a slice from
+//each side, otherwise both could end up waiting on each other.
+#define MAX_SKEW_CYCLES(slice) (8 * (slice) + EE_CYCLES_PER_IOP_CYCLE)
 
 Emulator::Emulator() :
-    bios_hle(this, &gs), cdvd(this), cpu(&bios_hle, this, &vu0), dmac(&cpu, this, &gif, &sif), gif(&gs), gs(&intc),
-    iop(this), iop_dma(this, &cdvd, &sif), iop_timers(this), intc(&cpu), timers(&intc), vu0(0), vu1(1)
+    ee_mmio("EE"), iop_mmio("IOP"), bios_hle(this, &gs), cdvd(this, &iop_scheduler), cpu(&bios_hle, this, &vu0), dmac(&cpu, this, &gif, &sif), gif(&gs), gs(&intc),
+    iop(this), iop_dma(this, &cdvd, &sif), iop_timers(this, &iop_scheduler), intc(&cpu), timers(&intc, &scheduler), vu0(0), vu1(1)
 {
     BIOS = nullptr;
     RDRAM = nullptr;
     IOP_RAM = nullptr;
+    fastmem_memory = false;
+    slice_cycles = DEFAULT_SLICE_CYCLES;
+    max_skew_cycles = MAX_SKEW_CYCLES(slice_cycles);
+    iop_threaded = false;
+    iop_thread_running = false;
+    idle_until_event = false;
     ELF_file = nullptr;
     ELF_size = 0;
-    ee_log.open("ee_log.txt", std::ios::out);
+    console.open_file("ee_log.txt");
+
+    vblank_start_id = scheduler.register_function([this] (uint64_t param) { vblank_start(); });
+    vblank_end_id = scheduler.register_function([this] (uint64_t param) { vblank_end(); });
+    hblank_id = scheduler.register_function([this] (uint64_t param) { hblank(); });
+    scheduler.set_slice_progress([this] { return (uint64_t)cpu.get_slice_progress(); });
+    iop_scheduler.set_slice_progress([this] { return (uint64_t)iop.get_slice_progress() * EE_CYCLES_PER_IOP_CYCLE; });
+
+    map_registers();
 }
 
 Emulator::~Emulator()
 {
-    if (ee_log.is_open())
-        ee_log.close();
-    if (RDRAM)
-        delete[] RDRAM;
-    if (IOP_RAM)
-        delete[] IOP_RAM;
-    if (BIOS)
-        delete[] BIOS;
+    stop_iop_thread();
+    if (!fastmem_memory)
+    {
+        if (RDRAM)
+            delete[] RDRAM;
+        if (IOP_RAM)
+            delete[] IOP_RAM;
+        if (BIOS)
+            delete[] BIOS;
+    }
     if (ELF_file)
         delete[] ELF_file;
 }
 
 void Emulator::run()
 {
+    if (iop_threaded && !iop_thread_running)
+        start_iop_thread();
+
     gs.start_frame();
-    instructions_run = 0;
-    //00201AF8
-    uint32_t addr = 0x00201AF8;
-    while (instructions_run < CYCLES_PER_FRAME)
-    {
-        uint32_t old = read32(addr);
-        cpu.run();
-        dmac.run();
-        timers.run();
-        if (instructions_run % 8 == 0)
+    frame_ended = false;
+    while (!frame_ended)
+    {
+        uint64_t slice = scheduler.cycles_until_next_event();
+        if (!iop_threaded && slice > iop_scheduler.cycles_until_next_event())
+            slice = iop_scheduler.cycles_until_next_event();
+        if (slice > (uint64_t)slice_cycles && !idle_until_event)
+            slice = slice_cycles;
+        if (!slice)
+            slice = 1;
+
+        if (iop_threaded)
         {
-            //printf("I: $%08X ", instructions_run / 8);
-            iop.run();
-            iop_dma.run();
-            iop_timers.run();
+            std::unique_lock<std::mutex> lock(iop_sync_mutex);
+            uint64_t end = scheduler.get_cycles() + slice;
+            iop_sync_cond.wait(lock, [&] { return iop_time + max_skew_cycles >= end; });
         }
 
-        //Start VBLANK
-        instructions_run++;
-        if (instructions_run == CYCLES_PER_FRAME * 0.80)
+        //Each CPU gets a whole slice to itself. The EE goes first and may overshoot slightly when finishing a
+        //block, or stop early to sync, so everything else catches up to what it actually ran.
+        int cycles = cpu.run(slice);
+        dmac.run(cycles);
+
+        //Events at the end of the slice may wake either CPU up
+        bool event_due = scheduler.cycles_until_next_event() <= (uint64_t)cycles;
+        if (!iop_threaded)
         {
-            /*if (frames == 12)
+            //A busy IOP still gets its usual slices when the EE is skipping to the next event. None of its own
+            //events can come up in between, so once it's idle as well it can skip the rest of the way.
+            for (int done = 0; done < cycles; )
             {
-                cpu.set_disassembly(true);
-            }*/
-            gs.set_VBLANK(true);
-            printf("VSYNC FRAMES: %d\n", frames);
-            frames++;
-            //iop_request_IRQ(0);
-            gs.render_CRT();
+                int iop_slice = cycles - done;
+                if (iop_slice > slice_cycles && !(done && iop.is_idle() && !iop_dma.is_active()))
+                    iop_slice = slice_cycles;
+                run_iop(iop_slice);
+                event_due |= iop_scheduler.cycles_until_next_event() <= (uint64_t)iop_slice;
+                iop_scheduler.advance(iop_slice);
+                done += iop_slice;
+            }
+        }
+        idle_until_event = !event_due && is_idle_until_event();
+        scheduler.advance(cycles);
+
+        if (iop_threaded)
+        {
+            std::lock_guard<std::mutex> lock(iop_sync_mutex);
+            ee_time = scheduler.get_cycles();
+            iop_sync_cond.notify_all();
         }
     }
-    //VBLANK end
+}
+
+/**
+ * Called at the end of a slice that had no events due. The EE sitting in an idle loop can then only be woken by the
+ * DMAC or the IOP changing something it reads. Loops that don't read I/O registers can't see the IOP, as it only
+ * reaches EE memory through the DMAC.
+ * The threaded IOP can't be vouched for, and its skew limit wouldn't allow long slices anyway.
+ */
+bool Emulator::is_idle_until_event()
+{
+    if (iop_threaded || !cpu.is_idle() || dmac.is_active())
+        return false;
+    if (!cpu.idle_loop_reads_io())
+        return true;
+    return iop.is_idle() && !iop_dma.is_active();
+}
+
+void Emulator::run_iop(int cycles)
+{
+    iop_cycles += cycles;
+    int iop_slice = iop_cycles / EE_CYCLES_PER_IOP_CYCLE;
+    iop_cycles -= iop_slice * EE_CYCLES_PER_IOP_CYCLE;
+    iop.run(iop_slice);
+    iop_dma.run(iop_slice);
+}
+
+/**
+ * Body of the IOP thread. The IOP runs its own slices against its own scheduler, but never past the last point the
+ * EE has published, so the EE never sees IOP state from its own future. Between slices the IOP is "paused" and its
+ * state may be touched from the EE side.
+ */
+void Emulator::iop_thread_loop()
+{
+    std::unique_lock<std::mutex> lock(iop_sync_mutex);
+    while (!iop_thread_quit)
+    {
+        iop_paused = true;
+        iop_sync_cond.notify_all();
+        iop_sync_cond.wait(lock, [this] {
+            return iop_thread_quit || (!iop_pause_requests && ee_time >= iop_time + EE_CYCLES_PER_IOP_CYCLE);
+        });
+        iop_paused = false;
+        if (iop_thread_quit)
+            break;
+
+        //Only whole IOP cycles, so there's never a partial one carried over
+        uint64_t slice = iop_scheduler.cycles_until_next_event();
+        if (slice > (uint64_t)slice_cycles)
+            slice = slice_cycles;
+        slice = (slice + EE_CYCLES_PER_IOP_CYCLE - 1) / EE_CYCLES_PER_IOP_CYCLE * EE_CYCLES_PER_IOP_CYCLE;
+        if (!slice)
+            slice = EE_CYCLES_PER_IOP_CYCLE;
+        uint64_t behind = (ee_time - iop_time) / EE_CYCLES_PER_IOP_CYCLE * EE_CYCLES_PER_IOP_CYCLE;
+        if (slice > behind)
+            slice = behind;
+
+        lock.unlock();
+        run_iop(slice);
+        iop_scheduler.advance(slice);
+        lock.lock();
+
+        iop_time = iop_scheduler.get_cycles();
+        iop_sync_cond.notify_all();
+    }
+    iop_paused = true;
+}
+
+void Emulator::start_iop_thread()
+{
+    //Both timelines are in step when coming from single-threaded mode or a reset
+    iop_thread_quit = false;
+    iop_pause_requests = 0;
+    iop_paused = false;
+    ee_time = scheduler.get_cycles();
+    iop_time = iop_scheduler.get_cycles();
+    iop_thread_running = true;
+    iop_thread = std::thread(&Emulator::iop_thread_loop, this);
+}
+
+void Emulator::stop_iop_thread()
+{
+    if (!iop_thread_running)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(iop_sync_mutex);
+        iop_thread_quit = true;
+        iop_sync_cond.notify_all();
+    }
+    iop_thread.join();
+    iop_thread_running = false;
+}
+
+//Holds the IOP thread still so that state shared with the IOP (CDVD etc.) can be used from the EE side
+void Emulator::pause_iop()
+{
+    if (!iop_thread_running)
+        return;
+    std::unique_lock<std::mutex> lock(iop_sync_mutex);
+    iop_pause_requests++;
+    iop_sync_cond.wait(lock, [this] { return iop_paused; });
+}
+
+void Emulator::resume_iop()
+{
+    if (!iop_thread_running)
+        return;
+    std::lock_guard<std::mutex> lock(iop_sync_mutex);
+    iop_pause_requests--;
+    iop_sync_cond.notify_all();
+}
+
+/**
+ * Called when the EE touches IOP RAM or the SIF registers. The IOP lags the EE by up to a slice, so the slice is
+ * cut short to let it catch up before the EE looks again.
+ * With the IOP on its own thread, the EE publishes where it is inside its slice and waits for the IOP to get there.
+ * The IOP can't go any further until the EE publishes again at the end of its slice, so it stays put while the EE
+ * does the access. The IOP never has to wait on its side, as the EE is always at least as far along.
+ */
+void Emulator::sync_with_iop()
+{
+    cpu.end_slice();
+    if (!iop_thread_running)
+        return;
+    std::unique_lock<std::mutex> lock(iop_sync_mutex);
+    uint64_t now = scheduler.get_current_cycles();
+    if (now > ee_time)
+    {
+        ee_time = now;
+        iop_sync_cond.notify_all();
+    }
+    iop_sync_cond.wait(lock, [&] { return iop_paused && iop_time + EE_CYCLES_PER_IOP_CYCLE > ee_time; });
+}
+
+void Emulator::vblank_start()
+{
+    /*if (frames == 12)
+    {
+        cpu.set_disassembly(true);
+    }*/
+    gs.set_VBLANK(true);
+    DEBUG_LOG(LOG_EMU, "VSYNC FRAMES: %d\n", frames);
+    frames++;
+    //iop_request_IRQ(0);
+    gs.render_CRT();
+}
+
+void Emulator::vblank_end()
+{
     //iop_request_IRQ(11);
     gs.set_VBLANK(false);
+    frame_ended = true;
+
+    //Scheduled from the ideal frame boundary so that lateness doesn't accumulate
+    frame_start += CYCLES_PER_FRAME;
+    uint64_t late = scheduler.get_cycles() - frame_start;
+    scheduler.add_event(vblank_start_id, VBLANK_START_CYCLES - late);
+    scheduler.add_event(vblank_end_id, CYCLES_PER_FRAME - late);
+}
+
+void Emulator::hblank()
+{
+    timers.hblank();
+    scheduler.add_event(hblank_id, CYCLES_PER_HBLANK);
 }
 
 void Emulator::reset()
 {
+    //Restarted on the next call to run()
+    stop_iop_thread();
+
     ee_stdout = "";
     frames = 0;
     skip_BIOS_hack = NONE;
@@ -84,10 +300,20 @@ void Emulator::reset()
     if (!BIOS)
         BIOS = new uint8_t[1024 * 1024 * 4];
 
+    scheduler.reset();
+    iop_scheduler.reset();
+    frame_start = 0;
+    frame_ended = false;
+    idle_until_event = false;
+    iop_cycles = 0;
+    scheduler.add_event(vblank_start_id, VBLANK_START_CYCLES);
+    scheduler.add_event(vblank_end_id, CYCLES_PER_FRAME);
+    scheduler.add_event(hblank_id, CYCLES_PER_HBLANK);
+
     //bios_hle.reset();
     cdvd.reset();
-    cpu.reset();
-    dmac.reset();
+    cpu.reset(RDRAM, BIOS);
+    dmac.reset(RDRAM);
     gs.reset();
     gif.reset();
     iop.reset();
@@ -109,11 +335,16 @@ void Emulator::reset()
 uint32_t* Emulator::get_framebuffer()
 {
     //This function should only be called upon ending a frame; return nullptr otherwise
-    if (!gs.is_frame_complete() && instructions_run < 1000000)
+    if (!gs.is_frame_complete() && !frame_ended)
         return nullptr;
     return gs.get_framebuffer();
 }
 
+uint64_t Emulator::get_cycles()
+{
+    return scheduler.get_cycles();
+}
+
 void Emulator::get_resolution(int &w, int &h)
 {
     gs.get_resolution(w, h);
@@ -135,11 +366,12 @@ bool Emulator::skip_BIOS()
                 break;
             case LOAD_DISC:
             {
+                pause_iop();
                 uint32_t system_cnf_size;
                 uint8_t* system_cnf = cdvd.read_file("SYSTEM.CNF;1", system_cnf_size);
                 if (!system_cnf)
                 {
-                    printf("[Emulator] Failed to load SYSTEM.CNF!\n");
+                    ERROR_LOG(LOG_EMU, "[Emulator] Failed to load SYSTEM.CNF!\n");
                     exit(1);
                 }
                 std::string exec_name = "";
@@ -153,11 +385,12 @@ bool Emulator::skip_BIOS()
                 }
                 exec_name += ";1";
                 delete[] system_cnf;
-                printf("[Emulator] Loading %s\n", exec_name.c_str());
+                INFO_LOG(LOG_EMU, "[Emulator] Loading %s\n", exec_name.c_str());
                 uint8_t* file = cdvd.read_file(exec_name, ELF_size);
+                resume_iop();
                 if (!file)
                 {
-                    printf("[Emulator] Failed to load %s!\n", exec_name.c_str());
+                    ERROR_LOG(LOG_EMU, "[Emulator] Failed to load %s!\n", exec_name.c_str());
                     exit(1);
                 }
                 load_ELF(file, ELF_size);
@@ -180,6 +413,104 @@ void Emulator::set_skip_BIOS_hack(SKIP_HACK type)
     skip_BIOS_hack = type;
 }
 
+void Emulator::set_ee_mode(CPU_MODE mode)
+{
+    cpu.set_mode(mode);
+}
+
+void Emulator::set_slice_cycles(int cycles)
+{
+    if (cycles < 1)
+        cycles = 1;
+    pause_iop();
+    slice_cycles = cycles;
+    max_skew_cycles = MAX_SKEW_CYCLES(cycles);
+    resume_iop();
+}
+
+void Emulator::set_dma_burst_length(int quadwords)
+{
+    dmac.set_burst_length(quadwords);
+}
+
+void Emulator::set_iop_threaded(bool threaded)
+{
+    //The thread itself is started by run()
+    if (!threaded)
+        stop_iop_thread();
+    iop_threaded = threaded;
+    idle_until_event = false;
+}
+
+void Emulator::set_gs_threaded(bool threaded)
+{
+    gs.set_threaded(threaded);
+}
+
+void Emulator::set_gs_worker_count(int count)
+{
+    gs.set_worker_count(count);
+}
+
+void Emulator::set_gs_jit(bool enabled)
+{
+    gs.set_jit(enabled);
+}
+
+int Emulator::verify_gs_rasterizer(int count, uint32_t seed)
+{
+    return gs.verify_rasterizer(count, seed);
+}
+
+void Emulator::set_idle_loop_detection(bool enabled)
+{
+    cpu.set_idle_loop_detection(enabled);
+    iop.set_idle_loop_detection(enabled);
+}
+
+void Emulator::set_console_target(CONSOLE_TARGET target)
+{
+    console.set_target(target);
+}
+
+bool Emulator::set_console_file(const char* name)
+{
+    return console.open_file(name);
+}
+
+std::string Emulator::read_console()
+{
+    return console.read_memory();
+}
+
+void Emulator::print_idle_loop_stats()
+{
+    cpu.print_idle_loop_stats();
+    pause_iop();
+    iop.print_idle_loop_stats();
+    resume_iop();
+}
+
+void Emulator::enable_fastmem()
+{
+    //Guest memory has to be carved out of the fastmem backing file, so this can't happen once it's been allocated
+    if (RDRAM)
+    {
+        WARN_LOG(LOG_EE, "[EE] Fastmem must be enabled before the first reset\n");
+        return;
+    }
+    EmotionFastmem* fastmem = cpu.enable_fastmem();
+    if (!fastmem)
+    {
+        WARN_LOG(LOG_EE, "[EE] Fastmem is unavailable on this host, using the page table\n");
+        return;
+    }
+    RDRAM = fastmem->get_RDRAM();
+    IOP_RAM = fastmem->get_IOP_RAM();
+    BIOS = fastmem->get_BIOS();
+    fastmem_memory = true;
+}
+
 void Emulator::load_BIOS(uint8_t *BIOS_file)
 {
     //if (BIOS)
@@ -199,10 +530,10 @@ void Emulator::load_ELF(uint8_t *ELF, uint32_t size)
 {
     if (ELF[0] != 0x7F || ELF[1] != 'E' || ELF[2] != 'L' || ELF[3] != 'F')
     {
-        printf("Invalid elf\n");
+        ERROR_LOG(LOG_EMU, "Invalid elf\n");
         return;
     }
-    printf("Valid elf\n");
+    INFO_LOG(LOG_EMU, "Valid elf\n");
     if (ELF_file)
         delete[] ELF_file;
     ELF_file = new uint8_t[size];
@@ -212,17 +543,20 @@ void Emulator::load_ELF(uint8_t *ELF, uint32_t size)
 
 bool Emulator::load_CDVD(const char *name)
 {
-    return cdvd.load_disc(name);
+    pause_iop();
+    bool loaded = cdvd.load_disc(name);
+    resume_iop();
+    return loaded;
 }
 
 void Emulator::execute_ELF()
 {
     if (!ELF_file)
     {
-        printf("[Emulator] ELF not loaded!\n");
+        ERROR_LOG(LOG_EMU, "[Emulator] ELF not loaded!\n");
         exit(1);
     }
-    printf("[Emulator] Loading ELF into memory...\n");
+    INFO_LOG(LOG_EMU, "[Emulator] Loading ELF into memory...\n");
     uint32_t e_entry = *(uint32_t*)&ELF_file[0x18];
     uint32_t e_phoff = *(uint32_t*)&ELF_file[0x1C];
     uint32_t e_shoff = *(uint32_t*)&ELF_file[0x20];
@@ -230,12 +564,12 @@ void Emulator::execute_ELF()
     uint16_t e_shnum = *(uint16_t*)&ELF_file[0x30];
     uint16_t e_shstrndx = *(uint16_t*)&ELF_file[0x32];
 
-    printf("Entry: $%08X\n", e_entry);
-    printf("Program header start: $%08X\n", e_phoff);
-    printf("Section header start: $%08X\n", e_shoff);
-    printf("Program header entries: %d\n", e_phnum);
-    printf("Section header entries: %d\n", e_shnum);
-    printf("Section header names index: %d\n", e_shstrndx);
+    DEBUG_LOG(LOG_EMU, "Entry: $%08X\n", e_entry);
+    DEBUG_LOG(LOG_EMU, "Program header start: $%08X\n", e_phoff);
+    DEBUG_LOG(LOG_EMU, "Section header start: $%08X\n", e_shoff);
+    DEBUG_LOG(LOG_EMU, "Program header entries: %d\n", e_phnum);
+    DEBUG_LOG(LOG_EMU, "Section header entries: %d\n", e_shnum);
+    DEBUG_LOG(LOG_EMU, "Section header names index: %d\n", e_shstrndx);
 
     for (int i = e_phoff; i < e_phoff + (e_phnum * 0x20); i += 0x20)
     {
@@ -243,13 +577,13 @@ void Emulator::execute_ELF()
         uint32_t p_paddr = *(uint32_t*)&ELF_file[i + 0xC];
         uint32_t p_filesz = *(uint32_t*)&ELF_file[i + 0x10];
         uint32_t p_memsz = *(uint32_t*)&ELF_file[i + 0x14];
-        printf("\nProgram header\n");
-        printf("p_type: $%08X\n", *(uint32_t*)&ELF_file[i]);
-        printf("p_offset: $%08X\n", p_offset);
-        printf("p_vaddr: $%08X\n", *(uint32_t*)&ELF_file[i + 0x8]);
-        printf("p_paddr: $%08X\n", p_paddr);
-        printf("p_filesz: $%08X\n", p_filesz);
-        printf("p_memsz: $%08X\n", p_memsz);
+        DEBUG_LOG(LOG_EMU, "Program header\n");
+        DEBUG_LOG(LOG_EMU, "p_type: $%08X\n", *(uint32_t*)&ELF_file[i]);
+        DEBUG_LOG(LOG_EMU, "p_offset: $%08X\n", p_offset);
+        DEBUG_LOG(LOG_EMU, "p_vaddr: $%08X\n", *(uint32_t*)&ELF_file[i + 0x8]);
+        DEBUG_LOG(LOG_EMU, "p_paddr: $%08X\n", p_paddr);
+        DEBUG_LOG(LOG_EMU, "p_filesz: $%08X\n", p_filesz);
+        DEBUG_LOG(LOG_EMU, "p_memsz: $%08X\n", p_memsz);
 
         int mem_w = p_paddr;
         for (int file_w = p_offset; file_w < (p_offset + p_filesz); file_w += 4)
@@ -261,7 +595,7 @@ void Emulator::execute_ELF()
     }
 
     uint32_t name_offset = ELF_file[e_shoff + (e_shstrndx * 0x28) + 0x10];
-    printf("Name offset: $%08X\n", name_offset);
+    DEBUG_LOG(LOG_EMU, "Name offset: $%08X\n", name_offset);
 
     for (int i = e_shoff; i < e_shoff + (e_shnum * 0x28); i += 0x28)
     {
@@ -269,27 +603,176 @@ void Emulator::execute_ELF()
         uint32_t sh_type = *(uint32_t*)&ELF_file[i + 0x4];
         uint32_t sh_offset = *(uint32_t*)&ELF_file[i + 0x10];
         uint32_t sh_size = *(uint32_t*)&ELF_file[i + 0x14];
-        printf("\nSection header\n");
-        printf("sh_type: $%08X\n", sh_type);
-        printf("sh_offset: $%08X\n", sh_offset);
-        printf("sh_size: $%08X\n", sh_size);
+        DEBUG_LOG(LOG_EMU, "Section header\n");
+        DEBUG_LOG(LOG_EMU, "sh_type: $%08X\n", sh_type);
+        DEBUG_LOG(LOG_EMU, "sh_offset: $%08X\n", sh_offset);
+        DEBUG_LOG(LOG_EMU, "sh_size: $%08X\n", sh_size);
 
         /*if (sh_type == 0x3)
         {
-            printf("Debug symbols found\n");
+            DEBUG_LOG(LOG_EMU, "Debug symbols found\n");
             for (int j = sh_offset; j < sh_offset + sh_size; j++)
             {
                 unsigned char burp = ELF_file[j];
                 if (!burp)
-                    printf("\n");
+                    DEBUG_LOG(LOG_EMU, "\n");
                 else
-                    printf("%c", burp);
+                    DEBUG_LOG(LOG_EMU, "%c", burp);
             }
         }*/
     }
     cpu.set_PC(e_entry);
 }
 
+void Emulator::map_registers()
+{
+    dmac.map_registers(&ee_mmio);
+    gs.map_registers(&ee_mmio);
+    intc.map_registers(&ee_mmio);
+    timers.map_registers(&ee_mmio);
+    sif.map_EE_registers(&ee_mmio, [this] () { sync_with_iop(); });
+
+    cdvd.map_registers(&iop_mmio);
+    iop_dma.map_registers(&iop_mmio);
+    iop_timers.map_registers(&iop_mmio);
+    sio2.map_registers(&iop_mmio);
+    sif.map_IOP_registers(&iop_mmio);
+
+    //The CDVD belongs to the IOP
+    ee_mmio.map_read(0x1F402017, 1, [this] (uint32_t addr)
+    {
+        pause_iop();
+        uint8_t value = cdvd.read_S_status();
+        resume_iop();
+        return value;
+    }, true);
+    ee_mmio.map_read(0x1F402018, 1, [this] (uint32_t addr)
+    {
+        pause_iop();
+        uint8_t value = cdvd.read_S_data();
+        resume_iop();
+        return value;
+    });
+
+    ee_mmio.map_read(0x1A000006, 2, [] (uint32_t addr) { return 1; }, true);
+    ee_mmio.map_read(0x1000F130, 4, [] (uint32_t addr) { return 0; }, true);
+    ee_mmio.map_write(0x1000F180, 1, [this] (uint32_t addr, uint64_t value)
+    {
+        console.put((char)value);
+    });
+
+    ee_mmio.map_read(0x1000F430, 4, [] (uint32_t addr)
+    {
+        DEBUG_LOG(LOG_MMIO, "Read from MCH_RICM\n");
+        return 0;
+    });
+    ee_mmio.map_read(0x1000F440, 4, [this] (uint32_t addr) { return read_MCH_DRD(); });
+    ee_mmio.map_write(0x1000F430, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_MMIO, "Write to MCH_RICM: $%08X\n", (uint32_t)value);
+        if ((((value >> 16) & 0xFFF) == 0x21) && (((value >> 6) & 0xF) == 1) &&
+                (((MCH_DRD >> 7) & 1) == 0))
+            rdram_sdevid = 0;
+        MCH_RICM = value & ~0x80000000;
+    });
+    ee_mmio.map_write(0x1000F440, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_MMIO, "Write to MCH_DRD: $%08X\n", (uint32_t)value);
+        MCH_DRD = value;
+    });
+
+    iop_mmio.map_read(0x1FA00000, 1, [this] (uint32_t addr) { return IOP_POST; }, true);
+    iop_mmio.map_write(0x1FA00000, 1, [this] (uint32_t addr, uint64_t value)
+    {
+        //Register intended to be displayed on an external 7 segment display
+        //Used to indicate how far along the boot process is
+        IOP_POST = value;
+        INFO_LOG(LOG_IOP, "[IOP] POST: $%02X\n", IOP_POST);
+    });
+
+    iop_mmio.map_read(0x1F801070, 4, [this] (uint32_t addr) { return IOP_I_STAT; }, true);
+    iop_mmio.map_read(0x1F801074, 4, [this] (uint32_t addr) { return IOP_I_MASK; }, true);
+    iop_mmio.map_read(0x1F801078, 4, [this] (uint32_t addr)
+    {
+        //I_CTRL is reset when read
+        uint32_t value = IOP_I_CTRL;
+        IOP_I_CTRL = 0;
+        return value;
+    });
+    iop_mmio.map_write(0x1F801070, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_IOP, "[IOP] I_STAT: $%08X\n", (uint32_t)value);
+        IOP_I_STAT &= value;
+        iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
+    });
+    iop_mmio.map_write(0x1F801074, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_IOP, "[IOP] I_MASK: $%08X\n", (uint32_t)value);
+        IOP_I_MASK = value;
+        iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
+    });
+    iop_mmio.map_write(0x1F801078, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        IOP_I_CTRL = value & 0x1;
+        iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
+        //DEBUG_LOG(LOG_IOP, "[IOP] I_CTRL: $%08X\n", value);
+    });
+
+    //Registers that are read as zero and/or have writes ignored
+    static const uint32_t iop_stub_reads[] =
+    {
+        0x1F801450,
+        0x1F801578, //No clue
+        0xFFFE0130 //Cache control?
+    };
+    static const uint32_t iop_stub_writes[] =
+    {
+        0x1F801000, 0x1F801004, 0x1F801008, 0x1F80100C,
+        0x1F801010, 0x1F801014, 0x1F801018, 0x1F80101C, //BIOS ROM delay?
+        0x1F801020, //Common delay?
+        0x1F801060, //RAM size?
+        0x1F801404,
+        0x1F801450, //Config reg? Do nothing to prevent log spam
+        0x1F801578,
+        0x1F802070, //POST2?
+        0xFFFE0130 //Cache control?
+    };
+    for (uint32_t addr : iop_stub_reads)
+        iop_mmio.map_read(addr, 4, [] (uint32_t addr) { return 0; }, true);
+    for (uint32_t addr : iop_stub_writes)
+        iop_mmio.map_write(addr, 4, [] (uint32_t addr, uint64_t value) {});
+    iop_mmio.map_write(0x1F802070, 1, [] (uint32_t addr, uint64_t value) {});
+}
+
+uint32_t Emulator::read_MCH_DRD()
+{
+    DEBUG_LOG(LOG_MMIO, "Read from MCH_DRD\n");
+    if (!((MCH_RICM >> 6) & 0xF))
+    {
+        switch ((MCH_RICM >> 16) & 0xFFF)
+        {
+            case 0x21:
+                DEBUG_LOG(LOG_MMIO, "Init\n");
+                if (rdram_sdevid < 2)
+                {
+                    rdram_sdevid++;
+                    return 0x1F;
+                }
+                return 0;
+            case 0x23:
+                DEBUG_LOG(LOG_MMIO, "ConfigA\n");
+                return 0x0D0D;
+            case 0x24:
+                DEBUG_LOG(LOG_MMIO, "ConfigB\n");
+                return 0x0090;
+            case 0x40:
+                DEBUG_LOG(LOG_MMIO, "Devid\n");
+                return MCH_RICM & 0x1F;
+        }
+    }
+    return 0;
+}
+
 uint8_t Emulator::read8(uint32_t address)
 {
     if (address < 0x10000000)
@@ -297,15 +780,14 @@ uint8_t Emulator::read8(uint32_t address)
     if (address >= 0x1FC00000 && address < 0x20000000)
         return BIOS[address & 0x3FFFFF];
     if (address >= 0x1C000000 && address < 0x1C200000)
-        return IOP_RAM[address & 0x1FFFFF];
-    switch (address)
     {
-        case 0x1F402017:
-            return cdvd.read_S_status();
-        case 0x1F402018:
-            return cdvd.read_S_data();
+        sync_with_iop();
+        return IOP_RAM[address & 0x1FFFFF];
     }
-    printf("Unrecognized read8 at physical addr $%08X\n", address);
+    uint8_t value;
+    if (ee_mmio.read(address, value))
+        return value;
+    WARN_LOG(LOG_MMIO, "Unrecognized read8 at physical addr $%08X\n", address);
     return 0;
 }
 
@@ -316,13 +798,14 @@ uint16_t Emulator::read16(uint32_t address)
     if (address >= 0x1FC00000 && address < 0x20000000)
         return *(uint16_t*)&BIOS[address & 0x3FFFFF];
     if (address >= 0x1C000000 && address < 0x1C200000)
-        return *(uint16_t*)&IOP_RAM[address & 0x1FFFFF];
-    switch (address)
     {
-        case 0x1A000006:
-            return 1;
+        sync_with_iop();
+        return *(uint16_t*)&IOP_RAM[address & 0x1FFFFF];
     }
-    printf("Unrecognized read16 at physical addr $%08X\n", address);
+    uint16_t value;
+    if (ee_mmio.read(address, value))
+        return value;
+    WARN_LOG(LOG_MMIO, "Unrecognized read16 at physical addr $%08X\n", address);
     return 0;
 }
 
@@ -332,68 +815,15 @@ uint32_t Emulator::read32(uint32_t address)
         return *(uint32_t*)&RDRAM[address & 0x01FFFFFF];
     if (address >= 0x1FC00000 && address < 0x20000000)
         return *(uint32_t*)&BIOS[address & 0x3FFFFF];
-    if (address >= 0x10000000 && address < 0x10002000)
-        return timers.read32(address);
-    if ((address & (0xFF000000)) == 0x12000000)
-        return gs.read32_privileged(address);
-    if (address >= 0x10008000 && address < 0x1000F000)
-        return dmac.read32(address);
     if (address >= 0x1C000000 && address < 0x1C200000)
+    {
+        sync_with_iop();
         return *(uint32_t*)&IOP_RAM[address & 0x1FFFFF];
-    switch (address)
-    {
-        case 0x1000F130:
-            return 0;
-        case 0x1000F000:
-            //printf("\nRead32 INTC_STAT: $%08X", intc.read_stat());
-            return intc.read_stat();
-        case 0x1000F010:
-            printf("\nRead32 INTC_MASK: $%08X", intc.read_mask());
-            return intc.read_mask();
-        case 0x1000F200:
-            return sif.get_mscom();
-        case 0x1000F210:
-            return sif.get_smcom();
-        case 0x1000F220:
-            return sif.get_msflag();
-        case 0x1000F230:
-            return sif.get_smflag();
-        case 0x1000F240:
-            printf("[EE] Read BD4: $%08X\n", sif.get_control() | 0xF0000102);
-            return sif.get_control() | 0xF0000102;
-        case 0x1000F430:
-            printf("\nRead from MCH_RICM");
-            return 0;
-        case 0x1000F440:
-            printf("\nRead from MCH_DRD");
-            if (!((MCH_RICM >> 6) & 0xF))
-            {
-                switch ((MCH_RICM >> 16) & 0xFFF)
-                {
-                    case 0x21:
-                        printf("\nInit");
-                        if (rdram_sdevid < 2)
-                        {
-                            rdram_sdevid++;
-                            return 0x1F;
-                        }
-                        return 0;
-                    case 0x23:
-                        printf("\nConfigA");
-                        return 0x0D0D;
-                    case 0x24:
-                        printf("\nConfigB");
-                        return 0x0090;
-                    case 0x40:
-                        printf("\nDevid");
-                        return MCH_RICM & 0x1F;
-                }
-            }
-            return 0;
-        case 0x1000F520:
-            return dmac.read_master_disable();
     }
-    printf("Unrecognized read32 at physical addr $%08X\n", address);
+    uint32_t value;
+    if (ee_mmio.read(address, value))
+        return value;
+    WARN_LOG(LOG_MMIO, "Unrecognized read32 at physical addr $%08X\n", address);
 
     return 0;
 }
@@ -404,41 +834,54 @@ uint64_t Emulator::read64(uint32_t address)
         return *(uint64_t*)&RDRAM[address & 0x01FFFFFF];
     if (address >= 0x1FC00000 && address < 0x20000000)
         return *(uint64_t*)&BIOS[address & 0x3FFFFF];
-    if (address >= 0x10008000 && address < 0x1000F000)
-        return dmac.read32(address);
-    if ((address & (0xFF000000)) == 0x12000000)
-        return gs.read64_privileged(address);
     if (address >= 0x1C000000 && address < 0x1C200000)
+    {
+        sync_with_iop();
         return *(uint64_t*)&IOP_RAM[address & 0x1FFFFF];
-    printf("Unrecognized read64 at physical addr $%08X\n", address);
+    }
+    uint64_t value;
+    if (ee_mmio.read(address, value))
+        return value;
+    WARN_LOG(LOG_MMIO, "Unrecognized read64 at physical addr $%08X\n", address);
     return 0;
 }
 
+uint128_t Emulator::read128(uint32_t address)
+{
+    if (address < 0x10000000)
+        return load128(&RDRAM[address & 0x01FFFFFF]);
+    if (address >= 0x1FC00000 && address < 0x20000000)
+        return load128(&BIOS[address & 0x3FFFFF]);
+
+    //No 128-bit registers are emulated, so anything else is split into two 64-bit accesses
+    uint128_t value;
+    value._u64[0] = read64(address);
+    value._u64[1] = read64(address + 8);
+    return value;
+}
+
 void Emulator::write8(uint32_t address, uint8_t value)
 {
     if (address >= 0x00200070 && address < 0x00200078)
     {
-        printf("[EE] Write to blorp $%08X: $%02X\n", address, value);
+        DEBUG_LOG(LOG_EE, "[EE] Write to blorp $%08X: $%02X\n", address, value);
         cpu.print_state();
     }
     if (address < 0x10000000)
     {
         RDRAM[address & 0x01FFFFFF] = value;
+        cpu.invalidate_code(address);
         return;
     }
     if (address >= 0x1C000000 && address < 0x1C200000)
     {
+        sync_with_iop();
         *(uint8_t*)&IOP_RAM[address & 0x1FFFFF] = value;
         return;
     }
-    switch (address)
-    {
-        case 0x1000F180:
-            ee_log << value;
-            ee_log.flush();
-            return;
-    }
-    printf("Unrecognized write8 at physical addr $%08X of $%02X\n", address, value);
+    if (ee_mmio.write(address, value))
+        return;
+    WARN_LOG(LOG_MMIO, "Unrecognized write8 at physical addr $%08X of $%02X\n", address, value);
     //exit(1);
 }
 
@@ -447,19 +890,23 @@ void Emulator::write16(uint32_t address, uint16_t value)
     if (address < 0x10000000)
     {
         *(uint16_t*)&RDRAM[address & 0x01FFFFFF] = value;
+        cpu.invalidate_code(address);
         return;
     }
     if (address >= 0x1C000000 && address < 0x1C200000)
     {
+        sync_with_iop();
         *(uint16_t*)&IOP_RAM[address & 0x1FFFFF] = value;
         return;
     }
+    if (ee_mmio.write(address, value))
+        return;
     if (address >= 0x1A000000 && address < 0x1FC00000)
     {
-        printf("[EE] Unrecognized write16 to IOP addr $%08X of $%04X\n", address, value);
+        WARN_LOG(LOG_MMIO, "[EE] Unrecognized write16 to IOP addr $%08X of $%04X\n", address, value);
         return;
     }
-    printf("Unrecognized write16 at physical addr $%08X of $%04X\n", address, value);
+    WARN_LOG(LOG_MMIO, "Unrecognized write16 at physical addr $%08X of $%04X\n", address, value);
 }
 
 void Emulator::write32(uint32_t address, uint32_t value)
@@ -467,76 +914,23 @@ void Emulator::write32(uint32_t address, uint32_t value)
     if (address < 0x10000000)
     {
         *(uint32_t*)&RDRAM[address & 0x01FFFFFF] = value;
-        return;
-    }
-    if (address >= 0x10000000 && address < 0x10002000)
-    {
-        timers.write32(address, value);
-        return;
-    }
-    if ((address & (0xFF000000)) == 0x12000000)
-    {
-        gs.write32_privileged(address, value);
-        return;
-    }
-    if (address >= 0x10008000 && address < 0x1000F000)
-    {
-        dmac.write32(address, value);
+        cpu.invalidate_code(address);
         return;
     }
     if (address >= 0x1C000000 && address < 0x1C200000)
     {
+        sync_with_iop();
         *(uint32_t*)&IOP_RAM[address & 0x1FFFFF] = value;
         return;
     }
+    if (ee_mmio.write(address, value))
+        return;
     if (address >= 0x1A000000 && address < 0x1FC00000)
     {
-        printf("[EE] Unrecognized write32 to IOP addr $%08X of $%08X\n", address, value);
+        WARN_LOG(LOG_MMIO, "[EE] Unrecognized write32 to IOP addr $%08X of $%08X\n", address, value);
         return;
     }
-    switch (address)
-    {
-        case 0x1000F000:
-            printf("\nWrite32 INTC_STAT: $%08X", value);
-            intc.write_stat(value);
-            return;
-        case 0x1000F010:
-            printf("\nWrite32 INTC_MASK: $%08X", value);
-            intc.write_mask(value);
-            return;
-        case 0x1000F200:
-            sif.set_mscom(value);
-            return;
-        case 0x1000F210:
-            return;
-        case 0x1000F220:
-            printf("[EE] Write32 msflag: $%08X\n", value);
-            sif.set_msflag(value);
-            return;
-        case 0x1000F230:
-            printf("[EE] Write32 smflag: $%08X\n", value);
-            sif.reset_smflag(value);
-            return;
-        case 0x1000F240:
-            printf("[EE] Write BD4: $%08X\n", value);
-            sif.set_control_EE(value);
-            return;
-        case 0x1000F430:
-            printf("\nWrite to MCH_RICM: $%08X", value);
-            if ((((value >> 16) & 0xFFF) == 0x21) && (((value >> 6) & 0xF) == 1) &&
-                    (((MCH_DRD >> 7) & 1) == 0))
-                rdram_sdevid = 0;
-            MCH_RICM = value & ~0x80000000;
-            return;
-        case 0x1000F440:
-            printf("\nWrite to MCH_DRD: $%08X", value);
-            MCH_DRD = value;
-            return;
-        case 0x1000F590:
-            dmac.write_master_disable(value);
-            return;
-    }
-    printf("Unrecognized write32 at physical addr $%08X of $%08X\n", address, value);
+    WARN_LOG(LOG_MMIO, "Unrecognized write32 at physical addr $%08X of $%08X\n", address, value);
 
     //exit(1);
 }
@@ -546,56 +940,53 @@ void Emulator::write64(uint32_t address, uint64_t value)
     if (address < 0x10000000)
     {
         *(uint64_t*)&RDRAM[address & 0x01FFFFFF] = value;
+        cpu.invalidate_code(address);
         return;
     }
-    if (address >= 0x10008000 && address < 0x1000F000)
+    if (address >= 0x1C000000 && address < 0x1C200000)
     {
-        dmac.write32(address, value);
+        sync_with_iop();
+        *(uint64_t*)&IOP_RAM[address & 0x1FFFFF] = value;
         return;
     }
-    if ((address & (0xFF000000)) == 0x12000000)
-    {
-        gs.write64_privileged(address, value);
+    if (ee_mmio.write(address, value))
         return;
-    }
-    if (address >= 0x1C000000 && address < 0x1C200000)
+    WARN_LOG(LOG_MMIO, "Unrecognized write64 at physical addr $%08X of $%08X_%08X\n", address, value >> 32,
+             value & 0xFFFFFFFF);
+    //exit(1);
+}
+
+void Emulator::write128(uint32_t address, uint128_t value)
+{
+    if (address < 0x10000000)
     {
-        *(uint64_t*)&IOP_RAM[address & 0x1FFFFF] = value;
+        store128(&RDRAM[address & 0x01FFFFFF], value);
+        cpu.invalidate_code(address);
         return;
     }
-    printf("Unrecognized write64 at physical addr $%08X of $%08X_%08X\n", address, value >> 32, value & 0xFFFFFFFF);
-    //exit(1);
+    write64(address, value._u64[0]);
+    write64(address + 8, value._u64[1]);
+}
+
+//True if reading the register at address has no side effects. IOP RAM isn't counted, as it's the IOP's to change.
+bool Emulator::is_pure_read(uint32_t address, int width)
+{
+    return ee_mmio.is_pure_read(address, width);
 }
 
 uint8_t Emulator::iop_read8(uint32_t address)
 {
     if (address < 0x00200000)
     {
-        //printf("[IOP] Read8 from $%08X: $%02X\n", address, IOP_RAM[address]);
+        //DEBUG_LOG(LOG_IOP, "[IOP] Read8 from $%08X: $%02X\n", address, IOP_RAM[address]);
         return IOP_RAM[address];
     }
     if (address >= 0x1FC00000 && address < 0x20000000)
         return BIOS[address & 0x3FFFFF];
-    switch (address)
-    {
-        case 0x1F402004:
-            return cdvd.read_N_callback();
-        case 0x1F402005:
-            return cdvd.read_N_status();
-        case 0x1F402008:
-            return cdvd.read_ISTAT();
-        case 0x1F40200F:
-            return cdvd.read_disc_type();
-        case 0x1F402016:
-            return cdvd.read_S_command();
-        case 0x1F402017:
-            return cdvd.read_S_status();
-        case 0x1F402018:
-            return cdvd.read_S_data();
-        case 0x1FA00000:
-            return IOP_POST;
-    }
-    printf("Unrecognized IOP read8 from physical addr $%08X\n", address);
+    uint8_t value;
+    if (iop_mmio.read(address, value))
+        return value;
+    WARN_LOG(LOG_MMIO, "Unrecognized IOP read8 from physical addr $%08X\n", address);
     return 0;
 }
 
@@ -605,71 +996,25 @@ uint16_t Emulator::iop_read16(uint32_t address)
         return *(uint16_t*)&IOP_RAM[address];
     if (address >= 0x1FC00000 && address < 0x20000000)
         return *(uint16_t*)&BIOS[address & 0x3FFFFF];
-    switch (address)
-    {
-        case 0x1F8014A4:
-            return iop_timers.read_control(5);
-    }
-    printf("Unrecognized IOP read16 from physical addr $%08X\n", address);
+    uint16_t value;
+    if (iop_mmio.read(address, value))
+        return value;
+    WARN_LOG(LOG_MMIO, "Unrecognized IOP read16 from physical addr $%08X\n", address);
     return 0;
 }
 
 uint32_t Emulator::iop_read32(uint32_t address)
 {
     if (address == 0x19608)
-        printf("[IOP] Read from $%08X of $%08X\n", address, *(uint32_t*)&IOP_RAM[address]);
+        DEBUG_LOG(LOG_IOP, "[IOP] Read from $%08X of $%08X\n", address, *(uint32_t*)&IOP_RAM[address]);
     if (address < 0x00200000)
         return *(uint32_t*)&IOP_RAM[address];
     if (address >= 0x1FC00000 && address < 0x20000000)
         return *(uint32_t*)&BIOS[address & 0x3FFFFF];
-    switch (address)
-    {
-        case 0x1D000000:
-            return sif.get_mscom();
-        case 0x1D000010:
-            return sif.get_smcom();
-        case 0x1D000020:
-            return sif.get_msflag();
-        case 0x1D000030:
-            return sif.get_smflag();
-        case 0x1D000040:
-            printf("[IOP] Read BD4: $%08X\n", sif.get_control() | 0xF0000002);
-            return sif.get_control() | 0xF0000002;
-        case 0x1F801070:
-            return IOP_I_STAT;
-        case 0x1F801074:
-            return IOP_I_MASK;
-        case 0x1F801078:
-        {
-            //I_CTRL is reset when read
-            uint32_t value = IOP_I_CTRL;
-            IOP_I_CTRL = 0;
-            return value;
-        }
-        case 0x1F8010B8:
-            return iop_dma.get_chan_control(3);
-        case 0x1F8010F0:
-            return iop_dma.get_DPCR();
-        case 0x1F8010F4:
-            return iop_dma.get_DICR();
-        case 0x1F801450:
-            return 0;
-        case 0x1F8014A0:
-            return iop_timers.read_counter(5);
-        case 0x1F801528:
-            return iop_dma.get_chan_control(10);
-        case 0x1F801578:
-            return 0; //No clue
-        case 0x1F801570:
-            return iop_dma.get_DPCR2();
-        case 0x1F801574:
-            return iop_dma.get_DICR2();
-        case 0x1F80826C:
-            return sio2.get_RECV1();
-        case 0xFFFE0130: //Cache control?
-            return 0;
-    }
-    printf("Unrecognized IOP read32 from physical addr $%08X\n", address);
+    uint32_t value;
+    if (iop_mmio.read(address, value))
+        return value;
+    WARN_LOG(LOG_MMIO, "Unrecognized IOP read32 from physical addr $%08X\n", address);
     //exit(1);
     return 0;
 }
@@ -678,44 +1023,13 @@ void Emulator::iop_write8(uint32_t address, uint8_t value)
 {
     if (address < 0x00200000)
     {
-        //printf("[IOP] Write to $%08X of $%02X\n", address, value);
+        //DEBUG_LOG(LOG_IOP, "[IOP] Write to $%08X of $%02X\n", address, value);
         IOP_RAM[address] = value;
         return;
     }
-    switch (address)
-    {
-        case 0x1F402004:
-            cdvd.send_N_command(value);
-            return;
-        case 0x1F402005:
-            cdvd.write_N_data(value);
-            return;
-        case 0x1F402006:
-            printf("[CDVD] Write to mode: $%02X\n", value);
-            return;
-        case 0x1F402008:
-            cdvd.write_ISTAT(value);
-            return;
-        case 0x1F402016:
-            cdvd.send_S_command(value);
-            return;
-        case 0x1F402017:
-            cdvd.write_S_data(value);
-            return;
-        //POST2?
-        case 0x1F802070:
-            return;
-        //SIO2 DATAIN
-        case 0x1F808260:
-            return;
-        case 0x1FA00000:
-            //Register intended to be displayed on an external 7 segment display
-            //Used to indicate how far along the boot process is
-            IOP_POST = value;
-            printf("[IOP] POST: $%02X\n", value);
-            return;
-    }
-    printf("Unrecognized IOP write8 to physical addr $%08X of $%02X\n", address, value);
+    if (iop_mmio.write(address, value))
+        return;
+    ERROR_LOG(LOG_MMIO, "Unrecognized IOP write8 to physical addr $%08X of $%02X\n", address, value);
     exit(1);
 }
 
@@ -723,32 +1037,13 @@ void Emulator::iop_write16(uint32_t address, uint16_t value)
 {
     if (address < 0x00200000)
     {
-        //printf("[IOP] Write16 to $%08X of $%08X\n", address, value);
+        //DEBUG_LOG(LOG_IOP, "[IOP] Write16 to $%08X of $%08X\n", address, value);
         *(uint16_t*)&IOP_RAM[address] = value;
         return;
     }
-    switch (address)
-    {
-        case 0x1F801484:
-            iop_timers.write_control(3, value);
-            return;
-        case 0x1F801494:
-            iop_timers.write_control(4, value);
-            return;
-        case 0x1F8014A4:
-            iop_timers.write_control(5, value);
-            return;
-        case 0x1F801524:
-            iop_dma.set_chan_size(10, value);
-            return;
-        case 0x1F801534:
-            iop_dma.set_chan_size(11, value);
-            return;
-        case 0x1F801536:
-            iop_dma.set_chan_count(11, value);
-            return;
-    }
-    printf("Unrecognized IOP write16 to physical addr $%08X of $%04X\n", address, value);
+    if (iop_mmio.write(address, value))
+        return;
+    WARN_LOG(LOG_MMIO, "Unrecognized IOP write16 to physical addr $%08X of $%04X\n", address, value);
     //exit(1);
 }
 
@@ -756,144 +1051,24 @@ void Emulator::iop_write32(uint32_t address, uint32_t value)
 {
     if (address < 0x00200000)
     {
-        //printf("[IOP] Write to $%08X of $%08X\n", address, value);
+        //DEBUG_LOG(LOG_IOP, "[IOP] Write to $%08X of $%08X\n", address, value);
         *(uint32_t*)&IOP_RAM[address] = value;
         return;
     }
-    if (address >= 0x1F808200 && address < 0x1F808280)
-    {
-        printf("[IOP SIO2] Write32 to $%08X of $%08X\n", address, value);
+    if (iop_mmio.write(address, value))
         return;
-    }
-    switch (address)
-    {
-        case 0x1D000000:
-            //Read only
-            return;
-        case 0x1D000010:
-            sif.set_smcom(value);
-            return;
-        case 0x1D000020:
-            sif.reset_msflag(value);
-            return;
-        case 0x1D000030:
-            printf("[IOP] Set smflag: $%08X\n", value);
-            sif.set_smflag(value);
-            return;
-        case 0x1D000040:
-            printf("[IOP] Write BD4: $%08X\n", value);
-            sif.set_control_IOP(value);
-            return;
-        case 0x1F801000:
-            return;
-        case 0x1F801004:
-            return;
-        case 0x1F801008:
-            return;
-        case 0x1F80100C:
-            return;
-        //BIOS ROM delay?
-        case 0x1F801010:
-            return;
-        case 0x1F801014:
-            return;
-        case 0x1F801018:
-            return;
-        case 0x1F80101C:
-            return;
-        //Common delay?
-        case 0x1F801020:
-            return;
-        //RAM size?
-        case 0x1F801060:
-            return;
-        case 0x1F801070:
-            printf("[IOP] I_STAT: $%08X\n", value);
-            IOP_I_STAT &= value;
-            iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
-            return;
-        case 0x1F801074:
-            printf("[IOP] I_MASK: $%08X\n", value);
-            IOP_I_MASK = value;
-            iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
-            return;
-        case 0x1F801078:
-            IOP_I_CTRL = value & 0x1;
-            iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
-            //printf("[IOP] I_CTRL: $%08X\n", value);
-            return;
-        //CDVD DMA
-        case 0x1F8010B0:
-            iop_dma.set_chan_addr(3, value);
-            return;
-        case 0x1F8010B4:
-            iop_dma.set_chan_block(3, value);
-            return;
-        case 0x1F8010B8:
-            iop_dma.set_chan_control(3, value);
-            return;
-        case 0x1F8010F0:
-            iop_dma.set_DPCR(value);
-            return;
-        case 0x1F8010F4:
-            iop_dma.set_DICR(value);
-            return;
-        case 0x1F801404:
-            return;
-        case 0x1F801450:
-            //Config reg? Do nothing to prevent log spam
-            return;
-        case 0x1F8014A0:
-            iop_timers.write_counter(5, value);
-            return;
-        case 0x1F8014A8:
-            iop_timers.write_target(5, value);
-            return;
-        //SIF0 DMA
-        case 0x1F801520:
-            iop_dma.set_chan_addr(10, value);
-            return;
-        case 0x1F801524:
-            iop_dma.set_chan_block(10, value);
-            return;
-        case 0x1F801528:
-            iop_dma.set_chan_control(10, value);
-            return;
-        case 0x1F80152C:
-            iop_dma.set_chan_tag_addr(10, value);
-            return;
-        //SIF1 DMA
-        case 0x1F801530:
-            iop_dma.set_chan_addr(11, value);
-            return;
-        case 0x1F801534:
-            iop_dma.set_chan_block(11, value);
-            return;
-        case 0x1F801538:
-            iop_dma.set_chan_control(11, value);
-            return;
-        case 0x1F801570:
-            iop_dma.set_DPCR2(value);
-            return;
-        case 0x1F801574:
-            iop_dma.set_DICR2(value);
-            return;
-        case 0x1F801578:
-            return;
-        //POST2?
-        case 0x1F802070:
-            return;
-        //Cache control?
-        case 0xFFFE0130:
-            return;
-    }
-    printf("Unrecognized IOP write32 to physical addr $%08X of $%08X\n", address, value);
+    WARN_LOG(LOG_MMIO, "Unrecognized IOP write32 to physical addr $%08X of $%08X\n", address, value);
     //exit(1);
 }
 
+bool Emulator::iop_is_pure_read(uint32_t address, int width)
+{
+    return iop_mmio.is_pure_read(address, width);
+}
+
 void Emulator::iop_request_IRQ(int index)
 {
-    printf("[IOP] Requesting IRQ %d\n", index);
+    DEBUG_LOG(LOG_IOP, "[IOP] Requesting IRQ %d\n", index);
     uint32_t new_stat = IOP_I_STAT | (1 << index);
     IOP_I_STAT = new_stat;
     iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
@@ -905,7 +1080,8 @@ void Emulator::iop_ksprintf()
     uint32_t arg_pointer = iop.get_gpr(7);
 
     uint32_t width;
-    printf("[IOP Debug] ksprintf: %s\n", (char*)&IOP_RAM[msg_pointer]);
+    std::ostringstream text;
+    DEBUG_LOG(LOG_IOP, "[IOP Debug] ksprintf: %s\n", (char*)&IOP_RAM[msg_pointer]);
     while (IOP_RAM[msg_pointer])
     {
         char c = IOP_RAM[msg_pointer];
@@ -925,17 +1101,17 @@ void Emulator::iop_ksprintf()
                 case 's':
                 {
                     uint32_t str_pointer = *(uint32_t*)&IOP_RAM[arg_pointer];
-                    ee_log << (char*)&IOP_RAM[str_pointer];
+                    text << (char*)&IOP_RAM[str_pointer];
                 }
                     break;
                 case 'd':
-                    ee_log << *(int32_t*)&IOP_RAM[arg_pointer];
-                    printf("[IOP Debug] %d\n", *(uint32_t*)&IOP_RAM[arg_pointer]);
+                    text << *(int32_t*)&IOP_RAM[arg_pointer];
+                    DEBUG_LOG(LOG_IOP, "[IOP Debug] %d\n", *(uint32_t*)&IOP_RAM[arg_pointer]);
                     break;
                 case 'x':
                 case 'X':
-                    ee_log << std::hex << *(uint32_t*)&IOP_RAM[arg_pointer];
-                    printf("[IOP Debug] $%08X\n", *(uint32_t*)&IOP_RAM[arg_pointer]);
+                    text << std::hex << *(uint32_t*)&IOP_RAM[arg_pointer];
+                    DEBUG_LOG(LOG_IOP, "[IOP Debug] $%08X\n", *(uint32_t*)&IOP_RAM[arg_pointer]);
                     break;
                 default:
                     break;
@@ -943,8 +1119,8 @@ void Emulator::iop_ksprintf()
             arg_pointer += 4;
         }
         else
-            ee_log << c;
+            text << c;
         msg_pointer++;
     }
-    ee_log.flush();
+    console.write(text.str());
 }
@@ -1,6 +1,9 @@
 #ifndef EMULATOR_HPP
 #define EMULATOR_HPP
-#include <fstream>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
 
 #include "ee/bios_hle.hpp"
 #include "ee/dmac.hpp"
@@ -15,8 +18,11 @@
 #include "iop/iop_timers.hpp"
 #include "iop/sio2.hpp"
 
+#include "console.hpp"
 #include "gs.hpp"
 #include "gif.hpp"
+#include "mmio.hpp"
+#include "scheduler.hpp"
 #include "sif.hpp"
 
 enum SKIP_HACK
@@ -29,6 +35,15 @@ enum SKIP_HACK
 class Emulator
 {
     private:
+        //Constructed first so that the other components can register their events with it
+        Scheduler scheduler;
+
+        //The IOP side keeps its own timeline so that it can run on another thread. Both count EE cycles.
+        Scheduler iop_scheduler;
+
+        //Register dispatch for each CPU's physical address space
+        MMIOTable ee_mmio, iop_mmio;
+
         int frames;
         BIOS_HLE bios_hle;
         CDVD_Drive cdvd;
@@ -45,17 +60,39 @@ class Emulator
         SubsystemInterface sif;
         VectorUnit vu0, vu1;
 
-        std::ofstream ee_log;
+        //EE SIO and IOP ksprintf output
+        GuestConsole console;
         std::string ee_stdout;
 
         uint8_t* RDRAM;
         uint8_t* IOP_RAM;
         uint8_t* BIOS;
+        bool fastmem_memory;
 
         uint32_t MCH_RICM, MCH_DRD;
         uint8_t rdram_sdevid;
 
-        uint32_t instructions_run;
+        uint64_t frame_start;
+        int slice_cycles;
+        int iop_cycles;
+        bool frame_ended;
+
+        //Set when nothing can happen before the next event, so the next slice doesn't need to be cut short
+        bool idle_until_event;
+
+        int vblank_start_id, vblank_end_id, hblank_id;
+
+        //Threaded IOP state. Everything from ee_time down is guarded by iop_sync_mutex.
+        bool iop_threaded;
+        bool iop_thread_running;
+        int max_skew_cycles;
+        std::thread iop_thread;
+        std::mutex iop_sync_mutex;
+        std::condition_variable iop_sync_cond;
+        uint64_t ee_time, iop_time;
+        bool iop_thread_quit;
+        int iop_pause_requests;
+        bool iop_paused;
 
         uint8_t IOP_POST;
         uint32_t IOP_I_STAT;
@@ -68,6 +105,22 @@ class Emulator
         uint32_t ELF_size;
 
         void iop_IRQ_check(uint32_t new_stat, uint32_t new_mask);
+
+        void map_registers();
+        uint32_t read_MCH_DRD();
+
+        void vblank_start();
+        void vblank_end();
+        void hblank();
+
+        void run_iop(int cycles);
+        bool is_idle_until_event();
+        void iop_thread_loop();
+        void start_iop_thread();
+        void stop_iop_thread();
+        void pause_iop();
+        void resume_iop();
+        void sync_with_iop();
     public:
         Emulator();
         ~Emulator();
@@ -75,11 +128,26 @@ class Emulator
         void reset();
         bool skip_BIOS();
         void set_skip_BIOS_hack(SKIP_HACK type);
+        void set_ee_mode(CPU_MODE mode);
+        void enable_fastmem();
+        void set_slice_cycles(int cycles);
+        void set_iop_threaded(bool threaded);
+        void set_gs_threaded(bool threaded);
+        void set_gs_worker_count(int count);
+        void set_gs_jit(bool enabled);
+        int verify_gs_rasterizer(int count, uint32_t seed);
+        void set_dma_burst_length(int quadwords);
+        void set_idle_loop_detection(bool enabled);
+        void set_console_target(CONSOLE_TARGET target);
+        bool set_console_file(const char* name);
+        std::string read_console();
+        void print_idle_loop_stats();
         void load_BIOS(uint8_t* BIOS);
         void load_ELF(uint8_t* ELF, uint32_t size);
         bool load_CDVD(const char* name);
         void execute_ELF();
         uint32_t* get_framebuffer();
+        uint64_t get_cycles();
         void get_resolution(int& w, int& h);
         void get_inner_resolution(int& w, int& h);
 
@@ -87,10 +155,13 @@ class Emulator
         uint16_t read16(uint32_t address);
         uint32_t read32(uint32_t address);
         uint64_t read64(uint32_t address);
+        uint128_t read128(uint32_t address);
         void write8(uint32_t address, uint8_t value);
         void write16(uint32_t address, uint16_t value);
         void write32(uint32_t address, uint32_t value);
         void write64(uint32_t address, uint64_t value);
+        void write128(uint32_t address, uint128_t value);
+        bool is_pure_read(uint32_t address, int width);
 
         uint8_t iop_read8(uint32_t address);
         uint16_t iop_read16(uint32_t address);
@@ -98,6 +169,7 @@ class Emulator
         void iop_write8(uint32_t address, uint8_t value);
         void iop_write16(uint32_t address, uint16_t value);
         void iop_write32(uint32_t address, uint32_t value);
+        bool iop_is_pure_read(uint32_t address, int width);
 
         void iop_request_IRQ(int index);
         void iop_ksprintf();
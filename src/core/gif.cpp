@@ -1,6 +1,6 @@
-#include <cstdio>
 #include "gif.hpp"
 #include "gs.hpp"
+#include "logger.hpp"
 
 GraphicsInterface::GraphicsInterface(GraphicsSynthesizer *gs) : gs(gs)
 {
@@ -65,14 +65,14 @@ void GraphicsInterface::process_PACKED(uint64_t data[])
             //NOP
             break;
         default:
-            printf("\nUnrecognized PACKED reg $%02X", reg);
+            WARN_LOG(LOG_GIF, "Unrecognized PACKED reg $%02X\n", reg);
             break;
     }
 }
 
 void GraphicsInterface::feed_GIF(uint64_t data[])
 {
-    //printf("\n[GIF] $%08X_%08X_%08X_%08X", data[1] >> 32, data[1] & 0xFFFFFFFF, data[0] >> 32, data[0] & 0xFFFFFFFF);
+    //DEBUG_LOG(LOG_GIF, "[GIF] $%08X_%08X_%08X_%08X\n", data[1] >> 32, data[1] & 0xFFFFFFFF, data[0] >> 32, data[0] & 0xFFFFFFFF);
     if (!current_tag.data_left)
     {
         //Read the GIFtag
@@ -92,13 +92,13 @@ void GraphicsInterface::feed_GIF(uint64_t data[])
         //Q is initialized to 1.0 upon reading a GIFtag
         gs->set_Q(1.0f);
 
-        /*printf("\n[GIF] New primitive!");
-        printf("\nNLOOP: $%04X", current_tag.NLOOP);
-        printf("\nEOP: %d", current_tag.end_of_packet);
-        printf("\nOutput PRIM: %d PRIM: $%04X", current_tag.output_PRIM, current_tag.PRIM);
-        printf("\nFormat: %d", current_tag.format);
-        printf("\nReg count: %d", current_tag.reg_count);
-        printf("\nRegs: $%08X_$%08X", current_tag.regs >> 32, current_tag.regs & 0xFFFFFFFF);*/
+        /*DEBUG_LOG(LOG_GIF, "[GIF] New primitive!\n");
+        DEBUG_LOG(LOG_GIF, "NLOOP: $%04X\n", current_tag.NLOOP);
+        DEBUG_LOG(LOG_GIF, "EOP: %d\n", current_tag.end_of_packet);
+        DEBUG_LOG(LOG_GIF, "Output PRIM: %d PRIM: $%04X\n", current_tag.output_PRIM, current_tag.PRIM);
+        DEBUG_LOG(LOG_GIF, "Format: %d\n", current_tag.format);
+        DEBUG_LOG(LOG_GIF, "Reg count: %d\n", current_tag.reg_count);
+        DEBUG_LOG(LOG_GIF, "Regs: $%08X_$%08X\n", current_tag.regs >> 32, current_tag.regs & 0xFFFFFFFF);*/
 
         if (current_tag.output_PRIM)
             gs->write64(0, current_tag.PRIM);
@@ -127,14 +127,14 @@ void GraphicsInterface::feed_GIF(uint64_t data[])
                 current_tag.data_left--;
                 break;
             default:
-                printf("\n[GS] Unrecognized GIFtag format %d", current_tag.format);
+                WARN_LOG(LOG_GIF, "[GS] Unrecognized GIFtag format %d\n", current_tag.format);
                 break;
         }
 
     }
 }
 
-void GraphicsInterface::send_PATH3(uint64_t data[])
+void GraphicsInterface::send_PATH3(uint128_t data)
 {
-    feed_GIF(data);
+    feed_GIF(data._u64);
 }
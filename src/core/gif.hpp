@@ -1,6 +1,7 @@
 #ifndef GIF_HPP
 #define GIF_HPP
 #include <cstdint>
+#include "int128.hpp"
 
 class GraphicsSynthesizer;
 
@@ -30,7 +31,7 @@ class GraphicsInterface
     public:
         GraphicsInterface(GraphicsSynthesizer* gs);
         void reset();
-        void send_PATH3(uint64_t data[2]);
+        void send_PATH3(uint128_t data);
 };
 
 #endif // GIF_HPP
@@ -1,10 +1,11 @@
 #include <algorithm>
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include "ee/intc.hpp"
 
 #include "gs.hpp"
+#include "logger.hpp"
+#include "mmio.hpp"
 using namespace std;
 
 /**
@@ -42,10 +43,19 @@ GraphicsSynthesizer::GraphicsSynthesizer(INTC* intc) : intc(intc)
     frame_complete = false;
     output_buffer = nullptr;
     local_mem = nullptr;
+    thread_running = false;
+    thread_idle = false;
+    worker_count = 1;
+    workers_busy = 0;
+    workers_quit = false;
+    worker_generation = 0;
+    jit_enabled = false;
 }
 
 GraphicsSynthesizer::~GraphicsSynthesizer()
 {
+    stop_thread();
+    set_worker_count(1);
     if (local_mem)
         delete[] local_mem;
     if (output_buffer)
@@ -54,8 +64,11 @@ GraphicsSynthesizer::~GraphicsSynthesizer()
 
 void GraphicsSynthesizer::reset()
 {
+    wait_for_thread();
+    flush_triangles();
+    //Pixel groups are read and written whole, so a group starting in the last few words may go a little past the end
     if (!local_mem)
-        local_mem = new uint32_t[1024 * 1024];
+        local_mem = new uint32_t[GS_MEM_WORDS + 3];
     if (!output_buffer)
         output_buffer = new uint32_t[640 * 448];
     pixels_transferred = 0;
@@ -72,11 +85,135 @@ void GraphicsSynthesizer::reset()
     context1.reset();
     context2.reset();
     current_ctx = &context1;
+    PRIM.alpha_blend = false;
+    update_pipelines();
     VBLANK_enabled = false;
     VBLANK_generated = false;
     set_CRT(false, 0x2, false);
 }
 
+//Everything in $12xxxxxx goes to the privileged registers
+void GraphicsSynthesizer::map_registers(MMIOTable* mmio)
+{
+    mmio->map_read_range(0x12000000, 0x13000000, 4,
+                         [this] (uint32_t addr) { return read32_privileged(addr); }, true);
+    mmio->map_read_range(0x12000000, 0x13000000, 8,
+                         [this] (uint32_t addr) { return read64_privileged(addr); }, true);
+    mmio->map_write_range(0x12000000, 0x13000000, 4,
+                          [this] (uint32_t addr, uint64_t value) { write32_privileged(addr, value); });
+    mmio->map_write_range(0x12000000, 0x13000000, 8,
+                          [this] (uint32_t addr, uint64_t value) { write64_privileged(addr, value); });
+}
+
+void GraphicsSynthesizer::set_threaded(bool threaded)
+{
+    if (threaded)
+        start_thread();
+    else
+        stop_thread();
+}
+
+void GraphicsSynthesizer::start_thread()
+{
+    if (thread_running)
+        return;
+    thread_quit = false;
+    thread_idle = false;
+    thread_running = true;
+    thread = std::thread(&GraphicsSynthesizer::thread_loop, this);
+}
+
+void GraphicsSynthesizer::stop_thread()
+{
+    if (!thread_running)
+        return;
+    wait_for_thread();
+    {
+        std::lock_guard<std::mutex> lock(thread_lock);
+        thread_quit = true;
+        thread_cond.notify_all();
+    }
+    thread.join();
+    thread_running = false;
+}
+
+void GraphicsSynthesizer::thread_loop()
+{
+    uint32_t words[COMMAND_WORDS];
+    while (true)
+    {
+        if (commands.size() < COMMAND_WORDS)
+        {
+            //Out of work. Whoever pushes next sees thread_idle and wakes us up.
+            flush_triangles();
+            std::unique_lock<std::mutex> lock(thread_lock);
+            thread_idle = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            thread_cond.notify_all();
+            thread_cond.wait(lock, [this] { return thread_quit || commands.size() >= COMMAND_WORDS; });
+            thread_idle = false;
+            if (thread_quit)
+                return;
+            continue;
+        }
+        commands.pop_n(words, COMMAND_WORDS);
+        process_command(words);
+    }
+}
+
+//Blocks until the GS thread has run everything queued so far
+void GraphicsSynthesizer::wait_for_thread()
+{
+    if (!thread_running)
+        return;
+    std::unique_lock<std::mutex> lock(thread_lock);
+    thread_cond.wait(lock, [this] { return thread_idle && !commands.size(); });
+}
+
+void GraphicsSynthesizer::push_command(GS_COMMAND type, uint32_t addr, uint64_t value)
+{
+    while (commands.free_space() < COMMAND_WORDS)
+        this_thread::yield();
+
+    uint32_t words[COMMAND_WORDS];
+    words[0] = type;
+    words[1] = addr;
+    words[2] = value & 0xFFFFFFFF;
+    words[3] = value >> 32;
+    commands.push_n(words, COMMAND_WORDS);
+
+    //Pairs with the fence in thread_loop, so that either we see the thread going idle or it sees the new command
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (thread_idle.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(thread_lock);
+        thread_cond.notify_all();
+    }
+}
+
+void GraphicsSynthesizer::process_command(const uint32_t* words)
+{
+    uint64_t value = words[2] | ((uint64_t)words[3] << 32);
+    switch (words[0])
+    {
+        case GS_WRITE64:
+            process_write64(words[1], value);
+            break;
+        case GS_SET_RGBA:
+            RGBAQ.r = value & 0xFF;
+            RGBAQ.g = (value >> 8) & 0xFF;
+            RGBAQ.b = (value >> 16) & 0xFF;
+            RGBAQ.a = (value >> 24) & 0xFF;
+            break;
+        case GS_SET_Q:
+            memcpy(&RGBAQ.q, &words[2], sizeof(float));
+            break;
+        case GS_SET_XYZ:
+            process_XYZ(value & 0xFFFF, (value >> 16) & 0xFFFF, value >> 32, words[1]);
+            break;
+    }
+}
+
 void GraphicsSynthesizer::start_frame()
 {
     frame_complete = false;
@@ -103,12 +240,12 @@ void GraphicsSynthesizer::set_VBLANK(bool is_VBLANK)
 {
     if (is_VBLANK)
     {
-        printf("[GS] VBLANK start\n");
+        DEBUG_LOG(LOG_GS, "[GS] VBLANK start\n");
         intc->assert_IRQ(2);
     }
     else
     {
-        printf("[GS] VBLANK end\n");
+        DEBUG_LOG(LOG_GS, "[GS] VBLANK end\n");
         intc->assert_IRQ(3);
     }
     VBLANK_generated = is_VBLANK;
@@ -116,7 +253,10 @@ void GraphicsSynthesizer::set_VBLANK(bool is_VBLANK)
 
 void GraphicsSynthesizer::render_CRT()
 {
-    printf("DISPLAY2: (%d, %d) wh: (%d, %d)\n", DISPLAY2.x >> 2, DISPLAY2.y, DISPLAY2.width >> 2, DISPLAY2.height);
+    wait_for_thread();
+    flush_triangles();
+    DEBUG_LOG(LOG_GS, "DISPLAY2: (%d, %d) wh: (%d, %d)\n", DISPLAY2.x >> 2, DISPLAY2.y, DISPLAY2.width >> 2,
+              DISPLAY2.height);
     int width = DISPLAY2.width >> 2;
     for (int y = 0; y < DISPLAY2.height; y++)
     {
@@ -174,7 +314,7 @@ uint32_t GraphicsSynthesizer::read32_privileged(uint32_t addr)
             return reg;
         }
         default:
-            printf("[GS] Unrecognized privileged read32 from $%04X\n", addr);
+            WARN_LOG(LOG_GS, "[GS] Unrecognized privileged read32 from $%04X\n", addr);
             return 0;
     }
 }
@@ -191,7 +331,7 @@ uint64_t GraphicsSynthesizer::read64_privileged(uint32_t addr)
             return reg;
         }
         default:
-            printf("[GS] Unrecognized privileged read64 from $%04X\n", addr);
+            WARN_LOG(LOG_GS, "[GS] Unrecognized privileged read64 from $%04X\n", addr);
             return 0;
     }
 }
@@ -202,13 +342,13 @@ void GraphicsSynthesizer::write32_privileged(uint32_t addr, uint32_t value)
     switch (addr)
     {
         case 0x0070:
-            printf("[GS] Write DISPFB1: $%08X\n", value);
+            DEBUG_LOG(LOG_GS, "[GS] Write DISPFB1: $%08X\n", value);
             DISPFB1.frame_base = (value & 0x3FF) * 2048;
             DISPFB1.width = ((value >> 9) & 0x3F) * 64;
             DISPFB1.format = (value >> 14) & 0x1F;
             break;
         case 0x1000:
-            printf("[GS] Write32 to GS_CSR: $%08X\n", value);
+            DEBUG_LOG(LOG_GS, "[GS] Write32 to GS_CSR: $%08X\n", value);
             if (value & 0x8)
             {
                 VBLANK_enabled = true;
@@ -216,7 +356,7 @@ void GraphicsSynthesizer::write32_privileged(uint32_t addr, uint32_t value)
             }
             break;
         default:
-            printf("\n[GS] Unrecognized privileged write32 to reg $%04X: $%08X", addr, value);
+            WARN_LOG(LOG_GS, "[GS] Unrecognized privileged write32 to reg $%04X: $%08X\n", addr, value);
     }
 }
 
@@ -226,7 +366,7 @@ void GraphicsSynthesizer::write64_privileged(uint32_t addr, uint64_t value)
     switch (addr)
     {
         case 0x0000:
-            printf("[GS] Write PMODE: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
+            DEBUG_LOG(LOG_GS, "[GS] Write PMODE: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
             PMODE.circuit1 = value & 0x1;
             PMODE.circuit2 = value & 0x2;
             PMODE.output_switching = (value >> 2) & 0x7;
@@ -236,13 +376,13 @@ void GraphicsSynthesizer::write64_privileged(uint32_t addr, uint64_t value)
             PMODE.ALP = (value >> 8) & 0xFF;
             break;
         case 0x0020:
-            printf("[GS] Write SMODE2: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
+            DEBUG_LOG(LOG_GS, "[GS] Write SMODE2: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
             SMODE2.interlaced = value & 0x1;
             SMODE2.frame_mode = value & 0x2;
             SMODE2.power_mode = (value >> 2) & 0x3;
             break;
         case 0x0070:
-            printf("[GS] Write DISPFB1: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
+            DEBUG_LOG(LOG_GS, "[GS] Write DISPFB1: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
             DISPFB1.frame_base = (value & 0x3FF) * 2048;
             DISPFB1.width = ((value >> 9) & 0x3F) * 64;
             DISPFB1.format = (value >> 14) & 0x1F;
@@ -250,7 +390,7 @@ void GraphicsSynthesizer::write64_privileged(uint32_t addr, uint64_t value)
             DISPFB1.y = (value >> 43) & 0x7FF;
             break;
         case 0x0080:
-            printf("[GS] Write DISPLAY1: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
+            DEBUG_LOG(LOG_GS, "[GS] Write DISPLAY1: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
             DISPLAY1.x = value & 0xFFF;
             DISPLAY1.y = (value >> 12) & 0x7FF;
             DISPLAY1.magnify_x = (value >> 23) & 0xF;
@@ -258,7 +398,7 @@ void GraphicsSynthesizer::write64_privileged(uint32_t addr, uint64_t value)
             DISPLAY1.width = ((value >> 32) & 0xFFF) + 1;
             DISPLAY1.height = ((value >> 44) & 0x7FF) + 1;
         case 0x0090:
-            printf("[GS] Write DISPFB2: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
+            DEBUG_LOG(LOG_GS, "[GS] Write DISPFB2: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
             DISPFB2.frame_base = (value & 0x3FF) * 2048;
             DISPFB2.width = ((value >> 9) & 0x3F) * 64;
             DISPFB2.format = (value >> 14) & 0x1F;
@@ -266,7 +406,7 @@ void GraphicsSynthesizer::write64_privileged(uint32_t addr, uint64_t value)
             DISPFB2.y = (value >> 43) & 0x7FF;
             break;
         case 0x00A0:
-            printf("[GS] Write DISPLAY2: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
+            DEBUG_LOG(LOG_GS, "[GS] Write DISPLAY2: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
             DISPLAY2.x = value & 0xFFF;
             DISPLAY2.y = (value >> 12) & 0x7FF;
             DISPLAY2.magnify_x = (value >> 23) & 0xF;
@@ -275,7 +415,7 @@ void GraphicsSynthesizer::write64_privileged(uint32_t addr, uint64_t value)
             DISPLAY2.height = ((value >> 44) & 0x7FF) + 1;
             break;
         case 0x1000:
-            printf("[GS] Write64 to GS_CSR: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
+            DEBUG_LOG(LOG_GS, "[GS] Write64 to GS_CSR: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
             if (value & 0x8)
             {
                 VBLANK_enabled = true;
@@ -283,13 +423,70 @@ void GraphicsSynthesizer::write64_privileged(uint32_t addr, uint64_t value)
             }
             break;
         default:
-            printf("[GS] Unrecognized privileged write64 to reg $%04X: $%08X_%08X\n", addr, value >> 32, value & 0xFFFFFFFF);
+            WARN_LOG(LOG_GS, "[GS] Unrecognized privileged write64 to reg $%04X: $%08X_%08X\n", addr, value >> 32,
+                     value & 0xFFFFFFFF);
     }
 }
 
 void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
+{
+    if (thread_running)
+        push_command(GS_WRITE64, addr, value);
+    else
+        process_write64(addr, value);
+}
+
+void GraphicsSynthesizer::set_RGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    if (thread_running)
+    {
+        push_command(GS_SET_RGBA, 0, r | (g << 8) | (b << 16) | ((uint32_t)a << 24));
+        return;
+    }
+    RGBAQ.r = r;
+    RGBAQ.g = g;
+    RGBAQ.b = b;
+    RGBAQ.a = a;
+}
+
+void GraphicsSynthesizer::set_Q(float q)
+{
+    if (thread_running)
+    {
+        uint32_t bits;
+        memcpy(&bits, &q, sizeof(float));
+        push_command(GS_SET_Q, 0, bits);
+        return;
+    }
+    RGBAQ.q = q;
+}
+
+void GraphicsSynthesizer::set_XYZ(uint32_t x, uint32_t y, uint32_t z, bool drawing_kick)
+{
+    if (thread_running)
+        push_command(GS_SET_XYZ, drawing_kick, x | (y << 16) | ((uint64_t)z << 32));
+    else
+        process_XYZ(x, y, z, drawing_kick);
+}
+
+void GraphicsSynthesizer::process_write64(uint32_t addr, uint64_t value)
 {
     addr &= 0xFFFF;
+
+    //Binned triangles keep their own vertices and PRIM settings, but anything else can change how they're drawn
+    //or touch what they draw to
+    switch (addr)
+    {
+        case 0x0000:
+        case 0x0001:
+        case 0x0003:
+        case 0x0005:
+        case 0x000D:
+            break;
+        default:
+            flush_triangles();
+    }
+
     switch (addr)
     {
         case 0x0000:
@@ -306,6 +503,7 @@ void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
             else
                 current_ctx = &context1;
             PRIM.fix_fragment_value = value & (1 << 10);
+            current_pipeline = pipelines[PRIM.use_context2][PRIM.alpha_blend];
             num_vertices = 0;
             break;
         case 0x0001:
@@ -318,7 +516,7 @@ void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
         case 0x0003:
             UV.u = value & 0x3FFF;
             UV.v = (value >> 16) & 0x3FFF;
-            printf("UV: ($%04X, $%04X)\n", UV.u, UV.v);
+            DEBUG_LOG(LOG_GS, "UV: ($%04X, $%04X)\n", UV.u, UV.v);
             break;
         case 0x0005:
             //XYZ2
@@ -350,7 +548,7 @@ void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
             use_PRIM = value & 0x1;
             break;
         case 0x003F:
-            printf("TEXFLUSH\n");
+            DEBUG_LOG(LOG_GS, "TEXFLUSH\n");
             break;
         case 0x0040:
             context1.set_scissor(value);
@@ -360,9 +558,11 @@ void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
             break;
         case 0x0042:
             context1.set_alpha(value);
+            update_pipelines();
             break;
         case 0x0043:
             context2.set_alpha(value);
+            update_pipelines();
             break;
         case 0x0045:
             DTHE = value & 0x1;
@@ -372,21 +572,27 @@ void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
             break;
         case 0x0047:
             context1.set_test(value);
+            update_pipelines();
             break;
         case 0x0048:
             context2.set_test(value);
+            update_pipelines();
             break;
         case 0x004C:
             context1.set_frame(value);
+            update_pipelines();
             break;
         case 0x004D:
             context2.set_frame(value);
+            update_pipelines();
             break;
         case 0x004E:
             context1.set_zbuf(value);
+            update_pipelines();
             break;
         case 0x004F:
             context2.set_zbuf(value);
+            update_pipelines();
             break;
         case 0x0050:
             BITBLTBUF.source_base = (value & 0x3FFF) * 64;
@@ -402,12 +608,12 @@ void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
             TRXPOS.dest_x = (value >> 32) & 0x7FF;
             TRXPOS.dest_y = (value >> 48) & 0x7FF;
             TRXPOS.trans_order = (value >> 59) & 0x3;
-            printf("TRXPOS: $%08X_%08X\n", value >> 32, value);
+            DEBUG_LOG(LOG_GS, "TRXPOS: $%08X_%08X\n", value >> 32, value);
             break;
         case 0x0052:
             TRXREG.width = value & 0xFFF;
             TRXREG.height = (value >> 32) & 0xFFF;
-            printf("TRXREG (%d, %d)\n", TRXREG.width, TRXREG.height);
+            DEBUG_LOG(LOG_GS, "TRXREG (%d, %d)\n", TRXREG.width, TRXREG.height);
             break;
         case 0x0053:
             TRXDIR = value & 0x3;
@@ -416,11 +622,11 @@ void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
             {
                 pixels_transferred = 0;
                 transfer_addr = BITBLTBUF.dest_base + (TRXPOS.dest_x + (TRXPOS.dest_y * BITBLTBUF.dest_width));
-                printf("Transfer started!\n");
-                printf("Dest base: $%08X\n", BITBLTBUF.dest_base);
-                printf("TRXPOS: (%d, %d)\n", TRXPOS.dest_x, TRXPOS.dest_y);
-                printf("Width: %d\n", BITBLTBUF.dest_width);
-                printf("Transfer addr: $%08X\n", transfer_addr);
+                DEBUG_LOG(LOG_GS, "Transfer started!\n");
+                DEBUG_LOG(LOG_GS, "Dest base: $%08X\n", BITBLTBUF.dest_base);
+                DEBUG_LOG(LOG_GS, "TRXPOS: (%d, %d)\n", TRXPOS.dest_x, TRXPOS.dest_y);
+                DEBUG_LOG(LOG_GS, "Width: %d\n", BITBLTBUF.dest_width);
+                DEBUG_LOG(LOG_GS, "Transfer addr: $%08X\n", transfer_addr);
                 if (TRXDIR == 2)
                 {
                     //VRAM-to-VRAM transfer
@@ -434,25 +640,13 @@ void GraphicsSynthesizer::write64(uint32_t addr, uint64_t value)
                 write_HWREG(value);
             break;
         default:
-            printf("\n[GS] Unrecognized write64 to reg $%04X: $%08X_%08X", addr, value >> 32, value & 0xFFFFFFFF);
+            WARN_LOG(LOG_GS, "[GS] Unrecognized write64 to reg $%04X: $%08X_%08X\n", addr, value >> 32,
+                     value & 0xFFFFFFFF);
             //exit(1);
     }
 }
 
-void GraphicsSynthesizer::set_RGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
-{
-    RGBAQ.r = r;
-    RGBAQ.g = g;
-    RGBAQ.b = b;
-    RGBAQ.a = a;
-}
-
-void GraphicsSynthesizer::set_Q(float q)
-{
-    RGBAQ.q = q;
-}
-
-void GraphicsSynthesizer::set_XYZ(uint32_t x, uint32_t y, uint32_t z, bool drawing_kick)
+void GraphicsSynthesizer::process_XYZ(uint32_t x, uint32_t y, uint32_t z, bool drawing_kick)
 {
     current_vtx.coords[0] = x;
     current_vtx.coords[1] = y;
@@ -507,7 +701,7 @@ void GraphicsSynthesizer::vertex_kick(bool drawing_kick)
             }
             break;
         default:
-            printf("\n[GS] Unrecognized primitive %d\n", PRIM.prim_type);
+            ERROR_LOG(LOG_GS, "[GS] Unrecognized primitive %d\n", PRIM.prim_type);
             exit(1);
     }
     if (drawing_kick && request_draw_kick)
@@ -536,196 +730,330 @@ void GraphicsSynthesizer::render_primitive()
     }
 }
 
-void GraphicsSynthesizer::draw_pixel(int32_t x, int32_t y, uint32_t color, uint32_t z, bool alpha_blending)
+//Draws a single pixel of a point, line, or sprite, in 12.4 fixed point
+void GraphicsSynthesizer::draw_pixel(int32_t x, int32_t y, uint32_t color, uint32_t z)
 {
     SCISSOR* s = &current_ctx->scissor;
     if (x < s->x1 || x > s->x2 || y < s->y1 || y > s->y2)
         return;
-    TEST* test = &current_ctx->test;
+    uint32_t pos = (x >> 4) + ((y >> 4) * current_ctx->frame.width);
+    (this->*current_pipeline->pixel)(current_ctx, pos, color, z);
+}
+
+/**
+ * The pixel pipeline, specialised on the state that decides which of its stages run. Which variant to use is worked
+ * out by update_pipelines whenever that state changes, so none of it is decoded per pixel.
+ * DEPTH_METHOD is that of TEST, with 1 (PASS) also standing for no depth test at all.
+ */
+template <bool ALPHA_TEST, int DEPTH_METHOD, bool ALPHA_BLEND, bool UPDATE_Z>
+void GraphicsSynthesizer::shade_pixel(GSContext* ctx, uint32_t pos, uint32_t color, uint32_t z)
+{
+    //FAIL
+    if (DEPTH_METHOD == 0)
+        return;
+
     bool update_frame = true;
     bool update_alpha = true;
-    bool update_z = !current_ctx->zbuf.no_update;
-    if (test->alpha_test)
+    bool update_z = UPDATE_Z;
+    if (ALPHA_TEST && !ctx->test.alpha_pass[color >> 24])
     {
-        bool fail = false;
-        uint8_t alpha = color >> 24;
-        switch (test->alpha_method)
+        switch (ctx->test.alpha_fail_method)
         {
-            case 0: //NEVER
-                fail = true;
-                break;
-            case 1: //ALWAYS
-                break;
-            case 2: //LESS
-                if (alpha >= test->alpha_ref)
-                    fail = true;
-                break;
-            case 3: //LEQUAL
-                if (alpha > test->alpha_ref)
-                    fail = true;
-                break;
-            case 4: //EQUAL
-                if (alpha != test->alpha_ref)
-                    fail = true;
-                break;
-            case 5: //GEQUAL
-                if (alpha < test->alpha_ref)
-                    fail = true;
+            case 0: //KEEP - Update nothing
+                return;
+            case 1: //FB_ONLY - Only update framebuffer
+                update_z = false;
                 break;
-            case 6: //GREATER
-                if (alpha <= test->alpha_ref)
-                    fail = true;
+            case 2: //ZB_ONLY - Only update z-buffer
+                update_frame = false;
                 break;
-            case 7: //NOTEQUAL
-                if (alpha == test->alpha_ref)
-                    fail = true;
+            case 3: //RGB_ONLY - Same as FB_ONLY, but ignore alpha
+                update_z = false;
+                update_alpha = false;
                 break;
         }
-        if (fail)
+    }
+
+    if (DEPTH_METHOD == 2) //GEQUAL
+    {
+        if (z < local_mem[ctx->zbuf.base_pointer + pos])
+            return;
+    }
+    else if (DEPTH_METHOD == 3) //GREATER
+    {
+        if (z <= local_mem[ctx->zbuf.base_pointer + pos])
+            return;
+    }
+
+    uint32_t* frame = &local_mem[ctx->frame.base_pointer + pos];
+    if (ALPHA_BLEND)
+    {
+        //Each of A, B, and D picks one of these colors, and C one of these alphas
+        uint32_t frame_color = *frame;
+        uint32_t colors[4] = {color, frame_color, 0, 0};
+        uint32_t alphas[4] = {color >> 24, frame_color >> 24, ctx->alpha.fixed_alpha, ctx->alpha.fixed_alpha};
+
+        uint32_t color1 = colors[ctx->alpha.spec_A];
+        uint32_t color2 = colors[ctx->alpha.spec_B];
+        uint32_t color3 = colors[ctx->alpha.spec_D];
+        uint32_t alpha = alphas[ctx->alpha.spec_C];
+
+        uint8_t r1 = (color1 >> 16) & 0xFF;
+        uint8_t g1 = (color1 >> 8) & 0xFF;
+        uint8_t b1 = color1 & 0xFF;
+        uint8_t r2 = (color2 >> 16) & 0xFF;
+        uint8_t g2 = (color2 >> 8) & 0xFF;
+        uint8_t b2 = color2 & 0xFF;
+        uint8_t cr = (color3 >> 16) & 0xFF;
+        uint8_t cg = (color3 >> 8) & 0xFF;
+        uint8_t cb = color3 & 0xFF;
+
+        uint32_t final_color = 0;
+        final_color |= alpha << 24;
+        final_color |= ((((r1 - r2) * alpha) >> 7) + cr) << 16;
+        final_color |= ((((g1 - g2) * alpha) >> 7) + cg) << 8;
+        final_color |= (((b1 - b2) * alpha) >> 7) + cb;
+        color = final_color;
+    }
+    if (update_frame)
+    {
+        uint8_t alpha = *frame >> 24;
+        if (update_alpha)
+            alpha = color >> 24;
+        color &= 0x00FFFFFF;
+        *frame = color | (alpha << 24);
+    }
+    if (update_z)
+        local_mem[ctx->zbuf.base_pointer + pos] = z;
+}
+
+#ifdef GS_SSE
+//Lanes whose bit is set in mask are all ones
+static inline __m128i lane_mask(int mask)
+{
+    const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+    return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask), bits), bits);
+}
+
+static inline __m128i select_lanes(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+//One channel of the blend, shifted back into place. Like shade_pixel, the product is unsigned and nothing is clamped,
+//so out of range channels spill into their neighbours the same way.
+static inline __m128i blend_channel(__m128i a, __m128i b, __m128i d, __m128i alpha, int shift)
+{
+    const __m128i byte = _mm_set1_epi32(0xFF);
+    __m128i count = _mm_cvtsi32_si128(shift);
+    __m128i diff = _mm_sub_epi32(_mm_and_si128(_mm_srl_epi32(a, count), byte),
+                                 _mm_and_si128(_mm_srl_epi32(b, count), byte));
+    //alpha has nothing in its upper halves, so this is a full 32-bit multiply of the difference and alpha
+    __m128i value = _mm_srli_epi32(_mm_madd_epi16(diff, alpha), 7);
+    value = _mm_add_epi32(value, _mm_and_si128(_mm_srl_epi32(d, count), byte));
+    return _mm_sll_epi32(value, count);
+}
+#endif
+
+/**
+ * Draws the covered pixels of a group from a triangle. With SSE, the whole group goes through the pipeline at once,
+ * with each test narrowing down which lanes get written, and the buffers are written back four pixels at a time.
+ * That reads and rewrites the pixels not being drawn too, so buffers overlapping by less than a group go through
+ * shade_pixel instead.
+ */
+template <bool ALPHA_TEST, int DEPTH_METHOD, bool ALPHA_BLEND, bool UPDATE_Z>
+void GraphicsSynthesizer::shade_span(const Triangle& tri, int32_t x, int32_t y, const PixelGroup& group)
+{
+    //FAIL
+    if (DEPTH_METHOD == 0)
+        return;
+
+    GSContext* ctx = tri.ctx;
+    uint32_t pos = x + y * ctx->frame.width;
+#ifdef GS_SSE
+    uint32_t frame_addr = ctx->frame.base_pointer + pos;
+    uint32_t z_addr = ctx->zbuf.base_pointer + pos;
+    int32_t overlap = (int32_t)(frame_addr - z_addr);
+    if (!overlap || abs(overlap) >= 4)
+    {
+        uint32_t* frame = &local_mem[frame_addr];
+        uint32_t* zbuf = &local_mem[z_addr];
+        __m128i color = _mm_loadu_si128((const __m128i*)group.color);
+        __m128i z = _mm_loadu_si128((const __m128i*)group.z);
+
+        __m128i covered = lane_mask(group.mask);
+        __m128i write_frame = covered;
+        __m128i write_z = UPDATE_Z ? covered : _mm_setzero_si128();
+        __m128i keep_alpha = _mm_setzero_si128();
+        if (ALPHA_TEST)
         {
-            switch (test->alpha_fail_method)
+            //The test is a table lookup, so it's done a lane at a time
+            int pass = 0;
+            for (int i = 0; i < 4; i++)
+                pass |= ctx->test.alpha_pass[group.color[i] >> 24] << i;
+            __m128i passed = lane_mask(pass);
+            switch (ctx->test.alpha_fail_method)
             {
                 case 0: //KEEP - Update nothing
-                    return;
+                    write_frame = _mm_and_si128(write_frame, passed);
+                    write_z = _mm_and_si128(write_z, passed);
+                    break;
                 case 1: //FB_ONLY - Only update framebuffer
-                    update_z = false;
+                    write_z = _mm_and_si128(write_z, passed);
                     break;
                 case 2: //ZB_ONLY - Only update z-buffer
-                    update_frame = false;
+                    write_frame = _mm_and_si128(write_frame, passed);
                     break;
                 case 3: //RGB_ONLY - Same as FB_ONLY, but ignore alpha
-                    update_z = false;
-                    update_alpha = false;
+                    write_z = _mm_and_si128(write_z, passed);
+                    keep_alpha = _mm_andnot_si128(passed, covered);
                     break;
             }
         }
-    }
 
-    uint32_t pos = (x >> 4) + ((y >> 4) * current_ctx->frame.width);
-    uint32_t dest_z = local_mem[current_ctx->zbuf.base_pointer + pos];
-    if (test->depth_test)
-    {
-        switch (test->depth_method)
+        if (DEPTH_METHOD >= 2)
         {
-            case 0: //FAIL
-                return;
-            case 1: //PASS
-                break;
-            case 2: //GEQUAL
-                if (z < dest_z)
-                    return;
-                break;
-            case 3: //GREATER
-                if (z <= dest_z)
-                    return;
-                break;
+            //Z is unsigned, so flip the sign bits to use signed compares
+            const __m128i sign = _mm_set1_epi32(0x80000000);
+            __m128i new_z = _mm_xor_si128(z, sign);
+            __m128i old_z = _mm_xor_si128(_mm_loadu_si128((const __m128i*)zbuf), sign);
+            __m128i passed;
+            if (DEPTH_METHOD == 2) //GEQUAL
+                passed = _mm_andnot_si128(_mm_cmpgt_epi32(old_z, new_z), covered);
+            else //GREATER
+                passed = _mm_cmpgt_epi32(new_z, old_z);
+            write_frame = _mm_and_si128(write_frame, passed);
+            write_z = _mm_and_si128(write_z, passed);
         }
-    }
 
-    if (alpha_blending)
+        if (_mm_movemask_ps(_mm_castsi128_ps(write_frame)))
+        {
+            __m128i old_frame = _mm_loadu_si128((const __m128i*)frame);
+            if (ALPHA_BLEND)
+            {
+                //Each of A, B, and D picks one of these colors, and C one of these alphas
+                __m128i fixed_alpha = _mm_set1_epi32(ctx->alpha.fixed_alpha);
+                __m128i colors[4] = {color, old_frame, _mm_setzero_si128(), _mm_setzero_si128()};
+                __m128i alphas[4] = {_mm_srli_epi32(color, 24), _mm_srli_epi32(old_frame, 24), fixed_alpha,
+                                     fixed_alpha};
+                __m128i a = colors[ctx->alpha.spec_A];
+                __m128i b = colors[ctx->alpha.spec_B];
+                __m128i d = colors[ctx->alpha.spec_D];
+                __m128i alpha = alphas[ctx->alpha.spec_C];
+
+                color = _mm_slli_epi32(alpha, 24);
+                color = _mm_or_si128(color, blend_channel(a, b, d, alpha, 16));
+                color = _mm_or_si128(color, blend_channel(a, b, d, alpha, 8));
+                color = _mm_or_si128(color, blend_channel(a, b, d, alpha, 0));
+            }
+            const __m128i alpha_bits = _mm_set1_epi32(0xFF000000);
+            color = select_lanes(_mm_and_si128(keep_alpha, alpha_bits), old_frame, color);
+            _mm_storeu_si128((__m128i*)frame, select_lanes(write_frame, color, old_frame));
+        }
+        //Read back after the frame is written, in case both buffers are the same
+        if (UPDATE_Z && _mm_movemask_ps(_mm_castsi128_ps(write_z)))
+            _mm_storeu_si128((__m128i*)zbuf, select_lanes(write_z, z, _mm_loadu_si128((const __m128i*)zbuf)));
+        return;
+    }
+#endif
+    for (int i = 0; i < 4; i++)
     {
-        uint8_t r1, g1, b1;
-        uint8_t r2, g2, b2;
-        uint8_t cr, cg, cb;
-        uint32_t alpha;
+        if (!(group.mask & (1 << i)))
+            continue;
+        shade_pixel<ALPHA_TEST, DEPTH_METHOD, ALPHA_BLEND, UPDATE_Z>(ctx, pos + i, group.color[i], group.z[i]);
+    }
+}
 
-        uint32_t frame_color = local_mem[current_ctx->frame.base_pointer + pos];
+#define PIPELINE(test, depth, blend, z) \
+    {&GraphicsSynthesizer::shade_pixel<test, depth, blend, z>, &GraphicsSynthesizer::shade_span<test, depth, blend, z>}
+#define PIPELINES_Z(test, depth, blend) PIPELINE(test, depth, blend, false), PIPELINE(test, depth, blend, true)
+#define PIPELINES_BLEND(test, depth) PIPELINES_Z(test, depth, false), PIPELINES_Z(test, depth, true)
+#define PIPELINES_DEPTH(test) PIPELINES_BLEND(test, 0), PIPELINES_BLEND(test, 1), PIPELINES_BLEND(test, 2), \
+    PIPELINES_BLEND(test, 3)
 
-        switch (current_ctx->alpha.spec_A)
-        {
-            case 0:
-                r1 = (color >> 16) & 0xFF;
-                g1 = (color >> 8) & 0xFF;
-                b1 = color & 0xFF;
-                break;
-            case 1:
-                r1 = (frame_color >> 16) & 0xFF;
-                g1 = (frame_color >> 8) & 0xFF;
-                b1 = frame_color & 0xFF;
-                break;
-            case 2:
-            case 3:
-                r1 = 0;
-                g1 = 0;
-                b1 = 0;
-                break;
-        }
+//Indexed by ((alpha test * 4 + depth method) * 2 + alpha blend) * 2 + Z update
+const GraphicsSynthesizer::PixelPipeline GraphicsSynthesizer::pipeline_table[32] =
+{
+    PIPELINES_DEPTH(false),
+    PIPELINES_DEPTH(true)
+};
 
-        switch (current_ctx->alpha.spec_B)
-        {
-            case 0:
-                r2 = (color >> 16) & 0xFF;
-                g2 = (color >> 8) & 0xFF;
-                b2 = color & 0xFF;
-                break;
-            case 1:
-                r2 = (frame_color >> 16) & 0xFF;
-                g2 = (frame_color >> 8) & 0xFF;
-                b2 = frame_color & 0xFF;
-                break;
-            case 2:
-            case 3:
-                r2 = 0;
-                g2 = 0;
-                b2 = 0;
-                break;
-        }
+#undef PIPELINES_DEPTH
+#undef PIPELINES_BLEND
+#undef PIPELINES_Z
+#undef PIPELINE
 
-        switch (current_ctx->alpha.spec_C)
-        {
-            case 0:
-                alpha = color >> 24;
-                break;
-            case 1:
-                alpha = frame_color >> 24;
-                break;
-            case 2:
-            case 3:
-                alpha = current_ctx->alpha.fixed_alpha;
-                break;
-        }
+/**
+ * Picks the pipeline variants for both contexts' current state, then the one PRIM currently draws with. With the
+ * JIT on, this also fetches the generated span routines, which depend on ALPHA and the buffer addresses too.
+ */
+void GraphicsSynthesizer::update_pipelines()
+{
+    GSContext* contexts[2] = {&context1, &context2};
+    if (jit_enabled)
+        jit.prepare(4);
+    for (int i = 0; i < 2; i++)
+    {
+        TEST& test = contexts[i]->test;
+        ALPHA& alpha = contexts[i]->alpha;
+        bool alpha_test = test.alpha_test && test.alpha_method != 1;
+        int depth_method = test.depth_test ? test.depth_method : 1;
+        bool update_z = !contexts[i]->zbuf.no_update;
+
+        //Failing the alpha test with KEEP draws nothing, same as failing the depth test
+        if (alpha_test && test.alpha_method == 0 && test.alpha_fail_method == 0)
+            depth_method = 0;
 
-        switch (current_ctx->alpha.spec_D)
+        for (int blend = 0; blend < 2; blend++)
         {
-            case 0:
-                cr = (color >> 16) & 0xFF;
-                cg = (color >> 8) & 0xFF;
-                cb = color & 0xFF;
-                break;
-            case 1:
-                cr = (frame_color >> 16) & 0xFF;
-                cg = (frame_color >> 8) & 0xFF;
-                cb = frame_color & 0xFF;
-                break;
-            case 2:
-                cr = 0;
-                cg = 0;
-                cb = 0;
-                break;
-        }
+            int index = ((alpha_test * 4 + depth_method) * 2 + blend) * 2 + update_z;
+            pipelines[i][blend] = &pipeline_table[index];
+            if (!jit_enabled)
+                continue;
 
-        uint32_t final_color = 0;
-        final_color |= alpha << 24;
-        final_color |= ((((r1 - r2) * alpha) >> 7) + cr) << 16;
-        final_color |= ((((g1 - g2) * alpha) >> 7) + cg) << 8;
-        final_color |= (((b1 - b2) * alpha) >> 7) + cb;
-        color = final_color;
+            SpanState state;
+            state.alpha_test = alpha_test;
+            state.alpha_method = alpha_test ? test.alpha_method : 0;
+            state.alpha_ref = alpha_test ? test.alpha_ref : 0;
+            state.alpha_fail_method = alpha_test ? test.alpha_fail_method : 0;
+            state.depth_method = depth_method;
+            state.alpha_blend = blend;
+            state.spec_A = blend ? alpha.spec_A : 0;
+            state.spec_B = blend ? alpha.spec_B : 0;
+            state.spec_C = blend ? alpha.spec_C : 0;
+            state.spec_D = blend ? alpha.spec_D : 0;
+            state.fixed_alpha = (blend && alpha.spec_C >= 2) ? alpha.fixed_alpha : 0;
+            state.update_z = update_z;
+            state.frame_base = contexts[i]->frame.base_pointer;
+            state.zbuf_base = (update_z || depth_method >= 2) ? contexts[i]->zbuf.base_pointer : 0;
+            jit_spans[i][blend] = jit.get_span(state);
+        }
     }
-    if (update_frame)
+    current_pipeline = pipelines[current_ctx == &context2][PRIM.alpha_blend];
+}
+
+void GraphicsSynthesizer::draw_span_jit(const Triangle& tri, int32_t x, int32_t y, const PixelGroup& group)
+{
+    jit_spans[tri.ctx == &context2][tri.alpha_blend](local_mem, x + y * tri.ctx->frame.width, &group);
+}
+
+void GraphicsSynthesizer::set_jit(bool enabled)
+{
+    wait_for_thread();
+    flush_triangles();
+    if (enabled && !jit.is_available())
     {
-        uint8_t alpha = local_mem[current_ctx->frame.base_pointer + pos] >> 24;
-        if (update_alpha)
-            alpha = color >> 24;
-        color &= 0x00FFFFFF;
-        local_mem[current_ctx->frame.base_pointer + pos] = color | (alpha << 24);
+        WARN_LOG(LOG_GS, "[GS] Unable to allocate JIT cache, falling back to the template pipeline\n");
+        enabled = false;
     }
-    if (update_z)
-        local_mem[current_ctx->zbuf.base_pointer + pos] = z;
+    jit_enabled = enabled;
+    update_pipelines();
 }
 
 void GraphicsSynthesizer::render_point()
 {
-    printf("\n[GS] Rendering point!");
+    flush_triangles();
+    DEBUG_LOG(LOG_GS, "[GS] Rendering point!\n");
     uint32_t point[3];
     point[0] = vtx_queue[0].coords[0] - current_ctx->xyoffset.x;
     point[1] = vtx_queue[0].coords[1] - current_ctx->xyoffset.y;
@@ -736,13 +1064,14 @@ void GraphicsSynthesizer::render_point()
     color |= vtx_queue[0].rgbaq.r << 16;
     color |= vtx_queue[0].rgbaq.g << 8;
     color |= vtx_queue[0].rgbaq.b;
-    printf("\nCoords: (%d, %d, %d)", point[0] >> 4, point[1] >> 4, point[2]);
-    draw_pixel(point[0], point[1], color, point[2], PRIM.alpha_blend);
+    DEBUG_LOG(LOG_GS, "Coords: (%d, %d, %d)\n", point[0] >> 4, point[1] >> 4, point[2]);
+    draw_pixel(point[0], point[1], color, point[2]);
 }
 
 void GraphicsSynthesizer::render_line()
 {
-    printf("\n[GS] Rendering line!");
+    flush_triangles();
+    DEBUG_LOG(LOG_GS, "[GS] Rendering line!\n");
     int32_t x1, x2, y1, y2;
 
     int32_t u1, u2, v1, v2;
@@ -797,7 +1126,7 @@ void GraphicsSynthesizer::render_line()
         swap(a1, a2);
     }
 
-    printf("\nCoords: (%d, %d, %d) (%d, %d, %d)", x1 >> 4, y1 >> 4, z1, x2 >> 4, y2 >> 4, z2);
+    DEBUG_LOG(LOG_GS, "Coords: (%d, %d, %d) (%d, %d, %d)\n", x1 >> 4, y1 >> 4, z1, x2 >> 4, y2 >> 4, z2);
 
     for (int32_t x = x1; x < x2; x += 0x10)
     {
@@ -822,139 +1151,181 @@ void GraphicsSynthesizer::render_line()
             color = interpolated_color;
         }
         if (is_steep)
-            draw_pixel(y, x, color, z, PRIM.alpha_blend);
+            draw_pixel(y, x, color, z);
         else
-            draw_pixel(x, y, color, z, PRIM.alpha_blend);
+            draw_pixel(x, y, color, z);
     }
 }
 
 
-// Returns positive value if the points are in counter-clockwise order
-// 0 if they it's on the same line
-// Negative value if they are in a clockwise order
-// Basicly the cross product of (v2 - v1) and (v3 - v1) vectors
-int32_t GraphicsSynthesizer::orient2D(const Point &v1, const Point &v2, const Point &v3)
+/**
+ * Queues a triangle for the worker threads. Only the pixels inside the scissor can be drawn, so the bounding box is
+ * clipped to it and the triangle goes into the bin of every tile it touches. A tile is always drawn by one thread
+ * in queue order, so each pixel sees the same writes in the same order as when drawing serially.
+ */
+void GraphicsSynthesizer::bin_triangle(const Triangle& tri)
 {
-    return (v2.x - v1.x) * (v3.y - v1.y) - (v3.x - v1.x) * (v2.y - v1.y);
+    SCISSOR& s = tri.ctx->scissor;
+    int32_t min_x = max(tri.min_x, (int32_t)s.x1);
+    int32_t min_y = max(tri.min_y, (int32_t)s.y1);
+    int32_t max_x = min(tri.max_x, (int32_t)s.x2);
+    int32_t max_y = min(tri.max_y, (int32_t)s.y2);
+    if (min_x > max_x || min_y > max_y)
+        return;
+
+    if (!tiles_independent(tri.ctx))
+    {
+        flush_triangles();
+        draw_triangle(tri, tri.min_x, tri.min_y, tri.max_x, tri.max_y);
+        return;
+    }
+
+    //PRIM can switch contexts without a flush. Tiles only cover the same words of local memory when they share a
+    //context's buffer layout, so a batch never mixes the two.
+    if (triangle_batch.size() >= MAX_BATCH || (!triangle_batch.empty() && triangle_batch.back().ctx != tri.ctx))
+        flush_triangles();
+
+    uint32_t index = triangle_batch.size();
+    triangle_batch.push_back(tri);
+    for (int ty = min_y >> TILE_SHIFT; ty <= max_y >> TILE_SHIFT; ty++)
+    {
+        for (int tx = min_x >> TILE_SHIFT; tx <= max_x >> TILE_SHIFT; tx++)
+        {
+            vector<uint32_t>& bin = tile_bins[tx + ty * TILES_PER_ROW];
+            if (bin.empty())
+                used_tiles.push_back(tx + ty * TILES_PER_ROW);
+            bin.push_back(index);
+        }
+    }
 }
 
-void GraphicsSynthesizer::render_triangle()
+//Tiles can only be drawn in parallel if no two of them can touch the same word of local memory
+bool GraphicsSynthesizer::tiles_independent(GSContext* ctx)
 {
-    printf("[GS] Rendering triangle!\n");
-    uint32_t color = 0x00000000;
-    color |= vtx_queue[0].rgbaq.r;
-    color |= vtx_queue[0].rgbaq.g << 8;
-    color |= vtx_queue[0].rgbaq.b << 16;
-    color |= vtx_queue[0].rgbaq.a << 24;
+    SCISSOR& s = ctx->scissor;
+    FRAME& frame = ctx->frame;
+    ZBUF& zbuf = ctx->zbuf;
+
+    //Pixels past the frame width wrap around onto the next row
+    if ((uint32_t)(s.x2 >> 4) >= frame.width)
+        return false;
+
+    if ((ctx->test.depth_test || !zbuf.no_update) && frame.base_pointer != zbuf.base_pointer)
+    {
+        uint32_t size = frame.width * ((s.y2 >> 4) + 1);
+        uint32_t distance = (frame.base_pointer > zbuf.base_pointer) ? frame.base_pointer - zbuf.base_pointer
+                                                                     : zbuf.base_pointer - frame.base_pointer;
+        if (distance < size)
+            return false;
+    }
+    return true;
+}
+
+//Draws every binned triangle, spreading the tiles across the workers and the calling thread
+void GraphicsSynthesizer::flush_triangles()
+{
+    if (triangle_batch.empty())
+        return;
 
-    int32_t x1, x2, x3, y1, y2, y3, z1, z2, z3;
-    uint8_t r1, r2, r3, g1, g2, g3, b1, b2, b3, a1, a2, a3;
-    x1 = vtx_queue[2].coords[0] - current_ctx->xyoffset.x;
-    y1 = vtx_queue[2].coords[1] - current_ctx->xyoffset.y;
-    z1 = vtx_queue[2].coords[2];
-    x2 = vtx_queue[1].coords[0] - current_ctx->xyoffset.x;
-    y2 = vtx_queue[1].coords[1] - current_ctx->xyoffset.y;
-    z2 = vtx_queue[1].coords[2];
-    x3 = vtx_queue[0].coords[0] - current_ctx->xyoffset.x;
-    y3 = vtx_queue[0].coords[1] - current_ctx->xyoffset.y;
-    z3 = vtx_queue[0].coords[2];
-    r1 = vtx_queue[2].rgbaq.r;
-    g1 = vtx_queue[2].rgbaq.g;
-    b1 = vtx_queue[2].rgbaq.b;
-    a1 = vtx_queue[2].rgbaq.a;
-    r2 = vtx_queue[1].rgbaq.r;
-    g2 = vtx_queue[1].rgbaq.g;
-    b2 = vtx_queue[1].rgbaq.b;
-    a2 = vtx_queue[1].rgbaq.a;
-    r3 = vtx_queue[0].rgbaq.r;
-    g3 = vtx_queue[0].rgbaq.g;
-    b3 = vtx_queue[0].rgbaq.b;
-    a3 = vtx_queue[0].rgbaq.a;
-    Point v1(x1, y1, z1, r1, g1, b1, a1);
-    Point v2(x2, y2, z2, r2, g2, b2, a2);
-    Point v3(x3, y3, z3, r3, g3, b3, a3);
-
-    //The triangle rasterization code uses an approach with barycentric coordinates
-    //Clear explanation can be read below:
-    //https://fgiesen.wordpress.com/2013/02/06/the-barycentric-conspirac/
-
-    //Order by counter-clockwise winding order
-    if (orient2D(v1, v2, v3) < 0)
-        swap(v2, v3);
-
-    //Calculate bounding box of triangle
-    int32_t min_x = min({v1.x, v2.x, v3.x});
-    int32_t min_y = min({v1.y, v2.y, v3.y});
-    int32_t max_x = max({v1.x, v2.x, v3.x});
-    int32_t max_y = max({v1.y, v2.y, v3.y});
-
-    //Calculate incremental steps for the weights
-    //Reference: https://fgiesen.wordpress.com/2013/02/10/optimizing-the-basic-rasterizer/
-    int32_t A12 = v1.y - v2.y;
-    int32_t B12 = v2.x - v1.x;
-    int32_t A23 = v2.y - v3.y;
-    int32_t B23 = v3.x - v2.x;
-    int32_t A31 = v3.y - v1.y;
-    int32_t B31 = v1.x - v3.x;
-
-    Point min_corner(min_x, min_y);
-    int32_t w1_row = orient2D(v2, v3, min_corner);
-    int32_t w2_row = orient2D(v3, v1, min_corner);
-    int32_t w3_row = orient2D(v1, v2, min_corner);
-
-    //TODO: Parallelize this
-    //Iterate through pixels in bounds
-    for (int32_t y = min_y; y <= max_y; y++)
+    next_tile = 0;
     {
-        int32_t w1 = w1_row;
-        int32_t w2 = w2_row;
-        int32_t w3 = w3_row;
-        for (int32_t x = min_x; x <= max_x; x++)
+        std::lock_guard<std::mutex> lock(worker_lock);
+        workers_busy = workers.size();
+        worker_generation++;
+    }
+    worker_cond.notify_all();
+
+    draw_tiles();
+
+    {
+        std::unique_lock<std::mutex> lock(worker_lock);
+        worker_cond.wait(lock, [this] { return !workers_busy; });
+    }
+
+    for (unsigned int i = 0; i < used_tiles.size(); i++)
+        tile_bins[used_tiles[i]].clear();
+    used_tiles.clear();
+    triangle_batch.clear();
+}
+
+void GraphicsSynthesizer::draw_tiles()
+{
+    while (true)
+    {
+        unsigned int index = next_tile++;
+        if (index >= used_tiles.size())
+            return;
+
+        int tile = used_tiles[index];
+        int32_t tile_x1 = (tile % TILES_PER_ROW) << TILE_SHIFT;
+        int32_t tile_y1 = (tile / TILES_PER_ROW) << TILE_SHIFT;
+        int32_t tile_x2 = tile_x1 + (1 << TILE_SHIFT) - 1;
+        int32_t tile_y2 = tile_y1 + (1 << TILE_SHIFT) - 1;
+
+        vector<uint32_t>& bin = tile_bins[tile];
+        for (unsigned int i = 0; i < bin.size(); i++)
         {
-            //Is inside triangle?
-            if ((w1 | w2 | w3) >= 0)
-            {
-                //Interpolate Z
-                float z = (float) v1.z * w1 + (float) v2.z * w2 + (float) v3.z * w3;
-                z /= (float) (w1 + w2 + w3);
-                if (PRIM.gourand_shading)
-                {
-                    float r = (float) v1.r * w1 + (float) v2.r * w2 + (float) v3.r * w3;
-                    float g = (float) v1.g * w1 + (float) v2.g * w2 + (float) v3.g * w3;
-                    float b = (float) v1.b * w1 + (float) v2.b * w2 + (float) v3.b * w3;
-                    float a = (float) v1.a * w1 + (float) v2.a * w2 + (float) v3.a * w3;
-                    r /= (float) (w1 + w2 + w3);
-                    g /= (float) (w1 + w2 + w3);
-                    b /= (float) (w1 + w2 + w3);
-                    a /= (float) (w1 + w2 + w3);
-
-                    uint32_t interpolated_color = 0x0000000;
-                    interpolated_color |= ((uint8_t)r);
-                    interpolated_color |= ((uint8_t)g) << 8;
-                    interpolated_color |= ((uint8_t)b) << 16;
-                    interpolated_color |= ((uint8_t)a) << 24;
-                    draw_pixel(x, y, interpolated_color, (int32_t) z, PRIM.alpha_blend);
-                }
-                else
-                {
-                    draw_pixel(x, y, color, (int32_t) z, PRIM.alpha_blend);
-                }
-            }
-            //Horizontal step
-            w1 += A23;
-            w2 += A31;
-            w3 += A12;
+            const Triangle& tri = triangle_batch[bin[i]];
+            SCISSOR& s = tri.ctx->scissor;
+            int32_t min_x = max({tri.min_x, (int32_t)s.x1, tile_x1});
+            int32_t min_y = max({tri.min_y, (int32_t)s.y1, tile_y1});
+            int32_t max_x = min({tri.max_x, (int32_t)s.x2, tile_x2});
+            int32_t max_y = min({tri.max_y, (int32_t)s.y2, tile_y2});
+            if (min_x <= max_x && min_y <= max_y)
+                draw_triangle(tri, min_x, min_y, max_x, max_y);
         }
-        //Vertical step
-        w1_row += B23;
-        w2_row += B31;
-        w3_row += B12;
     }
 }
 
+void GraphicsSynthesizer::worker_loop()
+{
+    uint32_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(worker_lock);
+            worker_cond.wait(lock, [&] { return workers_quit || worker_generation != generation; });
+            if (workers_quit)
+                return;
+            generation = worker_generation;
+        }
+
+        draw_tiles();
+
+        std::lock_guard<std::mutex> lock(worker_lock);
+        workers_busy--;
+        if (!workers_busy)
+            worker_cond.notify_all();
+    }
+}
+
+void GraphicsSynthesizer::set_worker_count(int count)
+{
+    if (count < 1)
+        count = 1;
+    wait_for_thread();
+    flush_triangles();
+    {
+        std::lock_guard<std::mutex> lock(worker_lock);
+        workers_quit = true;
+    }
+    worker_cond.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+    workers.clear();
+
+    //The calling thread draws too, so it counts as one of them
+    worker_count = count;
+    workers_quit = false;
+    worker_generation = 0;
+    for (int i = 1; i < count; i++)
+        workers.push_back(std::thread(&GraphicsSynthesizer::worker_loop, this));
+}
+
 void GraphicsSynthesizer::render_sprite()
 {
-    printf("\n[GS] Rendering sprite!");
+    flush_triangles();
+    DEBUG_LOG(LOG_GS, "[GS] Rendering sprite!\n");
     int32_t x1, x2, y1, y2;
     int32_t u1, u2, v1, v2;
     x1 = vtx_queue[1].coords[0] - current_ctx->xyoffset.x;
@@ -975,7 +1346,7 @@ void GraphicsSynthesizer::render_sprite()
         swap(v1, v2);
     }
 
-    printf("\nCoords: ($%08X, $%08X) ($%08X, $%08X)", x1, y1, x2, y2);
+    DEBUG_LOG(LOG_GS, "Coords: ($%08X, $%08X) ($%08X, $%08X)\n", x1, y1, x2, y2);
 
     for (int32_t y = y1; y < y2; y += 0x10)
     {
@@ -986,9 +1357,9 @@ void GraphicsSynthesizer::render_sprite()
             uint32_t tex_coord = current_ctx->tex0.texture_base + pix_u;
             tex_coord += (uint32_t)pix_v * current_ctx->tex0.tex_width;
             if (PRIM.texture_mapping)
-                draw_pixel(x, y, local_mem[tex_coord], z, PRIM.alpha_blend);
+                draw_pixel(x, y, local_mem[tex_coord], z);
             else
-                draw_pixel(x, y, 0x80000000, z, PRIM.alpha_blend);
+                draw_pixel(x, y, 0x80000000, z);
         }
     }
 }
@@ -1000,14 +1371,14 @@ void GraphicsSynthesizer::write_HWREG(uint64_t data)
     int ppd = 2; //pixels per doubleword
     *(uint64_t*)&local_mem[transfer_addr] = data;
 
-    //printf("\n[GS] Write to $%08X of $%08X_%08X", transfer_addr, data >> 32, data & 0xFFFFFFFF);
+    //DEBUG_LOG(LOG_GS, "[GS] Write to $%08X of $%08X_%08X\n", transfer_addr, data >> 32, data & 0xFFFFFFFF);
     uint32_t max_pixels = TRXREG.width * TRXREG.height;
     pixels_transferred += ppd;
     transfer_addr += ppd;
     if (pixels_transferred >= max_pixels)
     {
         //Deactivate the transmisssion
-        printf("\n[GS] HWREG transfer ended");
+        DEBUG_LOG(LOG_GS, "[GS] HWREG transfer ended\n");
         TRXDIR = 3;
         pixels_transferred = 0;
     }
@@ -1019,13 +1390,14 @@ void GraphicsSynthesizer::host_to_host()
     int ppd = 2; //pixels per doubleword
     uint32_t source_addr = BITBLTBUF.source_base + (TRXPOS.source_x + (TRXPOS.source_y * BITBLTBUF.source_width));
     uint32_t max_pixels = TRXREG.width * TRXREG.height;
-    printf("\nTRXPOS Source: (%d, %d) Dest: (%d, %d)", TRXPOS.source_x, TRXPOS.source_y, TRXPOS.dest_x, TRXPOS.dest_y);
-    printf("\nTRXREG: (%d, %d)", TRXREG.width, TRXREG.height);
-    printf("\nBase: $%08X", BITBLTBUF.source_base);
-    printf("\nSource addr: $%08X Dest addr: $%08X", source_addr, transfer_addr);
+    DEBUG_LOG(LOG_GS, "TRXPOS Source: (%d, %d) Dest: (%d, %d)\n", TRXPOS.source_x, TRXPOS.source_y,
+              TRXPOS.dest_x, TRXPOS.dest_y);
+    DEBUG_LOG(LOG_GS, "TRXREG: (%d, %d)\n", TRXREG.width, TRXREG.height);
+    DEBUG_LOG(LOG_GS, "Base: $%08X\n", BITBLTBUF.source_base);
+    DEBUG_LOG(LOG_GS, "Source addr: $%08X Dest addr: $%08X\n", source_addr, transfer_addr);
     while (pixels_transferred < max_pixels)
     {
-        //printf("\nTransfer from $%08X to $%08X", source_addr, transfer_addr);
+        //DEBUG_LOG(LOG_GS, "Transfer from $%08X to $%08X\n", source_addr, transfer_addr);
         uint64_t borp = *(uint64_t*)&local_mem[source_addr];
         *(uint64_t*)&local_mem[transfer_addr] = borp;
         pixels_transferred += ppd;
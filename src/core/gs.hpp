@@ -1,7 +1,23 @@
 #ifndef GS_HPP
 #define GS_HPP
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "gscontext.hpp"
+#include "gsjit.hpp"
+#include "ringbuffer.hpp"
+
+//The rasterizer and pixel pipeline have SSE2 paths, used wherever it's available
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GS_SSE
+#endif
+
+//Local memory in 32-bit words
+#define GS_MEM_WORDS (1024 * 1024)
 
 struct PRIM_REG
 {
@@ -94,11 +110,85 @@ struct Point
         : x(_x), y(_y), z(_z), r(_r), g(_g), b(_b), a(_a) {}
 };
 
+//Drawing calls as queued for the GS thread
+enum GS_COMMAND
+{
+    GS_WRITE64,
+    GS_SET_RGBA,
+    GS_SET_Q,
+    GS_SET_XYZ
+};
+
+//A triangle set up for drawing, with everything it needs from the GS state at the time
+struct Triangle
+{
+    Point v1, v2, v3;
+    int32_t min_x, min_y, max_x, max_y;
+    uint32_t color;
+    GSContext* ctx;
+    bool gourand_shading;
+    bool alpha_blend;
+
+    //Edge functions in pixels, w = a * x + b * y + c, with the fill rule folded into c. A pixel is covered when all
+    //three are non-negative.
+    int64_t edge_a[3], edge_b[3], edge_c[3];
+
+    //Z and RGBA in 16.16 fixed point, value = base + dx * x + dy * y with x and y relative to the origin pixel
+    int32_t origin_x, origin_y;
+    int64_t z_plane[3];
+    int64_t color_plane[4][3];
+
+    Triangle() : v1(0, 0), v2(0, 0), v3(0, 0) {}
+};
+
+//An inclusive range of pixels
+struct PixelBox
+{
+    int32_t x1, y1, x2, y2;
+};
+
+//Four horizontally adjacent pixels of a triangle, as handed from the rasterizer to the pixel pipeline
+struct PixelGroup
+{
+    int mask;
+    uint32_t z[4];
+    uint32_t color[4];
+};
+
+//A pixel as the rasterizer handed it to the pipeline, for checking the rasterizer
+struct RasterizedPixel
+{
+    int32_t x, y;
+    uint32_t z, color;
+};
+
 class INTC;
+class MMIOTable;
+
+/**
+The drawing side of the GS (general registers, vertex kicks, rasterization, and transfers into local memory) can run
+on a thread of its own. write64, set_RGBA, set_Q, and set_XYZ then just queue a command on a lock-free ring, so
+rasterization overlaps with EE and IOP emulation rather than adding to it.
+
+The privileged registers stay on the EE thread, as nothing on the drawing side uses them. The EE only has to wait
+for the GS thread to catch up when it looks at drawing results: in render_CRT, and on reset.
+
+Triangles can also be split across worker threads. They're binned into 64x64 pixel tiles, and each tile is drawn by
+a single thread in the order the triangles came in, so the result is the same as drawing them one by one. Bins are
+flushed before anything that could change or observe what they'd draw.
+**/
 
 class GraphicsSynthesizer
 {
     private:
+        //Each command is its type, an address or flag, and a 64-bit value
+        constexpr static int COMMAND_WORDS = 4;
+
+        //Tiles are 64 pixels, or 1024 in the 12.4 fixed point vertex coordinates, on a side
+        constexpr static int TILE_SHIFT = 10;
+        constexpr static int TILES_PER_ROW = 2048 >> (TILE_SHIFT - 4);
+        constexpr static unsigned int MAX_BATCH = 4096;
+
         INTC* intc;
         bool frame_complete;
         uint32_t* output_buffer;
@@ -138,21 +228,103 @@ class GraphicsSynthesizer
 
         static const unsigned int max_vertices[8];
 
+        //Threaded mode. The ring has one producer (the EE thread) and one consumer (the GS thread).
+        RingBuffer<1024 * 64> commands;
+        bool thread_running;
+        bool thread_quit;
+        std::atomic<bool> thread_idle;
+        std::thread thread;
+        std::mutex thread_lock;
+        std::condition_variable thread_cond;
+
+        void thread_loop();
+        void start_thread();
+        void stop_thread();
+        void wait_for_thread();
+        void push_command(GS_COMMAND type, uint32_t addr, uint64_t value);
+        void process_command(const uint32_t* words);
+
+        //Tile-parallel triangle drawing. The calling thread counts towards worker_count.
+        int worker_count;
+        std::vector<Triangle> triangle_batch;
+        std::vector<uint32_t> tile_bins[TILES_PER_ROW * TILES_PER_ROW];
+        std::vector<int> used_tiles;
+        std::atomic<unsigned int> next_tile;
+        std::vector<std::thread> workers;
+        std::mutex worker_lock;
+        std::condition_variable worker_cond;
+        uint32_t worker_generation;
+        int workers_busy;
+        bool workers_quit;
+
+        bool tiles_independent(GSContext* ctx);
+        void bin_triangle(const Triangle& tri);
+        void flush_triangles();
+        void draw_tiles();
+        void worker_loop();
+
+        void process_write64(uint32_t addr, uint64_t value);
+        void process_XYZ(uint32_t x, uint32_t y, uint32_t z, bool drawing_kick);
+
+        //Pixel pipeline variants, chosen per context and blending on register writes
+        typedef void (GraphicsSynthesizer::*PixelFunction)(GSContext* ctx, uint32_t pos, uint32_t color, uint32_t z);
+        typedef void (GraphicsSynthesizer::*SpanFunction)(const Triangle& tri, int32_t x, int32_t y,
+                                                           const PixelGroup& group);
+        struct PixelPipeline
+        {
+            PixelFunction pixel;
+            SpanFunction span;
+        };
+        static const PixelPipeline pipeline_table[32];
+        const PixelPipeline* pipelines[2][2];
+        const PixelPipeline* current_pipeline;
+
+        template <bool ALPHA_TEST, int DEPTH_METHOD, bool ALPHA_BLEND, bool UPDATE_Z>
+        void shade_pixel(GSContext* ctx, uint32_t pos, uint32_t color, uint32_t z);
+        template <bool ALPHA_TEST, int DEPTH_METHOD, bool ALPHA_BLEND, bool UPDATE_Z>
+        void shade_span(const Triangle& tri, int32_t x, int32_t y, const PixelGroup& group);
+        void update_pipelines();
+
+        //Generated span routines, replacing the template ones for triangles when enabled
+        GSPixelJIT jit;
+        bool jit_enabled;
+        JitSpanFunction jit_spans[2][2];
+
+        void draw_span_jit(const Triangle& tri, int32_t x, int32_t y, const PixelGroup& group);
+
         void vertex_kick(bool drawing_kick);
-        void draw_pixel(int32_t x, int32_t y, uint32_t color, uint32_t z, bool alpha_blending);
+        void draw_pixel(int32_t x, int32_t y, uint32_t color, uint32_t z);
         void render_primitive();
         void render_point();
         void render_line();
         void render_triangle();
+        bool setup_triangle(Triangle& tri, Point v1, Point v2, Point v3);
+        void draw_triangle(const Triangle& tri, int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y);
+        void rasterize_triangle(const Triangle& tri, int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y,
+                                SpanFunction span, bool allow_simd);
+        void draw_block(const Triangle& tri, SpanFunction span, int32_t block_x, int32_t block_y, const PixelBox& box,
+                        bool inside);
+        void draw_block_simd(const Triangle& tri, SpanFunction span, int32_t block_x, int32_t block_y,
+                             const PixelBox& box, bool inside);
+
+        std::vector<RasterizedPixel> rasterized_pixels;
+        void capture_span(const Triangle& tri, int32_t x, int32_t y, const PixelGroup& group);
+        bool capture_triangle(GSContext& ctx, Point v1, Point v2, Point v3, bool gourand_shading, bool simd);
+        int verify_known_triangles(GSContext& ctx);
+        bool verify_shared_edge(GSContext& ctx, Point v1, Point v2, Point v3, Point v4, bool simd);
+
         void render_sprite();
         void write_HWREG(uint64_t data);
         void host_to_host();
-
-        int32_t orient2D(const Point& v1, const Point& v2, const Point& v3);
     public:
         GraphicsSynthesizer(INTC* intc);
         ~GraphicsSynthesizer();
         void reset();
+        void map_registers(MMIOTable* mmio);
+        void set_threaded(bool threaded);
+        void set_worker_count(int count);
+        void set_jit(bool enabled);
+        int verify_rasterizer(int count, uint32_t seed);
         void start_frame();
         bool is_frame_complete();
         uint32_t* get_framebuffer();
@@ -1,5 +1,5 @@
-#include <cstdio>
 #include "gscontext.hpp"
+#include "logger.hpp"
 
 void GSContext::reset()
 {
@@ -37,14 +37,14 @@ void GSContext::set_tex0(uint64_t value)
     tex0.CLUT_offset = ((value >> 56) & 0x1F) * 16;
     tex0.CLUT_control = (value >> 61) & 0x7;
 
-    printf("\nTEX0: $%08X_%08X", value >> 32, value & 0xFFFFFFFF);
+    DEBUG_LOG(LOG_GS, "TEX0: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
 }
 
 void GSContext::set_xyoffset(uint64_t value)
 {
     xyoffset.x = value & 0xFFFF;
     xyoffset.y = (value >> 32) & 0xFFFF;
-    printf("\nXYOFFSET: $%08X_%08X", value >> 32, value & 0xFFFFFFFF);
+    DEBUG_LOG(LOG_GS, "XYOFFSET: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
 }
 
 void GSContext::set_scissor(uint64_t value)
@@ -54,9 +54,9 @@ void GSContext::set_scissor(uint64_t value)
     scissor.x2 = ((value >> 16) & 0x7FF) << 4;
     scissor.y1 = ((value >> 32) & 0x7FF) << 4;
     scissor.y2 = ((value >> 48) & 0x7FF) << 4;
-    printf("\nSCISSOR: $%08X_%08X", value >> 32, value & 0xFFFFFFFF);
-    printf("\n(%d)", ((value >> 48) & 0x7FF));
-    printf("\n(%d, %d) (%d, %d)", scissor.x1, scissor.y1, scissor.x2, scissor.y2);
+    DEBUG_LOG(LOG_GS, "SCISSOR: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
+    DEBUG_LOG(LOG_GS, "(%d)\n", ((value >> 48) & 0x7FF));
+    DEBUG_LOG(LOG_GS, "(%d, %d) (%d, %d)\n", scissor.x1, scissor.y1, scissor.x2, scissor.y2);
 }
 
 void GSContext::set_alpha(uint64_t value)
@@ -66,7 +66,7 @@ void GSContext::set_alpha(uint64_t value)
     alpha.spec_C = (value >> 4) & 0x3;
     alpha.spec_D = (value >> 6) & 0x3;
     alpha.fixed_alpha = (value >> 32) & 0xFF;
-    printf("\nALPHA: $%08X_%08X", value >> 32, value & 0xFFFFFFFF);
+    DEBUG_LOG(LOG_GS, "ALPHA: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
 }
 
 void GSContext::set_test(uint64_t value)
@@ -79,7 +79,39 @@ void GSContext::set_test(uint64_t value)
     test.dest_alpha_method = value & (1 << 15);
     test.depth_test = value & (1 << 16);
     test.depth_method = (value >> 17) & 0x3;
-    printf("\nTEST: $%08X", value & 0xFFFFFFFF);
+
+    for (int alpha = 0; alpha < 256; alpha++)
+    {
+        bool pass = false;
+        switch (test.alpha_method)
+        {
+            case 0: //NEVER
+                break;
+            case 1: //ALWAYS
+                pass = true;
+                break;
+            case 2: //LESS
+                pass = alpha < test.alpha_ref;
+                break;
+            case 3: //LEQUAL
+                pass = alpha <= test.alpha_ref;
+                break;
+            case 4: //EQUAL
+                pass = alpha == test.alpha_ref;
+                break;
+            case 5: //GEQUAL
+                pass = alpha >= test.alpha_ref;
+                break;
+            case 6: //GREATER
+                pass = alpha > test.alpha_ref;
+                break;
+            case 7: //NOTEQUAL
+                pass = alpha != test.alpha_ref;
+                break;
+        }
+        test.alpha_pass[alpha] = pass;
+    }
+    DEBUG_LOG(LOG_GS, "TEST: $%08X\n", value & 0xFFFFFFFF);
 }
 
 void GSContext::set_frame(uint64_t value)
@@ -88,7 +120,7 @@ void GSContext::set_frame(uint64_t value)
     frame.width = ((value >> 16) & 0x1F) * 64;
     frame.format = (value >> 24) & 0x3F;
     frame.mask = value >> 32;
-    printf("\nFRAME: $%08X_%08X", value >> 32, value & 0xFFFFFFFF);
+    DEBUG_LOG(LOG_GS, "FRAME: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
 }
 
 void GSContext::set_zbuf(uint64_t value)
@@ -96,5 +128,5 @@ void GSContext::set_zbuf(uint64_t value)
     zbuf.base_pointer = (value & 0x1FF) * 2048;
     zbuf.format = (value >> 24) & 0xF;
     zbuf.no_update = value & (1UL << 32);
-    printf("\nZBUF: $%08X_%08X", value >> 32, value & 0xFFFFFFFF);
+    DEBUG_LOG(LOG_GS, "ZBUF: $%08X_%08X\n", value >> 32, value & 0xFFFFFFFF);
 }
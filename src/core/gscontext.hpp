@@ -54,6 +54,9 @@ struct TEST
     bool dest_alpha_method;
     bool depth_test;
     uint8_t depth_method;
+
+    //Whether each source alpha passes the alpha test, worked out from alpha_method and alpha_ref
+    bool alpha_pass[256];
 };
 
 struct FRAME
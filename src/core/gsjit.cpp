@@ -0,0 +1,304 @@
+#include <cstddef>
+#include "gs.hpp"
+#include "gsjit.hpp"
+
+//Room for a thousand or so routines, far more states than a frame tends to draw with
+#define GS_JIT_CACHE_SIZE (1024 * 1024)
+
+//Comfortably more than the largest routine, about 550 bytes with every stage enabled
+#define MAX_SPAN_SIZE 1024
+
+uint64_t SpanState::pack() const
+{
+    uint64_t key = alpha_test;
+    key |= (uint64_t)alpha_method << 1;
+    key |= (uint64_t)alpha_ref << 4;
+    key |= (uint64_t)alpha_fail_method << 12;
+    key |= (uint64_t)depth_method << 14;
+    key |= (uint64_t)alpha_blend << 16;
+    key |= (uint64_t)spec_A << 17;
+    key |= (uint64_t)spec_B << 19;
+    key |= (uint64_t)spec_C << 21;
+    key |= (uint64_t)spec_D << 23;
+    key |= (uint64_t)fixed_alpha << 25;
+    key |= (uint64_t)update_z << 33;
+
+    //Buffers start on 2048 word boundaries
+    key |= (uint64_t)(frame_base / 2048) << 34;
+    key |= (uint64_t)(zbuf_base / 2048) << 43;
+    return key;
+}
+
+GSPixelJIT::GSPixelJIT() : cache(GS_JIT_CACHE_SIZE), emitter(&cache)
+{
+
+}
+
+bool GSPixelJIT::is_available()
+{
+    return cache.is_valid();
+}
+
+void GSPixelJIT::prepare(int count)
+{
+    if (cache.get_space_left() < (size_t)count * MAX_SPAN_SIZE)
+    {
+        cache.flush();
+        spans.clear();
+    }
+}
+
+JitSpanFunction GSPixelJIT::get_span(const SpanState& state)
+{
+    uint64_t key = state.pack();
+    auto it = spans.find(key);
+    if (it != spans.end())
+        return it->second;
+
+    JitSpanFunction span = compile(state);
+    spans[key] = span;
+    return span;
+}
+
+JitSpanFunction GSPixelJIT::compile(const SpanState& state)
+{
+    uint8_t* start = emitter.get_current_addr();
+
+    //Nothing ever passes the depth test
+    if (state.depth_method == 0)
+    {
+        emitter.RET();
+        return (JitSpanFunction)start;
+    }
+
+    //The buffers' base addresses are constants, so only the group's offset is added at runtime
+    emitter.MOV32_REG(REG_ARG1, R9);
+    emitter.ADD32_REG_IMM(state.frame_base, R9);
+    emitter.SHL32_REG_IMM(2, R9);
+    emitter.ADD64_REG(REG_ARG0, R9);
+    emitter.MOV32_REG(REG_ARG1, R10);
+    emitter.ADD32_REG_IMM(state.zbuf_base, R10);
+    emitter.SHL32_REG_IMM(2, R10);
+    emitter.ADD64_REG(REG_ARG0, R10);
+    emitter.MOV64_MR(REG_ARG2, R11);
+
+    emitter.MOV32_FROM_MEM(R11, R8, offsetof(PixelGroup, mask));
+    if (state.update_z)
+        emitter.MOV32_REG(R8, RCX);
+    emitter.MOVDQU_FROM_MEM(R11, XMM0, offsetof(PixelGroup, color));
+
+    if (state.alpha_test)
+        emit_alpha_test(state);
+    if (state.depth_method >= 2)
+        emit_depth_test(state);
+
+    emitter.TEST64_REG(R8, R8);
+    uint8_t* skip_frame = emitter.JCC_NEAR_DEFERRED(ConditionCode::E);
+    emitter.MOVDQU_FROM_MEM(R9, XMM5);
+    if (state.alpha_blend)
+        emit_blend(state);
+    if (state.alpha_test && state.alpha_fail_method == 3)
+    {
+        //RGB_ONLY, pixels failing the alpha test keep the frame's alpha
+        emit_lane_mask(RDX, XMM1);
+        emitter.PCMPEQD(XMM2, XMM2);
+        emitter.PSLLD(24, XMM2);
+        emitter.PAND(XMM2, XMM1);
+        emitter.MOVDQA_XMM(XMM5, XMM2);
+        emit_select(XMM1, XMM2, XMM0);
+        emitter.MOVDQA_XMM(XMM2, XMM0);
+    }
+    emit_lane_mask(R8, XMM1);
+    emit_select(XMM1, XMM0, XMM5);
+    emitter.MOVDQU_TO_MEM(XMM0, R9);
+    emitter.set_jump_dest(skip_frame);
+
+    if (state.update_z)
+    {
+        //Read back after the frame is written, in case both buffers are the same
+        emitter.TEST64_REG(RCX, RCX);
+        uint8_t* skip_z = emitter.JCC_NEAR_DEFERRED(ConditionCode::E);
+        emit_lane_mask(RCX, XMM1);
+        emitter.MOVDQU_FROM_MEM(R11, XMM0, offsetof(PixelGroup, z));
+        emitter.MOVDQU_FROM_MEM(R10, XMM2);
+        emit_select(XMM1, XMM0, XMM2);
+        emitter.MOVDQU_TO_MEM(XMM0, R10);
+        emitter.set_jump_dest(skip_z);
+    }
+    emitter.RET();
+    return (JitSpanFunction)start;
+}
+
+/**
+ * Compares each source alpha against the reference, leaving the passing lanes in RDX, then takes the failing ones out
+ * of the frame and Z writes according to the fail method.
+ */
+void GSPixelJIT::emit_alpha_test(const SpanState& state)
+{
+    switch (state.alpha_method)
+    {
+        case 0: //NEVER
+            emitter.XOR32_REG(RDX, RDX);
+            break;
+        case 1: //ALWAYS
+            emitter.MOV32_REG_IMM(0xF, RDX);
+            break;
+        default:
+        {
+            emitter.MOVDQA_XMM(XMM0, XMM1);
+            emitter.PSRLD(24, XMM1);
+            emitter.MOV32_REG_IMM(state.alpha_ref, RAX);
+            emitter.MOVD_TO_XMM(RAX, XMM2);
+            emitter.PSHUFD(0, XMM2, XMM2);
+
+            //Alpha and the reference are both bytes, so signed compares work. The rest are the inverse of these.
+            REG_XMM result = XMM1;
+            bool inverted = false;
+            switch (state.alpha_method)
+            {
+                case 2: //LESS
+                    emitter.PCMPGTD(XMM1, XMM2);
+                    result = XMM2;
+                    break;
+                case 3: //LEQUAL
+                    emitter.PCMPGTD(XMM2, XMM1);
+                    inverted = true;
+                    break;
+                case 4: //EQUAL
+                    emitter.PCMPEQD(XMM2, XMM1);
+                    break;
+                case 5: //GEQUAL
+                    emitter.PCMPGTD(XMM1, XMM2);
+                    result = XMM2;
+                    inverted = true;
+                    break;
+                case 6: //GREATER
+                    emitter.PCMPGTD(XMM2, XMM1);
+                    break;
+                case 7: //NOTEQUAL
+                    emitter.PCMPEQD(XMM2, XMM1);
+                    inverted = true;
+                    break;
+            }
+            emitter.MOVMSKPS(result, RDX);
+            if (inverted)
+                emitter.XOR64_REG_IMM(0xF, RDX);
+            break;
+        }
+    }
+
+    bool fail_frame = state.alpha_fail_method == 0 || state.alpha_fail_method == 2;
+    bool fail_z = state.update_z && state.alpha_fail_method != 2;
+    if (fail_frame)
+        emitter.AND64_REG(RDX, R8);
+    if (fail_z)
+        emitter.AND64_REG(RDX, RCX);
+    if (state.alpha_fail_method == 3)
+    {
+        //RGB_ONLY
+        emitter.XOR64_REG_IMM(0xF, RDX);
+        emitter.AND64_REG(R8, RDX);
+    }
+}
+
+//Takes the lanes failing the depth test out of the frame and Z writes
+void GSPixelJIT::emit_depth_test(const SpanState& state)
+{
+    emitter.MOVDQU_FROM_MEM(R11, XMM1, offsetof(PixelGroup, z));
+    emitter.MOVDQU_FROM_MEM(R10, XMM2);
+
+    //Z is unsigned, so flip the sign bits to use signed compares
+    emitter.PCMPEQD(XMM3, XMM3);
+    emitter.PSLLD(31, XMM3);
+    emitter.PXOR(XMM3, XMM1);
+    emitter.PXOR(XMM3, XMM2);
+    if (state.depth_method == 2)
+    {
+        //GEQUAL fails where the buffer is greater
+        emitter.PCMPGTD(XMM1, XMM2);
+        emitter.MOVMSKPS(XMM2, RAX);
+        emitter.XOR64_REG_IMM(0xF, RAX);
+    }
+    else
+    {
+        //GREATER
+        emitter.PCMPGTD(XMM2, XMM1);
+        emitter.MOVMSKPS(XMM1, RAX);
+    }
+    emitter.AND64_REG(RAX, R8);
+    if (state.update_z)
+        emitter.AND64_REG(RAX, RCX);
+}
+
+//Works like the template pipeline: ((A - B) * C >> 7) + D for each channel, on 32-bit unsigned arithmetic
+void GSPixelJIT::emit_blend(const SpanState& state)
+{
+    //C, the blend factor, goes in XMM1 and also ends up as the output alpha
+    switch (state.spec_C)
+    {
+        case 0:
+            emitter.MOVDQA_XMM(XMM0, XMM1);
+            emitter.PSRLD(24, XMM1);
+            break;
+        case 1:
+            emitter.MOVDQA_XMM(XMM5, XMM1);
+            emitter.PSRLD(24, XMM1);
+            break;
+        default:
+            emitter.MOV32_REG_IMM(state.fixed_alpha, RAX);
+            emitter.MOVD_TO_XMM(RAX, XMM1);
+            emitter.PSHUFD(0, XMM1, XMM1);
+            break;
+    }
+    emitter.MOVDQA_XMM(XMM1, XMM2);
+    emitter.PSLLD(24, XMM2);
+
+    for (int shift = 16; shift >= 0; shift -= 8)
+    {
+        emit_blend_operand(state.spec_A, shift, XMM3);
+        emit_blend_operand(state.spec_B, shift, XMM4);
+        emitter.PSUBD(XMM4, XMM3);
+
+        //C has nothing in its upper halves, so this is a full 32-bit multiply of the difference and C
+        emitter.PMADDWD(XMM1, XMM3);
+        emitter.PSRLD(7, XMM3);
+        emit_blend_operand(state.spec_D, shift, XMM4);
+        emitter.PADDD(XMM4, XMM3);
+        if (shift)
+            emitter.PSLLD(shift, XMM3);
+        emitter.POR(XMM3, XMM2);
+    }
+    emitter.MOVDQA_XMM(XMM2, XMM0);
+}
+
+//Loads one channel of the source colors, the destination colors, or zero
+void GSPixelJIT::emit_blend_operand(uint8_t spec, int shift, REG_XMM dest)
+{
+    if (spec >= 2)
+    {
+        emitter.PXOR(dest, dest);
+        return;
+    }
+    emitter.MOVDQA_XMM(spec ? XMM5 : XMM0, dest);
+    emitter.PSLLD(24 - shift, dest);
+    emitter.PSRLD(24, dest);
+}
+
+//Expands a 4-bit lane mask into all ones or all zeroes per lane
+void GSPixelJIT::emit_lane_mask(REG_64 lanes, REG_XMM dest)
+{
+    alignas(16) static const uint32_t lane_bits[4] = {1, 2, 4, 8};
+    emitter.MOVD_TO_XMM(lanes, dest);
+    emitter.PSHUFD(0, dest, dest);
+    emitter.MOV64_OI((uint64_t)lane_bits, RAX);
+    emitter.PAND_FROM_MEM(RAX, dest);
+    emitter.PCMPEQD_FROM_MEM(RAX, dest);
+}
+
+//a = mask ? a : b, per lane. mask is clobbered.
+void GSPixelJIT::emit_select(REG_XMM mask, REG_XMM a, REG_XMM b)
+{
+    emitter.PAND(mask, a);
+    emitter.PANDN(b, mask);
+    emitter.POR(mask, a);
+}
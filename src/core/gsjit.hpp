@@ -0,0 +1,86 @@
+#ifndef GSJIT_HPP
+#define GSJIT_HPP
+#include <cstdint>
+#include <unordered_map>
+#include "jitcommon/emitter64.hpp"
+#include "jitcommon/jitcache.hpp"
+
+/**
+x86-64 code generator for the GS pixel pipeline.
+
+Each routine draws one PixelGroup from the rasterizer: alpha test, depth test, blending, and the frame and Z buffer
+writes, fused together with everything about the draw state baked in as constants. That includes the ALPHA selectors,
+the alpha test's reference, and the buffer addresses, which the template pipeline still reads from the context.
+
+All four pixels go through SSE2 together, like the template pipeline's shade_span. The tests only narrow down which
+lanes get written, kept as 4-bit lane masks in general purpose registers, and the buffers are read and written back a
+whole group at a time.
+
+Routines are cached by their packed SpanState, so switching back to a state seen before costs a hash lookup. The
+cache is flushed wholesale when it runs low, so callers must fetch every routine they hold again after prepare().
+
+Generated code only uses registers that are caller-saved on both Windows and System V:
+R9 - the group's first pixel in the frame buffer
+R10 - the group's first pixel in the Z buffer
+R11 - the PixelGroup
+R8 - lanes to write to the frame buffer
+RCX - lanes to write to the Z buffer
+RDX - lanes passing the alpha test, then (for RGB_ONLY) lanes keeping the frame's alpha
+RAX - scratch
+XMM0 - source colors
+XMM5 - destination colors
+XMM1-XMM4 - scratch
+**/
+
+struct PixelGroup;
+
+//Everything a span routine depends on, reduced so that states drawing the same way share a routine
+struct SpanState
+{
+    bool alpha_test;
+    uint8_t alpha_method;
+    uint8_t alpha_ref;
+    uint8_t alpha_fail_method;
+
+    //As TEST, with 1 (PASS) also standing for no depth test at all
+    uint8_t depth_method;
+
+    bool alpha_blend;
+    uint8_t spec_A, spec_B, spec_C, spec_D;
+    uint8_t fixed_alpha;
+
+    bool update_z;
+    uint32_t frame_base;
+    uint32_t zbuf_base;
+
+    uint64_t pack() const;
+};
+
+typedef void (*JitSpanFunction)(uint32_t* local_mem, uint32_t pos, const PixelGroup* group);
+
+class GSPixelJIT
+{
+    private:
+        JitCache cache;
+        Emitter64 emitter;
+
+        std::unordered_map<uint64_t, JitSpanFunction> spans;
+
+        JitSpanFunction compile(const SpanState& state);
+        void emit_alpha_test(const SpanState& state);
+        void emit_depth_test(const SpanState& state);
+        void emit_blend(const SpanState& state);
+        void emit_blend_operand(uint8_t spec, int shift, REG_XMM dest);
+        void emit_lane_mask(REG_64 lanes, REG_XMM dest);
+        void emit_select(REG_XMM mask, REG_XMM a, REG_XMM b);
+    public:
+        GSPixelJIT();
+
+        bool is_available();
+
+        //Makes room for count more routines, flushing the cache if needed
+        void prepare(int count);
+        JitSpanFunction get_span(const SpanState& state);
+};
+
+#endif // GSJIT_HPP
@@ -0,0 +1,719 @@
+#include <algorithm>
+#include <cmath>
+#include "gs.hpp"
+#include "logger.hpp"
+
+using namespace std;
+
+/**
+Triangle setup and rasterization.
+
+Coverage uses edge functions sampled once per pixel, at the pixel's integer coordinate, with the usual top-left fill
+rule so that pixels on an edge shared by two triangles are drawn exactly once. Each edge function and the Z and RGBA
+planes are set up once per triangle, the planes in 16.16 fixed point relative to the triangle's first pixel.
+
+The scissored bounding box is covered in 8x8 blocks, each tested against the edges as a whole first, so only blocks
+straddling an edge pay for per-pixel edge tests. Pixels step through the edges and planes incrementally, four at a
+time, and each group of four goes to the pixel pipeline with a coverage mask.
+
+The SSE path and the scalar one give identical results. verify_rasterizer checks that on random triangles, and can
+be run with dobie-cli -verifyraster.
+**/
+
+//Fixed point plane coefficients are clamped to this, which only degenerate slivers ever reach
+#define PLANE_LIMIT 4611686018427387904.0
+
+static int64_t to_fixed(double value)
+{
+    value *= 65536.0;
+    if (value > PLANE_LIMIT)
+        return (int64_t)PLANE_LIMIT;
+    if (value < -PLANE_LIMIT)
+        return -(int64_t)PLANE_LIMIT;
+    return llround(value);
+}
+
+//Plane arithmetic wraps, as only the values at covered pixels have to be right
+static int64_t plane_at(const int64_t* plane, int32_t x, int32_t y)
+{
+    return (int64_t)((uint64_t)plane[0] + (uint64_t)plane[1] * (uint64_t)(int64_t)x +
+                     (uint64_t)plane[2] * (uint64_t)(int64_t)y);
+}
+
+static uint32_t plane_to_z(int64_t value)
+{
+    value >>= 16;
+    if (value < 0)
+        return 0;
+    if (value > 0xFFFFFFFFLL)
+        return 0xFFFFFFFF;
+    return (uint32_t)value;
+}
+
+static uint32_t plane_to_channel(int64_t value)
+{
+    value >>= 16;
+    if (value < 0)
+        return 0;
+    if (value > 0xFF)
+        return 0xFF;
+    return (uint32_t)value;
+}
+
+//Sets up value = base + dx * x + dy * y from the values at the three vertices
+static void setup_plane(const double* origin_w, const Triangle& tri, double area, const double* values, int64_t* plane)
+{
+    double base = 0.0, dx = 0.0, dy = 0.0;
+    for (int k = 0; k < 3; k++)
+    {
+        base += values[k] * origin_w[k];
+        dx += values[k] * tri.edge_a[k];
+        dy += values[k] * tri.edge_b[k];
+    }
+    plane[0] = to_fixed(base / area);
+    plane[1] = to_fixed(dx / area);
+    plane[2] = to_fixed(dy / area);
+}
+
+//Which of the four pixels starting at x fall inside [x1, x2]
+static int span_mask(int32_t x, int32_t x1, int32_t x2)
+{
+    int mask = 0xF;
+    if (x < x1)
+        mask &= 0xF << (x1 - x);
+    if (x + 3 > x2)
+        mask &= 0xF >> (x + 3 - x2);
+    return mask & 0xF;
+}
+
+//Reference rasterizer, evaluating everything directly at each pixel. Edge tests can be skipped for pixels already
+//known to be covered.
+static void rasterize_group(const Triangle& tri, int32_t x, int32_t y, bool test_edges, PixelGroup& group)
+{
+    group.mask = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int64_t px = x + i;
+        bool covered = true;
+        for (int k = 0; k < 3 && test_edges; k++)
+            covered &= tri.edge_a[k] * px + tri.edge_b[k] * y + tri.edge_c[k] >= 0;
+        if (!covered)
+            continue;
+
+        group.mask |= 1 << i;
+        int32_t rel_x = x + i - tri.origin_x;
+        int32_t rel_y = y - tri.origin_y;
+        group.z[i] = plane_to_z(plane_at(tri.z_plane, rel_x, rel_y));
+        if (tri.gourand_shading)
+        {
+            group.color[i] = 0;
+            for (int c = 0; c < 4; c++)
+                group.color[i] |= plane_to_channel(plane_at(tri.color_plane[c], rel_x, rel_y)) << (c * 8);
+        }
+    }
+}
+
+void GraphicsSynthesizer::render_triangle()
+{
+    DEBUG_LOG(LOG_GS, "[GS] Rendering triangle!\n");
+    Triangle tri;
+    tri.color = 0x00000000;
+    tri.color |= vtx_queue[0].rgbaq.r;
+    tri.color |= vtx_queue[0].rgbaq.g << 8;
+    tri.color |= vtx_queue[0].rgbaq.b << 16;
+    tri.color |= vtx_queue[0].rgbaq.a << 24;
+    tri.ctx = current_ctx;
+    tri.gourand_shading = PRIM.gourand_shading;
+    tri.alpha_blend = PRIM.alpha_blend;
+
+    int32_t x1, x2, x3, y1, y2, y3, z1, z2, z3;
+    uint8_t r1, r2, r3, g1, g2, g3, b1, b2, b3, a1, a2, a3;
+    x1 = vtx_queue[2].coords[0] - current_ctx->xyoffset.x;
+    y1 = vtx_queue[2].coords[1] - current_ctx->xyoffset.y;
+    z1 = vtx_queue[2].coords[2];
+    x2 = vtx_queue[1].coords[0] - current_ctx->xyoffset.x;
+    y2 = vtx_queue[1].coords[1] - current_ctx->xyoffset.y;
+    z2 = vtx_queue[1].coords[2];
+    x3 = vtx_queue[0].coords[0] - current_ctx->xyoffset.x;
+    y3 = vtx_queue[0].coords[1] - current_ctx->xyoffset.y;
+    z3 = vtx_queue[0].coords[2];
+    r1 = vtx_queue[2].rgbaq.r;
+    g1 = vtx_queue[2].rgbaq.g;
+    b1 = vtx_queue[2].rgbaq.b;
+    a1 = vtx_queue[2].rgbaq.a;
+    r2 = vtx_queue[1].rgbaq.r;
+    g2 = vtx_queue[1].rgbaq.g;
+    b2 = vtx_queue[1].rgbaq.b;
+    a2 = vtx_queue[1].rgbaq.a;
+    r3 = vtx_queue[0].rgbaq.r;
+    g3 = vtx_queue[0].rgbaq.g;
+    b3 = vtx_queue[0].rgbaq.b;
+    a3 = vtx_queue[0].rgbaq.a;
+    Point v1(x1, y1, z1, r1, g1, b1, a1);
+    Point v2(x2, y2, z2, r2, g2, b2, a2);
+    Point v3(x3, y3, z3, r3, g3, b3, a3);
+    if (!setup_triangle(tri, v1, v2, v3))
+        return;
+
+    if (worker_count > 1)
+        bin_triangle(tri);
+    else
+        draw_triangle(tri, tri.min_x, tri.min_y, tri.max_x, tri.max_y);
+}
+
+//Sets up the edges, bounding box, and planes of a triangle with the given vertices. Returns false if it has no area.
+bool GraphicsSynthesizer::setup_triangle(Triangle& tri, Point v1, Point v2, Point v3)
+{
+    //The triangle rasterization code uses an approach with barycentric coordinates
+    //Clear explanation can be read below:
+    //https://fgiesen.wordpress.com/2013/02/06/the-barycentric-conspirac/
+
+    //Order by counter-clockwise winding order
+    int64_t area = (int64_t)(v2.x - v1.x) * (v3.y - v1.y) - (int64_t)(v3.x - v1.x) * (v2.y - v1.y);
+    if (area < 0)
+    {
+        swap(v2, v3);
+        area = -area;
+    }
+
+    //Nothing is covered by a zero area triangle
+    if (!area)
+        return false;
+    tri.v1 = v1;
+    tri.v2 = v2;
+    tri.v3 = v3;
+
+    //Calculate bounding box of triangle
+    tri.min_x = min({v1.x, v2.x, v3.x});
+    tri.min_y = min({v1.y, v2.y, v3.y});
+    tri.max_x = max({v1.x, v2.x, v3.x});
+    tri.max_y = max({v1.y, v2.y, v3.y});
+
+    //Planes are relative to the first pixel in the bounding box, to keep the setup precise
+    tri.origin_x = (tri.min_x + 15) >> 4;
+    tri.origin_y = (tri.min_y + 15) >> 4;
+
+    //Edge k is the one opposite vertex k, and its weight at a pixel is the barycentric coordinate of that vertex.
+    //Coordinates are in pixels, while the vertices are in 12.4 fixed point.
+    const Point* vertices[3] = {&v1, &v2, &v3};
+    double origin_w[3];
+    bool top_left[3];
+    for (int k = 0; k < 3; k++)
+    {
+        const Point& p = *vertices[(k + 1) % 3];
+        const Point& q = *vertices[(k + 2) % 3];
+        tri.edge_a[k] = (int64_t)(p.y - q.y) * 16;
+        tri.edge_b[k] = (int64_t)(q.x - p.x) * 16;
+        tri.edge_c[k] = (int64_t)p.x * q.y - (int64_t)p.y * q.x;
+        origin_w[k] = (double)(tri.edge_a[k] * tri.origin_x + tri.edge_b[k] * tri.origin_y + tri.edge_c[k]);
+
+        //Top edges are horizontal with the triangle below them, left edges go up
+        top_left[k] = (q.y < p.y) || (q.y == p.y && q.x > p.x);
+    }
+
+    double values[3];
+    for (int k = 0; k < 3; k++)
+        values[k] = (uint32_t)vertices[k]->z;
+    setup_plane(origin_w, tri, area, values, tri.z_plane);
+    if (tri.gourand_shading)
+    {
+        for (int k = 0; k < 3; k++)
+            values[k] = vertices[k]->r;
+        setup_plane(origin_w, tri, area, values, tri.color_plane[0]);
+        for (int k = 0; k < 3; k++)
+            values[k] = vertices[k]->g;
+        setup_plane(origin_w, tri, area, values, tri.color_plane[1]);
+        for (int k = 0; k < 3; k++)
+            values[k] = vertices[k]->b;
+        setup_plane(origin_w, tri, area, values, tri.color_plane[2]);
+        for (int k = 0; k < 3; k++)
+            values[k] = vertices[k]->a;
+        setup_plane(origin_w, tri, area, values, tri.color_plane[3]);
+    }
+
+    //Fold the fill rule into the edges, so a pixel is covered when all three are non-negative
+    for (int k = 0; k < 3; k++)
+    {
+        if (!top_left[k])
+            tri.edge_c[k]--;
+    }
+    return true;
+}
+
+//Draws the part of the triangle that falls in [min_x, max_x] x [min_y, max_y], in 12.4 fixed point
+void GraphicsSynthesizer::draw_triangle(const Triangle& tri, int32_t min_x, int32_t min_y, int32_t max_x,
+                                        int32_t max_y)
+{
+    //The pipeline can't change while the triangle is drawn, as anything that could change it flushes binned ones
+    SpanFunction span = pipelines[tri.ctx == &context2][tri.alpha_blend]->span;
+    if (jit_enabled)
+        span = &GraphicsSynthesizer::draw_span_jit;
+    rasterize_triangle(tri, min_x, min_y, max_x, max_y, span, true);
+}
+
+/**
+ * Hands every covered pixel of the triangle in the box, clipped to the scissor, to span. The box is walked in 8x8
+ * pixel blocks, which are tested against the edges as a whole first. Blocks outside any edge are skipped, and blocks
+ * inside all three are filled without testing each pixel. allow_simd = false forces the scalar path.
+ */
+void GraphicsSynthesizer::rasterize_triangle(const Triangle& tri, int32_t min_x, int32_t min_y, int32_t max_x,
+                                             int32_t max_y, SpanFunction span, bool allow_simd)
+{
+    SCISSOR& s = tri.ctx->scissor;
+    min_x = max(min_x, (int32_t)s.x1);
+    min_y = max(min_y, (int32_t)s.y1);
+    max_x = min(max_x, (int32_t)s.x2);
+    max_y = min(max_y, (int32_t)s.y2);
+
+    //The pixels whose integer coordinates are inside the box
+    PixelBox box;
+    box.x1 = (min_x + 15) >> 4;
+    box.y1 = (min_y + 15) >> 4;
+    box.x2 = max_x >> 4;
+    box.y2 = max_y >> 4;
+    if (box.x1 > box.x2 || box.y1 > box.y2)
+        return;
+
+    bool simd = false;
+#ifdef GS_SSE
+    //The SSE path works on 32-bit edge values. They're linear, so they fit everywhere in the box if they fit at the
+    //corners of it.
+    simd = allow_simd;
+    int32_t corners_x[2] = {box.x1 & ~3, box.x2 | 3};
+    int32_t corners_y[2] = {box.y1, box.y2};
+    for (int k = 0; k < 3; k++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            int64_t w = tri.edge_a[k] * corners_x[i & 1] + tri.edge_b[k] * corners_y[i >> 1] + tri.edge_c[k];
+            simd &= w >= INT32_MIN && w <= INT32_MAX;
+        }
+    }
+#endif
+
+    //How far each edge function can go below and above its value at a block's top-left pixel within the block
+    int64_t below[3], above[3];
+    for (int k = 0; k < 3; k++)
+    {
+        below[k] = (min(tri.edge_a[k], (int64_t)0) + min(tri.edge_b[k], (int64_t)0)) * 7;
+        above[k] = (max(tri.edge_a[k], (int64_t)0) + max(tri.edge_b[k], (int64_t)0)) * 7;
+    }
+
+    for (int32_t block_y = box.y1 & ~7; block_y <= box.y2; block_y += 8)
+    {
+        for (int32_t block_x = box.x1 & ~7; block_x <= box.x2; block_x += 8)
+        {
+            bool outside = false;
+            bool inside = true;
+            for (int k = 0; k < 3; k++)
+            {
+                int64_t w = tri.edge_a[k] * block_x + tri.edge_b[k] * block_y + tri.edge_c[k];
+                outside |= w + above[k] < 0;
+                inside &= w + below[k] >= 0;
+            }
+            if (outside)
+                continue;
+
+            if (simd)
+                draw_block_simd(tri, span, block_x, block_y, box, inside);
+            else
+                draw_block(tri, span, block_x, block_y, box, inside);
+        }
+    }
+}
+
+void GraphicsSynthesizer::draw_block(const Triangle& tri, SpanFunction span, int32_t block_x, int32_t block_y,
+                                     const PixelBox& box, bool inside)
+{
+    PixelGroup group;
+    if (!tri.gourand_shading)
+        fill(group.color, group.color + 4, tri.color);
+
+    int32_t y1 = max(block_y, box.y1);
+    int32_t y2 = min(block_y + 7, box.y2);
+    for (int32_t y = y1; y <= y2; y++)
+    {
+        for (int32_t x = block_x; x < block_x + 8; x += 4)
+        {
+            int mask = span_mask(x, box.x1, box.x2);
+            if (!mask)
+                continue;
+            rasterize_group(tri, x, y, !inside, group);
+            group.mask &= mask;
+            if (group.mask)
+                (this->*span)(tri, x, y, group);
+        }
+    }
+}
+
+#ifdef GS_SSE
+//Walks the block a column of four pixels at a time, stepping the edges and planes down each column
+void GraphicsSynthesizer::draw_block_simd(const Triangle& tri, SpanFunction span, int32_t block_x,
+                                          int32_t block_y, const PixelBox& box, bool inside)
+{
+    int32_t y1 = max(block_y, box.y1);
+    int32_t y2 = min(block_y + 7, box.y2);
+    int32_t rel_y = y1 - tri.origin_y;
+
+    //Per-lane offsets from the first pixel of a group, and the step to the next row. All of this wraps the same way
+    //as the scalar plane arithmetic.
+    __m128i edge_lane[3], edge_step[3];
+    for (int k = 0; k < 3; k++)
+    {
+        uint32_t a = (uint32_t)tri.edge_a[k];
+        edge_lane[k] = _mm_set_epi32(a * 3, a * 2, a, 0);
+        edge_step[k] = _mm_set1_epi32((uint32_t)tri.edge_b[k]);
+    }
+    __m128i color_lane[4], color_step[4];
+    if (tri.gourand_shading)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            uint32_t dx = (uint32_t)tri.color_plane[c][1];
+            color_lane[c] = _mm_set_epi32(dx * 3, dx * 2, dx, 0);
+            color_step[c] = _mm_set1_epi32((uint32_t)tri.color_plane[c][2]);
+        }
+    }
+    uint64_t z_dx = (uint64_t)tri.z_plane[1];
+    uint64_t z_dy = (uint64_t)tri.z_plane[2];
+
+    PixelGroup group;
+    if (!tri.gourand_shading)
+        fill(group.color, group.color + 4, tri.color);
+
+    for (int32_t x = block_x; x < block_x + 8; x += 4)
+    {
+        int mask = span_mask(x, box.x1, box.x2);
+        if (!mask)
+            continue;
+
+        int32_t rel_x = x - tri.origin_x;
+        __m128i w[3];
+        for (int k = 0; k < 3; k++)
+        {
+            int64_t start = tri.edge_a[k] * x + tri.edge_b[k] * y1 + tri.edge_c[k];
+            w[k] = _mm_add_epi32(_mm_set1_epi32((int32_t)start), edge_lane[k]);
+        }
+        __m128i color[4];
+        if (tri.gourand_shading)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                int64_t start = plane_at(tri.color_plane[c], rel_x, rel_y);
+                color[c] = _mm_add_epi32(_mm_set1_epi32((int32_t)start), color_lane[c]);
+            }
+        }
+        uint64_t z = (uint64_t)plane_at(tri.z_plane, rel_x, rel_y);
+
+        for (int32_t y = y1; y <= y2; y++)
+        {
+            group.mask = mask;
+            if (!inside)
+            {
+                //A pixel is outside if any of its edge values has the sign bit set
+                __m128i outside = _mm_or_si128(_mm_or_si128(w[0], w[1]), w[2]);
+                group.mask &= ~_mm_movemask_ps(_mm_castsi128_ps(outside));
+            }
+
+            if (group.mask)
+            {
+                for (int i = 0; i < 4; i++)
+                    group.z[i] = plane_to_z((int64_t)(z + z_dx * i));
+
+                if (tri.gourand_shading)
+                {
+                    //Saturating packs clamp each channel to 0-255, then two unpacks gather the channels of each
+                    //pixel into RGBA
+                    __m128i r = _mm_srai_epi32(color[0], 16);
+                    __m128i g = _mm_srai_epi32(color[1], 16);
+                    __m128i b = _mm_srai_epi32(color[2], 16);
+                    __m128i a = _mm_srai_epi32(color[3], 16);
+                    __m128i channels = _mm_packus_epi16(_mm_packs_epi32(r, b), _mm_packs_epi32(g, a));
+                    channels = _mm_unpacklo_epi8(channels, _mm_srli_si128(channels, 8));
+                    channels = _mm_unpacklo_epi16(channels, _mm_srli_si128(channels, 8));
+                    _mm_storeu_si128((__m128i*)group.color, channels);
+                }
+
+                (this->*span)(tri, x, y, group);
+            }
+
+            for (int k = 0; k < 3; k++)
+                w[k] = _mm_add_epi32(w[k], edge_step[k]);
+            if (tri.gourand_shading)
+            {
+                for (int c = 0; c < 4; c++)
+                    color[c] = _mm_add_epi32(color[c], color_step[c]);
+            }
+            z += z_dy;
+        }
+    }
+}
+#endif
+
+void GraphicsSynthesizer::capture_span(const Triangle& tri, int32_t x, int32_t y, const PixelGroup& group)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (!(group.mask & (1 << i)))
+            continue;
+        RasterizedPixel pixel;
+        pixel.x = x + i;
+        pixel.y = y;
+        pixel.z = group.z[i];
+        pixel.color = group.color[i];
+        rasterized_pixels.push_back(pixel);
+    }
+}
+
+static bool pixel_order(const RasterizedPixel& a, const RasterizedPixel& b)
+{
+    if (a.y != b.y)
+        return a.y < b.y;
+    return a.x < b.x;
+}
+
+static bool same_pixel(const RasterizedPixel& a, const RasterizedPixel& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.color == b.color;
+}
+
+//Xorshift, so that a seed gives the same triangles on every host
+static uint32_t next_random(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+//Twice the signed area of a, b, p in 12.4 fixed point. Positive when p is to the left of a to b.
+static int64_t orient(const Point& a, const Point& b, int32_t px, int32_t py)
+{
+    return (int64_t)(b.x - a.x) * (py - a.y) - (int64_t)(b.y - a.y) * (px - a.x);
+}
+
+static int sign(int64_t value)
+{
+    return (value > 0) - (value < 0);
+}
+
+//Which side of each edge of a, b, c the point is on, relative to the triangle's own winding
+static void edge_sides(const Point& a, const Point& b, const Point& c, int32_t px, int32_t py, int* sides)
+{
+    int winding = sign(orient(a, b, c.x, c.y));
+    sides[0] = sign(orient(a, b, px, py)) * winding;
+    sides[1] = sign(orient(b, c, px, py)) * winding;
+    sides[2] = sign(orient(c, a, px, py)) * winding;
+}
+
+static bool strictly_inside(const Point& a, const Point& b, const Point& c, int32_t px, int32_t py)
+{
+    int sides[3];
+    edge_sides(a, b, c, px, py, sides);
+    return sides[0] > 0 && sides[1] > 0 && sides[2] > 0;
+}
+
+static bool inside_or_on_edge(const Point& a, const Point& b, const Point& c, int32_t px, int32_t py)
+{
+    int sides[3];
+    edge_sides(a, b, c, px, py, sides);
+    return sides[0] >= 0 && sides[1] >= 0 && sides[2] >= 0;
+}
+
+//Sets up a triangle for ctx and captures what the rasterizer hands to the pipeline, in pixel order
+bool GraphicsSynthesizer::capture_triangle(GSContext& ctx, Point v1, Point v2, Point v3, bool gourand_shading,
+                                           bool simd)
+{
+    Triangle tri;
+    tri.ctx = &ctx;
+    tri.color = v1.r | (v1.g << 8) | (v1.b << 16) | (v1.a << 24);
+    tri.gourand_shading = gourand_shading;
+    tri.alpha_blend = false;
+    rasterized_pixels.clear();
+    if (!setup_triangle(tri, v1, v2, v3))
+        return false;
+    rasterize_triangle(tri, tri.min_x, tri.min_y, tri.max_x, tri.max_y, &GraphicsSynthesizer::capture_span, simd);
+    sort(rasterized_pixels.begin(), rasterized_pixels.end(), pixel_order);
+    return true;
+}
+
+/**
+ * Checks triangles worked out by hand, so that a bug in the setup shared by both paths can't go unnoticed. Each
+ * pixel is given as x, y, and Z. Returns the number of triangles that came out wrong.
+ */
+int GraphicsSynthesizer::verify_known_triangles(GSContext& ctx)
+{
+    struct KnownTriangle
+    {
+        int32_t coords[3][2];
+        uint32_t z[3];
+        int pixel_count;
+        uint32_t pixels[10][3];
+    };
+
+    static const KnownTriangle known[] =
+    {
+        //Pixels on the top and left edges are drawn and the ones on the hypotenuse aren't. Z = 1000 + 100x + 200y.
+        {{{0, 0}, {4 * 16, 0}, {0, 4 * 16}}, {1000, 1400, 1800}, 10,
+         {{0, 0, 1000}, {1, 0, 1100}, {2, 0, 1200}, {3, 0, 1300}, {0, 1, 1200}, {1, 1, 1300}, {2, 1, 1400},
+          {0, 2, 1400}, {1, 2, 1500}, {0, 3, 1600}}},
+        //The same with half pixel corners and the other winding. (1, 3), (2, 2), and (3, 1) lie on the hypotenuse.
+        //Z = 65436 + 100x + 200y.
+        {{{8, 8}, {8, 56}, {56, 8}}, {65586, 66186, 65886}, 3,
+         {{1, 1, 65736}, {2, 1, 65836}, {1, 2, 65936}}},
+        //A sliver that only crosses the centers of (2, 1) and (2, 2). Flat Z.
+        {{{2 * 16 - 4, 8}, {2 * 16 + 4, 8}, {2 * 16, 3 * 16 - 8}}, {77, 77, 77}, 2,
+         {{2, 1, 77}, {2, 2, 77}}},
+        //No pixel center is inside
+        {{{16 + 2, 16 + 2}, {16 + 14, 16 + 2}, {16 + 2, 16 + 14}}, {0, 0, 0}, 0, {}},
+    };
+
+    int failures = 0;
+    for (int i = 0; i < (int)(sizeof(known) / sizeof(known[0])); i++)
+    {
+        const KnownTriangle& t = known[i];
+        Point v1(t.coords[0][0], t.coords[0][1], t.z[0]);
+        Point v2(t.coords[1][0], t.coords[1][1], t.z[1]);
+        Point v3(t.coords[2][0], t.coords[2][1], t.z[2]);
+        for (int simd = 0; simd < 2; simd++)
+        {
+            capture_triangle(ctx, v1, v2, v3, false, simd);
+            bool match = (int)rasterized_pixels.size() == t.pixel_count;
+            for (int p = 0; match && p < t.pixel_count; p++)
+            {
+                const RasterizedPixel& pixel = rasterized_pixels[p];
+                match = pixel.x == (int32_t)t.pixels[p][0] && pixel.y == (int32_t)t.pixels[p][1] &&
+                        pixel.z == t.pixels[p][2];
+            }
+            if (!match)
+            {
+                WARN_LOG(LOG_GS, "[GS] Known triangle %d came out wrong on the %s path\n", i, simd ? "SSE" : "scalar");
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+/**
+ * Draws two triangles sharing the edge v1-v2, with v3 and v4 on either side of it. Every pixel strictly inside
+ * either one, or on the shared edge between its ends, must be drawn exactly once, and nothing outside both may be
+ * drawn at all. Coverage is checked against exact point in triangle tests rather than the rasterizer's own edges.
+ */
+bool GraphicsSynthesizer::verify_shared_edge(GSContext& ctx, Point v1, Point v2, Point v3, Point v4, bool simd)
+{
+    int32_t x1 = max((min({v1.x, v2.x, v3.x, v4.x}) + 15) >> 4, (int32_t)ctx.scissor.x1 >> 4);
+    int32_t y1 = max((min({v1.y, v2.y, v3.y, v4.y}) + 15) >> 4, (int32_t)ctx.scissor.y1 >> 4);
+    int32_t x2 = min(max({v1.x, v2.x, v3.x, v4.x}) >> 4, (int32_t)ctx.scissor.x2 >> 4);
+    int32_t y2 = min(max({v1.y, v2.y, v3.y, v4.y}) >> 4, (int32_t)ctx.scissor.y2 >> 4);
+    if (x1 > x2 || y1 > y2)
+        return true;
+
+    int32_t width = x2 - x1 + 1;
+    vector<int> coverage(width * (y2 - y1 + 1), 0);
+    for (int t = 0; t < 2; t++)
+    {
+        capture_triangle(ctx, v1, v2, t ? v4 : v3, false, simd);
+        for (size_t p = 0; p < rasterized_pixels.size(); p++)
+            coverage[(rasterized_pixels[p].y - y1) * width + rasterized_pixels[p].x - x1]++;
+    }
+
+    int64_t edge_length = (int64_t)(v2.x - v1.x) * (v2.x - v1.x) + (int64_t)(v2.y - v1.y) * (v2.y - v1.y);
+    for (int32_t y = y1; y <= y2; y++)
+    {
+        for (int32_t x = x1; x <= x2; x++)
+        {
+            int32_t px = x * 16, py = y * 16;
+            int64_t along = (int64_t)(px - v1.x) * (v2.x - v1.x) + (int64_t)(py - v1.y) * (v2.y - v1.y);
+            bool on_edge = !orient(v1, v2, px, py) && along > 0 && along < edge_length;
+            bool must = on_edge || strictly_inside(v1, v2, v3, px, py) || strictly_inside(v1, v2, v4, px, py);
+            bool may = inside_or_on_edge(v1, v2, v3, px, py) || inside_or_on_edge(v1, v2, v4, px, py);
+
+            int count = coverage[(y - y1) * width + x - x1];
+            if (count > 1 || (must && count != 1) || (!may && count))
+            {
+                WARN_LOG(LOG_GS, "[GS] Pixel (%d, %d) drawn %d times by triangles sharing (%d, %d) (%d, %d)\n",
+                         x, y, count, v1.x, v1.y, v2.x, v2.y);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Checks the rasterizer against triangles worked out by hand, then rasterizes count random triangles through both
+ * the SSE path and the scalar one and compares every pixel they hand to the pipeline. Each random triangle also gets
+ * a neighbour across one of its edges, to check that the fill rule draws the pixels along it exactly once. Nothing
+ * is drawn. Returns the number of triangles that came out wrong.
+ */
+int GraphicsSynthesizer::verify_rasterizer(int count, uint32_t seed)
+{
+#ifndef GS_SSE
+    WARN_LOG(LOG_GS, "[GS] Built without SSE, so the rasterizer is only checked against itself\n");
+#endif
+    wait_for_thread();
+
+    //From slivers up to triangles big enough that their edges no longer fit the SSE path
+    static const int32_t sizes[4] = {8, 32, 128, 8192};
+
+    GSContext ctx;
+    ctx.reset();
+    //A small scissor keeps the big triangles cheap while still clipping them
+    ctx.set_scissor(255ULL << 16 | 255ULL << 48);
+
+    int mismatches = verify_known_triangles(ctx);
+
+    uint32_t state = seed ? seed : 1;
+    vector<RasterizedPixel> simd_pixels;
+    for (int i = 0; i < count; i++)
+    {
+        //Vertices are in 12.4 fixed point, and can fall outside the scissor
+        int32_t size = sizes[next_random(state) % 4] * 16;
+        int32_t center_x = (int32_t)(next_random(state) % (384 * 16)) - 64 * 16;
+        int32_t center_y = (int32_t)(next_random(state) % (384 * 16)) - 64 * 16;
+        int32_t coords[4][2];
+        uint32_t colors[3], z[3];
+        for (int k = 0; k < 4; k++)
+        {
+            coords[k][0] = center_x + (int32_t)(next_random(state) % size) - size / 2;
+            coords[k][1] = center_y + (int32_t)(next_random(state) % size) - size / 2;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            z[k] = next_random(state);
+            colors[k] = next_random(state);
+        }
+        Point v1(coords[0][0], coords[0][1], z[0], colors[0], colors[0] >> 8, colors[0] >> 16, colors[0] >> 24);
+        Point v2(coords[1][0], coords[1][1], z[1], colors[1], colors[1] >> 8, colors[1] >> 16, colors[1] >> 24);
+        Point v3(coords[2][0], coords[2][1], z[2], colors[2], colors[2] >> 8, colors[2] >> 16, colors[2] >> 24);
+        bool gourand_shading = next_random(state) & 1;
+
+        if (!capture_triangle(ctx, v1, v2, v3, gourand_shading, true))
+            continue;
+        simd_pixels.swap(rasterized_pixels);
+        capture_triangle(ctx, v1, v2, v3, gourand_shading, false);
+        if (simd_pixels.size() != rasterized_pixels.size() ||
+            !equal(simd_pixels.begin(), simd_pixels.end(), rasterized_pixels.begin(), same_pixel))
+        {
+            WARN_LOG(LOG_GS, "[GS] Rasterizer mismatch on triangle %d: (%d, %d) (%d, %d) (%d, %d), %d pixels vs %d\n",
+                     i, v1.x, v1.y, v2.x, v2.y, v3.x, v3.y, (int)simd_pixels.size(), (int)rasterized_pixels.size());
+            mismatches++;
+            continue;
+        }
+
+        //The neighbour has to be on the other side of v1-v2, so mirror it through the edge's middle if it isn't
+        Point v4(coords[3][0], coords[3][1]);
+        if (sign(orient(v1, v2, v4.x, v4.y)) == sign(orient(v1, v2, v3.x, v3.y)))
+        {
+            v4.x = v1.x + v2.x - v4.x;
+            v4.y = v1.y + v2.y - v4.y;
+        }
+        if (!orient(v1, v2, v4.x, v4.y))
+            continue;
+        if (!verify_shared_edge(ctx, v1, v2, v3, v4, true) || !verify_shared_edge(ctx, v1, v2, v3, v4, false))
+            mismatches++;
+    }
+    rasterized_pixels.clear();
+    return mismatches;
+}
@@ -0,0 +1,172 @@
+#include "idleloop.hpp"
+#include "logger.hpp"
+
+IdleLoopDetector::IdleLoopDetector(const char* name) : name(name)
+{
+    enabled = true;
+}
+
+void IdleLoopDetector::reset()
+{
+    loops.clear();
+}
+
+void IdleLoopDetector::set_enabled(bool enabled)
+{
+    this->enabled = enabled;
+}
+
+void IdleLoopDetector::record_skip(uint32_t start, uint64_t cycles)
+{
+    auto it = loops.find(start);
+    if (it == loops.end())
+        return;
+    it->second.skips++;
+    it->second.cycles_skipped += cycles;
+}
+
+//Whether the idle loop at start read any I/O registers the last time it was checked
+bool IdleLoopDetector::reads_io(uint32_t start)
+{
+    auto it = loops.find(start);
+    return it == loops.end() || it->second.reads_io;
+}
+
+void IdleLoopDetector::print_stats()
+{
+    for (auto it = loops.begin(); it != loops.end(); ++it)
+    {
+        IdleLoop& loop = it->second;
+        if (!loop.skips)
+            continue;
+        INFO_LOG(LOG_EMU, "[%s] Idle loop $%08X-$%08X: %llu skips, %llu cycles skipped\n", name, it->first,
+                 loop.branch_addr + 4, (unsigned long long)loop.skips, (unsigned long long)loop.cycles_skipped);
+    }
+}
+
+/**
+ * Works on the MIPS subset common to the EE and IOP, plus the EE's 64-bit integer ops.
+ * Anything not listed here (stores, traps, coprocessor ops, syscalls, etc.) disqualifies the loop.
+ */
+bool IdleLoopDetector::analyze(const uint32_t* code, int size)
+{
+    uint32_t sources[MAX_IDLE_LOOP_SIZE];
+    uint32_t dests[MAX_IDLE_LOOP_SIZE];
+
+    for (int i = 0; i < size; i++)
+    {
+        uint32_t instruction = code[i];
+        int op = instruction >> 26;
+        int rs = (instruction >> 21) & 0x1F;
+        int rt = (instruction >> 16) & 0x1F;
+        int rd = (instruction >> 11) & 0x1F;
+        bool is_branch_slot = i == size - 2;
+
+        sources[i] = 0;
+        dests[i] = 0;
+        switch (op)
+        {
+            case 0x00:
+                switch (instruction & 0x3F)
+                {
+                    case 0x00: //SLL
+                    case 0x02: //SRL
+                    case 0x03: //SRA
+                    case 0x38: //DSLL
+                    case 0x3A: //DSRL
+                    case 0x3B: //DSRA
+                    case 0x3C: //DSLL32
+                    case 0x3E: //DSRL32
+                    case 0x3F: //DSRA32
+                        sources[i] = 1 << rt;
+                        dests[i] = 1 << rd;
+                        break;
+                    case 0x04: //SLLV
+                    case 0x06: //SRLV
+                    case 0x07: //SRAV
+                    case 0x21: //ADDU
+                    case 0x23: //SUBU
+                    case 0x24: //AND
+                    case 0x25: //OR
+                    case 0x26: //XOR
+                    case 0x27: //NOR
+                    case 0x2A: //SLT
+                    case 0x2B: //SLTU
+                    case 0x2D: //DADDU
+                    case 0x2F: //DSUBU
+                        sources[i] = (1 << rs) | (1 << rt);
+                        dests[i] = 1 << rd;
+                        break;
+                    default:
+                        return false;
+                }
+                break;
+            case 0x01: //BLTZ/BGEZ and their likely forms
+                if (!is_branch_slot || rt > 0x03)
+                    return false;
+                sources[i] = 1 << rs;
+                break;
+            case 0x02: //J
+                if (!is_branch_slot)
+                    return false;
+                break;
+            case 0x04: //BEQ
+            case 0x05: //BNE
+            case 0x14: //BEQL
+            case 0x15: //BNEL
+                if (!is_branch_slot)
+                    return false;
+                sources[i] = (1 << rs) | (1 << rt);
+                break;
+            case 0x06: //BLEZ
+            case 0x07: //BGTZ
+            case 0x16: //BLEZL
+            case 0x17: //BGTZL
+                if (!is_branch_slot)
+                    return false;
+                sources[i] = 1 << rs;
+                break;
+            case 0x09: //ADDIU
+            case 0x0A: //SLTI
+            case 0x0B: //SLTIU
+            case 0x0C: //ANDI
+            case 0x0D: //ORI
+            case 0x0E: //XORI
+            case 0x19: //DADDIU
+            case 0x20: //LB
+            case 0x21: //LH
+            case 0x23: //LW
+            case 0x24: //LBU
+            case 0x25: //LHU
+            case 0x27: //LWU
+            case 0x37: //LD
+                sources[i] = 1 << rs;
+                dests[i] = 1 << rt;
+                break;
+            case 0x0F: //LUI
+                dests[i] = 1 << rt;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    //$zero never carries state
+    uint32_t written_anywhere = 0;
+    for (int i = 0; i < size; i++)
+        written_anywhere |= dests[i];
+    written_anywhere &= ~1;
+
+    //Each iteration must only see values it produced itself, or ones the loop never touches
+    uint32_t written = 0;
+    for (int i = 0; i < size; i++)
+    {
+        if (sources[i] & written_anywhere & ~written)
+            return false;
+        written |= dests[i];
+    }
+
+    //The only control flow allowed is the loop branch itself
+    int branch_op = code[size - 2] >> 26;
+    return branch_op == 0x01 || (branch_op >= 0x02 && branch_op <= 0x07) || (branch_op >= 0x14 && branch_op <= 0x17);
+}
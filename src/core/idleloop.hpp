@@ -0,0 +1,214 @@
+#ifndef IDLELOOP_HPP
+#define IDLELOOP_HPP
+#include <cstdint>
+#include <unordered_map>
+
+/**
+Idle loop detection shared by the EE and IOP.
+
+A short loop is considered idle if it has no stores or other side effects, and every register it reads is either
+never written inside the loop or is written earlier in the same iteration. Each pass through such a loop then
+does exactly the same thing unless memory changes underneath it, so the CPU can skip ahead to the next point where
+something else could have changed it instead of spinning.
+
+Loads are only allowed from plain memory and from I/O registers registered as pure reads, as reading other
+registers can have side effects (popping a FIFO, for instance) that make each pass different. Their addresses depend
+on register values, so they're resolved again each time a loop is used. Whether a loop reads any I/O registers is
+recorded too, as those are how the other CPU can get it going again.
+
+Results are cached by loop start. Idle loops are rechecked against their instructions each time they're used, so
+self-modifying code can't make a busy loop get skipped.
+**/
+
+#define MAX_IDLE_LOOP_SIZE 8
+
+struct IdleLoop
+{
+    uint32_t branch_addr;
+    uint32_t code[MAX_IDLE_LOOP_SIZE];
+    int size;
+    bool idle;
+    bool reads_io;
+
+    uint64_t skips;
+    uint64_t cycles_skipped;
+};
+
+class IdleLoopDetector
+{
+    private:
+        const char* name;
+        bool enabled;
+        std::unordered_map<uint32_t, IdleLoop> loops;
+
+        static bool analyze(const uint32_t* code, int size);
+        template <class CPU> static uint32_t read_gpr(CPU& cpu, int id);
+        template <class CPU> static bool loads_are_pure(CPU& cpu, const uint32_t* code, int size, bool& reads_io);
+    public:
+        IdleLoopDetector(const char* name);
+
+        void reset();
+        void set_enabled(bool enabled);
+
+        template <class CPU> bool is_idle_loop(CPU& cpu, uint32_t start, uint32_t branch_addr);
+        template <class CPU> bool can_skip(CPU& cpu, uint32_t start);
+        void record_skip(uint32_t start, uint64_t cycles);
+        bool reads_io(uint32_t start);
+        void print_stats();
+};
+
+//CPUs whose get_gpr isn't a plain 32-bit read specialize this
+template <class CPU>
+inline uint32_t IdleLoopDetector::read_gpr(CPU& cpu, int id)
+{
+    return cpu.get_gpr(id);
+}
+
+/**
+ * Checks that every load in an idle loop reads plain memory or a pure I/O register, given the CPU's current registers.
+ * Base registers the loop writes itself are followed through LUI/ORI/ADDIU; loads based on anything else the loop
+ * computes are rejected.
+ */
+template <class CPU>
+inline bool IdleLoopDetector::loads_are_pure(CPU& cpu, const uint32_t* code, int size, bool& reads_io)
+{
+    uint32_t values[32];
+    uint32_t written = 0;
+    uint32_t known = 0;
+    reads_io = false;
+    for (int i = 0; i < size; i++)
+    {
+        uint32_t instruction = code[i];
+        int op = instruction >> 26;
+        int rs = (instruction >> 21) & 0x1F;
+        int rt = (instruction >> 16) & 0x1F;
+        int rd = (instruction >> 11) & 0x1F;
+
+        uint32_t base = 0;
+        bool base_known = true;
+        if (rs && (written & (1 << rs)))
+        {
+            base_known = known & (1 << rs);
+            base = values[rs];
+        }
+        else if (rs)
+            base = read_gpr(cpu, rs);
+
+        switch (op)
+        {
+            case 0x00:
+                written |= 1 << rd;
+                known &= ~(1 << rd);
+                continue;
+            case 0x09: //ADDIU
+            case 0x19: //DADDIU
+                values[rt] = base + (int16_t)(instruction & 0xFFFF);
+                break;
+            case 0x0D: //ORI
+                values[rt] = base | (instruction & 0xFFFF);
+                break;
+            case 0x0F: //LUI
+                values[rt] = instruction << 16;
+                base_known = true;
+                break;
+            case 0x20: //LB
+            case 0x21: //LH
+            case 0x23: //LW
+            case 0x24: //LBU
+            case 0x25: //LHU
+            case 0x27: //LWU
+            case 0x37: //LD
+            {
+                if (!base_known)
+                    return false;
+                static const int widths[8] = {1, 2, 0, 4, 1, 2, 0, 4};
+                uint32_t addr = base + (int16_t)(instruction & 0xFFFF);
+                if (!cpu.is_memory_address(addr))
+                {
+                    if (!cpu.is_pure_io_read(addr, (op == 0x37) ? 8 : widths[op & 0x7]))
+                        return false;
+                    reads_io = true;
+                }
+                base_known = false;
+                break;
+            }
+            case 0x01:
+            case 0x02:
+            case 0x04:
+            case 0x05:
+            case 0x06:
+            case 0x07:
+            case 0x14:
+            case 0x15:
+            case 0x16:
+            case 0x17:
+                //Branches don't write registers
+                continue;
+            default:
+                base_known = false;
+                break;
+        }
+        written |= 1 << rt;
+        if (base_known)
+            known |= 1 << rt;
+        else
+            known &= ~(1 << rt);
+    }
+    return true;
+}
+
+/**
+ * start is the target of a taken backwards branch at branch_addr. The loop includes the delay slot.
+ * CPU needs read32, get_gpr (see read_gpr), is_memory_address, and is_pure_io_read methods.
+ */
+template <class CPU>
+inline bool IdleLoopDetector::is_idle_loop(CPU& cpu, uint32_t start, uint32_t branch_addr)
+{
+    if (!enabled || start > branch_addr)
+        return false;
+    int size = ((branch_addr - start) >> 2) + 2;
+    if (size > MAX_IDLE_LOOP_SIZE)
+        return false;
+
+    //Loops already known not to be idle aren't rechecked, as that would cost a few reads on every iteration
+    auto it = loops.find(start);
+    bool known = it != loops.end() && it->second.branch_addr == branch_addr && it->second.size == size;
+    if (known && !it->second.idle)
+        return false;
+
+    uint32_t code[MAX_IDLE_LOOP_SIZE];
+    for (int i = 0; i < size; i++)
+        code[i] = cpu.read32(start + (i << 2));
+
+    if (known)
+    {
+        bool same = true;
+        for (int i = 0; same && i < size; i++)
+            same = it->second.code[i] == code[i];
+        if (same)
+            return loads_are_pure(cpu, code, size, it->second.reads_io);
+    }
+
+    IdleLoop& loop = loops[start];
+    loop.branch_addr = branch_addr;
+    loop.size = size;
+    for (int i = 0; i < size; i++)
+        loop.code[i] = code[i];
+    loop.idle = analyze(code, size);
+    loop.skips = 0;
+    loop.cycles_skipped = 0;
+    loop.reads_io = false;
+    return loop.idle && loads_are_pure(cpu, code, size, loop.reads_io);
+}
+
+//For callers that found the loop at start idle before, and may be running it with different registers since
+template <class CPU>
+inline bool IdleLoopDetector::can_skip(CPU& cpu, uint32_t start)
+{
+    auto it = loops.find(start);
+    if (!enabled || it == loops.end() || !it->second.idle)
+        return false;
+    return loads_are_pure(cpu, it->second.code, it->second.size, it->second.reads_io);
+}
+
+#endif // IDLELOOP_HPP
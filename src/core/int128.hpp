@@ -0,0 +1,47 @@
+#ifndef INT128_HPP
+#define INT128_HPP
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define INT128_SSE
+#endif
+
+/**
+A quadword, the EE's natural 128-bit unit for LQ/SQ, DMA, and the GIF.
+load128/store128 move one in or out of host memory with a single unaligned SSE load or store where available.
+**/
+
+union alignas(16) uint128_t
+{
+    uint64_t _u64[2];
+    uint32_t _u32[4];
+    uint16_t _u16[8];
+    uint8_t _u8[16];
+#ifdef INT128_SSE
+    __m128i _sse;
+#endif
+};
+
+inline uint128_t load128(const void* mem)
+{
+    uint128_t value;
+#ifdef INT128_SSE
+    value._sse = _mm_loadu_si128((const __m128i*)mem);
+#else
+    memcpy(&value, mem, 16);
+#endif
+    return value;
+}
+
+inline void store128(void* mem, uint128_t value)
+{
+#ifdef INT128_SSE
+    _mm_storeu_si128((__m128i*)mem, value._sse);
+#else
+    memcpy(mem, &value, 16);
+#endif
+}
+
+#endif // INT128_HPP
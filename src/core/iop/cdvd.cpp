@@ -1,11 +1,17 @@
 #include "../emulator.hpp"
+#include "../logger.hpp"
+#include "../mmio.hpp"
+#include "../scheduler.hpp"
 #include "cdvd.hpp"
 
+//Time between a read command being issued and the drive signalling it's ready to transfer
+#define CDVD_READ_DELAY 4000
+
 using namespace std;
 
-CDVD_Drive::CDVD_Drive(Emulator* e) : e(e)
+CDVD_Drive::CDVD_Drive(Emulator* e, Scheduler* scheduler) : e(e), scheduler(scheduler)
 {
-
+    read_event_id = scheduler->register_function([this] (uint64_t param) { read_ready(); });
 }
 
 CDVD_Drive::~CDVD_Drive()
@@ -26,6 +32,27 @@ void CDVD_Drive::reset()
     ISTAT = 0;
 }
 
+void CDVD_Drive::map_registers(MMIOTable* mmio)
+{
+    mmio->map_read(0x1F402004, 1, [this] (uint32_t addr) { return read_N_callback(); }, true);
+    mmio->map_read(0x1F402005, 1, [this] (uint32_t addr) { return read_N_status(); }, true);
+    mmio->map_read(0x1F402008, 1, [this] (uint32_t addr) { return read_ISTAT(); }, true);
+    mmio->map_read(0x1F40200F, 1, [this] (uint32_t addr) { return read_disc_type(); }, true);
+    mmio->map_read(0x1F402016, 1, [this] (uint32_t addr) { return read_S_command(); }, true);
+    mmio->map_read(0x1F402017, 1, [this] (uint32_t addr) { return read_S_status(); }, true);
+    mmio->map_read(0x1F402018, 1, [this] (uint32_t addr) { return read_S_data(); });
+
+    mmio->map_write(0x1F402004, 1, [this] (uint32_t addr, uint64_t value) { send_N_command(value); });
+    mmio->map_write(0x1F402005, 1, [this] (uint32_t addr, uint64_t value) { write_N_data(value); });
+    mmio->map_write(0x1F402006, 1, [] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_CDVD, "[CDVD] Write to mode: $%02X\n", (uint8_t)value);
+    });
+    mmio->map_write(0x1F402008, 1, [this] (uint32_t addr, uint64_t value) { write_ISTAT(value); });
+    mmio->map_write(0x1F402016, 1, [this] (uint32_t addr, uint64_t value) { send_S_command(value); });
+    mmio->map_write(0x1F402017, 1, [this] (uint32_t addr, uint64_t value) { write_S_data(value); });
+}
+
 int CDVD_Drive::bytes_left()
 {
     return read_bytes_left;
@@ -52,7 +79,7 @@ bool CDVD_Drive::load_disc(const char *name)
     if (!cdvd_file.is_open())
         return false;
 
-    printf("[CDVD] Locating Primary Volume Descriptor\n");
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Locating Primary Volume Descriptor\n");
     uint8_t type = 0;
     int sector = 0x0F;
     while (type != 1)
@@ -61,19 +88,19 @@ bool CDVD_Drive::load_disc(const char *name)
         cdvd_file.seekg(sector * 2048);
         cdvd_file >> type;
     }
-    printf("[CDVD] Primary Volume Descriptor found at sector %d\n", sector);
+    INFO_LOG(LOG_CDVD, "[CDVD] Primary Volume Descriptor found at sector %d\n", sector);
 
     cdvd_file.seekg(sector * 2048);
     cdvd_file.read((char*)pvd_sector, 2048);
 
     LBA = *(uint16_t*)&pvd_sector[128];
-    printf("[CDVD] PVD LBA: $%08X\n", LBA);
+    DEBUG_LOG(LOG_CDVD, "[CDVD] PVD LBA: $%08X\n", LBA);
 
     root_location = *(uint32_t*)&pvd_sector[156 + 2] * LBA;
     root_len = *(uint32_t*)&pvd_sector[156 + 10];
-    printf("[CDVD] Root dir len: %d\n", *(uint16_t*)&pvd_sector[156]);
-    printf("[CDVD] Extent loc: $%08X\n", root_location);
-    printf("[CDVD] Extent len: $%08X\n", root_len);
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Root dir len: %d\n", *(uint16_t*)&pvd_sector[156]);
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Extent loc: $%08X\n", root_location);
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Extent len: $%08X\n", root_len);
     return true;
 }
 
@@ -86,7 +113,7 @@ uint8_t* CDVD_Drive::read_file(string name, uint32_t& file_size)
     uint32_t file_location = 0;
     uint8_t* file;
     file_size = 0;
-    printf("[CDVD] Finding %s...\n", name.c_str());
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Finding %s...\n", name.c_str());
     while (bytes < root_len)
     {
         int directory_len = root_extent[bytes + 32];
@@ -103,11 +130,11 @@ uint8_t* CDVD_Drive::read_file(string name, uint32_t& file_size)
             }
             if (match)
             {
-                printf("[CDVD] Match found!\n");
+                DEBUG_LOG(LOG_CDVD, "[CDVD] Match found!\n");
                 file_location = *(uint32_t*)&root_extent[bytes + 2] * LBA;
                 file_size = *(uint32_t*)&root_extent[bytes + 10];
-                printf("[CDVD] Location: $%08X\n", file_location);
-                printf("[CDVD] Size: $%08X\n", file_size);
+                DEBUG_LOG(LOG_CDVD, "[CDVD] Location: $%08X\n", file_location);
+                DEBUG_LOG(LOG_CDVD, "[CDVD] Size: $%08X\n", file_size);
 
                 file = new uint8_t[file_size];
                 cdvd_file.seekg(file_location);
@@ -154,7 +181,7 @@ uint8_t CDVD_Drive::read_S_data()
     if (S_out_params <= 0)
         return 0;
     uint8_t value = S_outdata[S_params];
-    printf("[CDVD] Read S data: $%02X\n", value);
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Read S data: $%02X\n", value);
     S_params++;
     S_out_params--;
     if (S_out_params == 0)
@@ -178,7 +205,7 @@ void CDVD_Drive::send_N_command(uint8_t value)
             N_command_read();
             break;
         default:
-            printf("[CDVD] Unrecognized N command $%02X\n", value);
+            ERROR_LOG(LOG_CDVD, "[CDVD] Unrecognized N command $%02X\n", value);
             exit(1);
     }
     N_params = 0;
@@ -186,10 +213,10 @@ void CDVD_Drive::send_N_command(uint8_t value)
 
 void CDVD_Drive::write_N_data(uint8_t value)
 {
-    printf("[CVD] Write NDATA: $%02X\n", value);
+    DEBUG_LOG(LOG_CDVD, "[CVD] Write NDATA: $%02X\n", value);
     if (N_params > 10)
     {
-        printf("[CDVD] Excess NDATA params!\n");
+        ERROR_LOG(LOG_CDVD, "[CDVD] Excess NDATA params!\n");
         exit(1);
     }
     else
@@ -201,7 +228,7 @@ void CDVD_Drive::write_N_data(uint8_t value)
 
 void CDVD_Drive::send_S_command(uint8_t value)
 {
-    printf("[CDVD] Send S command: $%02X\n", value);
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Send S command: $%02X\n", value);
     S_status &= ~0x40;
     S_command = value;
     switch (value)
@@ -210,28 +237,28 @@ void CDVD_Drive::send_S_command(uint8_t value)
             S_command_sub(S_command_params[0]);
             break;
         case 0x05:
-            printf("[CDVD] Media Change?\n");
+            DEBUG_LOG(LOG_CDVD, "[CDVD] Media Change?\n");
             prepare_S_outdata(1);
             S_outdata[0] = 0;
             break;
         case 0x08:
-            printf("[CDVD] ReadClock\n");
+            DEBUG_LOG(LOG_CDVD, "[CDVD] ReadClock\n");
             prepare_S_outdata(8);
             for (int i = 0; i < 8; i++)
                 S_outdata[i] = 0;
             break;
         default:
-            printf("[CDVD] Unrecognized S command $%02X\n", value);
+            ERROR_LOG(LOG_CDVD, "[CDVD] Unrecognized S command $%02X\n", value);
             exit(1);
     }
 }
 
 void CDVD_Drive::write_S_data(uint8_t value)
 {
-    printf("[CDVD] Write SDATA: $%02X (%d)\n", value, S_params);
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Write SDATA: $%02X (%d)\n", value, S_params);
     if (S_params > 15)
     {
-        printf("[CDVD] Excess SDATA params!\n");
+        ERROR_LOG(LOG_CDVD, "[CDVD] Excess SDATA params!\n");
         exit(1);
     }
     else
@@ -245,7 +272,7 @@ void CDVD_Drive::prepare_S_outdata(int amount)
 {
     if (amount > 15)
     {
-        printf("[CDVD] Excess S outdata! (%d)\n", amount);
+        ERROR_LOG(LOG_CDVD, "[CDVD] Excess S outdata! (%d)\n", amount);
         exit(1);
     }
     S_out_params = amount;
@@ -257,10 +284,15 @@ void CDVD_Drive::N_command_read()
 {
     uint32_t seek_pos = *(uint32_t*)&N_command_params[0];
     uint32_t sectors = *(uint32_t*)&N_command_params[4];
-    printf("[CDVD] Read; Seek pos: $%08X, Data: $%08X\n", seek_pos * 2048, sectors * 2048);
+    DEBUG_LOG(LOG_CDVD, "[CDVD] Read; Seek pos: $%08X, Data: $%08X\n", seek_pos * 2048, sectors * 2048);
     read_bytes_left = sectors * 2048;
     N_callback = 0;
     cdvd_file.seekg(seek_pos * 2048);
+    scheduler->add_event(read_event_id, CDVD_READ_DELAY);
+}
+
+void CDVD_Drive::read_ready()
+{
     e->iop_request_IRQ(2);
 }
 
@@ -269,12 +301,12 @@ void CDVD_Drive::S_command_sub(uint8_t func)
     switch (func)
     {
         case 0x00:
-            printf("[CDVD] GetMecaconVersion\n");
+            DEBUG_LOG(LOG_CDVD, "[CDVD] GetMecaconVersion\n");
             prepare_S_outdata(4);
             *(uint32_t*)&S_outdata[0] = 0x00020603;
             break;
         default:
-            printf("[CDVD] Unrecognized sub (0x3) S command $%02X\n", func);
+            ERROR_LOG(LOG_CDVD, "[CDVD] Unrecognized sub (0x3) S command $%02X\n", func);
             exit(1);
     }
 }
@@ -3,11 +3,14 @@
 #include <fstream>
 
 class Emulator;
+class MMIOTable;
+class Scheduler;
 
 class CDVD_Drive
 {
     private:
         Emulator* e;
+        Scheduler* scheduler;
         std::ifstream cdvd_file;
         int read_bytes_left;
 
@@ -18,6 +21,8 @@ class CDVD_Drive
 
         uint8_t ISTAT;
 
+        int read_event_id;
+
         uint8_t N_command_params[11];
         uint8_t N_callback;
         uint8_t N_params;
@@ -33,12 +38,14 @@ class CDVD_Drive
         void prepare_S_outdata(int amount);
 
         void N_command_read();
+        void read_ready();
         void S_command_sub(uint8_t func);
     public:
-        CDVD_Drive(Emulator* e);
+        CDVD_Drive(Emulator* e, Scheduler* scheduler);
         ~CDVD_Drive();
 
         void reset();
+        void map_registers(MMIOTable* mmio);
         int bytes_left();
 
         void read_to_RAM(uint8_t* RAM, uint32_t bytes);
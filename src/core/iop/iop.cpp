@@ -5,8 +5,9 @@
 
 #include "../emulator.hpp"
 #include "../ee/emotiondisasm.hpp"
+#include "../logger.hpp"
 
-IOP::IOP(Emulator* e) : e(e)
+IOP::IOP(Emulator* e) : e(e), idle_loops("IOP")
 {
 
 }
@@ -36,6 +37,10 @@ void IOP::reset()
     will_branch = false;
     inc_PC = true;
     can_disassemble = false;
+    cycles_run = 0;
+    idle_loop_hit = false;
+    skipped_idle = false;
+    idle_loops.reset();
 }
 
 uint32_t IOP::translate_addr(uint32_t addr)
@@ -51,12 +56,31 @@ uint32_t IOP::translate_addr(uint32_t addr)
     return addr;
 }
 
-void IOP::run()
+void IOP::run(int cycles)
+{
+    skipped_idle = false;
+    for (cycles_run = 0; cycles_run < cycles; cycles_run++)
+    {
+        step();
+
+        //Pending interrupts were already taken by step(), so nothing can change until the next slice
+        if (idle_loop_hit)
+        {
+            idle_loop_hit = false;
+            idle_loops.record_skip(PC, cycles - cycles_run - 1);
+            skipped_idle = true;
+            break;
+        }
+    }
+    cycles_run = 0;
+}
+
+void IOP::step()
 {
     //bool old_int = cop0.status.IEc && (cop0.status.Im & cop0.cause.int_pending);
     uint32_t instr = read32(PC);
     if (can_disassemble)
-        printf("[IOP] [$%08X] $%08X - %s\n", PC, instr, EmotionDisasm::disasm_instr(instr, PC).c_str());
+        INFO_LOG(LOG_IOP, "[IOP] [$%08X] $%08X - %s\n", PC, instr, EmotionDisasm::disasm_instr(instr, PC).c_str());
     IOP_Interpreter::interpret(*this, instr);
 
     if (inc_PC)
@@ -69,6 +93,11 @@ void IOP::run()
         if (!load_delay)
         {
             will_branch = false;
+
+            //PC is just past the delay slot here
+            if (new_PC < PC && idle_loops.is_idle_loop(*this, new_PC, PC - 8))
+                idle_loop_hit = true;
+
             PC = new_PC;
             if (PC == 0x86D0 || PC == 0x90E0)
                 e->iop_ksprintf();
@@ -78,7 +107,20 @@ void IOP::run()
     }
 
     if (cop0.status.IEc && (cop0.status.Im & cop0.cause.int_pending))
+    {
+        idle_loop_hit = false;
         interrupt();
+    }
+}
+
+void IOP::set_idle_loop_detection(bool enabled)
+{
+    idle_loops.set_enabled(enabled);
+}
+
+void IOP::print_idle_loop_stats()
+{
+    idle_loops.print_stats();
 }
 
 void IOP::set_disassembly(bool dis)
@@ -127,7 +169,7 @@ void IOP::handle_exception(uint32_t addr, uint8_t cause)
 void IOP::syscall_exception()
 {
     uint8_t op = read8(PC - 4);
-    printf("[IOP] SYSCALL: $%02X\n", op);
+    DEBUG_LOG(LOG_IOP, "[IOP] SYSCALL: $%02X\n", op);
     handle_exception(0x80000080, 0x08);
     //can_disassemble = true;
 }
@@ -148,7 +190,7 @@ void IOP::interrupt_check(bool i_pass)
 
 void IOP::interrupt()
 {
-    printf("[IOP] Processing interrupt!\n");
+    DEBUG_LOG(LOG_IOP, "[IOP] Processing interrupt!\n");
     handle_exception(0x80000080, 0x00);
     //can_disassemble = true;
 }
@@ -161,7 +203,7 @@ void IOP::mfc(int cop_id, int cop_reg, int reg)
             set_gpr(reg, cop0.mfc(cop_reg));
             break;
         default:
-            printf("\n[IOP] MFC: Unknown COP%d", cop_id);
+            ERROR_LOG(LOG_IOP, "[IOP] MFC: Unknown COP%d\n", cop_id);
             exit(1);
     }
 }
@@ -175,7 +217,7 @@ void IOP::mtc(int cop_id, int cop_reg, int reg)
             cop0.mtc(cop_reg, bark);
             break;
         default:
-            printf("\n[IOP] MTC: Unknown COP%d", cop_id);
+            ERROR_LOG(LOG_IOP, "[IOP] MTC: Unknown COP%d\n", cop_id);
             exit(1);
     }
 }
@@ -187,7 +229,7 @@ void IOP::rfe()
 
     cop0.status.IEc = cop0.status.IEp;
     cop0.status.IEp = cop0.status.IEo;
-    printf("[IOP] RFE!\n");
+    DEBUG_LOG(LOG_IOP, "[IOP] RFE!\n");
     //can_disassemble = false;
 }
 
@@ -206,6 +248,12 @@ uint32_t IOP::read32(uint32_t addr)
     return e->iop_read32(translate_addr(addr));
 }
 
+//For addresses is_memory_address rejects. Width is the access size in bytes.
+bool IOP::is_pure_io_read(uint32_t addr, int width)
+{
+    return e->iop_is_pure_read(translate_addr(addr), width);
+}
+
 void IOP::write8(uint32_t addr, uint8_t value)
 {
     if (cop0.status.IsC)
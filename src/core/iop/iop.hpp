@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include "iop_cop0.hpp"
+#include "../idleloop.hpp"
 
 class Emulator;
 
@@ -21,14 +22,26 @@ class IOP
         bool will_branch;
         bool inc_PC;
 
+        IdleLoopDetector idle_loops;
+        bool idle_loop_hit;
+        bool skipped_idle;
+
         uint32_t translate_addr(uint32_t addr);
+
+        //IOP cycles run so far in the current call to run()
+        int cycles_run;
     public:
         IOP(Emulator* e);
         static const char* REG(int id);
 
         void reset();
-        void run();
+        void run(int cycles);
+        int get_slice_progress();
+        bool is_idle();
+        void step();
         void set_disassembly(bool dis);
+        void set_idle_loop_detection(bool enabled);
+        void print_idle_loop_stats();
 
         void jp(uint32_t addr);
         void branch(bool condition, int32_t offset);
@@ -55,11 +68,25 @@ class IOP
         uint8_t read8(uint32_t addr);
         uint16_t read16(uint32_t addr);
         uint32_t read32(uint32_t addr);
+        bool is_memory_address(uint32_t addr);
+        bool is_pure_io_read(uint32_t addr, int width);
         void write8(uint32_t addr, uint8_t value);
         void write16(uint32_t addr, uint16_t value);
         void write32(uint32_t addr, uint32_t value);
 };
 
+inline int IOP::get_slice_progress()
+{
+    return cycles_run;
+}
+
+//True if the last slice ended by skipping an idle loop. The IOP stops right after the loop's branch, so it's
+//still sitting at the start of it.
+inline bool IOP::is_idle()
+{
+    return skipped_idle;
+}
+
 inline uint32_t IOP::get_PC()
 {
     return PC;
@@ -70,6 +97,13 @@ inline uint32_t IOP::get_gpr(int index)
     return gpr[index];
 }
 
+//True if addr reads RAM or the BIOS rather than an I/O register
+inline bool IOP::is_memory_address(uint32_t addr)
+{
+    addr = translate_addr(addr);
+    return addr < 0x00200000 || (addr >= 0x1FC00000 && addr < 0x20000000);
+}
+
 inline uint32_t IOP::get_LO()
 {
     return LO;
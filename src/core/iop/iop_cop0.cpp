@@ -1,7 +1,8 @@
-#include <cstdio>
 #include <cstdlib>
 #include "iop_cop0.hpp"
 
+#include "../logger.hpp"
+
 IOP_Cop0::IOP_Cop0()
 {
 
@@ -26,7 +27,7 @@ void IOP_Cop0::reset()
 
 uint32_t IOP_Cop0::mfc(int cop_reg)
 {
-    //printf("[IOP COP0] MFC: Read from %d\n", cop_reg);
+    //DEBUG_LOG(LOG_IOP, "[IOP COP0] MFC: Read from %d\n", cop_reg);
     switch (cop_reg)
     {
         case 12:
@@ -56,14 +57,14 @@ uint32_t IOP_Cop0::mfc(int cop_reg)
         case 15:
             return 0x1F;
         default:
-            printf("[IOP COP0] MFC: Unknown cop_reg %d\n", cop_reg);
+            ERROR_LOG(LOG_IOP, "[IOP COP0] MFC: Unknown cop_reg %d\n", cop_reg);
             exit(1);
     }
 }
 
 void IOP_Cop0::mtc(int cop_reg, uint32_t value)
 {
-    //printf("[IOP COP0] MTC: Write to %d of $%08X\n", cop_reg, value);
+    //DEBUG_LOG(LOG_IOP, "[IOP COP0] MTC: Write to %d of $%08X\n", cop_reg, value);
     switch (cop_reg)
     {
         case 12:
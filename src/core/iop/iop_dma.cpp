@@ -1,8 +1,9 @@
-#include <cstdio>
 #include "cdvd.hpp"
 #include "iop_dma.hpp"
 
 #include "../emulator.hpp"
+#include "../logger.hpp"
+#include "../mmio.hpp"
 #include "../sif.hpp"
 
 enum CHANNELS
@@ -54,30 +55,78 @@ void IOP_DMA::reset(uint8_t* RAM)
     DICR.MASK[1] = 0;
     DICR.master_int_enable[0] = false;
     DICR.master_int_enable[1] = false;
+    active_channels = 0;
 }
 
-void IOP_DMA::run()
+void IOP_DMA::map_registers(MMIOTable* mmio)
 {
-    for (int i = 0; i < 16; i++)
+    mmio->map_read(0x1F8010F0, 4, [this] (uint32_t addr) { return get_DPCR(); }, true);
+    mmio->map_read(0x1F8010F4, 4, [this] (uint32_t addr) { return get_DICR(); }, true);
+    mmio->map_read(0x1F801570, 4, [this] (uint32_t addr) { return get_DPCR2(); }, true);
+    mmio->map_read(0x1F801574, 4, [this] (uint32_t addr) { return get_DICR2(); }, true);
+    mmio->map_write(0x1F8010F0, 4, [this] (uint32_t addr, uint64_t value) { set_DPCR(value); });
+    mmio->map_write(0x1F8010F4, 4, [this] (uint32_t addr, uint64_t value) { set_DICR(value); });
+    mmio->map_write(0x1F801570, 4, [this] (uint32_t addr, uint64_t value) { set_DPCR2(value); });
+    mmio->map_write(0x1F801574, 4, [this] (uint32_t addr, uint64_t value) { set_DICR2(value); });
+
+    //CDVD
+    mmio->map_read(0x1F8010B8, 4, [this] (uint32_t addr) { return get_chan_control(CDVD); }, true);
+    mmio->map_write(0x1F8010B0, 4, [this] (uint32_t addr, uint64_t value) { set_chan_addr(CDVD, value); });
+    mmio->map_write(0x1F8010B4, 4, [this] (uint32_t addr, uint64_t value) { set_chan_block(CDVD, value); });
+    mmio->map_write(0x1F8010B8, 4, [this] (uint32_t addr, uint64_t value) { set_chan_control(CDVD, value); });
+
+    //SIF0
+    mmio->map_read(0x1F801528, 4, [this] (uint32_t addr) { return get_chan_control(SIF0); }, true);
+    mmio->map_write(0x1F801520, 4, [this] (uint32_t addr, uint64_t value) { set_chan_addr(SIF0, value); });
+    mmio->map_write(0x1F801524, 4, [this] (uint32_t addr, uint64_t value) { set_chan_block(SIF0, value); });
+    mmio->map_write(0x1F801524, 2, [this] (uint32_t addr, uint64_t value) { set_chan_size(SIF0, value); });
+    mmio->map_write(0x1F801528, 4, [this] (uint32_t addr, uint64_t value) { set_chan_control(SIF0, value); });
+    mmio->map_write(0x1F80152C, 4, [this] (uint32_t addr, uint64_t value) { set_chan_tag_addr(SIF0, value); });
+
+    //SIF1
+    mmio->map_write(0x1F801530, 4, [this] (uint32_t addr, uint64_t value) { set_chan_addr(SIF1, value); });
+    mmio->map_write(0x1F801534, 4, [this] (uint32_t addr, uint64_t value) { set_chan_block(SIF1, value); });
+    mmio->map_write(0x1F801534, 2, [this] (uint32_t addr, uint64_t value) { set_chan_size(SIF1, value); });
+    mmio->map_write(0x1F801536, 2, [this] (uint32_t addr, uint64_t value) { set_chan_count(SIF1, value); });
+    mmio->map_write(0x1F801538, 4, [this] (uint32_t addr, uint64_t value) { set_chan_control(SIF1, value); });
+}
+
+void IOP_DMA::run(int cycles)
+{
+    //Each active channel gets a turn per cycle, moving one word, or for SIF as much as the FIFO allows.
+    //Stop early once everything is idle.
+    for (int cycle = 0; cycle < cycles && active_channels; cycle++)
     {
-        if (DPCR.enable[i] && channels[i].control.busy)
+        for (int i = 0; i < 16; i++)
         {
-            switch (i)
+            if (active_channels & (1 << i))
             {
-                case CDVD:
-                    process_CDVD();
-                    break;
-                case SIF0:
-                    process_SIF0();
-                    break;
-                case SIF1:
-                    process_SIF1();
-                    break;
+                switch (i)
+                {
+                    case CDVD:
+                        process_CDVD();
+                        break;
+                    case SIF0:
+                        process_SIF0();
+                        break;
+                    case SIF1:
+                        process_SIF1();
+                        break;
+                }
             }
         }
     }
 }
 
+//A channel only runs while it's both enabled in DPCR and started in its CHCR
+void IOP_DMA::update_active(int index)
+{
+    if (DPCR.enable[index] && channels[index].control.busy)
+        active_channels |= 1 << index;
+    else
+        active_channels &= ~(1 << index);
+}
+
 void IOP_DMA::process_CDVD()
 {
     if (cdvd->bytes_left() > 0)
@@ -92,17 +141,20 @@ void IOP_DMA::process_CDVD()
     }
 }
 
+//Copies straight from RAM into the FIFO, as much as there's room for
 void IOP_DMA::process_SIF0()
 {
     if (channels[SIF0].word_count)
     {
-        if (sif->get_SIF0_size() < SubsystemInterface::MAX_FIFO_SIZE)
+        int words = SubsystemInterface::MAX_FIFO_SIZE - sif->get_SIF0_size();
+        if (words > channels[SIF0].word_count)
+            words = channels[SIF0].word_count;
+        if (words)
         {
-            uint32_t data = *(uint32_t*)&RAM[channels[SIF0].addr];
-            sif->write_SIF0(data);
+            sif->write_SIF0((uint32_t*)&RAM[channels[SIF0].addr], words);
 
-            channels[SIF0].addr += 4;
-            channels[SIF0].word_count--;
+            channels[SIF0].addr += words * 4;
+            channels[SIF0].word_count -= words;
         }
     }
     else
@@ -117,37 +169,37 @@ void IOP_DMA::process_SIF0()
             uint32_t data = *(uint32_t*)&RAM[channels[SIF0].tag_addr];
             uint32_t words = *(uint32_t*)&RAM[channels[SIF0].tag_addr + 4];
             //Transfer EEtag
-            sif->write_SIF0(*(uint32_t*)&RAM[channels[SIF0].tag_addr + 8]);
-            sif->write_SIF0(*(uint32_t*)&RAM[channels[SIF0].tag_addr + 12]);
+            sif->write_SIF0((uint32_t*)&RAM[channels[SIF0].tag_addr + 8], 2);
 
             channels[SIF0].addr = data & 0xFFFFFF;
             channels[SIF0].word_count = (words + 3) & 0xFFFFFFFC; //round to nearest 4?
 
             channels[SIF0].tag_addr += 16;
 
-            printf("[IOP DMA] Read SIF0 DMAtag!\n");
-            printf("Data: $%08X\n", data);
-            printf("Words: $%08X\n", channels[SIF0].word_count);
+            DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] Read SIF0 DMAtag!\n");
+            DEBUG_LOG(LOG_IOP_DMA, "Data: $%08X\n", data);
+            DEBUG_LOG(LOG_IOP_DMA, "Words: $%08X\n", channels[SIF0].word_count);
 
             if ((data & (1 << 31)) || (data & (1 << 30)))
                 channels[SIF0].tag_end = true;
         }
-        //printf("[IOP DMA] SIF0 no data!\n");
+        //DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] SIF0 no data!\n");
     }
 }
 
+//Copies straight out of the FIFO into RAM, as much as is there
 void IOP_DMA::process_SIF1()
 {
     if (channels[SIF1].word_count)
     {
-        if (sif->get_SIF1_size() > 0)
+        int words = sif->get_SIF1_size();
+        if (words > channels[SIF1].word_count)
+            words = channels[SIF1].word_count;
+        if (words)
         {
-            uint32_t data = sif->read_SIF1();
-            printf("[IOP DMA] SIF1: Transfer to $%08X of $%08X\n", channels[SIF1].addr, data);
-
-            *(uint32_t*)&RAM[channels[SIF1].addr] = data;
-            channels[SIF1].addr += 4;
-            channels[SIF1].word_count--;
+            sif->read_SIF1((uint32_t*)&RAM[channels[SIF1].addr], words);
+            channels[SIF1].addr += words * 4;
+            channels[SIF1].word_count -= words;
         }
     }
     else
@@ -158,17 +210,16 @@ void IOP_DMA::process_SIF1()
         }
         else if (sif->get_SIF1_size() >= 4)
         {
-            //Read IOP DMAtag
-            uint32_t data = sif->read_SIF1();
+            //IOP DMAtag, then the EEtag which isn't needed here
+            uint32_t tag[4];
+            sif->read_SIF1(tag, 4);
+            uint32_t data = tag[0];
             channels[SIF1].addr = data & 0xFFFFFF;
-            channels[SIF1].word_count = sif->read_SIF1();
-
-            //EEtag
-            sif->read_SIF1();
-            sif->read_SIF1();
-            printf("[IOP DMA] Read SIF1 DMAtag!\n");
-            printf("Addr: $%08X\n", channels[SIF1].addr);
-            printf("Words: $%08X\n", channels[SIF1].word_count);
+            channels[SIF1].word_count = tag[1];
+
+            DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] Read SIF1 DMAtag!\n");
+            DEBUG_LOG(LOG_IOP_DMA, "Addr: $%08X\n", channels[SIF1].addr);
+            DEBUG_LOG(LOG_IOP_DMA, "Words: $%08X\n", channels[SIF1].word_count);
             if ((data & (1 << 31)) || (data & (1 << 30)))
                 channels[SIF1].tag_end = true;
         }
@@ -177,9 +228,10 @@ void IOP_DMA::process_SIF1()
 
 void IOP_DMA::transfer_end(int index)
 {
-    printf("[IOP DMA] %s transfer ended\n", CHAN(index));
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] %s transfer ended\n", CHAN(index));
     channels[index].control.busy = false;
     channels[index].tag_end = false;
+    update_active(index);
     bool dicr2 = index > 7;
     if (dicr2)
         index -= 8;
@@ -187,7 +239,7 @@ void IOP_DMA::transfer_end(int index)
 
     if (DICR.STAT[dicr2] & DICR.MASK[dicr2])
     {
-        printf("[IOP DMA] IRQ requested\n");
+        DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] IRQ requested\n");
         e->iop_request_IRQ(3);
     }
 }
@@ -227,7 +279,7 @@ uint32_t IOP_DMA::get_DICR()
     else
         IRQ = false;
     reg |= IRQ << 31;
-    printf("[IOP DMA] Get DICR: $%08X\n", reg);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] Get DICR: $%08X\n", reg);
     return reg;
 }
 
@@ -244,7 +296,7 @@ uint32_t IOP_DMA::get_DICR2()
     else
         IRQ = false;
     reg |= IRQ << 31;
-    printf("[IOP DMA] Get DICR2: $%08X\n", reg);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] Get DICR2: $%08X\n", reg);
     return reg;
 }
 
@@ -261,7 +313,7 @@ uint32_t IOP_DMA::get_chan_control(int index)
 
 void IOP_DMA::set_DPCR(uint32_t value)
 {
-    printf("[IOP DMA] Set DPCR: $%08X\n", value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] Set DPCR: $%08X\n", value);
     for (int i = 0; i < 8; i++)
     {
         bool old_enable = DPCR.enable[i];
@@ -269,12 +321,13 @@ void IOP_DMA::set_DPCR(uint32_t value)
         DPCR.enable[i] = value & (1 << ((i << 2) + 3));
         if (!old_enable && DPCR.enable[i])
             channels[i].tag_end = false;
+        update_active(i);
     }
 }
 
 void IOP_DMA::set_DPCR2(uint32_t value)
 {
-    printf("[IOP DMA] Set DPCR2: $%08X\n", value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] Set DPCR2: $%08X\n", value);
     for (int i = 8; i < 16; i++)
     {
         bool old_enable = DPCR.enable[i];
@@ -282,12 +335,13 @@ void IOP_DMA::set_DPCR2(uint32_t value)
         DPCR.enable[i] = value & (1 << ((i << 2) + 3));
         if (!old_enable && DPCR.enable[i])
             channels[i].tag_end = false;
+        update_active(i);
     }
 }
 
 void IOP_DMA::set_DICR(uint32_t value)
 {
-    printf("[IOP DMA] Set DICR: $%08X\n", value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] Set DICR: $%08X\n", value);
     DICR.MASK[0] = (value >> 16) & 0x7F;
     DICR.master_int_enable[0] = value & (1 << 23);
     DICR.STAT[0] &= ~((value >> 24) & 0x7F);
@@ -295,7 +349,7 @@ void IOP_DMA::set_DICR(uint32_t value)
 
 void IOP_DMA::set_DICR2(uint32_t value)
 {
-    printf("[IOP DMA] Set DICR2: $%08X\n", value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] Set DICR2: $%08X\n", value);
     DICR.MASK[1] = (value >> 16) & 0x7F;
     DICR.master_int_enable[1] = value & (1 << 23);
     DICR.STAT[1] &= ~((value >> 24) & 0x7F);
@@ -303,41 +357,42 @@ void IOP_DMA::set_DICR2(uint32_t value)
 
 void IOP_DMA::set_chan_addr(int index, uint32_t value)
 {
-    printf("[IOP DMA] %s addr: $%08X\n", CHAN(index), value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] %s addr: $%08X\n", CHAN(index), value);
     channels[index].addr = value;
 }
 
 void IOP_DMA::set_chan_block(int index, uint32_t value)
 {
-    printf("[IOP DMA] %s block: $%08X\n", CHAN(index), value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] %s block: $%08X\n", CHAN(index), value);
     channels[index].block_size = value & 0xFFFF;
     channels[index].word_count = value >> 16;
 }
 
 void IOP_DMA::set_chan_size(int index, uint16_t value)
 {
-    printf("[IOP DMA] %s size: $%04X\n", CHAN(index), value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] %s size: $%04X\n", CHAN(index), value);
     channels[index].block_size = value;
 }
 
 void IOP_DMA::set_chan_count(int index, uint16_t value)
 {
-    printf("[IOP DMA] %s count: $%04X\n", CHAN(index), value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] %s count: $%04X\n", CHAN(index), value);
     channels[index].word_count = value;
 }
 
 void IOP_DMA::set_chan_control(int index, uint32_t value)
 {
-    printf("[IOP DMA] %s control: $%08X\n", CHAN(index), value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] %s control: $%08X\n", CHAN(index), value);
     channels[index].control.direction_from = value & 1;
     channels[index].control.unk8 = value & (1 << 8);
     channels[index].control.sync_mode = (value >> 9) & 0x3;
     channels[index].control.busy = value & (1 << 24);
     channels[index].control.unk30 = value & (1 << 30);
+    update_active(index);
 }
 
 void IOP_DMA::set_chan_tag_addr(int index, uint32_t value)
 {
-    printf("[IOP DMA] %s tag addr: $%08X\n", CHAN(index), value);
+    DEBUG_LOG(LOG_IOP_DMA, "[IOP DMA] %s tag addr: $%08X\n", CHAN(index), value);
     channels[index].tag_addr = value;
 }
@@ -37,6 +37,7 @@ struct DMA_DICR
 
 class Emulator;
 class CDVD_Drive;
+class MMIOTable;
 class SubsystemInterface;
 
 class IOP_DMA
@@ -48,10 +49,14 @@ class IOP_DMA
         SubsystemInterface* sif;
         IOP_DMA_Channel channels[16];
 
+        //Bit per channel that's enabled and busy, so an idle IOP DMA costs nothing
+        uint16_t active_channels;
+
         //Merge of DxCR, DxCR2, DxCR3 for easier processing
         DMA_DPCR DPCR;
         DMA_DICR DICR;
 
+        void update_active(int index);
         void transfer_end(int index);
         void process_CDVD();
         void process_SIF0();
@@ -61,7 +66,9 @@ class IOP_DMA
         IOP_DMA(Emulator* e, CDVD_Drive* cdvd, SubsystemInterface* sif);
 
         void reset(uint8_t* RAM);
-        void run();
+        void map_registers(MMIOTable* mmio);
+        void run(int cycles);
+        bool is_active();
 
         uint32_t get_DPCR();
         uint32_t get_DPCR2();
@@ -83,4 +90,9 @@ class IOP_DMA
         void set_chan_tag_addr(int index, uint32_t value);
 };
 
+inline bool IOP_DMA::is_active()
+{
+    return active_channels != 0;
+}
+
 #endif // IOP_DMA_HPP
@@ -1,7 +1,8 @@
-#include <cstdio>
 #include <cstdlib>
 #include "iop_interpreter.hpp"
 
+#include "../logger.hpp"
+
 void IOP_Interpreter::interpret(IOP &cpu, uint32_t instruction)
 {
     if (!instruction)
@@ -124,11 +125,11 @@ void IOP_Interpreter::j(IOP &cpu, uint32_t instruction)
             name[8] = 0;
             for (int i = 0; i < 8; i++)
                 name[i] = cpu.read8(struct_ptr + 12 + i);
-            printf("[IOP] RegisterLibraryEntries: %s version %d.0%d\n", name, version >> 8, version & 0xFF);
+            DEBUG_LOG(LOG_IOP, "[IOP] RegisterLibraryEntries: %s version %d.0%d\n", name, version >> 8, version & 0xFF);
         }
         else
         {
-            printf("[IOP] Jump to module function $%02X at $%08X\n", next_instr & 0xFF, addr);
+            DEBUG_LOG(LOG_IOP, "[IOP] Jump to module function $%02X at $%08X\n", next_instr & 0xFF, addr);
         }
 
     }
@@ -822,7 +823,7 @@ void IOP_Interpreter::mtc(IOP &cpu, uint32_t instruction)
 
 void IOP_Interpreter::unknown_op(const char *type, uint16_t op, uint32_t instruction)
 {
-    printf("\n[IOP_Interpreter] Unrecognized %s op $%02X\n", type, op);
-    printf("[IOP Interpreter] Instruction: $%08X\n", instruction);
+    ERROR_LOG(LOG_IOP, "[IOP_Interpreter] Unrecognized %s op $%02X\n", type, op);
+    ERROR_LOG(LOG_IOP, "[IOP Interpreter] Instruction: $%08X\n", instruction);
     exit(1);
 }
@@ -1,10 +1,15 @@
-#include <cstdio>
 #include "../emulator.hpp"
+#include "../logger.hpp"
+#include "../mmio.hpp"
+#include "../scheduler.hpp"
 #include "iop_timers.hpp"
 
-IOPTiming::IOPTiming(Emulator* e) : e(e)
-{
+//The IOP runs at 1/8 of the EE clock
+#define EE_CYCLES_PER_IOP_CYCLE 8
 
+IOPTiming::IOPTiming(Emulator* e, Scheduler* scheduler) : e(e), scheduler(scheduler)
+{
+    timer_event_id = scheduler->register_function([this] (uint64_t param) { timer_event(param); });
 }
 
 void IOPTiming::reset()
@@ -12,57 +17,242 @@ void IOPTiming::reset()
     for (int i = 0; i < 6; i++)
     {
         timers[i].counter = 0;
+        timers[i].target = 0;
+        timers[i].control.use_gate = false;
         timers[i].control.gate_mode = 0;
+        timers[i].control.zero_return = false;
+        timers[i].control.compare_interrupt_enabled = false;
+        timers[i].control.overflow_interrupt_enabled = false;
+        timers[i].control.extern_signal = false;
+        timers[i].control.prescale = 1;
         timers[i].control.compare_interrupt = false;
         timers[i].control.overflow_interrupt = false;
+        timers[i].last_update = 0;
+        timers[i].event_pending = false;
+    }
+}
+
+//Timers 0-2 are at $1F801100, 3-5 at $1F801480, each with a counter, mode, and target register
+void IOPTiming::map_registers(MMIOTable* mmio)
+{
+    for (int index = 0; index < 6; index++)
+    {
+        uint32_t base = (index < 3) ? 0x1F801100 + (index * 0x10) : 0x1F801480 + ((index - 3) * 0x10);
+        for (int width = 2; width <= 4; width *= 2)
+        {
+            mmio->map_read(base, width, [this, index] (uint32_t addr) { return read_counter(index); });
+            mmio->map_read(base + 4, width, [this, index] (uint32_t addr) { return read_control(index); });
+            mmio->map_read(base + 8, width, [this, index] (uint32_t addr) { return read_target(index); }, true);
+            mmio->map_write(base, width,
+                            [this, index] (uint32_t addr, uint64_t value) { write_counter(index, value); });
+            mmio->map_write(base + 4, width,
+                            [this, index] (uint32_t addr, uint64_t value) { write_control(index, value); });
+            mmio->map_write(base + 8, width,
+                            [this, index] (uint32_t addr, uint64_t value) { write_target(index, value); });
+        }
     }
 }
 
-void IOPTiming::run()
+//Timers 0-2 are 16-bit, 3-5 are 32-bit
+uint64_t IOPTiming::get_max_count(int index)
+{
+    if (index < 3)
+        return 0xFFFF;
+    return 0xFFFFFFFF;
+}
+
+//External clock sources (pixel clock, HBLANK) aren't emulated, so those timers run off the IOP clock too
+int IOPTiming::get_clock_divider(int index)
+{
+    return EE_CYCLES_PER_IOP_CYCLE * timers[index].control.prescale;
+}
+
+void IOPTiming::update_counter(int index)
+{
+    uint64_t now = scheduler->get_current_cycles();
+    int divider = get_clock_divider(index);
+
+    //Already brought further along by a read later in the slice than this event
+    if (now <= timers[index].last_update)
+        return;
+
+    //Leftover cycles that don't make up a full count carry over to the next update
+    uint64_t ticks = (now - timers[index].last_update) / divider;
+    timers[index].last_update += ticks * divider;
+    count_up(index, ticks);
+}
+
+void IOPTiming::reschedule(int index)
 {
-    //timers[5].counter++;
-    if (timers[5].counter == timers[5].target)
+    IOP_Timer& timer = timers[index];
+    if (timer.event_pending)
     {
-        timers[5].control.compare_interrupt = true;
-        if (timers[5].control.compare_interrupt_enabled)
-            e->iop_request_IRQ(16);
+        scheduler->cancel_event(timer.event_id);
+        timer.event_pending = false;
     }
-    if (timers[5].counter > 0xFFFFFFFF)
+
+    //Counts until the counter next reaches each point of interest, going around through zero if needed
+    uint64_t wrap = get_max_count(index) + 1;
+    uint64_t ticks = UINT64_MAX;
+    if (timer.control.compare_interrupt_enabled)
     {
-        timers[5].control.overflow_interrupt = true;
-        if (timers[5].control.overflow_interrupt_enabled)
-            e->iop_request_IRQ(16);
+        if (timer.target > timer.counter)
+            ticks = timer.target - timer.counter;
+        else
+            ticks = wrap - timer.counter + timer.target;
     }
+    bool returns_first = timer.control.zero_return && timer.counter < timer.target;
+    if (timer.control.overflow_interrupt_enabled && !returns_first && ticks > wrap - timer.counter)
+        ticks = wrap - timer.counter;
+    if (ticks == UINT64_MAX)
+        return;
+
+    //The counter may already be partway to its next count, and last_update can be partway into the current slice
+    uint64_t due = timer.last_update + ticks * get_clock_divider(index);
+    timer.event_id = scheduler->add_event(timer_event_id, due - scheduler->get_cycles(), index);
+    timer.event_pending = true;
+}
+
+void IOPTiming::timer_event(int index)
+{
+    timers[index].event_pending = false;
+    update_counter(index);
+    reschedule(index);
+}
+
+/**
+ * Advances the counter by any number of counts at once, raising the target and overflow interrupts it passes.
+ * Once the counter is back at zero, every further period looks the same, so whole periods are skipped together.
+ */
+void IOPTiming::count_up(int index, uint64_t ticks)
+{
+    IOP_Timer& timer = timers[index];
+    uint64_t wrap = get_max_count(index) + 1;
+    bool returns = timer.control.zero_return && timer.target;
+    uint64_t period = returns ? timer.target : wrap;
+    while (ticks)
+    {
+        if (timer.counter == 0 && ticks >= period)
+        {
+            ticks %= period;
+            target_hit(index);
+            if (!returns)
+                overflow(index);
+            continue;
+        }
+
+        uint64_t step = wrap - timer.counter;
+        if (timer.counter < timer.target && timer.target - timer.counter < step)
+            step = timer.target - timer.counter;
+        if (step > ticks)
+            step = ticks;
+        timer.counter += step;
+        ticks -= step;
+
+        if (timer.counter == wrap)
+        {
+            timer.counter = 0;
+            overflow(index);
+        }
+        if (timer.counter == timer.target)
+        {
+            target_hit(index);
+            if (returns)
+                timer.counter = 0;
+        }
+    }
+}
+
+void IOPTiming::target_hit(int index)
+{
+    timers[index].control.compare_interrupt = true;
+    if (timers[index].control.compare_interrupt_enabled)
+        request_IRQ(index);
+}
+
+void IOPTiming::overflow(int index)
+{
+    timers[index].control.overflow_interrupt = true;
+    if (timers[index].control.overflow_interrupt_enabled)
+        request_IRQ(index);
+}
+
+void IOPTiming::request_IRQ(int index)
+{
+    if (index < 3)
+        e->iop_request_IRQ(4 + index);
+    else
+        e->iop_request_IRQ(14 + index - 3);
 }
 
 uint32_t IOPTiming::read_counter(int index)
 {
+    update_counter(index);
     return timers[index].counter;
 }
 
 uint16_t IOPTiming::read_control(int index)
 {
+    update_counter(index);
     uint16_t reg = 0;
+    reg |= timers[index].control.use_gate;
+    reg |= timers[index].control.gate_mode << 1;
+    reg |= timers[index].control.zero_return << 3;
+    reg |= timers[index].control.compare_interrupt_enabled << 4;
+    reg |= timers[index].control.overflow_interrupt_enabled << 5;
+    reg |= timers[index].control.extern_signal << 8;
     reg |= timers[index].control.compare_interrupt << 11;
     reg |= timers[index].control.overflow_interrupt << 12;
-    printf("[IOP Timing] Read timer %d control: $%04X\n", index, reg);
+    DEBUG_LOG(LOG_IOP_TIMERS, "[IOP Timing] Read timer %d control: $%04X\n", index, reg);
+
+    //The reached flags are acknowledged by reading them
+    timers[index].control.compare_interrupt = false;
+    timers[index].control.overflow_interrupt = false;
     return reg;
 }
 
+uint32_t IOPTiming::read_target(int index)
+{
+    return timers[index].target;
+}
+
 void IOPTiming::write_counter(int index, uint32_t value)
 {
-    timers[index].counter = value;
+    update_counter(index);
+    timers[index].counter = value & get_max_count(index);
+    reschedule(index);
 }
 
 void IOPTiming::write_control(int index, uint16_t value)
 {
-    printf("[IOP Timing] Write timer %d control $%04X\n", index, value);
+    DEBUG_LOG(LOG_IOP_TIMERS, "[IOP Timing] Write timer %d control $%04X\n", index, value);
+    update_counter(index);
+    timers[index].control.use_gate = value & 0x1;
+    timers[index].control.gate_mode = (value >> 1) & 0x3;
+    timers[index].control.zero_return = value & (1 << 3);
     timers[index].control.compare_interrupt_enabled = value & (1 << 4);
     timers[index].control.overflow_interrupt_enabled = value & (1 << 5);
+    timers[index].control.extern_signal = value & (1 << 8);
+
+    timers[index].control.prescale = 1;
+    if (index == 2 && (value & (1 << 9)))
+        timers[index].control.prescale = 8;
+    else if (index >= 4)
+    {
+        static const uint16_t prescales[] = {1, 8, 16, 256};
+        timers[index].control.prescale = prescales[(value >> 13) & 0x3];
+    }
+
+    //Writing the mode also restarts the count
+    timers[index].counter = 0;
+    timers[index].last_update = scheduler->get_current_cycles();
+    reschedule(index);
 }
 
 void IOPTiming::write_target(int index, uint32_t value)
 {
-    printf("[IOP Timing] Write timer %d target $%08X\n", index, value);
-    timers[index].target = value;
+    DEBUG_LOG(LOG_IOP_TIMERS, "[IOP Timing] Write timer %d target $%08X\n", index, value);
+    update_counter(index);
+    timers[index].target = value & get_max_count(index);
+    reschedule(index);
 }
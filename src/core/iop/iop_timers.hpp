@@ -2,6 +2,11 @@
 #define IOP_TIMERS_HPP
 #include <cstdint>
 
+/**
+The IOP timers are counted lazily, the same way as the EE's. Counters are derived from the elapsed cycles
+whenever they're accessed, and target/overflow interrupts are scheduled ahead of time as events.
+**/
+
 struct IOP_Timer_Control
 {
     bool use_gate;
@@ -9,6 +14,8 @@ struct IOP_Timer_Control
     bool zero_return;
     bool compare_interrupt_enabled;
     bool overflow_interrupt_enabled;
+    bool extern_signal;
+    uint16_t prescale;
     bool compare_interrupt;
     bool overflow_interrupt;
 };
@@ -18,22 +25,46 @@ struct IOP_Timer
     uint64_t counter;
     IOP_Timer_Control control;
     uint32_t target;
+
+    //Cycle the counter was last updated at
+    uint64_t last_update;
+
+    bool event_pending;
+    uint64_t event_id;
 };
 
 class Emulator;
+class MMIOTable;
+class Scheduler;
 
 class IOPTiming
 {
     private:
         Emulator* e;
+        Scheduler* scheduler;
         IOP_Timer timers[6];
+
+        int timer_event_id;
+
+        uint64_t get_max_count(int index);
+        int get_clock_divider(int index);
+        void update_counter(int index);
+        void reschedule(int index);
+        void timer_event(int index);
+
+        void count_up(int index, uint64_t ticks);
+        void target_hit(int index);
+        void overflow(int index);
+        void request_IRQ(int index);
     public:
-        IOPTiming(Emulator* e);
+        IOPTiming(Emulator* e, Scheduler* scheduler);
 
         void reset();
-        void run();
+        void map_registers(MMIOTable* mmio);
+
         uint32_t read_counter(int index);
         uint16_t read_control(int index);
+        uint32_t read_target(int index);
 
         void write_counter(int index, uint32_t value);
         void write_control(int index, uint16_t value);
@@ -1,5 +1,8 @@
 #include "sio2.hpp"
 
+#include "../logger.hpp"
+#include "../mmio.hpp"
+
 SIO2::SIO2()
 {
 
@@ -10,6 +13,18 @@ void SIO2::reset()
 
 }
 
+void SIO2::map_registers(MMIOTable* mmio)
+{
+    mmio->map_write_range(0x1F808200, 0x1F808280, 4, [] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_SIO2, "[IOP SIO2] Write32 to $%08X of $%08X\n", addr, (uint32_t)value);
+    });
+    mmio->map_read(0x1F80826C, 4, [this] (uint32_t addr) { return get_RECV1(); }, true);
+
+    //DATAIN
+    mmio->map_write(0x1F808260, 1, [] (uint32_t addr, uint64_t value) {});
+}
+
 uint32_t SIO2::get_RECV1()
 {
     return 0x1D100;
@@ -2,6 +2,8 @@
 #define SIO2_HPP
 #include <cstdint>
 
+class MMIOTable;
+
 class SIO2
 {
     private:
@@ -10,6 +12,7 @@ class SIO2
         SIO2();
 
         void reset();
+        void map_registers(MMIOTable* mmio);
 
         uint32_t get_control();
         uint32_t get_RECV1();
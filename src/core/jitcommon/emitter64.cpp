@@ -0,0 +1,620 @@
+#include "emitter64.hpp"
+
+Emitter64::Emitter64(JitCache* cache) : cache(cache)
+{
+
+}
+
+void Emitter64::rex(bool w, int reg, int index, int base, bool force)
+{
+    uint8_t value = 0x40;
+    value |= w << 3;
+    value |= ((reg >> 3) & 0x1) << 2;
+    value |= ((index >> 3) & 0x1) << 1;
+    value |= (base >> 3) & 0x1;
+    if (value != 0x40 || force)
+        cache->write8(value);
+}
+
+void Emitter64::opcode(uint16_t op)
+{
+    //Two-byte opcodes are passed in as 0x0FXX
+    if (op > 0xFF)
+        cache->write8(op >> 8);
+    cache->write8(op & 0xFF);
+}
+
+void Emitter64::modrm_reg(int reg, int rm)
+{
+    cache->write8(0xC0 | ((reg & 0x7) << 3) | (rm & 0x7));
+}
+
+void Emitter64::modrm_mem(int reg, REG_64 base, int32_t offset)
+{
+    int b = base & 0x7;
+    uint8_t mod;
+    if (!offset && b != 5)
+        mod = 0x00;
+    else if (offset >= -128 && offset <= 127)
+        mod = 0x40;
+    else
+        mod = 0x80;
+    cache->write8(mod | ((reg & 0x7) << 3) | b);
+
+    //RSP and R12 can only be used as a base through a SIB byte
+    if (b == 4)
+        cache->write8(0x24);
+
+    if (mod == 0x40)
+        cache->write8((uint8_t)offset);
+    else if (mod == 0x80)
+        cache->write32((uint32_t)offset);
+}
+
+void Emitter64::modrm_sib(int reg, REG_64 base, REG_64 index, int scale)
+{
+    int b = base & 0x7;
+
+    //RBP and R13 have no mod=00 encoding, so use a zero disp8 instead
+    if (b == 5)
+    {
+        cache->write8(0x44 | ((reg & 0x7) << 3));
+        cache->write8((scale << 6) | ((index & 0x7) << 3) | b);
+        cache->write8(0);
+    }
+    else
+    {
+        cache->write8(0x04 | ((reg & 0x7) << 3));
+        cache->write8((scale << 6) | ((index & 0x7) << 3) | b);
+    }
+}
+
+void Emitter64::op_reg(uint16_t op, bool w, int reg, REG_64 rm)
+{
+    rex(w, reg, 0, rm);
+    opcode(op);
+    modrm_reg(reg, rm);
+}
+
+void Emitter64::op_mem(uint16_t op, bool w, int reg, REG_64 base, int32_t offset, bool force_rex)
+{
+    rex(w, reg, 0, base, force_rex);
+    opcode(op);
+    modrm_mem(reg, base, offset);
+}
+
+void Emitter64::op_sib(uint16_t op, bool w, int reg, REG_64 base, REG_64 index, bool force_rex, int scale)
+{
+    rex(w, reg, index, base, force_rex);
+    opcode(op);
+    modrm_sib(reg, base, index, scale);
+}
+
+void Emitter64::alu_reg_imm(int ext, bool w, REG_64 dest, uint32_t imm)
+{
+    int32_t simm = (int32_t)imm;
+    if (simm >= -128 && simm <= 127)
+    {
+        op_reg(0x83, w, ext, dest);
+        cache->write8((uint8_t)imm);
+    }
+    else
+    {
+        op_reg(0x81, w, ext, dest);
+        cache->write32(imm);
+    }
+}
+
+void Emitter64::alu_mem_imm(int ext, bool w, REG_64 base, int32_t offset, uint32_t imm)
+{
+    int32_t simm = (int32_t)imm;
+    if (simm >= -128 && simm <= 127)
+    {
+        op_mem(0x83, w, ext, base, offset);
+        cache->write8((uint8_t)imm);
+    }
+    else
+    {
+        op_mem(0x81, w, ext, base, offset);
+        cache->write32(imm);
+    }
+}
+
+void Emitter64::shift_imm(int ext, bool w, REG_64 dest, uint8_t shift)
+{
+    op_reg(0xC1, w, ext, dest);
+    cache->write8(shift);
+}
+
+//SSE instructions put their mandatory prefix ahead of any REX prefix
+void Emitter64::sse_reg(uint8_t prefix, uint16_t op, int reg, int rm)
+{
+    if (prefix)
+        cache->write8(prefix);
+    op_reg(op, false, reg, (REG_64)rm);
+}
+
+void Emitter64::sse_mem(uint8_t prefix, uint16_t op, int reg, REG_64 base, int32_t offset)
+{
+    if (prefix)
+        cache->write8(prefix);
+    op_mem(op, false, reg, base, offset);
+}
+
+void Emitter64::ADD32_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x01, false, source, dest);
+}
+
+void Emitter64::ADD64_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x01, true, source, dest);
+}
+
+void Emitter64::SUB32_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x29, false, source, dest);
+}
+
+void Emitter64::SUB64_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x29, true, source, dest);
+}
+
+void Emitter64::AND64_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x21, true, source, dest);
+}
+
+void Emitter64::OR64_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x09, true, source, dest);
+}
+
+void Emitter64::XOR32_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x31, false, source, dest);
+}
+
+void Emitter64::XOR64_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x31, true, source, dest);
+}
+
+void Emitter64::CMP32_REG(REG_64 op2, REG_64 op1)
+{
+    op_reg(0x39, false, op2, op1);
+}
+
+void Emitter64::CMP64_REG(REG_64 op2, REG_64 op1)
+{
+    op_reg(0x39, true, op2, op1);
+}
+
+void Emitter64::TEST32_REG(REG_64 op2, REG_64 op1)
+{
+    op_reg(0x85, false, op2, op1);
+}
+
+void Emitter64::TEST64_REG(REG_64 op2, REG_64 op1)
+{
+    op_reg(0x85, true, op2, op1);
+}
+
+void Emitter64::NOT64(REG_64 dest)
+{
+    op_reg(0xF7, true, 2, dest);
+}
+
+void Emitter64::IMUL32_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x0FAF, false, dest, source);
+}
+
+void Emitter64::ADD32_REG_IMM(uint32_t imm, REG_64 dest)
+{
+    alu_reg_imm(0, false, dest, imm);
+}
+
+void Emitter64::ADD64_REG_IMM(uint32_t imm, REG_64 dest)
+{
+    alu_reg_imm(0, true, dest, imm);
+}
+
+void Emitter64::AND32_REG_IMM(uint32_t imm, REG_64 dest)
+{
+    alu_reg_imm(4, false, dest, imm);
+}
+
+void Emitter64::AND64_REG_IMM(uint32_t imm, REG_64 dest)
+{
+    alu_reg_imm(4, true, dest, imm);
+}
+
+void Emitter64::OR64_REG_IMM(uint32_t imm, REG_64 dest)
+{
+    alu_reg_imm(1, true, dest, imm);
+}
+
+void Emitter64::XOR64_REG_IMM(uint32_t imm, REG_64 dest)
+{
+    alu_reg_imm(6, true, dest, imm);
+}
+
+void Emitter64::CMP32_REG_IMM(uint32_t imm, REG_64 op)
+{
+    alu_reg_imm(7, false, op, imm);
+}
+
+void Emitter64::CMP64_REG_IMM(uint32_t imm, REG_64 op)
+{
+    alu_reg_imm(7, true, op, imm);
+}
+
+void Emitter64::ADD32_MEM_IMM(uint32_t imm, REG_64 base, int32_t offset)
+{
+    alu_mem_imm(0, false, base, offset, imm);
+}
+
+void Emitter64::SUB32_MEM_IMM(uint32_t imm, REG_64 base, int32_t offset)
+{
+    alu_mem_imm(5, false, base, offset, imm);
+}
+
+void Emitter64::CMP64_MEM_IMM(uint32_t imm, REG_64 base, int32_t offset)
+{
+    alu_mem_imm(7, true, base, offset, imm);
+}
+
+void Emitter64::CMP8_MEM_IMM(uint8_t imm, REG_64 base, int32_t offset)
+{
+    op_mem(0x80, false, 7, base, offset);
+    cache->write8(imm);
+}
+
+void Emitter64::CMP64_MEM(REG_64 base, REG_64 op1, int32_t offset)
+{
+    op_mem(0x3B, true, op1, base, offset);
+}
+
+void Emitter64::SHL32_REG_IMM(uint8_t shift, REG_64 dest)
+{
+    shift_imm(4, false, dest, shift);
+}
+
+void Emitter64::SHR32_REG_IMM(uint8_t shift, REG_64 dest)
+{
+    shift_imm(5, false, dest, shift);
+}
+
+void Emitter64::SAR32_REG_IMM(uint8_t shift, REG_64 dest)
+{
+    shift_imm(7, false, dest, shift);
+}
+
+void Emitter64::SHL64_REG_IMM(uint8_t shift, REG_64 dest)
+{
+    shift_imm(4, true, dest, shift);
+}
+
+void Emitter64::SHR64_REG_IMM(uint8_t shift, REG_64 dest)
+{
+    shift_imm(5, true, dest, shift);
+}
+
+void Emitter64::SAR64_REG_IMM(uint8_t shift, REG_64 dest)
+{
+    shift_imm(7, true, dest, shift);
+}
+
+void Emitter64::MOV32_REG(REG_64 source, REG_64 dest)
+{
+    op_reg(0x89, false, source, dest);
+}
+
+void Emitter64::MOV64_MR(REG_64 source, REG_64 dest)
+{
+    op_reg(0x89, true, source, dest);
+}
+
+void Emitter64::MOV32_REG_IMM(uint32_t imm, REG_64 dest)
+{
+    rex(false, 0, 0, dest);
+    cache->write8(0xB8 + (dest & 0x7));
+    cache->write32(imm);
+}
+
+void Emitter64::MOV64_OI(uint64_t imm, REG_64 dest)
+{
+    rex(true, 0, 0, dest);
+    cache->write8(0xB8 + (dest & 0x7));
+    cache->write64(imm);
+}
+
+void Emitter64::MOVSX32_TO_64(REG_64 source, REG_64 dest)
+{
+    op_reg(0x63, true, dest, source);
+}
+
+void Emitter64::MOVZX8_TO_32(REG_64 source, REG_64 dest)
+{
+    //SPL, BPL, SIL, and DIL are only addressable with a REX prefix
+    rex(false, dest, 0, source, source >= RSP && source <= RDI);
+    opcode(0x0FB6);
+    modrm_reg(dest, source);
+}
+
+void Emitter64::SETCC8(ConditionCode cond, REG_64 dest)
+{
+    rex(false, 0, 0, dest, dest >= RSP && dest <= RDI);
+    opcode(0x0F90 + (int)cond);
+    modrm_reg(0, dest);
+}
+
+void Emitter64::CMOVCC64(ConditionCode cond, REG_64 source, REG_64 dest)
+{
+    op_reg(0x0F40 + (int)cond, true, dest, source);
+}
+
+void Emitter64::MOV32_FROM_MEM(REG_64 base, REG_64 dest, int32_t offset)
+{
+    op_mem(0x8B, false, dest, base, offset);
+}
+
+void Emitter64::MOV64_FROM_MEM(REG_64 base, REG_64 dest, int32_t offset)
+{
+    op_mem(0x8B, true, dest, base, offset);
+}
+
+void Emitter64::MOV8_TO_MEM(REG_64 source, REG_64 base, int32_t offset)
+{
+    op_mem(0x88, false, source, base, offset, source >= RSP && source <= RDI);
+}
+
+void Emitter64::MOV32_TO_MEM(REG_64 source, REG_64 base, int32_t offset)
+{
+    op_mem(0x89, false, source, base, offset);
+}
+
+void Emitter64::MOV64_TO_MEM(REG_64 source, REG_64 base, int32_t offset)
+{
+    op_mem(0x89, true, source, base, offset);
+}
+
+void Emitter64::MOV8_IMM_MEM(uint8_t imm, REG_64 base, int32_t offset)
+{
+    op_mem(0xC6, false, 0, base, offset);
+    cache->write8(imm);
+}
+
+void Emitter64::MOV32_IMM_MEM(uint32_t imm, REG_64 base, int32_t offset)
+{
+    op_mem(0xC7, false, 0, base, offset);
+    cache->write32(imm);
+}
+
+void Emitter64::MOVZX8_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest)
+{
+    op_sib(0x0FB6, false, dest, base, index);
+}
+
+void Emitter64::MOVSX8_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest)
+{
+    op_sib(0x0FBE, true, dest, base, index);
+}
+
+void Emitter64::MOVZX16_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest)
+{
+    op_sib(0x0FB7, false, dest, base, index);
+}
+
+void Emitter64::MOVSX16_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest)
+{
+    op_sib(0x0FBF, true, dest, base, index);
+}
+
+void Emitter64::MOV32_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest)
+{
+    op_sib(0x8B, false, dest, base, index);
+}
+
+void Emitter64::MOV64_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest)
+{
+    op_sib(0x8B, true, dest, base, index);
+}
+
+//mov dest, [base + index * 8]
+void Emitter64::MOV64_FROM_SIB_X8(REG_64 base, REG_64 index, REG_64 dest)
+{
+    op_sib(0x8B, true, dest, base, index, false, 3);
+}
+
+void Emitter64::MOV8_TO_SIB(REG_64 source, REG_64 base, REG_64 index)
+{
+    op_sib(0x88, false, source, base, index, source >= RSP && source <= RDI);
+}
+
+void Emitter64::MOV16_TO_SIB(REG_64 source, REG_64 base, REG_64 index)
+{
+    cache->write8(0x66);
+    op_sib(0x89, false, source, base, index);
+}
+
+void Emitter64::MOV32_TO_SIB(REG_64 source, REG_64 base, REG_64 index)
+{
+    op_sib(0x89, false, source, base, index);
+}
+
+void Emitter64::MOV64_TO_SIB(REG_64 source, REG_64 base, REG_64 index)
+{
+    op_sib(0x89, true, source, base, index);
+}
+
+void Emitter64::CMP8_SIB_IMM(uint8_t imm, REG_64 base, REG_64 index)
+{
+    op_sib(0x80, false, 7, base, index);
+    cache->write8(imm);
+}
+
+void Emitter64::MOVDQA_XMM(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0F6F, dest, source);
+}
+
+void Emitter64::MOVDQU_FROM_MEM(REG_64 base, REG_XMM dest, int32_t offset)
+{
+    sse_mem(0xF3, 0x0F6F, dest, base, offset);
+}
+
+void Emitter64::MOVDQU_TO_MEM(REG_XMM source, REG_64 base, int32_t offset)
+{
+    sse_mem(0xF3, 0x0F7F, source, base, offset);
+}
+
+void Emitter64::MOVD_TO_XMM(REG_64 source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0F6E, dest, source);
+}
+
+void Emitter64::MOVMSKPS(REG_XMM source, REG_64 dest)
+{
+    sse_reg(0, 0x0F50, dest, source);
+}
+
+void Emitter64::PSHUFD(uint8_t order, REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0F70, dest, source);
+    cache->write8(order);
+}
+
+void Emitter64::PADDD(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0FFE, dest, source);
+}
+
+void Emitter64::PSUBD(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0FFA, dest, source);
+}
+
+void Emitter64::PMADDWD(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0FF5, dest, source);
+}
+
+void Emitter64::PAND(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0FDB, dest, source);
+}
+
+void Emitter64::PAND_FROM_MEM(REG_64 base, REG_XMM dest, int32_t offset)
+{
+    sse_mem(0x66, 0x0FDB, dest, base, offset);
+}
+
+void Emitter64::PANDN(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0FDF, dest, source);
+}
+
+void Emitter64::POR(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0FEB, dest, source);
+}
+
+void Emitter64::PXOR(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0FEF, dest, source);
+}
+
+void Emitter64::PCMPEQD(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0F76, dest, source);
+}
+
+void Emitter64::PCMPEQD_FROM_MEM(REG_64 base, REG_XMM dest, int32_t offset)
+{
+    sse_mem(0x66, 0x0F76, dest, base, offset);
+}
+
+void Emitter64::PCMPGTD(REG_XMM source, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0F66, dest, source);
+}
+
+void Emitter64::PSLLD(uint8_t shift, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0F72, 6, dest);
+    cache->write8(shift);
+}
+
+void Emitter64::PSRLD(uint8_t shift, REG_XMM dest)
+{
+    sse_reg(0x66, 0x0F72, 2, dest);
+    cache->write8(shift);
+}
+
+void Emitter64::PUSH(REG_64 reg)
+{
+    rex(false, 0, 0, reg);
+    cache->write8(0x50 + (reg & 0x7));
+}
+
+void Emitter64::POP(REG_64 reg)
+{
+    rex(false, 0, 0, reg);
+    cache->write8(0x58 + (reg & 0x7));
+}
+
+void Emitter64::CALL(const void* func)
+{
+    MOV64_OI((uint64_t)func, RAX);
+    op_reg(0xFF, false, 2, RAX);
+}
+
+void Emitter64::RET()
+{
+    cache->write8(0xC3);
+}
+
+void Emitter64::JMP(const uint8_t* dest)
+{
+    set_jump_dest(JMP_NEAR_DEFERRED(), dest);
+}
+
+void Emitter64::JMP_REG(REG_64 dest)
+{
+    op_reg(0xFF, false, 4, dest);
+}
+
+void Emitter64::JCC(ConditionCode cond, const uint8_t* dest)
+{
+    set_jump_dest(JCC_NEAR_DEFERRED(cond), dest);
+}
+
+uint8_t* Emitter64::JMP_NEAR_DEFERRED()
+{
+    cache->write8(0xE9);
+    uint8_t* addr = cache->get_current_addr();
+    cache->write32(0);
+    return addr;
+}
+
+uint8_t* Emitter64::JCC_NEAR_DEFERRED(ConditionCode cond)
+{
+    opcode(0x0F80 + (int)cond);
+    uint8_t* addr = cache->get_current_addr();
+    cache->write32(0);
+    return addr;
+}
+
+void Emitter64::set_jump_dest(uint8_t* jump)
+{
+    set_jump_dest(jump, cache->get_current_addr());
+}
+
+void Emitter64::set_jump_dest(uint8_t* jump, const uint8_t* dest)
+{
+    //Displacements are relative to the end of the 4-byte immediate
+    *(int32_t*)jump = (int32_t)(dest - (jump + 4));
+}
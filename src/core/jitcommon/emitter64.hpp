@@ -0,0 +1,187 @@
+#ifndef EMITTER64_HPP
+#define EMITTER64_HPP
+#include <cstdint>
+#include "jitcache.hpp"
+
+/**
+A small x86-64 machine code emitter.
+Only the forms actually needed by the recompilers are implemented. Operand order follows AT&T style:
+the source comes first and the destination last, e.g. ADD64_REG(RCX, RAX) is "add rax, rcx".
+Memory operands are always [base + offset] or [base + index].
+SSE2 instructions take the same order, e.g. PSUBD(XMM1, XMM0) is "psubd xmm0, xmm1".
+**/
+
+enum REG_64
+{
+    RAX, RCX, RDX, RBX,
+    RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11,
+    R12, R13, R14, R15
+};
+
+enum REG_XMM
+{
+    XMM0, XMM1, XMM2, XMM3,
+    XMM4, XMM5, XMM6, XMM7,
+    XMM8, XMM9, XMM10, XMM11,
+    XMM12, XMM13, XMM14, XMM15
+};
+
+enum class ConditionCode
+{
+    O, NO, B, AE,
+    E, NE, BE, A,
+    S, NS, P, NP,
+    L, GE, LE, G
+};
+
+//Argument registers for calls into C++ code
+#ifdef _WIN32
+const REG_64 REG_ARG0 = RCX;
+const REG_64 REG_ARG1 = RDX;
+const REG_64 REG_ARG2 = R8;
+const REG_64 REG_ARG3 = R9;
+#else
+const REG_64 REG_ARG0 = RDI;
+const REG_64 REG_ARG1 = RSI;
+const REG_64 REG_ARG2 = RDX;
+const REG_64 REG_ARG3 = RCX;
+#endif
+
+class Emitter64
+{
+    private:
+        JitCache* cache;
+
+        void rex(bool w, int reg, int index, int base, bool force = false);
+        void opcode(uint16_t op);
+        void modrm_reg(int reg, int rm);
+        void modrm_mem(int reg, REG_64 base, int32_t offset);
+        void modrm_sib(int reg, REG_64 base, REG_64 index, int scale = 0);
+
+        void op_reg(uint16_t op, bool w, int reg, REG_64 rm);
+        void op_mem(uint16_t op, bool w, int reg, REG_64 base, int32_t offset, bool force_rex = false);
+        void op_sib(uint16_t op, bool w, int reg, REG_64 base, REG_64 index, bool force_rex = false, int scale = 0);
+        void alu_reg_imm(int ext, bool w, REG_64 dest, uint32_t imm);
+        void alu_mem_imm(int ext, bool w, REG_64 base, int32_t offset, uint32_t imm);
+        void shift_imm(int ext, bool w, REG_64 dest, uint8_t shift);
+        void sse_reg(uint8_t prefix, uint16_t op, int reg, int rm);
+        void sse_mem(uint8_t prefix, uint16_t op, int reg, REG_64 base, int32_t offset);
+    public:
+        Emitter64(JitCache* cache);
+
+        uint8_t* get_current_addr();
+
+        void ADD32_REG(REG_64 source, REG_64 dest);
+        void ADD64_REG(REG_64 source, REG_64 dest);
+        void SUB32_REG(REG_64 source, REG_64 dest);
+        void SUB64_REG(REG_64 source, REG_64 dest);
+        void AND64_REG(REG_64 source, REG_64 dest);
+        void OR64_REG(REG_64 source, REG_64 dest);
+        void XOR32_REG(REG_64 source, REG_64 dest);
+        void XOR64_REG(REG_64 source, REG_64 dest);
+        void CMP32_REG(REG_64 op2, REG_64 op1);
+        void CMP64_REG(REG_64 op2, REG_64 op1);
+        void TEST32_REG(REG_64 op2, REG_64 op1);
+        void TEST64_REG(REG_64 op2, REG_64 op1);
+        void NOT64(REG_64 dest);
+        void IMUL32_REG(REG_64 source, REG_64 dest);
+
+        void ADD32_REG_IMM(uint32_t imm, REG_64 dest);
+        void ADD64_REG_IMM(uint32_t imm, REG_64 dest);
+        void AND32_REG_IMM(uint32_t imm, REG_64 dest);
+        void AND64_REG_IMM(uint32_t imm, REG_64 dest);
+        void OR64_REG_IMM(uint32_t imm, REG_64 dest);
+        void XOR64_REG_IMM(uint32_t imm, REG_64 dest);
+        void CMP32_REG_IMM(uint32_t imm, REG_64 op);
+        void CMP64_REG_IMM(uint32_t imm, REG_64 op);
+
+        void ADD32_MEM_IMM(uint32_t imm, REG_64 base, int32_t offset = 0);
+        void SUB32_MEM_IMM(uint32_t imm, REG_64 base, int32_t offset = 0);
+        void CMP64_MEM_IMM(uint32_t imm, REG_64 base, int32_t offset = 0);
+        void CMP8_MEM_IMM(uint8_t imm, REG_64 base, int32_t offset = 0);
+        void CMP64_MEM(REG_64 base, REG_64 op1, int32_t offset = 0);
+
+        void SHL32_REG_IMM(uint8_t shift, REG_64 dest);
+        void SHR32_REG_IMM(uint8_t shift, REG_64 dest);
+        void SAR32_REG_IMM(uint8_t shift, REG_64 dest);
+        void SHL64_REG_IMM(uint8_t shift, REG_64 dest);
+        void SHR64_REG_IMM(uint8_t shift, REG_64 dest);
+        void SAR64_REG_IMM(uint8_t shift, REG_64 dest);
+
+        void MOV32_REG(REG_64 source, REG_64 dest);
+        void MOV64_MR(REG_64 source, REG_64 dest);
+        void MOV32_REG_IMM(uint32_t imm, REG_64 dest);
+        void MOV64_OI(uint64_t imm, REG_64 dest);
+        void MOVSX32_TO_64(REG_64 source, REG_64 dest);
+        void MOVZX8_TO_32(REG_64 source, REG_64 dest);
+        void SETCC8(ConditionCode cond, REG_64 dest);
+        void CMOVCC64(ConditionCode cond, REG_64 source, REG_64 dest);
+
+        void MOV32_FROM_MEM(REG_64 base, REG_64 dest, int32_t offset = 0);
+        void MOV64_FROM_MEM(REG_64 base, REG_64 dest, int32_t offset = 0);
+        void MOV8_TO_MEM(REG_64 source, REG_64 base, int32_t offset = 0);
+        void MOV32_TO_MEM(REG_64 source, REG_64 base, int32_t offset = 0);
+        void MOV64_TO_MEM(REG_64 source, REG_64 base, int32_t offset = 0);
+        void MOV8_IMM_MEM(uint8_t imm, REG_64 base, int32_t offset = 0);
+        void MOV32_IMM_MEM(uint32_t imm, REG_64 base, int32_t offset = 0);
+
+        void MOVZX8_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest);
+        void MOVSX8_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest);
+        void MOVZX16_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest);
+        void MOVSX16_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest);
+        void MOV32_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest);
+        void MOV64_FROM_SIB(REG_64 base, REG_64 index, REG_64 dest);
+        void MOV64_FROM_SIB_X8(REG_64 base, REG_64 index, REG_64 dest);
+        void MOV8_TO_SIB(REG_64 source, REG_64 base, REG_64 index);
+        void MOV16_TO_SIB(REG_64 source, REG_64 base, REG_64 index);
+        void MOV32_TO_SIB(REG_64 source, REG_64 base, REG_64 index);
+        void MOV64_TO_SIB(REG_64 source, REG_64 base, REG_64 index);
+        void CMP8_SIB_IMM(uint8_t imm, REG_64 base, REG_64 index);
+
+        void MOVDQA_XMM(REG_XMM source, REG_XMM dest);
+        void MOVDQU_FROM_MEM(REG_64 base, REG_XMM dest, int32_t offset = 0);
+        void MOVDQU_TO_MEM(REG_XMM source, REG_64 base, int32_t offset = 0);
+        void MOVD_TO_XMM(REG_64 source, REG_XMM dest);
+        void MOVMSKPS(REG_XMM source, REG_64 dest);
+        void PSHUFD(uint8_t order, REG_XMM source, REG_XMM dest);
+
+        void PADDD(REG_XMM source, REG_XMM dest);
+        void PSUBD(REG_XMM source, REG_XMM dest);
+        void PMADDWD(REG_XMM source, REG_XMM dest);
+        void PAND(REG_XMM source, REG_XMM dest);
+        void PAND_FROM_MEM(REG_64 base, REG_XMM dest, int32_t offset = 0);
+        //dest = ~dest & source
+        void PANDN(REG_XMM source, REG_XMM dest);
+        void POR(REG_XMM source, REG_XMM dest);
+        void PXOR(REG_XMM source, REG_XMM dest);
+        void PCMPEQD(REG_XMM source, REG_XMM dest);
+        void PCMPEQD_FROM_MEM(REG_64 base, REG_XMM dest, int32_t offset = 0);
+        //dest = dest > source, signed
+        void PCMPGTD(REG_XMM source, REG_XMM dest);
+
+        void PSLLD(uint8_t shift, REG_XMM dest);
+        void PSRLD(uint8_t shift, REG_XMM dest);
+
+        void PUSH(REG_64 reg);
+        void POP(REG_64 reg);
+        void CALL(const void* func);
+        void RET();
+
+        //Jumps with a 32-bit displacement. The DEFERRED variants return the address of the displacement,
+        //which must later be resolved with set_jump_dest.
+        void JMP(const uint8_t* dest);
+        void JMP_REG(REG_64 dest);
+        void JCC(ConditionCode cond, const uint8_t* dest);
+        uint8_t* JMP_NEAR_DEFERRED();
+        uint8_t* JCC_NEAR_DEFERRED(ConditionCode cond);
+        void set_jump_dest(uint8_t* jump);
+        static void set_jump_dest(uint8_t* jump, const uint8_t* dest);
+};
+
+inline uint8_t* Emitter64::get_current_addr()
+{
+    return cache->get_current_addr();
+}
+
+#endif // EMITTER64_HPP
@@ -0,0 +1,41 @@
+#include "jitcache.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+JitCache::JitCache(size_t size) : size(size), used(0)
+{
+#ifdef _WIN32
+    block = (uint8_t*)VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    block = (uint8_t*)mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+        block = nullptr;
+#endif
+    if (!block)
+        this->size = 0;
+}
+
+JitCache::~JitCache()
+{
+    if (!block)
+        return;
+#ifdef _WIN32
+    VirtualFree(block, 0, MEM_RELEASE);
+#else
+    munmap(block, size);
+#endif
+}
+
+bool JitCache::is_valid()
+{
+    return block != nullptr;
+}
+
+void JitCache::flush()
+{
+    used = 0;
+}
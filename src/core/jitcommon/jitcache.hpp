@@ -0,0 +1,68 @@
+#ifndef JITCACHE_HPP
+#define JITCACHE_HPP
+#include <cstddef>
+#include <cstdint>
+
+/**
+The JitCache owns a single region of executable host memory that recompilers emit code into.
+Allocation is a simple bump pointer; individual blocks are never freed. When the cache runs out of space,
+the owner is expected to flush it and recompile everything from scratch.
+**/
+
+class JitCache
+{
+    private:
+        uint8_t* block;
+        size_t size;
+        size_t used;
+    public:
+        JitCache(size_t size);
+        ~JitCache();
+
+        bool is_valid();
+        void flush();
+
+        uint8_t* get_current_addr();
+        size_t get_space_left();
+
+        void write8(uint8_t value);
+        void write16(uint16_t value);
+        void write32(uint32_t value);
+        void write64(uint64_t value);
+};
+
+inline uint8_t* JitCache::get_current_addr()
+{
+    return block + used;
+}
+
+inline size_t JitCache::get_space_left()
+{
+    return size - used;
+}
+
+inline void JitCache::write8(uint8_t value)
+{
+    block[used] = value;
+    used++;
+}
+
+inline void JitCache::write16(uint16_t value)
+{
+    *(uint16_t*)&block[used] = value;
+    used += 2;
+}
+
+inline void JitCache::write32(uint32_t value)
+{
+    *(uint32_t*)&block[used] = value;
+    used += 4;
+}
+
+inline void JitCache::write64(uint64_t value)
+{
+    *(uint64_t*)&block[used] = value;
+    used += 8;
+}
+
+#endif // JITCACHE_HPP
@@ -0,0 +1,178 @@
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "logger.hpp"
+
+//Loggers that get this far ahead of the writer wait for it to catch up
+#define MAX_BACKLOG (1024 * 1024)
+
+#define ALL_SUBSYSTEMS ((1 << LOG_SUBSYSTEM_COUNT) - 1)
+
+namespace Logger
+{
+    //Debug messages are off until asked for
+    std::atomic<uint32_t> enabled_masks[LOG_LEVEL_COUNT] = {{0}, {ALL_SUBSYSTEMS}, {ALL_SUBSYSTEMS}, {ALL_SUBSYSTEMS}};
+
+    //Never destroyed, as other threads may still be logging while the program exits
+    struct Writer
+    {
+        std::thread thread;
+        std::mutex queue_lock;
+        std::condition_variable queue_cond;
+        std::string queue;
+
+        //Held while writing so that flush() doesn't overtake the writer thread
+        std::mutex output_lock;
+    };
+
+    static Writer* writer = nullptr;
+    static std::once_flag writer_started;
+
+    static const char* level_names[] = {"debug", "info", "warning", "error"};
+    static const char* subsystem_names[] =
+    {
+        "emu", "ee", "jit", "bios", "dmac", "gif", "gs", "intc", "timers", "vu",
+        "iop", "iopdma", "ioptimers", "cdvd", "sif", "sio2", "mmio"
+    };
+
+    static void writer_loop()
+    {
+        std::string output;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(writer->queue_lock);
+                writer->queue_cond.wait(lock, [] { return !writer->queue.empty(); });
+            }
+
+            //Always taken before queue_lock, same as in flush()
+            std::lock_guard<std::mutex> output_guard(writer->output_lock);
+            {
+                std::lock_guard<std::mutex> lock(writer->queue_lock);
+                output.swap(writer->queue);
+            }
+            writer->queue_cond.notify_all();
+            fwrite(output.data(), 1, output.size(), stdout);
+            fflush(stdout);
+            output.clear();
+        }
+    }
+
+    static void start_writer()
+    {
+        writer = new Writer();
+        writer->thread = std::thread(writer_loop);
+        writer->thread.detach();
+        atexit(flush);
+    }
+
+    void write(const char* format, ...)
+    {
+        char buffer[1024];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length < 0)
+            return;
+        if (length >= (int)sizeof(buffer))
+            length = sizeof(buffer) - 1;
+
+        std::call_once(writer_started, start_writer);
+        std::unique_lock<std::mutex> lock(writer->queue_lock);
+        writer->queue_cond.wait(lock, [] { return writer->queue.size() < MAX_BACKLOG; });
+        bool was_empty = writer->queue.empty();
+        writer->queue.append(buffer, length);
+        if (was_empty)
+            writer->queue_cond.notify_all();
+    }
+
+    void set_level(LOG_SUBSYSTEM subsystem, LOG_LEVEL level)
+    {
+        for (int i = 0; i < LOG_LEVEL_COUNT; i++)
+        {
+            if (i >= level)
+                enabled_masks[i] |= 1 << subsystem;
+            else
+                enabled_masks[i] &= ~(1 << subsystem);
+        }
+    }
+
+    void set_level(LOG_LEVEL level)
+    {
+        for (int i = 0; i < LOG_SUBSYSTEM_COUNT; i++)
+            set_level((LOG_SUBSYSTEM)i, level);
+    }
+
+    static int find_name(const char* const* names, int count, const std::string& name)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (name == names[i])
+                return i;
+        }
+        return -1;
+    }
+
+    bool configure(const char* filter)
+    {
+        bool valid = true;
+        std::string list(filter);
+        size_t start = 0;
+        while (start <= list.size())
+        {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos)
+                end = list.size();
+            std::string entry = list.substr(start, end - start);
+            start = end + 1;
+            if (entry.empty())
+                continue;
+
+            size_t equals = entry.find('=');
+            std::string subsystem_name = (equals == std::string::npos) ? "" : entry.substr(0, equals);
+            std::string level_name = (equals == std::string::npos) ? entry : entry.substr(equals + 1);
+
+            int level = find_name(level_names, LOG_LEVEL_COUNT, level_name);
+            if (level < 0)
+            {
+                valid = false;
+                continue;
+            }
+            if (subsystem_name.empty() || subsystem_name == "all")
+            {
+                set_level((LOG_LEVEL)level);
+                continue;
+            }
+            int subsystem = find_name(subsystem_names, LOG_SUBSYSTEM_COUNT, subsystem_name);
+            if (subsystem < 0)
+            {
+                valid = false;
+                continue;
+            }
+            set_level((LOG_SUBSYSTEM)subsystem, (LOG_LEVEL)level);
+        }
+        return valid;
+    }
+
+    void flush()
+    {
+        if (!writer)
+            return;
+
+        //Whatever the writer thread has already taken is out once it lets go of the output
+        std::lock_guard<std::mutex> output_guard(writer->output_lock);
+        std::string output;
+        {
+            std::lock_guard<std::mutex> lock(writer->queue_lock);
+            output.swap(writer->queue);
+        }
+        writer->queue_cond.notify_all();
+        fwrite(output.data(), 1, output.size(), stdout);
+        fflush(stdout);
+    }
+};
@@ -0,0 +1,96 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+#include <atomic>
+#include <cstdint>
+
+/**
+Debug output for the core. Every message belongs to a subsystem and has a level, and each subsystem can be set to
+only show messages at or above some level.
+
+Messages below LOG_MIN_LEVEL are compiled out entirely. For everything else, the macros check the subsystem's bit
+in that level's mask before evaluating any arguments, so a disabled message costs a single test and branch.
+Enabled messages are formatted right away and queued for a writer thread, which does the actual output, so the
+emulation threads never wait on the console.
+
+Like printf, messages supply their own line breaks.
+**/
+
+enum LOG_LEVEL
+{
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR,
+    LOG_LEVEL_COUNT
+};
+
+enum LOG_SUBSYSTEM
+{
+    LOG_EMU,
+    LOG_EE,
+    LOG_JIT,
+    LOG_BIOS,
+    LOG_DMAC,
+    LOG_GIF,
+    LOG_GS,
+    LOG_INTC,
+    LOG_TIMERS,
+    LOG_VU,
+    LOG_IOP,
+    LOG_IOP_DMA,
+    LOG_IOP_TIMERS,
+    LOG_CDVD,
+    LOG_SIF,
+    LOG_SIO2,
+    LOG_MMIO,
+    LOG_SUBSYSTEM_COUNT
+};
+
+//Build with e.g. -DLOG_MIN_LEVEL=LOG_WARNING to strip out everything less severe
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_DEBUG
+#endif
+
+#if defined(__GNUC__)
+#define LOG_FORMAT(fmt, args) __attribute__((format(printf, fmt, args)))
+#else
+#define LOG_FORMAT(fmt, args)
+#endif
+
+#define LOG_MESSAGE(level, subsystem, ...) \
+    do \
+    { \
+        if ((level) >= LOG_MIN_LEVEL && Logger::is_enabled(level, subsystem)) \
+            Logger::write(__VA_ARGS__); \
+    } while (0)
+
+#define DEBUG_LOG(subsystem, ...) LOG_MESSAGE(LOG_DEBUG, subsystem, __VA_ARGS__)
+#define INFO_LOG(subsystem, ...) LOG_MESSAGE(LOG_INFO, subsystem, __VA_ARGS__)
+#define WARN_LOG(subsystem, ...) LOG_MESSAGE(LOG_WARNING, subsystem, __VA_ARGS__)
+#define ERROR_LOG(subsystem, ...) LOG_MESSAGE(LOG_ERROR, subsystem, __VA_ARGS__)
+
+namespace Logger
+{
+    //One bit per subsystem for each level
+    extern std::atomic<uint32_t> enabled_masks[LOG_LEVEL_COUNT];
+
+    inline bool is_enabled(LOG_LEVEL level, LOG_SUBSYSTEM subsystem)
+    {
+        return enabled_masks[level].load(std::memory_order_relaxed) & (1 << subsystem);
+    }
+
+    void write(const char* format, ...) LOG_FORMAT(1, 2);
+
+    //Shows messages at or above level
+    void set_level(LOG_SUBSYSTEM subsystem, LOG_LEVEL level);
+    void set_level(LOG_LEVEL level);
+
+    //Takes a comma-separated list of "level" or "subsystem=level", e.g. "warning,gs=debug,dmac=info".
+    //Returns false if anything in it wasn't recognized.
+    bool configure(const char* filter);
+
+    //Blocks until everything queued so far has been written out
+    void flush();
+};
+
+#endif // LOGGER_HPP
@@ -0,0 +1,117 @@
+#include <cstdlib>
+#include <cstring>
+#include "logger.hpp"
+#include "mmio.hpp"
+
+MMIOTable::MMIOTable(const char* name) : name(name)
+{
+    memset(directory, 0, sizeof(directory));
+
+    //Reserve ID 0 for "unmapped"
+    read_handlers.push_back(nullptr);
+    write_handlers.push_back(nullptr);
+    pure_reads.push_back(false);
+}
+
+MMIOTable::~MMIOTable()
+{
+    for (unsigned int i = 0; i < sizeof(directory) / sizeof(Page**); i++)
+    {
+        if (!directory[i])
+            continue;
+        for (int j = 0; j < TABLE_SIZE; j++)
+        {
+            Page* page = directory[i][j];
+            if (!page)
+                continue;
+            for (int k = 0; k < WIDTHS; k++)
+            {
+                delete[] page->reg_read[k];
+                delete[] page->reg_write[k];
+            }
+            delete page;
+        }
+        delete[] directory[i];
+    }
+}
+
+MMIOTable::Page* MMIOTable::get_or_add_page(uint32_t address)
+{
+    Page**& table = directory[address >> TABLE_SHIFT];
+    if (!table)
+        table = new Page*[TABLE_SIZE]();
+
+    Page*& page = table[(address >> PAGE_SHIFT) & (TABLE_SIZE - 1)];
+    if (!page)
+        page = new Page();
+    return page;
+}
+
+void MMIOTable::map(uint32_t start, uint32_t end, int width, bool write, uint16_t id)
+{
+    int index = get_width_index(width);
+    uint64_t addr = start;
+    while (addr < end)
+    {
+        Page* page = get_or_add_page(addr);
+        uint64_t page_end = (addr & ~(uint64_t)PAGE_MASK) + PAGE_SIZE;
+        uint64_t chunk_end = (end < page_end) ? end : page_end;
+
+        //Whole pages take a single page-wide handler, anything smaller is mapped register by register
+        if (!(addr & PAGE_MASK) && chunk_end == page_end)
+        {
+            uint16_t& page_id = write ? page->page_write[index] : page->page_read[index];
+            if (page_id)
+                WARN_LOG(LOG_MMIO, "[MMIO] %s: page $%08X is mapped twice for %d-bit %s\n", name, (uint32_t)addr,
+                         width * 8, write ? "writes" : "reads");
+            page_id = id;
+        }
+        else
+        {
+            uint16_t*& regs = write ? page->reg_write[index] : page->reg_read[index];
+            if (!regs)
+                regs = new uint16_t[PAGE_SIZE]();
+            for (uint64_t reg = addr; reg < chunk_end; reg++)
+            {
+                if (regs[reg & PAGE_MASK])
+                    WARN_LOG(LOG_MMIO, "[MMIO] %s: $%08X is mapped twice for %d-bit %s\n", name, (uint32_t)reg,
+                             width * 8, write ? "writes" : "reads");
+                regs[reg & PAGE_MASK] = id;
+            }
+        }
+        addr = chunk_end;
+    }
+}
+
+void MMIOTable::map_read(uint32_t address, int width, ReadHandler handler, bool pure)
+{
+    map_read_range(address, address + 1, width, handler, pure);
+}
+
+void MMIOTable::map_write(uint32_t address, int width, WriteHandler handler)
+{
+    map_write_range(address, address + 1, width, handler);
+}
+
+void MMIOTable::map_read_range(uint32_t start, uint32_t end, int width, ReadHandler handler, bool pure)
+{
+    if (read_handlers.size() > UINT16_MAX)
+    {
+        ERROR_LOG(LOG_MMIO, "[MMIO] %s: Out of read handlers!\n", name);
+        exit(1);
+    }
+    read_handlers.push_back(handler);
+    pure_reads.push_back(pure);
+    map(start, end, width, false, read_handlers.size() - 1);
+}
+
+void MMIOTable::map_write_range(uint32_t start, uint32_t end, int width, WriteHandler handler)
+{
+    if (write_handlers.size() > UINT16_MAX)
+    {
+        ERROR_LOG(LOG_MMIO, "[MMIO] %s: Out of write handlers!\n", name);
+        exit(1);
+    }
+    write_handlers.push_back(handler);
+    map(start, end, width, true, write_handlers.size() - 1);
+}
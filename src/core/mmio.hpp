@@ -0,0 +1,150 @@
+#ifndef MMIO_HPP
+#define MMIO_HPP
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+Dispatch table for memory-mapped registers. Devices register handlers for their registers, by exact address and
+access width, or for a whole range at once. Lookups are a page table walk and then an index into that page, so
+they cost the same no matter how many registers are mapped.
+
+Pages are 4 KB. A page keeps one table per access width, allocated the first time a single register of that width
+is mapped on it. Ranges that cover whole pages use a page-wide handler instead, which applies wherever no single
+register handler is set.
+
+Reads can be registered as pure, meaning they have no side effects and their value only changes when something
+else changes the device's state. Status registers are the usual case. Idle loop detection lets loops poll pure
+registers, but not ones like FIFOs where each read moves things along.
+
+Handlers are only registered during setup, so lookups don't need any locking.
+**/
+
+class MMIOTable
+{
+    public:
+        typedef std::function<uint64_t(uint32_t address)> ReadHandler;
+        typedef std::function<void(uint32_t address, uint64_t value)> WriteHandler;
+    private:
+        constexpr static int PAGE_SHIFT = 12;
+        constexpr static int PAGE_SIZE = 1 << PAGE_SHIFT;
+        constexpr static int PAGE_MASK = PAGE_SIZE - 1;
+        constexpr static int TABLE_SHIFT = 22;
+        constexpr static int TABLE_SIZE = 1 << (TABLE_SHIFT - PAGE_SHIFT);
+
+        //8, 16, 32, and 64-bit accesses
+        constexpr static int WIDTHS = 4;
+
+        //Handler IDs index into read_handlers and write_handlers. 0 is never used, so it means "unmapped".
+        struct Page
+        {
+            uint16_t page_read[WIDTHS];
+            uint16_t page_write[WIDTHS];
+            uint16_t* reg_read[WIDTHS];
+            uint16_t* reg_write[WIDTHS];
+        };
+
+        const char* name;
+        Page** directory[1 << (32 - TABLE_SHIFT)];
+        std::vector<ReadHandler> read_handlers;
+        std::vector<WriteHandler> write_handlers;
+        std::vector<bool> pure_reads;
+
+        static int get_width_index(int width);
+        Page* get_page(uint32_t address);
+        uint16_t get_read_id(uint32_t address, int width);
+        Page* get_or_add_page(uint32_t address);
+        void map(uint32_t start, uint32_t end, int width, bool write, uint16_t id);
+    public:
+        MMIOTable(const char* name);
+        ~MMIOTable();
+
+        //Width is the access size in bytes
+        void map_read(uint32_t address, int width, ReadHandler handler, bool pure = false);
+        void map_write(uint32_t address, int width, WriteHandler handler);
+
+        //Covers every address in [start, end)
+        void map_read_range(uint32_t start, uint32_t end, int width, ReadHandler handler, bool pure = false);
+        void map_write_range(uint32_t start, uint32_t end, int width, WriteHandler handler);
+
+        //Return false if nothing is mapped there
+        template <typename T> bool read(uint32_t address, T& value);
+        template <typename T> bool write(uint32_t address, T value);
+
+        bool is_pure_read(uint32_t address, int width);
+};
+
+inline int MMIOTable::get_width_index(int width)
+{
+    switch (width)
+    {
+        case 1:
+            return 0;
+        case 2:
+            return 1;
+        case 4:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+inline MMIOTable::Page* MMIOTable::get_page(uint32_t address)
+{
+    Page** table = directory[address >> TABLE_SHIFT];
+    if (!table)
+        return nullptr;
+    return table[(address >> PAGE_SHIFT) & (TABLE_SIZE - 1)];
+}
+
+//Width is the access size in bytes. Returns 0 if nothing is mapped there.
+inline uint16_t MMIOTable::get_read_id(uint32_t address, int width)
+{
+    Page* page = get_page(address);
+    if (!page)
+        return 0;
+
+    int index = get_width_index(width);
+    uint16_t id = 0;
+    if (page->reg_read[index])
+        id = page->reg_read[index][address & PAGE_MASK];
+    if (!id)
+        id = page->page_read[index];
+    return id;
+}
+
+template <typename T>
+inline bool MMIOTable::read(uint32_t address, T& value)
+{
+    uint16_t id = get_read_id(address, sizeof(T));
+    if (!id)
+        return false;
+    value = (T)read_handlers[id](address);
+    return true;
+}
+
+template <typename T>
+inline bool MMIOTable::write(uint32_t address, T value)
+{
+    Page* page = get_page(address);
+    if (!page)
+        return false;
+
+    int width = get_width_index(sizeof(T));
+    uint16_t id = 0;
+    if (page->reg_write[width])
+        id = page->reg_write[width][address & PAGE_MASK];
+    if (!id)
+        id = page->page_write[width];
+    if (!id)
+        return false;
+    write_handlers[id](address, value);
+    return true;
+}
+
+inline bool MMIOTable::is_pure_read(uint32_t address, int width)
+{
+    return pure_reads[get_read_id(address, width)];
+}
+
+#endif // MMIO_HPP
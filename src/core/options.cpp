@@ -0,0 +1,63 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "emulator.hpp"
+#include "logger.hpp"
+#include "options.hpp"
+
+namespace Options
+{
+    const char* USAGE = "[-skip] [-jit | -cached] [-fastmem] [-noidle] [-slice cycles] [-iopthread] [-gsthread] "
+                        "[-gsworkers count] [-gsjit] [-dmaburst quadwords] [-log filter] [-console file | stdout]";
+
+    int parse(Emulator* e, int argc, char** argv, int i, bool& skip_BIOS)
+    {
+        const char* flag = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(flag, "-skip") == 0)
+            skip_BIOS = true;
+        else if (strcmp(flag, "-jit") == 0)
+            e->set_ee_mode(CPU_MODE::JIT);
+        else if (strcmp(flag, "-cached") == 0)
+            e->set_ee_mode(CPU_MODE::CACHED_INTERPRETER);
+        else if (strcmp(flag, "-fastmem") == 0)
+            e->enable_fastmem();
+        else if (strcmp(flag, "-noidle") == 0)
+            e->set_idle_loop_detection(false);
+        else if (strcmp(flag, "-iopthread") == 0)
+            e->set_iop_threaded(true);
+        else if (strcmp(flag, "-gsthread") == 0)
+            e->set_gs_threaded(true);
+        else if (strcmp(flag, "-gsjit") == 0)
+            e->set_gs_jit(true);
+        else
+        {
+            //Everything else takes a value
+            if (!value)
+                return 0;
+            if (strcmp(flag, "-slice") == 0)
+                e->set_slice_cycles(atoi(value));
+            else if (strcmp(flag, "-gsworkers") == 0)
+                e->set_gs_worker_count(atoi(value));
+            else if (strcmp(flag, "-dmaburst") == 0)
+                e->set_dma_burst_length(atoi(value));
+            else if (strcmp(flag, "-log") == 0)
+            {
+                if (!Logger::configure(value))
+                    printf("Unrecognized log filter %s\n", value);
+            }
+            else if (strcmp(flag, "-console") == 0)
+            {
+                if (strcmp(value, "stdout") == 0)
+                    e->set_console_target(CONSOLE_STDOUT);
+                else if (!e->set_console_file(value))
+                    printf("Failed to open console log %s\n", value);
+            }
+            else
+                return 0;
+            return 2;
+        }
+        return 1;
+    }
+};
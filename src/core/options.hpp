@@ -0,0 +1,21 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+class Emulator;
+
+/**
+Command line flags for the emulator itself, shared by every frontend so that they all take the same ones. Frontends
+handle their own flags first and hand the rest over here.
+**/
+
+namespace Options
+{
+    //Usage text for the flags below, for frontends to print after their own
+    extern const char* USAGE;
+
+    //Applies the flag at argv[i] to e. -skip only sets skip_BIOS, as it is up to the frontend when to load things.
+    //Returns how many arguments were used (the flag and any value), or 0 if argv[i] isn't an emulator flag.
+    int parse(Emulator* e, int argc, char** argv, int i, bool& skip_BIOS);
+};
+
+#endif // OPTIONS_HPP
@@ -0,0 +1,128 @@
+#ifndef RINGBUFFER_HPP
+#define RINGBUFFER_HPP
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+/**
+Fixed-size FIFO of 32-bit words. It's safe for one producer and one consumer to use it at the same time from
+different threads without any locking, and costs next to nothing when used from a single thread.
+
+head and tail only ever count up and are masked on access, so a full buffer holds all SIZE words. Each is only
+written by one side, and each is aligned to its own cache line so the two sides don't bounce them around.
+
+Callers are expected to check size() or free_space() before pushing or popping.
+**/
+
+template <unsigned int SIZE>
+class RingBuffer
+{
+    private:
+        static_assert((SIZE & (SIZE - 1)) == 0, "RingBuffer size must be a power of two");
+        static const int CACHE_LINE_SIZE = 64;
+
+        //Written by the consumer
+        alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> head;
+
+        //Written by the producer
+        alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> tail;
+
+        alignas(CACHE_LINE_SIZE) uint32_t data[SIZE];
+    public:
+        RingBuffer();
+
+        void reset();
+        int size();
+        int free_space();
+
+        void push(uint32_t word);
+        void push_n(const uint32_t* words, int count);
+        void push_quad(const uint64_t* quad);
+        uint32_t pop();
+        void pop_n(uint32_t* words, int count);
+};
+
+template <unsigned int SIZE>
+inline RingBuffer<SIZE>::RingBuffer()
+{
+    reset();
+}
+
+//Not thread-safe; both sides must be stopped
+template <unsigned int SIZE>
+inline void RingBuffer<SIZE>::reset()
+{
+    head.store(0);
+    tail.store(0);
+}
+
+template <unsigned int SIZE>
+inline int RingBuffer<SIZE>::size()
+{
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+template <unsigned int SIZE>
+inline int RingBuffer<SIZE>::free_space()
+{
+    return SIZE - size();
+}
+
+template <unsigned int SIZE>
+inline void RingBuffer<SIZE>::push(uint32_t word)
+{
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    data[pos & (SIZE - 1)] = word;
+    tail.store(pos + 1, std::memory_order_release);
+}
+
+template <unsigned int SIZE>
+inline void RingBuffer<SIZE>::push_n(const uint32_t* words, int count)
+{
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    uint32_t start = pos & (SIZE - 1);
+
+    //At most two copies, one up to the end of the buffer and one for whatever wraps around
+    uint32_t first = SIZE - start;
+    if (first > (uint32_t)count)
+        first = count;
+    memcpy(&data[start], words, first * sizeof(uint32_t));
+    memcpy(&data[0], words + first, (count - first) * sizeof(uint32_t));
+    tail.store(pos + count, std::memory_order_release);
+}
+
+template <unsigned int SIZE>
+inline void RingBuffer<SIZE>::push_quad(const uint64_t* quad)
+{
+    uint32_t words[4];
+    words[0] = quad[0] & 0xFFFFFFFF;
+    words[1] = quad[0] >> 32;
+    words[2] = quad[1] & 0xFFFFFFFF;
+    words[3] = quad[1] >> 32;
+    push_n(words, 4);
+}
+
+template <unsigned int SIZE>
+inline uint32_t RingBuffer<SIZE>::pop()
+{
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    uint32_t word = data[pos & (SIZE - 1)];
+    head.store(pos + 1, std::memory_order_release);
+    return word;
+}
+
+template <unsigned int SIZE>
+inline void RingBuffer<SIZE>::pop_n(uint32_t* words, int count)
+{
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    uint32_t start = pos & (SIZE - 1);
+
+    uint32_t first = SIZE - start;
+    if (first > (uint32_t)count)
+        first = count;
+    memcpy(words, &data[start], first * sizeof(uint32_t));
+    memcpy(words + first, &data[0], (count - first) * sizeof(uint32_t));
+    head.store(pos + count, std::memory_order_release);
+}
+
+#endif // RINGBUFFER_HPP
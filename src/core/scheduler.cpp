@@ -0,0 +1,75 @@
+#include <algorithm>
+#include "scheduler.hpp"
+
+Scheduler::Scheduler()
+{
+    cycles = 0;
+    next_event_id = 0;
+}
+
+void Scheduler::reset()
+{
+    //Registered functions belong to the components and survive a reset; pending events don't
+    cycles = 0;
+    next_event_id = 0;
+    events.clear();
+}
+
+bool Scheduler::later(const SchedulerEvent& a, const SchedulerEvent& b)
+{
+    if (a.time != b.time)
+        return a.time > b.time;
+    return a.id > b.id;
+}
+
+int Scheduler::register_function(SchedulerFunc func)
+{
+    funcs.push_back(func);
+    return funcs.size() - 1;
+}
+
+void Scheduler::set_slice_progress(SliceProgressFunc func)
+{
+    slice_progress = func;
+}
+
+uint64_t Scheduler::add_event(int func_id, uint64_t delta, uint64_t param)
+{
+    SchedulerEvent event;
+    event.time = cycles + delta;
+    event.id = next_event_id;
+    event.func_id = func_id;
+    event.param = param;
+    next_event_id++;
+
+    events.push_back(event);
+    std::push_heap(events.begin(), events.end(), later);
+    return event.id;
+}
+
+void Scheduler::cancel_event(uint64_t event_id)
+{
+    for (auto it = events.begin(); it != events.end(); ++it)
+    {
+        if (it->id == event_id)
+        {
+            events.erase(it);
+            std::make_heap(events.begin(), events.end(), later);
+            return;
+        }
+    }
+}
+
+void Scheduler::advance(uint64_t delta)
+{
+    cycles += delta;
+
+    //Callbacks are free to schedule more events, including ones that are already due
+    while (!events.empty() && events.front().time <= cycles)
+    {
+        SchedulerEvent event = events.front();
+        std::pop_heap(events.begin(), events.end(), later);
+        events.pop_back();
+        funcs[event.func_id](event.param);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+Event scheduler. All timestamps are in EE cycles. The emulator keeps one for the EE side and one for the IOP side,
+so that the IOP can run on its own thread.
+
+Components register a callback once at construction, then schedule events against it as needed. The emulator
+asks how long it is until the next event, runs the CPUs for that long, then advances the scheduler, which fires
+every event that has come due in timestamp order. Events scheduled for the same cycle fire in the order they
+were added.
+
+The scheduler's own clock only moves between slices. Anything that needs the time partway through one, like a
+timer read by the CPU, uses get_current_cycles, which adds how far the CPU has gotten into the slice so far.
+
+Events are kept in a binary min-heap. There are only ever a handful pending at once, so cancelling is a linear
+search followed by a re-heapify.
+**/
+
+typedef std::function<void(uint64_t param)> SchedulerFunc;
+
+//Cycles the CPU has run so far in the current slice, 0 between slices
+typedef std::function<uint64_t()> SliceProgressFunc;
+
+struct SchedulerEvent
+{
+    uint64_t time;
+    uint64_t id;
+    int func_id;
+    uint64_t param;
+};
+
+class Scheduler
+{
+    private:
+        uint64_t cycles;
+        uint64_t next_event_id;
+        std::vector<SchedulerFunc> funcs;
+        std::vector<SchedulerEvent> events;
+        SliceProgressFunc slice_progress;
+
+        static bool later(const SchedulerEvent& a, const SchedulerEvent& b);
+    public:
+        Scheduler();
+
+        void reset();
+
+        int register_function(SchedulerFunc func);
+        void set_slice_progress(SliceProgressFunc func);
+        uint64_t add_event(int func_id, uint64_t delta, uint64_t param = 0);
+        void cancel_event(uint64_t event_id);
+
+        uint64_t get_cycles();
+        uint64_t get_current_cycles();
+        uint64_t cycles_until_next_event();
+        void advance(uint64_t delta);
+};
+
+inline uint64_t Scheduler::get_cycles()
+{
+    return cycles;
+}
+
+inline uint64_t Scheduler::get_current_cycles()
+{
+    if (!slice_progress)
+        return cycles;
+    return cycles + slice_progress();
+}
+
+inline uint64_t Scheduler::cycles_until_next_event()
+{
+    if (events.empty())
+        return UINT64_MAX;
+    if (events.front().time <= cycles)
+        return 0;
+    return events.front().time - cycles;
+}
+
+#endif // SCHEDULER_HPP
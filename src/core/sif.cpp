@@ -1,8 +1,13 @@
-#include <cstdio>
+#include "logger.hpp"
+#include "mmio.hpp"
 #include "sif.hpp"
 
 /**
  * TODO: What are the sizes of the SIF0/SIF1 DMAC FIFOs?
+ *
+ * The EE and IOP sides may live on different host threads. Each FIFO has exactly one producer and one consumer
+ * (SIF0: IOP DMA -> EE DMAC, SIF1: EE DMAC -> IOP DMA), so they're lock-free ring buffers, and a size check
+ * followed by a transfer of that many words stays valid. The registers are shared both ways and use the lock.
  */
 
 SubsystemInterface::SubsystemInterface()
@@ -12,9 +17,9 @@ SubsystemInterface::SubsystemInterface()
 
 void SubsystemInterface::reset()
 {
-    std::queue<uint32_t> empty, empty2;
-    SIF0_FIFO.swap(empty);
-    SIF1_FIFO.swap(empty2);
+    std::lock_guard<std::mutex> guard(lock);
+    SIF0_FIFO.reset();
+    SIF1_FIFO.reset();
     mscom = 0;
     smcom = 0;
     msflag = 0;
@@ -22,6 +27,72 @@ void SubsystemInterface::reset()
     control = 0;
 }
 
+void SubsystemInterface::map_EE_registers(MMIOTable* mmio, std::function<void()> sync)
+{
+    mmio->map_read(0x1000F200, 4, [this, sync] (uint32_t addr) { sync(); return get_mscom(); }, true);
+    mmio->map_read(0x1000F210, 4, [this, sync] (uint32_t addr) { sync(); return get_smcom(); }, true);
+    mmio->map_read(0x1000F220, 4, [this, sync] (uint32_t addr) { sync(); return get_msflag(); }, true);
+    mmio->map_read(0x1000F230, 4, [this, sync] (uint32_t addr) { sync(); return get_smflag(); }, true);
+    mmio->map_read(0x1000F240, 4, [this, sync] (uint32_t addr)
+    {
+        sync();
+        uint32_t value = get_control() | 0xF0000102;
+        DEBUG_LOG(LOG_SIF, "[EE] Read BD4: $%08X\n", value);
+        return value;
+    });
+
+    mmio->map_write(0x1000F200, 4, [this, sync] (uint32_t addr, uint64_t value) { sync(); set_mscom(value); });
+    //smcom is read only for the EE
+    mmio->map_write(0x1000F210, 4, [sync] (uint32_t addr, uint64_t value) { sync(); });
+    mmio->map_write(0x1000F220, 4, [this, sync] (uint32_t addr, uint64_t value)
+    {
+        sync();
+        DEBUG_LOG(LOG_SIF, "[EE] Write32 msflag: $%08X\n", (uint32_t)value);
+        set_msflag(value);
+    });
+    mmio->map_write(0x1000F230, 4, [this, sync] (uint32_t addr, uint64_t value)
+    {
+        sync();
+        DEBUG_LOG(LOG_SIF, "[EE] Write32 smflag: $%08X\n", (uint32_t)value);
+        reset_smflag(value);
+    });
+    mmio->map_write(0x1000F240, 4, [this, sync] (uint32_t addr, uint64_t value)
+    {
+        sync();
+        DEBUG_LOG(LOG_SIF, "[EE] Write BD4: $%08X\n", (uint32_t)value);
+        set_control_EE(value);
+    });
+}
+
+void SubsystemInterface::map_IOP_registers(MMIOTable* mmio)
+{
+    mmio->map_read(0x1D000000, 4, [this] (uint32_t addr) { return get_mscom(); }, true);
+    mmio->map_read(0x1D000010, 4, [this] (uint32_t addr) { return get_smcom(); }, true);
+    mmio->map_read(0x1D000020, 4, [this] (uint32_t addr) { return get_msflag(); }, true);
+    mmio->map_read(0x1D000030, 4, [this] (uint32_t addr) { return get_smflag(); }, true);
+    mmio->map_read(0x1D000040, 4, [this] (uint32_t addr)
+    {
+        uint32_t value = get_control() | 0xF0000002;
+        DEBUG_LOG(LOG_SIF, "[IOP] Read BD4: $%08X\n", value);
+        return value;
+    });
+
+    //mscom is read only for the IOP
+    mmio->map_write(0x1D000000, 4, [] (uint32_t addr, uint64_t value) { });
+    mmio->map_write(0x1D000010, 4, [this] (uint32_t addr, uint64_t value) { set_smcom(value); });
+    mmio->map_write(0x1D000020, 4, [this] (uint32_t addr, uint64_t value) { reset_msflag(value); });
+    mmio->map_write(0x1D000030, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_SIF, "[IOP] Set smflag: $%08X\n", (uint32_t)value);
+        set_smflag(value);
+    });
+    mmio->map_write(0x1D000040, 4, [this] (uint32_t addr, uint64_t value)
+    {
+        DEBUG_LOG(LOG_SIF, "[IOP] Write BD4: $%08X\n", (uint32_t)value);
+        set_control_IOP(value);
+    });
+}
+
 int SubsystemInterface::get_SIF0_size()
 {
     return SIF0_FIFO.size();
@@ -32,92 +103,95 @@ int SubsystemInterface::get_SIF1_size()
     return SIF1_FIFO.size();
 }
 
-void SubsystemInterface::write_SIF0(uint32_t word)
+void SubsystemInterface::write_SIF0(uint32_t* words, int count)
 {
-    SIF0_FIFO.push(word);
-    printf("[SIF0] Word: $%08X\n", word);
+    SIF0_FIFO.push_n(words, count);
 }
 
-void SubsystemInterface::write_SIF1(uint64_t *quad)
+void SubsystemInterface::write_SIF1(uint128_t quad)
 {
-    SIF1_FIFO.push(quad[0] & 0xFFFFFFFF);
-    SIF1_FIFO.push(quad[0] >> 32);
-    SIF1_FIFO.push(quad[1] & 0xFFFFFFFF);
-    SIF1_FIFO.push(quad[1] >> 32);
-    printf("[SIF1] Quad: $%08X_%08X_%08X_%08X\n", quad[1] >> 32, quad[1], quad[0] >> 32, quad[0]);
+    SIF1_FIFO.push_quad(quad._u64);
 }
 
-uint32_t SubsystemInterface::read_SIF0()
+void SubsystemInterface::read_SIF0(uint32_t* words, int count)
 {
-    uint32_t value = SIF0_FIFO.front();
-    SIF0_FIFO.pop();
-    return value;
+    SIF0_FIFO.pop_n(words, count);
 }
 
-uint32_t SubsystemInterface::read_SIF1()
+void SubsystemInterface::read_SIF1(uint32_t* words, int count)
 {
-    uint32_t value = SIF1_FIFO.front();
-    SIF1_FIFO.pop();
-    return value;
+    SIF1_FIFO.pop_n(words, count);
 }
 
 uint32_t SubsystemInterface::get_mscom()
 {
+    std::lock_guard<std::mutex> guard(lock);
     return mscom;
 }
 
 uint32_t SubsystemInterface::get_smcom()
 {
+    std::lock_guard<std::mutex> guard(lock);
     return smcom;
 }
 
 uint32_t SubsystemInterface::get_msflag()
 {
+    std::lock_guard<std::mutex> guard(lock);
     return msflag;
 }
 
 uint32_t SubsystemInterface::get_smflag()
 {
+    std::lock_guard<std::mutex> guard(lock);
     return smflag;
 }
 
 uint32_t SubsystemInterface::get_control()
 {
+    std::lock_guard<std::mutex> guard(lock);
     return control;
 }
 
 void SubsystemInterface::set_mscom(uint32_t value)
 {
+    std::lock_guard<std::mutex> guard(lock);
     mscom = value;
 }
 
 void SubsystemInterface::set_smcom(uint32_t value)
 {
+    std::lock_guard<std::mutex> guard(lock);
     smcom = value;
 }
 
 void SubsystemInterface::set_msflag(uint32_t value)
 {
+    std::lock_guard<std::mutex> guard(lock);
     msflag |= value;
 }
 
 void SubsystemInterface::reset_msflag(uint32_t value)
 {
+    std::lock_guard<std::mutex> guard(lock);
     msflag &= ~value;
 }
 
 void SubsystemInterface::set_smflag(uint32_t value)
 {
+    std::lock_guard<std::mutex> guard(lock);
     smflag |= value;
 }
 
 void SubsystemInterface::reset_smflag(uint32_t value)
 {
+    std::lock_guard<std::mutex> guard(lock);
     smflag &= ~value;
 }
 
 void SubsystemInterface::set_control_EE(uint32_t value)
 {
+    std::lock_guard<std::mutex> guard(lock);
     if (!(value & 0x100))
         control &= ~0x100;
     else
@@ -126,6 +200,7 @@ void SubsystemInterface::set_control_EE(uint32_t value)
 
 void SubsystemInterface::set_control_IOP(uint32_t value)
 {
+    std::lock_guard<std::mutex> guard(lock);
     uint8_t bark = value & 0xF0;
 
     if (value & 0xA0)
@@ -1,31 +1,43 @@
 #ifndef SIF_HPP
 #define SIF_HPP
 #include <cstdint>
-#include <queue>
+#include <functional>
+#include <mutex>
+#include "int128.hpp"
+#include "ringbuffer.hpp"
+
+class MMIOTable;
 
 class SubsystemInterface
 {
+    public:
+        constexpr static int MAX_FIFO_SIZE = 32;
     private:
         uint32_t mscom;
         uint32_t smcom;
         uint32_t msflag;
         uint32_t smflag;
         uint32_t control; //???
+        std::mutex lock;
 
-        std::queue<uint32_t> SIF0_FIFO;
-        std::queue<uint32_t> SIF1_FIFO;
+        RingBuffer<MAX_FIFO_SIZE> SIF0_FIFO;
+        RingBuffer<MAX_FIFO_SIZE> SIF1_FIFO;
     public:
-        constexpr static int MAX_FIFO_SIZE = 32;
         SubsystemInterface();
 
         void reset();
+
+        //Both CPUs see the same registers. sync is called before each EE access so that the IOP is caught up.
+        //The IOP never runs ahead of the EE, so its side needs nothing of the sort.
+        void map_EE_registers(MMIOTable* mmio, std::function<void()> sync);
+        void map_IOP_registers(MMIOTable* mmio);
         int get_SIF0_size();
         int get_SIF1_size();
 
-        void write_SIF0(uint32_t word);
-        void write_SIF1(uint64_t* quad);
-        uint32_t read_SIF0();
-        uint32_t read_SIF1();
+        void write_SIF0(uint32_t* words, int count);
+        void write_SIF1(uint128_t quad);
+        void read_SIF0(uint32_t* words, int count);
+        void read_SIF1(uint32_t* words, int count);
 
         uint32_t get_mscom();
         uint32_t get_smcom();
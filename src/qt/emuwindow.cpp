@@ -6,6 +6,7 @@
 #include <QString>
 
 #include "emuwindow.hpp"
+#include "../core/options.hpp"
 
 using namespace std;
 
@@ -26,23 +27,29 @@ int EmuWindow::init(int argc, char** argv)
 {
     if (argc < 3)
     {
-        printf("Args: [BIOS] [ELF/ISO]\n");
+        printf("Args: [BIOS] [ELF/ISO] %s\n", Options::USAGE);
         return 1;
     }
 
-    //Initialize emulator
-    e.reset();
     char* bios_name = argv[1];
     char* file_name = argv[2];
 
     bool skip_BIOS = false;
-    //Flag parsing - to be reworked
-    if (argc >= 4)
+    for (int i = 3; i < argc; i++)
     {
-        if (strcmp(argv[3], "-skip") == 0)
-            skip_BIOS = true;
+        int used = Options::parse(&e, argc, argv, i, skip_BIOS);
+        if (!used)
+        {
+            printf("Unrecognized argument %s\n", argv[i]);
+            printf("Args: [BIOS] [ELF/ISO] %s\n", Options::USAGE);
+            return 1;
+        }
+        i += used - 1;
     }
 
+    //Initialize emulator
+    e.reset();
+
     ifstream BIOS_file(bios_name, ios::binary | ios::in);
     if (!BIOS_file.is_open())
     {
@@ -147,6 +154,7 @@ void EmuWindow::closeEvent(QCloseEvent *event)
 {
     event->accept();
     is_running = false;
+    e.print_idle_loop_stats();
 }
 
 double EmuWindow::get_frame_rate()